@@ -0,0 +1,116 @@
+#include "Benchmark.hpp"
+
+#include "json_string.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+void Benchmark::add(std::string const &name, double value)
+{
+	auto found = std::find_if(series.begin(), series.end(), [&](Series const &s)
+							  { return s.name == name; });
+	if (found == series.end())
+	{
+		series.emplace_back(Series{.name = name, .values = {}});
+		found = series.end() - 1;
+	}
+	found->values.emplace_back(value);
+}
+
+Benchmark::Summary Benchmark::summarize(std::vector<double> values)
+{
+	Summary summary;
+	summary.count = values.size();
+	if (values.empty())
+		return summary;
+
+	std::sort(values.begin(), values.end());
+	// smallest value with at least fraction of the values at or below it:
+	auto rank = [&](double fraction)
+	{
+		size_t index = size_t(std::ceil(fraction * double(values.size())));
+		return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+	};
+	summary.min = values.front();
+	summary.median = rank(0.50);
+	summary.p95 = rank(0.95);
+	summary.p99 = rank(0.99);
+	summary.mean = std::accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+	return summary;
+}
+
+void Benchmark::print(std::ostream &out) const
+{
+	out << "Benchmark: " << measured_frames << " frames (after " << warmup_frames << " warm-up) at dt " << dt << " on " << device << "\n";
+	out << "  " << std::left << std::setw(24) << "series" << std::right
+		<< std::setw(10) << "min" << std::setw(10) << "median" << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "mean" << "\n";
+	for (Series const &s : series)
+	{
+		Summary summary = summarize(s.values);
+		out << "  " << std::left << std::setw(24) << s.name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << summary.min << std::setw(10) << summary.median << std::setw(10) << summary.p95
+			<< std::setw(10) << summary.p99 << std::setw(10) << summary.mean << "\n";
+		out.unsetf(std::ios::floatfield);
+	}
+	out.flush();
+}
+
+void Benchmark::write(std::string const &path) const
+{
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("Failed to open benchmark output '" + path + "'.");
+	file << std::setprecision(9);
+
+	if (path.ends_with(".csv"))
+	{
+		// RFC 4180 quoting: device names have commas in them ("llvmpipe (LLVM 15.0.7, 256 bits)"):
+		auto field = [](std::string const &str)
+		{
+			if (str.find_first_of(",\"\r\n") == std::string::npos)
+				return str;
+			std::string ret = "\"";
+			for (char c : str)
+			{
+				if (c == '"')
+					ret += '"';
+				ret += c;
+			}
+			return ret + "\"";
+		};
+
+		// the run's settings repeat on every row, so files from different builds and devices can simply be concatenated:
+		file << "device,warmup_frames,measured_frames,dt,series,count,min,median,p95,p99,mean\n";
+		for (Series const &s : series)
+		{
+			Summary summary = summarize(s.values);
+			file << field(device) << ',' << warmup_frames << ',' << measured_frames << ',' << dt << ','
+				 << field(s.name) << ',' << summary.count << ',' << summary.min << ',' << summary.median << ','
+				 << summary.p95 << ',' << summary.p99 << ',' << summary.mean << '\n';
+		}
+	}
+	else
+	{
+		file << "{\n";
+		file << "\t\"device\": " << json_string(device) << ",\n";
+		file << "\t\"warmup_frames\": " << warmup_frames << ",\n";
+		file << "\t\"measured_frames\": " << measured_frames << ",\n";
+		file << "\t\"dt\": " << dt << ",\n";
+		file << "\t\"series\": {";
+		for (size_t i = 0; i < series.size(); ++i)
+		{
+			Summary summary = summarize(series[i].values);
+			file << (i ? ",\n" : "\n") << "\t\t" << json_string(series[i].name) << ": { "
+				 << "\"count\": " << summary.count << ", \"min\": " << summary.min << ", \"median\": " << summary.median
+				 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"mean\": " << summary.mean << " }";
+		}
+		file << "\n\t}\n}\n";
+	}
+
+	if (!file)
+		throw std::runtime_error("Failed to write benchmark output '" + path + "'.");
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// per-frame measurements from RTG::run's benchmark mode (--benchmark): named series of values (times in milliseconds),
+// summarized as percentiles and written as JSON or CSV so runs can be compared across builds and devices
+struct Benchmark
+{
+	struct Series
+	{
+		std::string name;
+		std::vector<double> values;
+	};
+	std::vector<Series> series; // in the order they were first added
+
+	// appends value to the named series, creating it if needed:
+	void add(std::string const &name, double value);
+
+	struct Summary
+	{
+		size_t count = 0;
+		double min = 0.0;
+		double median = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double mean = 0.0;
+	};
+	static Summary summarize(std::vector<double> values); // nearest-rank percentiles
+
+	// what the numbers were measured on, written alongside them:
+	std::string device;
+	uint32_t warmup_frames = 0;
+	uint32_t measured_frames = 0;
+	float dt = 0.0f;
+
+	void print(std::ostream &) const;
+	// .csv writes one row per series (each starting with the fields above), anything else JSON; throws on failure:
+	void write(std::string const &path) const;
+};
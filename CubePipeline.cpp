@@ -15,6 +15,10 @@ static uint32_t comp_irradiance[] =
 static uint32_t comp_specular[] =
 #include "spv/ggx.comp.inl"
     ;
+
+static uint32_t comp_sh[] =
+#include "spv/sh_project.comp.inl"
+    ;
 ;
 ;
 
@@ -116,6 +120,49 @@ void CubePipeline::create(RTG &rtg)
         VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &brdf_layout));
     }
 
+    {
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+        };
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data(),
+        };
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_sh));
+    }
+
+    {
+        VkPushConstantRange range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(SHPush),
+        };
+
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &set0_sh,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &range,
+        };
+
+        VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &sh_layout));
+    }
+
     auto make_compute = [&](uint32_t const *code, size_t bytes, VkPipelineLayout layout, VkPipeline *out)
     {
         VkShaderModule mod = rtg.helpers.create_shader_module(code, bytes);
@@ -133,13 +180,14 @@ void CubePipeline::create(RTG &rtg)
             .layout = layout,
         };
 
-        VK(vkCreateComputePipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, out));
+        VK(vkCreateComputePipelines(rtg.device, rtg.pipeline_cache, 1, &create_info, nullptr, out));
         vkDestroyShaderModule(rtg.device, mod, nullptr);
     };
 
     make_compute(comp_irradiance, sizeof(comp_irradiance), irradiance_layout, &irradiance_pipeline);
     make_compute(comp_specular, sizeof(comp_specular), specular_layout, &specular_pipeline);
     make_compute(comp_brdf, sizeof(comp_brdf), brdf_layout, &brdf_pipeline);
+    make_compute(comp_sh, sizeof(comp_sh), sh_layout, &sh_pipeline);
 }
 
 void CubePipeline::destroy(RTG &rtg)
@@ -151,12 +199,16 @@ void CubePipeline::destroy(RTG &rtg)
         vkDestroyPipeline(rtg.device, specular_pipeline, nullptr);
     if (brdf_pipeline)
         vkDestroyPipeline(rtg.device, brdf_pipeline, nullptr);
+    if (sh_pipeline)
+        vkDestroyPipeline(rtg.device, sh_pipeline, nullptr);
     if (irradiance_layout)
         vkDestroyPipelineLayout(rtg.device, irradiance_layout, nullptr);
     if (specular_layout)
         vkDestroyPipelineLayout(rtg.device, specular_layout, nullptr);
     if (brdf_layout)
         vkDestroyPipelineLayout(rtg.device, brdf_layout, nullptr);
+    if (sh_layout)
+        vkDestroyPipelineLayout(rtg.device, sh_layout, nullptr);
 
     irradiance_pipeline = VK_NULL_HANDLE;
     specular_pipeline = VK_NULL_HANDLE;
@@ -164,6 +216,13 @@ void CubePipeline::destroy(RTG &rtg)
     irradiance_layout = VK_NULL_HANDLE;
     specular_layout = VK_NULL_HANDLE;
     brdf_layout = VK_NULL_HANDLE;
+    sh_pipeline = VK_NULL_HANDLE;
+    sh_layout = VK_NULL_HANDLE;
+    if (set0_sh != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set0_sh, nullptr);
+        set0_sh = VK_NULL_HANDLE;
+    }
     if (set1_brdf != VK_NULL_HANDLE)
     {
         vkDestroyDescriptorSetLayout(rtg.device, set1_brdf, nullptr);
@@ -7,11 +7,14 @@ struct CubePipeline
 	// descriptor set layouts:
 	VkDescriptorSetLayout set0_env = VK_NULL_HANDLE;  // used for input
 	VkDescriptorSetLayout set1_brdf = VK_NULL_HANDLE; // used for ggx only
+	VkDescriptorSetLayout set0_sh = VK_NULL_HANDLE;	  // input cubemap + buffer of per-workgroup partial sums
 
 	struct IrradiancePush
 	{
 		uint32_t size;
 		uint32_t numSamples;
+		uint32_t originX; // first texel of the tile being dispatched
+		uint32_t originY;
 	};
 
 	struct SpecularPush // GGX
@@ -19,9 +22,18 @@ struct CubePipeline
 		uint32_t size;
 		uint32_t numSamples;
 		float roughness;
-		float pad;
+		float mipBias; // source level bias for filtered importance sampling
+		uint32_t originX; // first texel of the tile being dispatched
+		uint32_t originY;
 	};
 
+	struct SHPush
+	{
+		uint32_t size;
+	};
+	// sh_project.comp: 16x16 texels per workgroup, 9 vec4 partial sums out of each
+	static constexpr uint32_t SHTile = 16;
+
 	struct BrdfPush
 	{ // brdf_lut
 		uint32_t size;
@@ -34,6 +46,9 @@ struct CubePipeline
 	VkPipelineLayout specular_layout = VK_NULL_HANDLE;
 	VkPipeline specular_pipeline = VK_NULL_HANDLE;
 
+	VkPipelineLayout sh_layout = VK_NULL_HANDLE;
+	VkPipeline sh_pipeline = VK_NULL_HANDLE;
+
 	VkPipelineLayout brdf_layout = VK_NULL_HANDLE;
 	VkPipeline brdf_pipeline = VK_NULL_HANDLE;
 
@@ -0,0 +1,190 @@
+#include "Render.hpp"
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+// layout: Header, then every field below in the order write_frame_capture() lists them; vectors are a uint64_t count
+// followed by their elements. Values are written as they sit in memory, so captures only replay on the same endianness.
+
+namespace
+{
+	template <typename T>
+	void write_pod(std::ofstream &out, T const &value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "written byte-for-byte");
+		out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+	}
+
+	template <typename T>
+	void write_vector(std::ofstream &out, std::vector<T> const &values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "written byte-for-byte");
+		write_pod(out, uint64_t(values.size()));
+		out.write(reinterpret_cast<char const *>(values.data()), std::streamsize(values.size() * sizeof(T)));
+	}
+
+	template <typename T>
+	void read_pod(std::ifstream &in, std::string const &path, T &value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "read byte-for-byte");
+		if (!in.read(reinterpret_cast<char *>(&value), sizeof(T)))
+			throw std::runtime_error("Frame capture '" + path + "' is truncated.");
+	}
+
+	template <typename T>
+	void read_vector(std::ifstream &in, std::string const &path, std::vector<T> &values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "read byte-for-byte");
+		uint64_t count = 0;
+		read_pod(in, path, count);
+		if (count > (uint64_t(1) << 32))
+			throw std::runtime_error("Frame capture '" + path + "' has an implausible array of " + std::to_string(count) + " elements.");
+		values.resize(size_t(count));
+		if (!in.read(reinterpret_cast<char *>(values.data()), std::streamsize(values.size() * sizeof(T))))
+			throw std::runtime_error("Frame capture '" + path + "' is truncated.");
+	}
+} // namespace
+
+void Render::write_frame_capture(std::string const &path) const
+{
+	TRACE_ZONE("Render::write_frame_capture");
+
+	FrameCapture::Header header;
+	header.meshes = uint32_t(scene.meshes.size());
+	header.materials = uint32_t(scene.materials.size());
+	header.vertices_count = scene.vertices_count;
+	header.lights = uint32_t(scene.lights.size());
+	header.shadowed_spot_lights = uint32_t(scene.spot_lights_sorted_indices.size());
+	header.camera_mode = uint32_t(camera_mode);
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		throw std::runtime_error("Failed to open '" + path + "' for writing.");
+
+	write_pod(out, header);
+	write_pod(out, CLIP_FROM_WORLD);
+	write_pod(out, world);
+	write_pod(out, time);
+	write_vector(out, lines_vertices);
+
+	write_vector(out, sun_lights);
+	write_vector(out, sphere_lights);
+	write_vector(out, spot_lights);
+	write_vector(out, spot_light_from_world);
+	write_vector(out, shadow_atlas.regions);
+	write_vector(out, light_clusters.ranges);
+	write_vector(out, light_clusters.indices);
+
+	write_vector(out, lambertian_instances);
+	write_vector(out, environment_instances);
+	write_vector(out, mirror_instances);
+	write_vector(out, pbr_instances);
+	write_pod(out, uint64_t(in_spot_light_instances.size()));
+	for (std::array<std::vector<uint32_t>, 4> const &lists : in_spot_light_instances)
+	{
+		for (std::vector<uint32_t> const &list : lists)
+			write_vector(out, list);
+	}
+
+	if (!out)
+		throw std::runtime_error("Failed to write frame capture '" + path + "'.");
+}
+
+void Render::read_frame_capture(std::string const &path)
+{
+	TRACE_ZONE("Render::read_frame_capture");
+
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		throw std::runtime_error("Failed to open frame capture '" + path + "'.");
+
+	FrameCapture::Header header;
+	read_pod(in, path, header);
+	if (std::memcmp(header.magic, FrameCapture::Header().magic, 4) != 0 || header.version != FrameCapture::Header().version)
+		throw std::runtime_error("'" + path + "' is not a frame capture (or was written by a different version).");
+	if (header.meshes != scene.meshes.size() || header.materials != scene.materials.size() || header.vertices_count != scene.vertices_count || header.lights != scene.lights.size() || header.shadowed_spot_lights != scene.spot_lights_sorted_indices.size())
+		throw std::runtime_error("Frame capture '" + path + "' was made with a different scene than '" + scene.scene_path + "'.");
+	if (header.camera_mode > uint32_t(CameraMode::Debug))
+		throw std::runtime_error("Frame capture '" + path + "' has an unknown camera mode.");
+	camera_mode = CameraMode(header.camera_mode);
+
+	read_pod(in, path, CLIP_FROM_WORLD);
+	{ // keep what was computed at load (the capture's copies describe the same scene, but maybe another build's environment):
+		ObjectsPipeline::World loaded = world;
+		read_pod(in, path, world);
+		world.ENVIRONMENT_MIPS = loaded.ENVIRONMENT_MIPS;
+		world.SHADOW_ATLAS_SIZE = loaded.SHADOW_ATLAS_SIZE;
+		std::copy(std::begin(loaded.IRRADIANCE_SH), std::end(loaded.IRRADIANCE_SH), std::begin(world.IRRADIANCE_SH));
+	}
+	read_pod(in, path, time);
+	read_vector(in, path, lines_vertices);
+
+	read_vector(in, path, sun_lights);
+	read_vector(in, path, sphere_lights);
+	read_vector(in, path, spot_lights);
+	read_vector(in, path, spot_light_from_world);
+	read_vector(in, path, shadow_atlas.regions);
+	read_vector(in, path, light_clusters.ranges);
+	read_vector(in, path, light_clusters.indices);
+	if (sun_lights.size() != world.SUN_LIGHT_COUNT || sphere_lights.size() != world.SPHERE_LIGHT_COUNT || spot_lights.size() != world.SPOT_LIGHT_COUNT || spot_light_from_world.size() != header.shadowed_spot_lights || shadow_atlas.regions.size() != spot_lights.size() || light_clusters.ranges.size() != LightClusters::cluster_count)
+		throw std::runtime_error("Frame capture '" + path + "' has inconsistent light arrays.");
+
+	read_vector(in, path, lambertian_instances);
+	read_vector(in, path, environment_instances);
+	read_vector(in, path, mirror_instances);
+	read_vector(in, path, pbr_instances);
+	uint64_t lights_count = 0;
+	read_pod(in, path, lights_count);
+	if (lights_count != header.shadowed_spot_lights)
+		throw std::runtime_error("Frame capture '" + path + "' has inconsistent light arrays.");
+	in_spot_light_instances.assign(size_t(lights_count), {});
+	for (std::array<std::vector<uint32_t>, 4> &lists : in_spot_light_instances)
+	{
+		for (std::vector<uint32_t> &list : lists)
+			read_vector(in, path, list);
+	}
+
+	{ // indices render() will follow must stay inside the scene's buffers:
+		std::array<std::vector<ObjectInstance> const *, 4> instance_lists{&lambertian_instances, &environment_instances, &mirror_instances, &pbr_instances};
+		for (std::vector<ObjectInstance> const *instances : instance_lists)
+		{
+			for (ObjectInstance const &inst : *instances)
+			{
+				if (inst.material_index >= header.materials || uint64_t(inst.vertices.first) + inst.vertices.count > header.vertices_count)
+					throw std::runtime_error("Frame capture '" + path + "' references geometry or materials outside the scene.");
+			}
+		}
+		for (std::array<std::vector<uint32_t>, 4> const &lists : in_spot_light_instances)
+		{
+			for (uint32_t list = 0; list < 4; ++list)
+			{
+				for (uint32_t index : lists[list])
+				{
+					if (index >= instance_lists[list]->size())
+						throw std::runtime_error("Frame capture '" + path + "' has an out-of-range shadow caster.");
+				}
+			}
+		}
+	}
+
+	// update() won't run the traversal, so the counters it would have filled describe the capture:
+	frame_stats.instances_visited = uint32_t(lambertian_instances.size() + environment_instances.size() + mirror_instances.size() + pbr_instances.size());
+	frame_stats.instances_culled_camera = 0;
+	frame_stats.instances_culled_light.assign(in_spot_light_instances.size(), 0);
+
+	require(Requirements{
+		.environment_map = !lambertian_instances.empty(),
+		.environment_pipeline = !environment_instances.empty(),
+		.mirror_pipeline = !mirror_instances.empty(),
+		.pbr = !pbr_instances.empty(),
+		.shadows = scene_has_shadows,
+	});
+
+	replaying = true;
+}
@@ -0,0 +1,57 @@
+#include "Render.hpp"
+
+#include "Benchmark.hpp"
+
+#include <iostream>
+
+void Render::FrameStats::reset_render()
+{
+	draws.fill(0);
+	pipeline_binds = 0;
+	descriptor_set_binds = 0;
+	triangles = 0;
+	shadow_regions = 0;
+	upload_bytes = 0;
+}
+
+void Render::FrameStats::add_to(Benchmark &benchmark) const
+{
+	uint32_t culled_light_total = 0;
+	for (uint32_t culled : instances_culled_light)
+		culled_light_total += culled;
+	uint32_t draws_total = 0;
+	for (uint32_t count : draws)
+		draws_total += count;
+
+	benchmark.add("stats_instances_visited", instances_visited);
+	benchmark.add("stats_instances_culled_camera", instances_culled_camera);
+	benchmark.add("stats_instances_culled_lights", culled_light_total);
+	for (uint32_t i = 0; i < instances_culled_light.size(); ++i)
+		benchmark.add("stats_instances_culled_light_" + std::to_string(i), instances_culled_light[i]);
+	benchmark.add("stats_draws", draws_total);
+	for (uint32_t pipeline = 0; pipeline < PipelineCount; ++pipeline)
+		benchmark.add("stats_draws_" + std::string(pipeline_names[pipeline]), draws[pipeline]);
+	benchmark.add("stats_pipeline_binds", pipeline_binds);
+	benchmark.add("stats_descriptor_set_binds", descriptor_set_binds);
+	benchmark.add("stats_triangles", double(triangles));
+	benchmark.add("stats_shadow_regions", shadow_regions);
+	benchmark.add("stats_upload_bytes", double(upload_bytes));
+}
+
+void Render::FrameStats::print(std::ostream &out) const
+{
+	uint32_t culled_light_total = 0;
+	for (uint32_t culled : instances_culled_light)
+		culled_light_total += culled;
+
+	out << "Frame: " << instances_visited << " instances, " << instances_culled_camera << " culled by the camera, "
+		<< culled_light_total << " culled by " << instances_culled_light.size() << " shadowed lights\n";
+	out << "  draws:";
+	for (uint32_t pipeline = 0; pipeline < PipelineCount; ++pipeline)
+	{
+		if (draws[pipeline] != 0)
+			out << " " << pipeline_names[pipeline] << " " << draws[pipeline];
+	}
+	out << "\n  " << pipeline_binds << " pipeline binds, " << descriptor_set_binds << " descriptor set binds, "
+		<< triangles << " triangles, " << shadow_regions << " shadow regions, " << upload_bytes << " bytes uploaded" << std::endl;
+}
@@ -0,0 +1,148 @@
+#include "Render.hpp"
+
+#include "Benchmark.hpp"
+#include "VK.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+// query 2 * pass is written before the pass's commands start, 2 * pass + 1 once they have all finished:
+
+void Render::GPUTimestamps::create(RTG &rtg, std::vector<Workspace> &workspaces)
+{
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(rtg.physical_device, &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(rtg.physical_device, &family_count, families.data());
+
+	uint32_t valid_bits = families.at(rtg.graphics_queue_family.value()).timestampValidBits;
+	if (valid_bits == 0)
+	{
+		if (rtg.configuration.gpu_timings)
+			std::cerr << "WARNING: the graphics queue can't write timestamps, --gpu-timings has nothing to report." << std::endl;
+		return;
+	}
+	valid_mask = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(rtg.physical_device, &properties);
+	ms_per_tick = double(properties.limits.timestampPeriod) * 1e-6;
+
+	report = rtg.configuration.gpu_timings;
+	report_start = std::chrono::steady_clock::now();
+
+	for (Workspace &workspace : workspaces)
+	{
+		VkQueryPoolCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = 2 * PassCount,
+		};
+		VK(vkCreateQueryPool(rtg.device, &create_info, nullptr, &workspace.timestamps));
+	}
+}
+
+void Render::GPUTimestamps::destroy(RTG &rtg, std::vector<Workspace> &workspaces)
+{
+	for (Workspace &workspace : workspaces)
+	{
+		if (workspace.timestamps != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(rtg.device, workspace.timestamps, nullptr);
+			workspace.timestamps = VK_NULL_HANDLE;
+		}
+		workspace.timestamps_pending = false;
+	}
+}
+
+bool Render::GPUTimestamps::read(RTG &rtg, Workspace &workspace)
+{
+	if (workspace.timestamps == VK_NULL_HANDLE || !workspace.timestamps_pending)
+		return false;
+	workspace.timestamps_pending = false;
+
+	// (value, availability) per query; passes the frame skipped were never written, so VK_NOT_READY is expected:
+	std::array<uint64_t, 2 * 2 * PassCount> results{};
+	VkResult result = vkGetQueryPoolResults(rtg.device, workspace.timestamps, 0, 2 * PassCount, sizeof(results), results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+		throw std::runtime_error("Reading GPU timestamps returned " + std::string(string_VkResult(result)) + ".");
+
+	for (uint32_t pass = 0; pass < PassCount; ++pass)
+	{
+		uint64_t const *begin = &results[4 * pass];
+		uint64_t const *end = &results[4 * pass + 2];
+		if (begin[1] == 0 || end[1] == 0)
+		{
+			last_ms[pass] = -1.0;
+			continue;
+		}
+		last_ms[pass] = double((end[0] - begin[0]) & valid_mask) * ms_per_tick;
+	}
+	has_last = true;
+
+	if (report)
+	{
+		for (uint32_t pass = 0; pass < PassCount; ++pass)
+		{
+			if (last_ms[pass] < 0.0)
+				continue;
+			report_ms[pass] += last_ms[pass];
+			report_count[pass] += 1;
+		}
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - report_start >= std::chrono::seconds(1))
+		{
+			std::cout << "GPU ms (mean of " << report_count[Frame] << " frames):" << std::fixed << std::setprecision(3);
+			for (uint32_t pass = 0; pass < PassCount; ++pass)
+			{
+				if (report_count[pass] == 0)
+					continue;
+				std::cout << " " << names[pass] << " " << report_ms[pass] / report_count[pass];
+			}
+			std::cout << std::defaultfloat << std::endl;
+			report_ms.fill(0.0);
+			report_count.fill(0);
+			report_start = now;
+		}
+	}
+	return true;
+}
+
+void Render::GPUTimestamps::begin_frame(RTG &rtg, Workspace &workspace)
+{
+	if (workspace.timestamps == VK_NULL_HANDLE)
+		return;
+	// render() is only called once the workspace's fence has signalled, so its last frame's queries are done:
+	read(rtg, workspace);
+	vkCmdResetQueryPool(workspace.command_buffer, workspace.timestamps, 0, 2 * PassCount);
+	workspace.timestamps_pending = true;
+}
+
+void Render::GPUTimestamps::begin(Workspace &workspace, Pass pass)
+{
+	if (workspace.timestamps == VK_NULL_HANDLE)
+		return;
+	vkCmdWriteTimestamp(workspace.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, workspace.timestamps, 2 * pass);
+}
+
+void Render::GPUTimestamps::end(Workspace &workspace, Pass pass)
+{
+	if (workspace.timestamps == VK_NULL_HANDLE)
+		return;
+	vkCmdWriteTimestamp(workspace.command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, workspace.timestamps, 2 * pass + 1);
+}
+
+void Render::add_benchmark_stats(uint32_t workspace_index, Benchmark &benchmark)
+{
+	frame_stats.add_to(benchmark);
+
+	// the frame has finished, so reading it now (instead of when the workspace comes around again) is exact:
+	if (!gpu_timestamps.read(rtg, workspaces.at(workspace_index)))
+		return;
+	for (uint32_t pass = 0; pass < GPUTimestamps::PassCount; ++pass)
+	{
+		if (gpu_timestamps.last_ms[pass] < 0.0)
+			continue;
+		benchmark.add("gpu_" + std::string(GPUTimestamps::names[pass]) + "_ms", gpu_timestamps.last_ms[pass]);
+	}
+}
@@ -2,12 +2,15 @@
 
 #include "RTG.hpp"
 #include "VK.hpp"
+#include "StartupProfile.hpp"
 
 #include < vulkan/utility/vk_format_utils.h> //useful for byte counting
 
+#include <algorithm>
 #include <utility>
 #include <cassert>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 
 Helpers::Allocation::Allocation(Allocation &&from)
@@ -18,6 +21,8 @@ Helpers::Allocation::Allocation(Allocation &&from)
 	std::swap(size, from.size);
 	std::swap(offset, from.offset);
 	std::swap(mapped, from.mapped);
+	std::swap(memory_type_index, from.memory_type_index);
+	std::swap(category, from.category);
 }
 
 Helpers::Allocation &Helpers::Allocation::operator=(Allocation &&from)
@@ -32,6 +37,8 @@ Helpers::Allocation &Helpers::Allocation::operator=(Allocation &&from)
 	std::swap(size, from.size);
 	std::swap(offset, from.offset);
 	std::swap(mapped, from.mapped);
+	std::swap(memory_type_index, from.memory_type_index);
+	std::swap(category, from.category);
 
 	return *this;
 }
@@ -59,6 +66,15 @@ Helpers::Allocation Helpers::allocate(VkDeviceSize size, VkDeviceSize alginment,
 
 	allocation.size = size;
 	allocation.offset = 0;
+	allocation.memory_type_index = memory_type_index;
+	allocation.category = memory_category;
+
+	for (MemoryUsage *usage : {&memory_by_category[memory_category], &memory_by_type[memory_type_index], &memory_total})
+	{
+		usage->bytes += size;
+		usage->peak = std::max(usage->peak, usage->bytes);
+		usage->allocations += 1;
+	}
 
 	if (map == Mapped)
 	{
@@ -83,9 +99,20 @@ void Helpers::free(Helpers::Allocation &&allocation)
 
 	vkFreeMemory(rtg.device, allocation.handle, nullptr);
 
+	if (allocation.handle != VK_NULL_HANDLE)
+	{
+		for (MemoryUsage *usage : {&memory_by_category[allocation.category], &memory_by_type[allocation.memory_type_index], &memory_total})
+		{
+			usage->bytes -= allocation.size;
+			usage->allocations -= 1;
+		}
+	}
+
 	allocation.handle = VK_NULL_HANDLE;
 	allocation.offset = 0;
 	allocation.size = 0;
+	allocation.memory_type_index = 0;
+	allocation.category = Other;
 }
 
 //-----------------------------
@@ -128,6 +155,7 @@ Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat
 	AllocatedImage image;
 	image.extent = extent;
 	image.format = format;
+	image.mip_levels = mip_levels;
 
 	VkImageCreateInfo create_info{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -165,6 +193,7 @@ void Helpers::destroy_image(AllocatedImage &&image)
 	image.handle = VK_NULL_HANDLE;
 	image.extent = VkExtent2D{.width = 0, .height = 0};
 	image.format = VK_FORMAT_UNDEFINED;
+	image.mip_levels = 1;
 
 	this->free(std::move(image.allocation));
 }
@@ -173,6 +202,9 @@ void Helpers::destroy_image(AllocatedImage &&image)
 
 void Helpers::transfer_to_buffer(void const *data, size_t size, AllocatedBuffer &target)
 {
+	StartupProfile::Work upload_work("upload");
+	upload_work.bytes = size;
+	MemoryScope staging(*this, Staging);
 	AllocatedBuffer transfer_src = create_buffer(
 		size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -222,6 +254,8 @@ void Helpers::transfer_to_buffer(void const *data, size_t size, AllocatedBuffer
 
 void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &target)
 {
+	StartupProfile::Work upload_work("upload");
+	upload_work.bytes = size;
 
 	assert(target.handle != VK_NULL_HANDLE); // targe image should be allocated,not null
 
@@ -231,6 +265,7 @@ void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &t
 	assert(size == target.extent.width * target.extent.height * bytes_per_block / texels_per_block);
 
 	// create a host coherent source buffer
+	MemoryScope staging(*this, Staging);
 	AllocatedBuffer transfer_src = create_buffer(
 		size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -254,7 +289,7 @@ void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &t
 	VkImageSubresourceRange whole_image{
 		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 		.baseMipLevel = 0,
-		.levelCount = 1,
+		.levelCount = target.mip_levels,
 		.baseArrayLayer = 0,
 		.layerCount = 1,
 	};
@@ -309,34 +344,81 @@ void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &t
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1, &region);
 
-		// note is the image had mip level, we would need to copy as additional region here
+		// mip levels past 0 are filled by the blits below
 	}
 
-	// transition the image memory to shader real only optimal layout [new]
+	// blit each mip level down from the one above, handing finished levels to the shader as we go:
+	auto level_barrier = [&](uint32_t level, VkAccessFlags src_access, VkAccessFlags dst_access, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
 	{
 		VkImageMemoryBarrier barrier{
 			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			.srcAccessMask = src_access,
+			.dstAccessMask = dst_access,
+			.oldLayout = old_layout,
+			.newLayout = new_layout,
 			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 			.image = target.handle,
-			.subresourceRange = whole_image,
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = level,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
 		};
+		vkCmdPipelineBarrier(transfer_command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	};
 
-		vkCmdPipelineBarrier(
-			transfer_command_buffer,			   // commandBuffer
-			VK_PIPELINE_STAGE_TRANSFER_BIT,		   // srcStageMask
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask
-			0,									   // dependcy flabgs
-			0, nullptr,							   // memory barrier count, pointer
-			0, nullptr,							   // buffer memory barrier count, point,
-			1, &barrier							   // image memory barrier count, pinter
-		);
+	int32_t level_width = int32_t(target.extent.width);
+	int32_t level_height = int32_t(target.extent.height);
+	for (uint32_t level = 1; level < target.mip_levels; ++level)
+	{
+		level_barrier(level - 1,
+					  VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+					  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		int32_t next_width = std::max(1, level_width / 2);
+		int32_t next_height = std::max(1, level_height / 2);
+		VkImageBlit blit{
+			.srcSubresource{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = level - 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.srcOffsets{VkOffset3D{0, 0, 0}, VkOffset3D{level_width, level_height, 1}},
+			.dstSubresource{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = level,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.dstOffsets{VkOffset3D{0, 0, 0}, VkOffset3D{next_width, next_height, 1}},
+		};
+		vkCmdBlitImage(
+			transfer_command_buffer,
+			target.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			target.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit,
+			VK_FILTER_LINEAR);
+
+		level_barrier(level - 1,
+					  VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+					  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+		level_width = next_width;
+		level_height = next_height;
 	}
 
+	// transition the last (or only) mip level to shader read only optimal layout
+	level_barrier(target.mip_levels - 1,
+				  VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
 	// end an dsu7mit thej command buffer
 	VK(vkEndCommandBuffer(transfer_command_buffer));
 
@@ -354,6 +436,115 @@ void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &t
 	destroy_buffer(std::move(transfer_src));
 }
 
+void Helpers::transfer_to_image_levels(void const *data, size_t size, AllocatedImage &target, std::vector<size_t> const &level_offsets)
+{
+	StartupProfile::Work upload_work("upload");
+	upload_work.bytes = size;
+	assert(target.handle != VK_NULL_HANDLE);
+	assert(level_offsets.size() == target.mip_levels);
+
+	MemoryScope staging(*this, Staging);
+	AllocatedBuffer transfer_src = create_buffer(
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		Mapped);
+
+	std::memcpy(transfer_src.allocation.data(), data, size);
+
+	VK(vkResetCommandBuffer(transfer_command_buffer, 0));
+
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+
+	VK(vkBeginCommandBuffer(transfer_command_buffer, &begin_info));
+
+	record_image_levels_upload(transfer_command_buffer, transfer_src, target, level_offsets);
+
+	VK(vkEndCommandBuffer(transfer_command_buffer));
+
+	VkSubmitInfo submit_info{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &transfer_command_buffer};
+
+	VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+	VK(vkQueueWaitIdle(rtg.graphics_queue));
+
+	destroy_buffer(std::move(transfer_src));
+}
+
+void Helpers::record_image_levels_upload(VkCommandBuffer command_buffer, AllocatedBuffer const &source, AllocatedImage const &target, std::vector<size_t> const &level_offsets)
+{
+	assert(target.handle != VK_NULL_HANDLE);
+	assert(level_offsets.size() == target.mip_levels);
+
+	VkImageSubresourceRange all_levels{
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel = 0,
+		.levelCount = target.mip_levels,
+		.baseArrayLayer = 0,
+		.layerCount = 1,
+	};
+
+	{ // UNDEFINED -> TRANSFER_DST_OPTIMAL
+		VkImageMemoryBarrier barrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = target.handle,
+			.subresourceRange = all_levels,
+		};
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	{ // one copy region per level, rows are tightly packed (for block formats, rows of blocks):
+		std::vector<VkBufferImageCopy> regions;
+		regions.reserve(level_offsets.size());
+		for (uint32_t level = 0; level < level_offsets.size(); ++level)
+		{
+			regions.emplace_back(VkBufferImageCopy{
+				.bufferOffset = level_offsets[level],
+				.bufferRowLength = 0,
+				.bufferImageHeight = 0,
+				.imageSubresource{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = level,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+				.imageOffset{.x = 0, .y = 0, .z = 0},
+				.imageExtent{
+					.width = std::max(1u, target.extent.width >> level),
+					.height = std::max(1u, target.extent.height >> level),
+					.depth = 1},
+			});
+		}
+		vkCmdCopyBufferToImage(command_buffer, source.handle, target.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(regions.size()), regions.data());
+	}
+
+	{ // TRANSFER_DST_OPTIMAL -> SHADER_READ_ONLY_OPTIMAL
+		VkImageMemoryBarrier barrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = target.handle,
+			.subresourceRange = all_levels,
+		};
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
+
 void Helpers::transfer_to_image_2d(
 	void const *data,
 	size_t size,
@@ -362,6 +553,7 @@ void Helpers::transfer_to_image_2d(
 {
 	assert(target.handle);
 
+	MemoryScope staging(*this, Staging);
 	AllocatedBuffer transfer_src = create_buffer(
 		size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -487,12 +679,15 @@ void Helpers::transfer_to_image_2d(
 
 	destroy_buffer(std::move(transfer_src));
 }
-void Helpers::transfer_to_image_cube(void *data, size_t size, AllocatedImage &target, uint8_t mip_level)
+void Helpers::transfer_to_image_cube(void const *data, size_t size, AllocatedImage &target, uint8_t mip_level)
 {
+	StartupProfile::Work upload_work("upload");
+	upload_work.bytes = size;
 	assert(target.handle);
 
 	size_t bytes_per_pixel = vkuFormatTexelBlockSize(target.format);
 
+	MemoryScope staging(*this, Staging);
 	AllocatedBuffer transfer_src = create_buffer(
 		size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -643,6 +838,7 @@ void Helpers::transfer_to_cubemap_layer(
 	// size_t texels_per_block = vkuFormatTexelsPerBlock(target.format);
 	// assert(size == mip_width * mip_height * bytes_per_block / texels_per_block);
 
+	MemoryScope staging(*this, Staging);
 	AllocatedBuffer transfer_src = create_buffer(
 		size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -773,6 +969,7 @@ Helpers::AllocatedImage Helpers::create_cubemap(
 	AllocatedImage image;
 	image.extent = extent;
 	image.format = format;
+	image.mip_levels = mip_levels;
 
 	VkImageCreateInfo create_info{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -829,6 +1026,69 @@ uint32_t Helpers::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags f
 	throw std::runtime_error("No suitable memory type found.");
 }
 
+void Helpers::report_memory(std::ostream &out) const
+{
+	auto mib = [](VkDeviceSize bytes)
+	{ return double(bytes) / double(1 << 20); };
+	auto usage_line = [&](MemoryUsage const &usage)
+	{
+		out << std::setw(9) << mib(usage.bytes) << " MiB now, " << std::setw(9) << mib(usage.peak) << " MiB peak, " << usage.allocations << " allocations\n";
+	};
+
+	std::ios_base::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(1);
+	out << "GPU memory:\n  by category:\n";
+	for (uint32_t category = 0; category < MemoryCategoryCount; ++category)
+	{
+		if (memory_by_category[category].peak == 0)
+			continue;
+		out << "    " << std::left << std::setw(13) << memory_category_names[category] << std::right;
+		usage_line(memory_by_category[category]);
+	}
+	out << "    " << std::left << std::setw(13) << "total" << std::right;
+	usage_line(memory_total);
+
+	out << "  by memory type:\n";
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+	{
+		if (memory_by_type[i].peak == 0)
+			continue;
+		VkMemoryType const &type = memory_properties.memoryTypes[i];
+		out << "    [" << i << "] heap " << type.heapIndex << ", " << string_VkMemoryPropertyFlags(type.propertyFlags) << ":\n      ";
+		usage_line(memory_by_type[i]);
+	}
+
+	// budget is what the device suggests this process stays under, usage what the process (all allocators) has now:
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+	};
+	if (rtg.memory_budget_enabled)
+	{
+		VkPhysicalDeviceMemoryProperties2 properties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+			.pNext = &budget,
+		};
+		vkGetPhysicalDeviceMemoryProperties2(rtg.physical_device, &properties);
+	}
+	out << "  heaps:" << (rtg.memory_budget_enabled ? "" : " (no VK_EXT_memory_budget, so no budget)") << "\n";
+	for (uint32_t h = 0; h < memory_properties.memoryHeapCount; ++h)
+	{
+		VkMemoryHeap const &heap = memory_properties.memoryHeaps[h];
+		VkDeviceSize ours = 0;
+		for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+		{
+			if (memory_properties.memoryTypes[i].heapIndex == h)
+				ours += memory_by_type[i].bytes;
+		}
+		out << "    [" << h << "] " << mib(heap.size) << " MiB" << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " device local" : "") << ": " << mib(ours) << " MiB allocated through Helpers";
+		if (rtg.memory_budget_enabled)
+			out << ", process usage " << mib(budget.heapUsage[h]) << " MiB of a " << mib(budget.heapBudget[h]) << " MiB budget";
+		out << "\n";
+	}
+	out.flush();
+	out.flags(flags);
+}
+
 VkFormat Helpers::find_image_format(std::vector<VkFormat> const &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const
 {
 	for (VkFormat format : candidates)
@@ -847,6 +1107,22 @@ VkFormat Helpers::find_image_format(std::vector<VkFormat> const &candidates, VkI
 	throw std::runtime_error("No supported format matches request.");
 }
 
+uint32_t Helpers::blittable_mip_levels(VkExtent2D const &extent, VkFormat format) const
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(rtg.physical_device, format, &props);
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	if ((props.optimalTilingFeatures & needed) != needed)
+		return 1;
+
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(extent.width, extent.height); size > 1; size >>= 1)
+	{
+		++levels;
+	}
+	return levels;
+}
+
 VkShaderModule Helpers::create_shader_module(uint32_t const *code, size_t bytes) const
 {
 	VkShaderModule shader_module = VK_NULL_HANDLE;
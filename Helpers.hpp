@@ -2,6 +2,8 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <array>
+#include <iosfwd>
 #include <vector>
 
 struct RTG;
@@ -12,6 +14,22 @@ struct Helpers
 	//-----------------------
 	// memory allocation:
 
+	// what device memory is for, for the report below; allocations made inside a MemoryScope get its category:
+	enum MemoryCategory : uint32_t
+	{
+		Other,
+		Staging,	 // transfer sources, freed right after the copy
+		Attachments, // depth and headless swapchain images
+		Workspaces,	 // per-workspace streamed buffers
+		Vertices,
+		Textures,
+		ShadowAtlas,
+		Environment, // (prefiltered) environment cubemaps
+		BRDFLUT,
+		MemoryCategoryCount
+	};
+	static constexpr std::array<char const *, MemoryCategoryCount> memory_category_names{"other", "staging", "attachments", "workspaces", "vertices", "textures", "shadow atlas", "environment", "BRDF LUT"};
+
 	// An owning reference to (part of) a slab of device memory:
 	struct Allocation
 	{
@@ -19,6 +37,8 @@ struct Helpers
 		VkDeviceSize offset = 0; // offset of the allocated object inside the memory
 		VkDeviceSize size = 0;	 // size of the allocated object inside the memory (might be *larger* than the internal size of the object!)
 		void *mapped = nullptr;
+		uint32_t memory_type_index = 0; // these two are for the memory report
+		MemoryCategory category = Other;
 		void *data() const { return reinterpret_cast<char *>(mapped) + offset; } // get pointer to beginning of allocation, taking offset into account
 
 		// Call an all-zero (no handle, offset, size, mapped) Allocation "empty":
@@ -43,6 +63,33 @@ struct Helpers
 
 	// free an allocated block:
 	void free(Allocation &&allocation);
+
+	// sets the category of allocations made while it is alive (like the rest of Helpers, not thread safe):
+	struct MemoryScope
+	{
+		MemoryScope(Helpers &helpers_, MemoryCategory category) : helpers(helpers_), previous(helpers_.memory_category) { helpers.memory_category = category; }
+		~MemoryScope() { helpers.memory_category = previous; }
+		MemoryScope(MemoryScope const &) = delete;
+		MemoryScope &operator=(MemoryScope const &) = delete;
+
+		Helpers &helpers;
+		MemoryCategory previous;
+	};
+	MemoryCategory memory_category = Other;
+
+	// live totals, kept by allocate() and free():
+	struct MemoryUsage
+	{
+		VkDeviceSize bytes = 0;
+		VkDeviceSize peak = 0;
+		uint32_t allocations = 0;
+	};
+	std::array<MemoryUsage, MemoryCategoryCount> memory_by_category{};
+	std::array<MemoryUsage, VK_MAX_MEMORY_TYPES> memory_by_type{};
+	MemoryUsage memory_total{};
+
+	// prints usage by category and by memory type, and per heap the device's budget when VK_EXT_memory_budget is enabled:
+	void report_memory(std::ostream &) const;
 	// specializations that also create a buffer or image (respectively):
 	struct AllocatedBuffer
 	{
@@ -60,6 +107,7 @@ struct Helpers
 		VkImage handle = VK_NULL_HANDLE;
 		VkExtent2D extent{.width = 0, .height = 0};
 		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t mip_levels = 1;
 		Allocation allocation;
 
 		// NOTE: could define default constructor, move constructor, move assignment, destructor for a bit more paranoia
@@ -73,7 +121,13 @@ struct Helpers
 	// NOTE: synchronizes *hard* against the GPU; inefficient to use for streaming data!
 	void transfer_to_buffer(void const *data, size_t size, AllocatedBuffer &target);
 	void transfer_to_image(void const *data, size_t size, AllocatedImage &image); // NOTE: image layout after call is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-	void transfer_to_image_cube(void *data, size_t size, AllocatedImage &target, uint8_t mip_level = 1);
+	// (data is mip level 0, any further mip levels of image are generated by blitting down; image needs TRANSFER_SRC usage)
+	// uploads every mip level of target from data, level i starting at level_offsets[i] (block compressed formats welcome):
+	void transfer_to_image_levels(void const *data, size_t size, AllocatedImage &target, std::vector<size_t> const &level_offsets);
+	// records the same upload from a filled (TRANSFER_SRC) buffer into command_buffer instead, without waiting; the
+	// caller keeps source alive until command_buffer has finished:
+	void record_image_levels_upload(VkCommandBuffer command_buffer, AllocatedBuffer const &source, AllocatedImage const &target, std::vector<size_t> const &level_offsets);
+	void transfer_to_image_cube(void const *data, size_t size, AllocatedImage &target, uint8_t mip_level = 1); // data: every level, faces of a level together (see get_cube_buffer_offset)
 	void transfer_to_image_2d(void const *data, size_t size, AllocatedImage &target, VkImageLayout final_layout);
 	AllocatedImage create_cubemap(
 		VkExtent2D const &eextent,
@@ -103,6 +157,9 @@ struct Helpers
 	// for selecting image formats:
 	VkFormat find_image_format(std::vector<VkFormat> const &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const;
 
+	// number of mip levels transfer_to_image can fill for an optimal-tiling image: the full chain if format supports linear blits, otherwise 1:
+	uint32_t blittable_mip_levels(VkExtent2D const &extent, VkFormat format) const;
+
 	// shader code from buffers -> modules:
 	VkShaderModule create_shader_module(uint32_t const *code, size_t bytes) const;
 	// version that figures out the size from a static array:
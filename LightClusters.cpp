@@ -0,0 +1,149 @@
+#include "Render.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// clustered forward shading, concept from https://www.aortiz.me/2018/12/21/CG.html
+// lights are bound by a sphere of radius LIMIT, binned into every cluster the sphere's screen rectangle and depth range touch
+
+// light with no LIMIT are cut off where their energy drops below this threshold (same cutoff used for spot light shadow frustums)
+static constexpr float unlimited_light_threshold = 0.001f;
+
+static float light_range(glm::vec3 const &energy, float limit)
+{
+    if (limit > 0.0f)
+        return limit;
+    return std::sqrt(glm::length(energy) / (float(M_PI) * 4.0f * unlimited_light_threshold));
+}
+
+void Render::LightClusters::update(glm::mat4 const &clip_from_world, float near, std::vector<ObjectsPipeline::SphereLight> const &sphere_lights, std::vector<ObjectsPipeline::SpotLight> const &spot_lights)
+{
+    struct Box
+    {
+        uint32_t x0, x1, y0, y1;
+        float depth_min, depth_max;
+    };
+
+    z_near = std::max(near, 1.0e-4f);
+    float z_far = 2.0f * z_near;
+
+    // find the cluster-space bounds of a light's bounding sphere, returns false if it is not visible:
+    auto bound_light = [&](glm::vec3 const &center, float radius, Box &box) -> bool
+    {
+        // clip.w is the view-space distance along the camera's forward direction:
+        float depth = (clip_from_world * glm::vec4(center, 1.0f)).w;
+        // slices start at the near plane, a sphere that ends before it lights nothing the camera sees:
+        if (depth + radius < z_near)
+            return false;
+        box.depth_min = depth - radius;
+        box.depth_max = depth + radius;
+
+        glm::vec2 ndc_min = glm::vec2(-1.0f);
+        glm::vec2 ndc_max = glm::vec2(1.0f);
+        // the box's corners reach radius * sqrt(3) from the center, so they can be behind the camera (and project
+        // mirrored) even when the sphere is not; only project when every corner is past the near plane:
+        if (depth - radius * std::sqrt(3.0f) > z_near)
+        { // bounding box is fully in front of the camera, project its corners:
+            ndc_min = glm::vec2(std::numeric_limits<float>::infinity());
+            ndc_max = glm::vec2(-std::numeric_limits<float>::infinity());
+            for (uint32_t corner = 0; corner < 8; ++corner)
+            {
+                glm::vec3 offset = glm::vec3(
+                    (corner & 1) ? radius : -radius,
+                    (corner & 2) ? radius : -radius,
+                    (corner & 4) ? radius : -radius);
+                glm::vec4 clip = clip_from_world * glm::vec4(center + offset, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                ndc_min = glm::min(ndc_min, ndc);
+                ndc_max = glm::max(ndc_max, ndc);
+            }
+            if (ndc_max.x < -1.0f || ndc_min.x > 1.0f || ndc_max.y < -1.0f || ndc_min.y > 1.0f)
+                return false;
+        }
+
+        auto to_tile = [](float ndc, uint32_t count) -> uint32_t
+        {
+            float t = std::floor((ndc * 0.5f + 0.5f) * float(count));
+            return uint32_t(std::clamp(t, 0.0f, float(count - 1)));
+        };
+        box.x0 = to_tile(ndc_min.x, x_count);
+        box.x1 = to_tile(ndc_max.x, x_count);
+        box.y0 = to_tile(ndc_min.y, y_count);
+        box.y1 = to_tile(ndc_max.y, y_count);
+
+        z_far = std::max(z_far, box.depth_max);
+        return true;
+    };
+
+    std::vector<Box> sphere_boxes, spot_boxes;
+    std::vector<uint32_t> sphere_visible, spot_visible;
+    sphere_boxes.reserve(sphere_lights.size());
+    spot_boxes.reserve(spot_lights.size());
+
+    for (uint32_t i = 0; i < sphere_lights.size(); ++i)
+    {
+        Box box;
+        if (bound_light(sphere_lights[i].POSITION, light_range(sphere_lights[i].ENERGY, sphere_lights[i].LIMIT), box))
+        {
+            sphere_boxes.emplace_back(box);
+            sphere_visible.emplace_back(i);
+        }
+    }
+    for (uint32_t i = 0; i < spot_lights.size(); ++i)
+    {
+        Box box;
+        if (bound_light(spot_lights[i].POSITION, light_range(spot_lights[i].ENERGY, spot_lights[i].LIMIT), box))
+        {
+            spot_boxes.emplace_back(box);
+            spot_visible.emplace_back(i);
+        }
+    }
+
+    // exponential depth slices between z_near and the furthest visible light:
+    log_scale = float(z_count) / std::log(z_far / z_near);
+    auto to_slice = [&](float depth) -> uint32_t
+    {
+        float t = std::floor(std::log(std::max(depth, z_near) / z_near) * log_scale);
+        return uint32_t(std::clamp(t, 0.0f, float(z_count - 1)));
+    };
+
+    // calls fn(cluster) for every cluster overlapped by box:
+    auto for_each_cluster = [&](Box const &box, auto &&fn)
+    {
+        uint32_t z0 = to_slice(box.depth_min);
+        uint32_t z1 = to_slice(box.depth_max);
+        for (uint32_t z = z0; z <= z1; ++z)
+            for (uint32_t y = box.y0; y <= box.y1; ++y)
+                for (uint32_t x = box.x0; x <= box.x1; ++x)
+                    fn((z * y_count + y) * x_count + x);
+    };
+
+    // count lights per cluster:
+    ranges.assign(cluster_count, Range{});
+    for (Box const &box : sphere_boxes)
+        for_each_cluster(box, [&](uint32_t c)
+                         { ++ranges[c].sphere_count; });
+    for (Box const &box : spot_boxes)
+        for_each_cluster(box, [&](uint32_t c)
+                         { ++ranges[c].spot_count; });
+
+    // prefix sum into offsets, counts are rebuilt during the fill below:
+    uint32_t total = 0;
+    for (Range &range : ranges)
+    {
+        range.sphere_first = total;
+        total += range.sphere_count;
+        range.spot_first = total;
+        total += range.spot_count;
+        range.sphere_count = 0;
+        range.spot_count = 0;
+    }
+    indices.resize(total);
+
+    for (uint32_t i = 0; i < sphere_boxes.size(); ++i)
+        for_each_cluster(sphere_boxes[i], [&](uint32_t c)
+                         { indices[ranges[c].sphere_first + ranges[c].sphere_count++] = sphere_visible[i]; });
+    for (uint32_t i = 0; i < spot_boxes.size(); ++i)
+        for_each_cluster(spot_boxes[i], [&](uint32_t c)
+                         { indices[ranges[c].spot_first + ranges[c].spot_count++] = spot_visible[i]; });
+}
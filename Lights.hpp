@@ -0,0 +1,40 @@
+#pragma once
+
+#include "glm.hpp"
+
+#include <cstdint>
+
+// the light arrays of ObjectsPipeline's World descriptor set, laid out like objects.frag reads them; kept apart from
+// Render.hpp so code that fills them (and bin/microbench) doesn't need Vulkan:
+
+struct SunLight
+{
+	glm::vec4 DIRECTION; // w padding
+	glm::vec3 ENERGY;
+	float SIN_ANGLE;
+};
+static_assert(sizeof(SunLight) == 4 * 4 + 4 * 3 + 4, "SunLight is the expected size.");
+
+struct SphereLight
+{
+	glm::vec3 POSITION;
+	float RADIUS;
+	glm::vec3 ENERGY;
+	float LIMIT;
+};
+static_assert(sizeof(SphereLight) == 4 * 3 + 4 + 4 * 3 + 4, "SphereLight is the expected size.");
+
+struct SpotLight
+{
+	glm::vec3 POSITION;
+	uint32_t shadow_size = 0;
+	glm::vec3 DIRECTION;
+	float RADIUS;
+	glm::vec3 ENERGY;
+	float LIMIT;
+	glm::vec2 CONE_ANGLES;
+	glm::vec2 pad0 = glm::vec2(0.0f);
+	glm::mat4x4 LIGHT_FROM_WORLD;
+	glm::mat4x4 ATLAS_COORD_FROM_WORLD;
+};
+static_assert(sizeof(SpotLight) == 192, "SpotLight is the expected size.");
@@ -21,17 +21,36 @@ const maek = init_maek();
 //======================================================================
 
 //set up variables that control compiler and linker flags:
+let cpu_LINKLibs; //linker flags for the tools that don't need Vulkan or GLFW (set along with maek.options.LINKLibs)
 custom_flags_and_rules();
 //(moved to a function so the build definition is closer to the top of the file)
 
 //maek.CPP(...) builds a c++ file:
 // it returns the path to the output object file
 
+// no Vulkan calls, shared with the microbenchmarks:
+const cpu_objs = [
+	maek.CPP('Benchmark.cpp'),
+	maek.CPP('Trace.cpp'),
+	maek.CPP('StartupProfile.cpp'),
+	maek.CPP('data_path.cpp'),
+	maek.CPP('json_string.cpp'),
+	maek.CPP('rgbe.cpp'),
+	maek.CPP('../Lib/sejp.cpp'),
+];
+const scene_objs = [
+	maek.CPP('scene.cpp'),
+	maek.CPP('frustum_culling.cpp'),
+	maek.CPP('ShadowAtlas.cpp'),
+	maek.CPP('scene_traversal.cpp'),
+];
+
 const common_objs = [
 	maek.CPP('RTG.cpp'),
 	maek.CPP('Helpers.cpp'),
-	maek.CPP('data_path.cpp'),
-	maek.CPP('../Lib/sejp.cpp'),
+	maek.CPP('PackedCubemap.cpp'),
+	maek.CPP('SphericalHarmonics.cpp'),
+	...cpu_objs,
 ];
 const main_objs = [
 	maek.CPP('Render.cpp'),
@@ -39,12 +58,40 @@ const main_objs = [
 	maek.CPP('PosNorTexVertex.cpp'),
 	maek.CPP('PosNorTanTexVertex.cpp'),
 	maek.CPP('main.cpp'),
-	maek.CPP('scene.cpp'),
-	maek.CPP('frustum_culling.cpp'),
-		maek.CPP('ShadowAtlas.cpp'),
+	...scene_objs,
+	maek.CPP('LightClusters.cpp'),
+	maek.CPP('TextureCompression.cpp'),
+	maek.CPP('TextureStreaming.cpp'),
+	maek.CPP('GPUTimestamps.cpp'),
+	maek.CPP('FrameStats.cpp'),
+	maek.CPP('FrameCapture.cpp'),
 	...common_objs,
 ];
 
+const scene_gen_obj = maek.CPP('scene_gen.cpp');
+
+const scene_gen_objs = [
+	maek.CPP('scene_gen_main.cpp'),
+	scene_gen_obj,
+];
+
+const microbench_objs = [
+	maek.CPP('microbench_main.cpp'),
+	scene_gen_obj,
+	...scene_objs,
+	...cpu_objs,
+];
+
+const regress_objs = [
+	maek.CPP('regress_main.cpp'),
+	...cpu_objs,
+];
+
+const rgbe_test_objs = [
+	maek.CPP('rgbe_test_main.cpp'),
+	...cpu_objs,
+];
+
 const cube_objs = [
 	maek.CPP('cube_main.cpp'),
 	...common_objs,
@@ -94,6 +141,7 @@ const cube_shaders = [
 	  maek.GLSLC('brdf.comp', 'spv/brdf.comp'),
     maek.GLSLC('lambert_irradiance.comp', 'spv/lambertian-irradiance.comp'),
     maek.GLSLC('ggx.comp', 'spv/ggx.comp'),
+    maek.GLSLC('sh_project.comp', 'spv/sh_project.comp'),
 ];
 const shadow_shaders = [
 	maek.GLSLC('shadow.vert', 'spv/shadow.vert', {GLSLCFlags: []}),
@@ -102,15 +150,19 @@ const shadow_shaders = [
 main_objs.push( maek.CPP('ShadowPipeline.cpp', undefined, { depends:[...shadow_shaders] } ) );
 const cube_pipeline_obj =
     maek.CPP('CubePipeline.cpp', undefined, { depends: [...cube_shaders] });
-main_objs.push(cube_pipeline_obj);
 cube_objs.push(cube_pipeline_obj);
 
 const viewer_exe = maek.LINK([...main_objs], 'bin/viewer');
 ////and link the executable in the same way as the viewer:
 const cube_exe = maek.LINK([...cube_objs], 'bin/cube');
+//tools that don't need Vulkan:
+const scene_gen_exe = maek.LINK([...scene_gen_objs], 'bin/scene-gen', { LINKLibs: cpu_LINKLibs });
+const microbench_exe = maek.LINK([...microbench_objs], 'bin/microbench', { LINKLibs: cpu_LINKLibs });
+const regress_exe = maek.LINK([...regress_objs], 'bin/regress', { LINKLibs: cpu_LINKLibs });
+const rgbe_test_exe = maek.LINK([...rgbe_test_objs], 'bin/rgbe-test', { LINKLibs: cpu_LINKLibs });
 
 //default targets:
-maek.TARGETS = [viewer_exe, cube_exe];
+maek.TARGETS = [viewer_exe, cube_exe, scene_gen_exe, microbench_exe, regress_exe, rgbe_test_exe];
 //maek.TARGETS = [viewer_exe];
 
 //- - - - - - - - - - - - - - - - - - - - -
@@ -143,6 +195,11 @@ function custom_flags_and_rules() {
 			`-L${GLFW_DIR}/lib`,
 			'-lX11',
 			`-lglfw3`,
+			'-pthread', //std::async for parallel pipeline creation
+		];
+		cpu_LINKLibs = [
+			'-O2',
+			'-pthread',
 		];
 
 	} else if (maek.OS === 'windows') {
@@ -175,6 +232,10 @@ function custom_flags_and_rules() {
 			'Shell32.lib',
 			`/MANIFEST:EMBED`, `/MANIFESTINPUT:set-utf8-code-page.manifest`
 		];
+		cpu_LINKLibs = [
+			'Shell32.lib',
+			`/MANIFEST:EMBED`, `/MANIFESTINPUT:set-utf8-code-page.manifest`
+		];
 	
 	} else if (maek.OS === 'macos') {
 		const fs = require('fs');
@@ -204,6 +265,7 @@ function custom_flags_and_rules() {
 			'-framework', 'QuartzCore',
 			'-framework', 'IOKit',
 		];
+		cpu_LINKLibs = [];
 
 	} else {
 		console.error(`Unsupported OS: ${maek.OS}.`);
@@ -0,0 +1,160 @@
+#include "PackedCubemap.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+size_t PackedCubemap::data_size_for(uint32_t face_size, uint32_t mip_levels, uint32_t texel_size)
+{
+	size_t total = 0;
+	for (uint32_t level = 0; level < mip_levels; ++level)
+	{
+		size_t size = face_size >> level;
+		total += 6 * size * size * texel_size;
+	}
+	return total;
+}
+
+void PackedCubemap::map(std::string const &path)
+{
+	unmap();
+
+	// map the whole file, the header is checked in place:
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open packed cubemap '" + path + "'.");
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < LONGLONG(sizeof(Header)))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Packed cubemap '" + path + "' is too small.");
+	}
+	HANDLE file_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!file_mapping)
+		throw std::runtime_error("Failed to map packed cubemap '" + path + "'.");
+	mapping = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(file_mapping); // the view keeps the mapping alive
+	if (!mapping)
+		throw std::runtime_error("Failed to map packed cubemap '" + path + "'.");
+	mapping_size = size_t(file_size.QuadPart);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Failed to open packed cubemap '" + path + "'.");
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < off_t(sizeof(Header)))
+	{
+		close(fd);
+		throw std::runtime_error("Packed cubemap '" + path + "' is too small.");
+	}
+	void *address = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file alive
+	if (address == MAP_FAILED)
+		throw std::runtime_error("Failed to map packed cubemap '" + path + "'.");
+	madvise(address, size_t(info.st_size), MADV_SEQUENTIAL); // read once, front to back, by the upload
+	mapping = address;
+	mapping_size = size_t(info.st_size);
+#endif
+
+	std::memcpy(&header, mapping, sizeof(header));
+	if (std::memcmp(header.magic, Header().magic, 4) != 0 || header.version != Header().version)
+	{
+		unmap();
+		throw std::runtime_error("'" + path + "' is not a packed cubemap (or was written by a different version).");
+	}
+	if (header.face_size == 0 || header.mip_levels == 0 || header.mip_levels > 16 || (header.face_size >> (header.mip_levels - 1)) == 0 || header.texel_size == 0 || header.data_size != data_size_for(header.face_size, header.mip_levels, header.texel_size) || mapping_size - sizeof(Header) < header.data_size)
+	{
+		unmap();
+		throw std::runtime_error("Packed cubemap '" + path + "' has an invalid header or is truncated.");
+	}
+	data = static_cast<uint8_t const *>(mapping) + sizeof(Header);
+}
+
+void PackedCubemap::unmap()
+{
+	if (mapping)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mapping);
+#else
+		munmap(mapping, mapping_size);
+#endif
+	}
+	mapping = nullptr;
+	mapping_size = 0;
+	data = nullptr;
+	header = Header();
+}
+
+void PackedCubemap::write(std::string const &path, VkFormat format, uint32_t face_size, uint32_t mip_levels, uint32_t texel_size, void const *data)
+{
+	Writer writer(path, format, face_size, mip_levels, texel_size);
+	writer.append(data, size_t(writer.data_size));
+	writer.finish();
+}
+
+PackedCubemap::Writer::Writer(std::string const &path_, VkFormat format, uint32_t face_size, uint32_t mip_levels, uint32_t texel_size)
+	: path(path_), temp_path(path_ + ".tmp")
+{
+	Header header;
+	header.vk_format = uint32_t(format);
+	header.face_size = face_size;
+	header.mip_levels = mip_levels;
+	header.texel_size = texel_size;
+	header.data_size = data_size_for(face_size, mip_levels, texel_size);
+	data_size = header.data_size;
+
+	// write to a temporary and rename, so a renderer never maps a half-written file:
+	file.open(temp_path, std::ios::binary);
+	file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+	if (!file)
+		throw std::runtime_error("Failed to write packed cubemap '" + temp_path + "'.");
+}
+
+PackedCubemap::Writer::~Writer()
+{
+	if (!finished)
+	{
+		file.close();
+		std::error_code ec;
+		std::filesystem::remove(temp_path, ec);
+	}
+}
+
+void PackedCubemap::Writer::append(void const *bytes, size_t size)
+{
+	if (size > data_size - written)
+		throw std::runtime_error("Packed cubemap '" + path + "' was given more than its " + std::to_string(data_size) + " bytes of data.");
+	file.write(reinterpret_cast<char const *>(bytes), std::streamsize(size));
+	if (!file)
+		throw std::runtime_error("Failed to write packed cubemap '" + temp_path + "'.");
+	written += size;
+}
+
+void PackedCubemap::Writer::finish()
+{
+	if (written != data_size)
+		throw std::runtime_error("Packed cubemap '" + path + "' is missing " + std::to_string(data_size - written) + " bytes of data.");
+	file.close();
+	if (!file)
+		throw std::runtime_error("Failed to write packed cubemap '" + temp_path + "'.");
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+		throw std::runtime_error("Failed to write packed cubemap '" + path + "': " + ec.message());
+	finished = true;
+}
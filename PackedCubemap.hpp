@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// a prefiltered environment cubemap in one file: every mip level of all six faces, already in the GPU format
+// written by the cube tool (--packed), memory-mapped by the renderer and handed to Helpers::transfer_to_image_cube as is
+// layout: Header, then level 0 faces +X,-X,+Y,-Y,+Z,-Z, level 1 faces, ... tightly packed (see Helpers::get_cube_buffer_offset)
+struct PackedCubemap
+{
+	static constexpr char const *extension = ".nkcube";
+
+	struct Header
+	{
+		char magic[4] = {'n', 'k', 'c', 'b'};
+		uint32_t version = 1;
+		uint32_t vk_format = 0;
+		uint32_t face_size = 0; // width and height of level 0 faces
+		uint32_t mip_levels = 0;
+		uint32_t texel_size = 0; // bytes per texel
+		uint64_t data_size = 0;
+		// followed by data_size bytes of texels
+	};
+	static_assert(sizeof(Header) == 32, "PackedCubemap::Header is tightly packed.");
+
+	Header header;
+	void const *data = nullptr; // points into the mapping, header.data_size bytes
+
+	PackedCubemap() = default;
+	PackedCubemap(PackedCubemap const &) = delete;
+	PackedCubemap &operator=(PackedCubemap const &) = delete;
+	~PackedCubemap() { unmap(); }
+
+	VkFormat format() const { return VkFormat(header.vk_format); }
+
+	// maps path read-only, throws if it can't be opened or isn't a well-formed packed cubemap:
+	void map(std::string const &path);
+	void unmap();
+
+	static size_t data_size_for(uint32_t face_size, uint32_t mip_levels, uint32_t texel_size);
+
+	// data: data_size_for(face_size, mip_levels, texel size of format) bytes in the layout above, throws on failure
+	static void write(std::string const &path, VkFormat format, uint32_t face_size, uint32_t mip_levels, uint32_t texel_size, void const *data);
+
+	// the same file written a piece at a time (in layout order), so the whole cubemap never has to be in memory at once;
+	// it goes to path + ".tmp" and only replaces path in finish(), a writer destroyed before that removes the temporary:
+	struct Writer
+	{
+		Writer(std::string const &path, VkFormat format, uint32_t face_size, uint32_t mip_levels, uint32_t texel_size);
+		~Writer();
+		Writer(Writer const &) = delete;
+		Writer &operator=(Writer const &) = delete;
+
+		void append(void const *bytes, size_t size); // throws on failure or past the end of the data
+		void finish();								 // throws on failure or if data is missing
+
+		std::string path, temp_path;
+		uint64_t data_size = 0;
+		uint64_t written = 0;
+		std::ofstream file;
+		bool finished = false;
+	};
+
+private:
+	void *mapping = nullptr;
+	size_t mapping_size = 0;
+};
@@ -2,6 +2,9 @@
 
 #include "VK.hpp"
 #include "data_path.hpp"
+#include "Benchmark.hpp"
+#include "Trace.hpp"
+#include "StartupProfile.hpp"
 
 #include <vulkan/vulkan_core.h>
 #if defined(__APPLE__)
@@ -18,7 +21,9 @@
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#include <filesystem>
 #include <fstream>
+#include <optional>
 #include <set>
 
 void RTG::Configuration::parse(int argc, char **argv) {
@@ -43,18 +48,44 @@ void RTG::Configuration::parse(int argc, char **argv) {
 				argi += 1;
 				lambert_out_image = argv[argi];
 			}
+			else if (arg == "--packed") {
+				if (argi + 1 >= argc) throw std::runtime_error("--packed requires a parameter (a file path for the packed cubemap).");
+				argi += 1;
+				packed_out_image = argv[argi];
+			}
+			else if (arg == "--sh") {
+				if (argi + 1 >= argc) throw std::runtime_error("--sh requires a parameter (a file path for the spherical harmonics).");
+				argi += 1;
+				sh_out = argv[argi];
+			}
 			else if (arg == "--ggx-levels") {
 				if (argi + 1 >= argc) throw std::runtime_error("--ggx-levels requires a parameter (number of output levels).");
 				argi += 1;
 				ggx_levels = uint8_t(atoi(argv[argi]));
 			}
+			else if (arg == "--batch") {
+				cube_batch = true;
+			}
+			else if (arg == "--ggx-quality") {
+				if (argi + 1 >= argc) throw std::runtime_error("--ggx-quality requires a parameter (relative error).");
+				argi += 1;
+				ggx_quality = float(atof(argv[argi]));
+				if (!(ggx_quality > 0.0f)) throw std::runtime_error("--ggx-quality must be positive.");
+			}
 			else {
 				throw std::runtime_error("Unrecognized argument '" + arg + "'.");
 			}
 		}
-		if (ggx_out_image == "" && lambert_out_image == "") {
+		if (ggx_out_image == "" && lambert_out_image == "" && packed_out_image == "" && sh_out == "") {
 			throw std::runtime_error("No output image requested");
 		}
+		if (cube_batch) {
+			for (std::string const *out : {&ggx_out_image, &lambert_out_image, &packed_out_image, &sh_out}) {
+				if (*out != "" && out->find('%') == std::string::npos) {
+					throw std::runtime_error("--batch output names need a % (replaced by each input's name), '" + *out + "' has none.");
+				}
+			}
+		}
 		return;
 	}
 	else {
@@ -135,6 +166,74 @@ void RTG::Configuration::parse(int argc, char **argv) {
 				argi += 1;
 				expose = (float)atof(argv[argi]);
 			}
+			else if (arg == "--pipeline-cache") {
+				if (argi + 1 >= argc) throw std::runtime_error("--pipeline-cache requires a parameter (a file path).");
+				argi += 1;
+				pipeline_cache_path = argv[argi];
+				use_pipeline_cache = true;
+			}
+			else if (arg == "--no-pipeline-cache") {
+				use_pipeline_cache = false;
+			}
+			else if (arg == "--no-texture-compression") {
+				compress_textures = false;
+			}
+			else if (arg == "--texture-budget") {
+				if (argi + 1 >= argc) throw std::runtime_error("--texture-budget requires a parameter (MiB, 0 keeps every texture fully resident).");
+				argi += 1;
+				int budget = atoi(argv[argi]);
+				texture_budget_mb = budget > 0 ? uint32_t(budget) : 0;
+			}
+			else if (arg == "--benchmark") {
+				if (argi + 2 >= argc) throw std::runtime_error("--benchmark requires two parameters (warm-up frames and measured frames).");
+				int warmup = atoi(argv[argi + 1]);
+				int frames = atoi(argv[argi + 2]);
+				argi += 2;
+				if (warmup < 0 || frames <= 0) throw std::runtime_error("--benchmark needs zero or more warm-up frames and at least one measured frame.");
+				benchmark_warmup = uint32_t(warmup);
+				benchmark_frames = uint32_t(frames);
+				headless = true;
+			}
+			else if (arg == "--benchmark-dt") {
+				if (argi + 1 >= argc) throw std::runtime_error("--benchmark-dt requires a parameter (seconds per frame).");
+				argi += 1;
+				benchmark_dt = float(atof(argv[argi]));
+				if (!(benchmark_dt >= 0.0f)) throw std::runtime_error("--benchmark-dt must not be negative.");
+			}
+			else if (arg == "--benchmark-out") {
+				if (argi + 1 >= argc) throw std::runtime_error("--benchmark-out requires a parameter (a .json or .csv file path).");
+				argi += 1;
+				benchmark_out = argv[argi];
+			}
+			else if (arg == "--gpu-timings") {
+				gpu_timings = true;
+			}
+			else if (arg == "--memory-report") {
+				memory_report = true;
+			}
+			else if (arg == "--trace") {
+				if (argi + 1 >= argc) throw std::runtime_error("--trace requires a parameter (a .json file path).");
+				argi += 1;
+				trace_out = argv[argi];
+			}
+			else if (arg == "--capture") {
+				if (argi + 1 >= argc) throw std::runtime_error("--capture requires a parameter (a .nkframe file path).");
+				argi += 1;
+				capture_out = argv[argi];
+			}
+			else if (arg == "--replay") {
+				if (argi + 1 >= argc) throw std::runtime_error("--replay requires a parameter (a .nkframe file written by --capture).");
+				argi += 1;
+				replay_in = argv[argi];
+			}
+			else if (arg == "--startup-report") {
+				startup_report = true;
+			}
+			else if (arg == "--startup-report-out") {
+				if (argi + 1 >= argc) throw std::runtime_error("--startup-report-out requires a parameter (a .json file path).");
+				argi += 1;
+				startup_report_out = argv[argi];
+			}
 			else if (arg == "--tone-map") {
 				argi += 1;
 				std::string settings = argv[argi];
@@ -170,13 +269,31 @@ void RTG::Configuration::usage(std::function< void(const char *, const char *) >
 	callback("--animation < loop | play-once | paused >", "Animate the scene with drivers starting paused, only plays once, or loops, default plays once");
 	callback("--exposure <E>", " changes the expose of the scene by 2*E tot eh radience");
 	callback("--tone-map <linear| ACES | paused >", "does tone mapping defaulting to linear, gamma, and others");
+	callback("--pipeline-cache <path>", "Load and save the Vulkan pipeline cache at <path> (default: pipeline-cache.bin next to the executable).");
+	callback("--no-pipeline-cache", "Don't load or save a pipeline cache.");
+	callback("--no-texture-compression", "Upload material textures uncompressed instead of as BC1/BC4/BC5.");
+	callback("--texture-budget <MiB>", "Stream compressed texture mip levels within <MiB> of GPU memory (default 512, 0 keeps every texture fully resident).");
+	callback("--benchmark <warmup> <frames>", "Headless: render <warmup> frames, then <frames> measured frames, and report frame time statistics.");
+	callback("--benchmark-dt <seconds>", "Time step of each benchmark frame (default 1/60).");
+	callback("--benchmark-out <file>", "Also write the benchmark statistics to <file> (.csv or .json).");
+	callback("--gpu-timings", "Print per-pass GPU times about once a second (benchmark statistics include them regardless).");
+	callback("--memory-report", "Print GPU memory use (by category, memory type and heap) after loading and at exit; M prints it any time.");
+	callback("--trace <file.json>", "Record CPU profiling zones and write them to <file.json> (Chrome trace format) on exit or when T is pressed.");
+	callback("--capture <file.nkframe>", "Write a frame's draw state to <file.nkframe>: the first frame when headless, otherwise when K is pressed.");
+	callback("--replay <file.nkframe>", "Re-submit the captured frame every frame, skipping animation, traversal and culling (same scene required).");
+	callback("--startup-report", "Print how long each startup phase took and the slowest meshes, textures and pipelines to load.");
+	callback("--startup-report-out <file.json>", "Write the startup breakdown, with every asset, to <file.json>.");
 }
 
 void RTG::Configuration::cube_usage(std::function< void(const char*, const char*) > const& callback) {
 	callback("--debug, --no-debug", "Turn on/off debug and validation layers.");
 	callback("--lambertian <name>", "Save the output lambertian image to <name>.");
 	callback("--ggx <name.png>", "Save the output ggx images to <name.1.png> to <name.N.png>.");
+	callback("--packed <name.nkcube>", "Save all ggx levels, in the renderer's format, to one memory-mappable file <name.nkcube>.");
+	callback("--sh <name.sh9>", "Save the diffuse lighting as 9 spherical harmonics coefficients to <name.sh9>.");
 	callback("--ggx-levels <N>", "Set the number of levels wanted for ggx, default min(5, log2(input size))");
+	callback("--batch", "Treat the input as a directory of .png strips or a text file listing one per line; each output name's % becomes the input's name.");
+	callback("--ggx-quality <error>", "Double each ggx level's samples until the result changes by less than <error> (relative, default 0.005).");
 }
 
 
@@ -205,6 +322,7 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
 }
 
 RTG::RTG(Configuration const &configuration_) : helpers(*this) {
+	StartupProfile::Phase startup_phase("RTG::RTG (instance, device, swapchain)");
 
 	//copy input configuration:
 	configuration = configuration_;
@@ -353,9 +471,8 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this) {
 		}
 
 		{ //report device name:
-			VkPhysicalDeviceProperties properties;
-			vkGetPhysicalDeviceProperties(physical_device, &properties);
-			std::cout << "Selected physical device '" << properties.deviceName << "'." << std::endl;
+			vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+			std::cout << "Selected physical device '" << device_properties.deviceName << "'." << std::endl;
 
 		}
 	}
@@ -491,6 +608,18 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this) {
 		//Add the swapchain extension:
 		device_extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 		}
+		{ //the memory report uses VK_EXT_memory_budget when the device has it:
+			uint32_t count = 0;
+			VK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, nullptr));
+			std::vector< VkExtensionProperties > available(count);
+			VK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, available.data()));
+			for (VkExtensionProperties const &extension : available) {
+				if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+					device_extensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+					memory_budget_enabled = true;
+				}
+			}
+		}
 		{//create the logical device:
 			std::vector< VkDeviceQueueCreateInfo > queue_create_infos;
 			std::set< uint32_t > unique_queue_families{
@@ -531,6 +660,8 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this) {
 		}
 	}
 
+	create_pipeline_cache();
+
 	//run any resource creation required by Helpers structure:
 	helpers.create();
 
@@ -586,6 +717,12 @@ RTG::~RTG() {
 	//destroy Helpers structure resources:
 	helpers.destroy();
 
+	if (pipeline_cache != VK_NULL_HANDLE) {
+		save_pipeline_cache();
+		vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+		pipeline_cache = VK_NULL_HANDLE;
+	}
+
 	//destroy the rest of the resources:
 	if (device != VK_NULL_HANDLE) {
 		vkDestroyDevice(device, nullptr);
@@ -617,6 +754,131 @@ RTG::~RTG() {
 }
 
 
+// pipeline cache files start with this header so caches written for another device or driver are skipped:
+struct PipelineCacheFileHeader {
+	char magic[4];
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint32_t driver_version;
+	uint8_t device_uuid[VK_UUID_SIZE];
+	uint8_t cache_uuid[VK_UUID_SIZE];
+	uint64_t data_size;
+};
+static constexpr char pipeline_cache_magic[4] = {'n', 'k', 'p', 'c'};
+
+static PipelineCacheFileHeader pipeline_cache_header(VkPhysicalDevice physical_device, VkPhysicalDeviceProperties const &properties) {
+	VkPhysicalDeviceIDProperties id_properties{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+	};
+	VkPhysicalDeviceProperties2 properties2{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &id_properties,
+	};
+	vkGetPhysicalDeviceProperties2(physical_device, &properties2);
+
+	PipelineCacheFileHeader header{
+		.vendor_id = properties.vendorID,
+		.device_id = properties.deviceID,
+		.driver_version = properties.driverVersion,
+		.data_size = 0,
+	};
+	std::memcpy(header.magic, pipeline_cache_magic, sizeof(header.magic));
+	std::memcpy(header.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+	std::memcpy(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	return header;
+}
+
+static std::string pipeline_cache_file(RTG::Configuration const &configuration) {
+	if (!configuration.pipeline_cache_path.empty()) return configuration.pipeline_cache_path;
+	return data_path("pipeline-cache.bin");
+}
+
+void RTG::create_pipeline_cache() {
+	std::vector< char > initial_data;
+
+	if (configuration.use_pipeline_cache) { //try to read a cache written by a previous run:
+		std::string path = pipeline_cache_file(configuration);
+		std::ifstream file(path, std::ios::binary);
+		if (file) {
+			PipelineCacheFileHeader expected = pipeline_cache_header(physical_device, device_properties);
+			PipelineCacheFileHeader header;
+			if (!file.read(reinterpret_cast< char * >(&header), sizeof(header))) {
+				std::cerr << "WARNING: pipeline cache '" << path << "' is truncated; ignoring it." << std::endl;
+			} else if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0
+				|| header.vendor_id != expected.vendor_id
+				|| header.device_id != expected.device_id
+				|| header.driver_version != expected.driver_version
+				|| std::memcmp(header.device_uuid, expected.device_uuid, VK_UUID_SIZE) != 0
+				|| std::memcmp(header.cache_uuid, expected.cache_uuid, VK_UUID_SIZE) != 0) {
+				std::cout << "Pipeline cache '" << path << "' was written for a different device or driver; rebuilding it." << std::endl;
+			} else if (std::error_code ec; std::filesystem::file_size(path, ec) - sizeof(header) != header.data_size || ec) {
+				//check the size before allocating it, a corrupt header could ask for anything:
+				std::cerr << "WARNING: pipeline cache '" << path << "' doesn't match the data size in its header; ignoring it." << std::endl;
+			} else {
+				initial_data.resize(size_t(header.data_size));
+				if (!file.read(initial_data.data(), initial_data.size())) {
+					std::cerr << "WARNING: pipeline cache '" << path << "' is truncated; ignoring it." << std::endl;
+					initial_data.clear();
+				} else {
+					std::cout << "Loaded " << initial_data.size() << " bytes of pipeline cache from '" << path << "'." << std::endl;
+				}
+			}
+		}
+	}
+
+	VkPipelineCacheCreateInfo create_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = initial_data.size(),
+		.pInitialData = initial_data.empty() ? nullptr : initial_data.data(),
+	};
+	if (VkResult result = vkCreatePipelineCache(device, &create_info, nullptr, &pipeline_cache); result != VK_SUCCESS) {
+		//the driver rejected the saved data, so start from an empty cache instead:
+		std::cerr << "WARNING: failed to create pipeline cache from saved data [" << string_VkResult(result) << "]; starting empty." << std::endl;
+		create_info.initialDataSize = 0;
+		create_info.pInitialData = nullptr;
+		VK(vkCreatePipelineCache(device, &create_info, nullptr, &pipeline_cache));
+	}
+}
+
+void RTG::save_pipeline_cache() const {
+	if (!configuration.use_pipeline_cache) return;
+
+	//(called from the destructor, so report failures instead of throwing)
+	size_t size = 0;
+	std::vector< char > data;
+	VkResult result = vkGetPipelineCacheData(device, pipeline_cache, &size, nullptr);
+	if (result == VK_SUCCESS) {
+		data.resize(size);
+		result = vkGetPipelineCacheData(device, pipeline_cache, &size, data.data());
+	}
+	if (result != VK_SUCCESS) {
+		std::cerr << "WARNING: failed to read back pipeline cache [" << string_VkResult(result) << "]; not saving it." << std::endl;
+		return;
+	}
+	data.resize(size);
+
+	PipelineCacheFileHeader header = pipeline_cache_header(physical_device, device_properties);
+	header.data_size = uint64_t(data.size());
+
+	//write to a temporary file and rename so a crash mid-write can't leave a corrupt cache behind:
+	std::string path = pipeline_cache_file(configuration);
+	std::string temp_path = path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary);
+		file.write(reinterpret_cast< char const * >(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		if (!file) {
+			std::cerr << "WARNING: failed to write pipeline cache to '" << temp_path << "'." << std::endl;
+			return;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec) {
+		std::cerr << "WARNING: failed to move pipeline cache to '" << path << "': " << ec.message() << std::endl;
+	}
+}
+
 void RTG::recreate_swapchain() {
 	//cleanup swapchian if it already exist
 	if (!swapchain_images.empty()) {
@@ -651,6 +913,7 @@ void RTG::recreate_swapchain() {
 			HeadlessSwapchainImage& h = headless_swapchain.emplace_back();
 
 			//allocate image data: (on-GPU, will be rendered to)
+			Helpers::MemoryScope memory_scope(helpers, Helpers::Attachments);
 			h.image = helpers.create_image(
 				swapchain_extent,
 				surface_format.format,
@@ -1000,6 +1263,19 @@ void RTG::HeadlessSwapchainImage::save() const {
 }
 
 void RTG::run(Application &application) {
+	//with a startup report, startup lasts until the first frame has been rendered (main started the profile):
+	std::optional< StartupProfile::Phase > first_frame_phase;
+	if (StartupProfile::enabled()) first_frame_phase.emplace("RTG::run until the first frame is rendered");
+	auto finish_startup_profile = [&, this]() {
+		first_frame_phase.reset();
+		StartupProfile::finish();
+		if (configuration.startup_report) StartupProfile::print(std::cout);
+		if (configuration.startup_report_out != "") {
+			StartupProfile::write(configuration.startup_report_out);
+			std::cout << "Wrote startup report to " << configuration.startup_report_out << std::endl;
+		}
+	};
+
 	//INTIAL ON SWAPCHAIN
 	auto on_swapchain = [&, this]() {
 		application.on_swapchain(*this, SwapchainEvent{
@@ -1025,14 +1301,29 @@ void RTG::run(Application &application) {
 	//setup time handling
 	std::chrono::high_resolution_clock::time_point before = std::chrono::high_resolution_clock::now();
 
-
+	//benchmark mode makes its own frames instead of reading events, and times each one:
+	bool benchmarking = configuration.benchmark_frames > 0;
+	uint32_t benchmark_frame = 0;
+	Benchmark benchmark;
+	auto ms_between = [](std::chrono::high_resolution_clock::time_point a, std::chrono::high_resolution_clock::time_point b) {
+		return std::chrono::duration< double, std::milli >(b - a).count();
+	};
 
 	while (configuration.headless || !glfwWindowShouldClose(window)) {
+		TRACE_ZONE("RTG::run frame");
 		float headless_dt = 0.0f;
 		std::string headless_save = "";
 
+		std::chrono::high_resolution_clock::time_point frame_start = std::chrono::high_resolution_clock::now();
+		double update_ms = 0.0;
+		double record_ms = 0.0;
+
 		//event handling:
-		if (configuration.headless) {
+		if (configuration.headless && benchmarking) {
+			if (benchmark_frame == configuration.benchmark_warmup + configuration.benchmark_frames) break;
+			headless_dt = configuration.benchmark_dt;
+		}
+		else if (configuration.headless) {
 			//read events from stdin
 			std::string line;
 			while (std::getline(std::cin, line)) {
@@ -1092,11 +1383,13 @@ void RTG::run(Application &application) {
 			if (configuration.headless) dt = headless_dt;
 
 			application.update(dt);
+			update_ms = ms_between(after, std::chrono::high_resolution_clock::now());
 		}
 
 		// acqier ea workspace
 		uint32_t workspace_index;
 		{ //acquire a workspace:
+			TRACE_ZONE("RTG::run wait for workspace");
 			assert(next_workspace < workspaces.size());
 			workspace_index = next_workspace;
 			next_workspace = (next_workspace + 1) % workspaces.size();
@@ -1110,6 +1403,7 @@ void RTG::run(Application &application) {
 		// acquire an image (resize swapchain if needed)
 		uint32_t image_index = -1U;
 
+		Trace::Zone acquire_zone("RTG::run acquire image");
 		if (configuration.headless) {
 			assert(swapchain == VK_NULL_HANDLE);
 
@@ -1165,8 +1459,10 @@ void RTG::run(Application &application) {
 			}
 		}
 
+		acquire_zone.end();
+
 		//call te render function:
-		
+		std::chrono::high_resolution_clock::time_point record_start = std::chrono::high_resolution_clock::now();
 		application.render(*this, RenderParams{
 			.workspace_index = workspace_index,
 			.image_index = image_index,
@@ -1174,8 +1470,11 @@ void RTG::run(Application &application) {
 			.image_done = swapchain_image_dones[image_index],
 			.workspace_available = workspaces[workspace_index].workspace_available,
 			});
+		std::chrono::high_resolution_clock::time_point submitted = std::chrono::high_resolution_clock::now();
+		record_ms = ms_between(record_start, submitted);
 
 		{ 
+			TRACE_ZONE("RTG::run present");
 			//queue the work for presentation:
 			if (configuration.headless) {
 				//in headless mode, submit the copy command we recorded previously:
@@ -1219,6 +1518,45 @@ void RTG::run(Application &application) {
 			}
 		}
 		// present image(resize swapchain if needed)
+
+		if (first_frame_phase) {
+			//the first frame is queued for presentation; it counts as startup until the GPU has finished it:
+			VK(vkWaitForFences(device, 1, &workspaces[workspace_index].workspace_available, VK_TRUE, UINT64_MAX));
+			finish_startup_profile();
+		}
+
+		if (benchmarking) {
+			//wait for the frame right away, so the GPU time is exact and frames don't overlap (runs stay comparable across devices):
+			VK(vkWaitForFences(device, 1, &workspaces[workspace_index].workspace_available, VK_TRUE, UINT64_MAX));
+			std::chrono::high_resolution_clock::time_point done = std::chrono::high_resolution_clock::now();
+
+			if (benchmark_frame >= configuration.benchmark_warmup) {
+				benchmark.add("update_ms", update_ms);
+				benchmark.add("record_ms", record_ms);
+				benchmark.add("gpu_ms", ms_between(submitted, done));
+				benchmark.add("frame_ms", ms_between(frame_start, done));
+				application.add_benchmark_stats(workspace_index, benchmark);
+			}
+			benchmark_frame += 1;
+		}
+	}
+
+	//the loop ended before any frame was rendered (e.g., headless with no events), report what startup there was:
+	if (first_frame_phase) finish_startup_profile();
+
+	if (benchmarking) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physical_device, &properties);
+		benchmark.device = properties.deviceName;
+		benchmark.warmup_frames = configuration.benchmark_warmup;
+		benchmark.measured_frames = configuration.benchmark_frames;
+		benchmark.dt = configuration.benchmark_dt;
+
+		benchmark.print(std::cout);
+		if (configuration.benchmark_out != "") {
+			benchmark.write(configuration.benchmark_out);
+			std::cout << "Wrote benchmark statistics to " << configuration.benchmark_out << std::endl;
+		}
 	}
 
 	//wait for any in-flight "headless" frames marked for saving to finish:
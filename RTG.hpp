@@ -12,6 +12,7 @@
 #include <string>
 
 struct GLFWwindow;
+struct Benchmark;
 
 /*
  * Real-time Graphics support framework.
@@ -80,15 +81,24 @@ struct RTG
 		bool cube = false;
 		// path to the input image
 		std::string in_image = "";
+		// in_image is a directory or list of input images, output names contain % for each one's name (see cube_main.cpp):
+		bool cube_batch = false;
 
 		std::string ggx_out_image = "";
 
 		std::string lambert_out_image = "";
 
+		std::string packed_out_image = ""; // all ggx levels as one PackedCubemap
+
+		std::string sh_out = ""; // diffuse lighting as SH9 (SphericalHarmonics.hpp)
+
 		uint8_t cube_mode = 0;
 
 		uint8_t ggx_levels = 5;
 
+		// ggx levels are refined until doubling the samples changes them by less than this (mean relative difference):
+		float ggx_quality = 0.005f;
+
 		// path.s72 format scene
 		//  --scene <path>
 		std::string scene_path = "";
@@ -107,6 +117,52 @@ struct RTG
 		float expose = 0.f;
 		int tone_mapping = 0; // 0 linear, 1 arcc, others/
 
+		// pipeline cache file, reused between runs when it matches the device and driver:
+		//  `--pipeline-cache <path>` and `--no-pipeline-cache` command-line flags
+		std::string pipeline_cache_path = ""; // empty uses pipeline-cache.bin next to the executable
+		bool use_pipeline_cache = true;
+
+		// block compress sourced material textures (cached next to the scene):
+		//  `--no-texture-compression` command-line flag
+		bool compress_textures = true;
+
+		// GPU memory for streamed (block compressed) texture levels, 0 disables streaming:
+		//  `--texture-budget <MiB>` command-line flag
+		uint32_t texture_budget_mb = 512;
+
+		// headless benchmark: render benchmark_warmup frames, then benchmark_frames measured ones, at a fixed dt instead of
+		// reading events; timings are summarized on the console and, if benchmark_out is set, written there (see Benchmark.hpp)
+		//  `--benchmark <warmup> <frames>`, `--benchmark-dt <seconds>`, `--benchmark-out <file.json|file.csv>` command-line flags
+		uint32_t benchmark_warmup = 0;
+		uint32_t benchmark_frames = 0; // 0 is no benchmark
+		float benchmark_dt = 1.0f / 60.0f;
+		std::string benchmark_out = "";
+
+		// print per-pass GPU times (timestamp queries) about once a second:
+		//  `--gpu-timings` command-line flag
+		bool gpu_timings = false;
+
+		// record CPU profiling zones (Trace.hpp) and write them as a Chrome trace when the viewer exits (or T is pressed):
+		//  `--trace <file.json>` command-line flag
+		std::string trace_out = "";
+
+		// print GPU memory use by category, memory type and heap once the scene is loaded and again at exit (M prints it any time):
+		//  `--memory-report` command-line flag
+		bool memory_report = false;
+
+		// write one frame's complete draw state (instances, transforms, lights, atlas regions, camera) to a file: the first
+		// frame in headless mode, otherwise whenever K is pressed; replay re-submits a captured frame every frame instead of
+		// animating, traversing and culling the scene, so the GPU work is identical across runs, builds and devices
+		//  `--capture <file.nkframe>`, `--replay <file.nkframe>` command-line flags
+		std::string capture_out = "";
+		std::string replay_in = "";
+
+		// time each startup phase (scene parse, device creation, pipelines, environment, meshes, textures, uploads, ...) and
+		// each asset, then print the breakdown with the slowest meshes and textures and/or write it as JSON (StartupProfile.hpp):
+		//  `--startup-report`, `--startup-report-out <file.json>` command-line flags
+		bool startup_report = false;
+		std::string startup_report_out = "";
+
 		// for configuration construction + management:
 		Configuration() = default;
 		void parse(int argc, char **argv);													// parse command-line options; throws on error
@@ -128,6 +184,7 @@ struct RTG
 	VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE;
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 	VkDevice device = VK_NULL_HANDLE;
+	bool memory_budget_enabled = false; // VK_EXT_memory_budget is available and enabled (see Helpers::report_memory)
 
 	// queue for graphics and transfer operations:
 	std::optional<uint32_t> graphics_queue_family;
@@ -141,6 +198,11 @@ struct RTG
 	std::optional<uint32_t> compute_queue_family;
 	VkQueue compute_queue = VK_NULL_HANDLE;
 
+	// shared by all pipeline creation; loaded from disk at startup and written back on destruction:
+	VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+	void create_pipeline_cache();
+	void save_pipeline_cache() const;
+
 	//-------------------------------------------------
 	// Handles for the window and surface:
 
@@ -222,6 +284,10 @@ struct RTG
 
 		// queue commands to render a frame: (called every frame)
 		virtual void render(RTG &, RenderParams const &) = 0;
+
+		// add measurements of a benchmark frame to its statistics: (called in benchmark mode once the frame rendered
+		// into workspace_index has finished on the GPU, for measured frames only)
+		virtual void add_benchmark_stats(uint32_t workspace_index, Benchmark &) { }
 	};
 
 	//------------------------------
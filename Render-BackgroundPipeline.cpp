@@ -149,7 +149,7 @@ void Render::BackgroundPipeline::create(RTG& rtg, VkRenderPass render_pass, uint
 			.subpass = subpass,
 		};
 
-		VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+		VK(vkCreateGraphicsPipelines(rtg.device, rtg.pipeline_cache, 1, &create_info, nullptr, &handle));
 	}
 
 	//modules no longer needed now that pipline ise created:
@@ -17,17 +17,12 @@ void Render::EnvironmentPipeline::create(RTG &rtg, VkRenderPass render_pass, uin
 	VkShaderModule frag_module = rtg.helpers.create_shader_module(frag_code);
 
 	{ // the set0_world layout hold workl dinfo in a unhiform buffer use in the fragment shader: and a environment cubemap
-		std::array<VkDescriptorSetLayoutBinding, 7> bindings{
+		std::array<VkDescriptorSetLayoutBinding, 6> bindings{
 			VkDescriptorSetLayoutBinding{
 				.binding = 0,
 				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				.descriptorCount = 1,
 				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
-			VkDescriptorSetLayoutBinding{
-				.binding = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
 			VkDescriptorSetLayoutBinding{
 				.binding = 2,
 				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -235,7 +230,7 @@ void Render::EnvironmentPipeline::create(RTG &rtg, VkRenderPass render_pass, uin
 			.subpass = subpass,
 		};
 
-		VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+		VK(vkCreateGraphicsPipelines(rtg.device, rtg.pipeline_cache, 1, &create_info, nullptr, &handle));
 	}
 
 	// modules no longer needed now that pipline ise created:
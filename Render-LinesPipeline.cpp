@@ -160,7 +160,7 @@ void Render::LinesPipeline::create(RTG& rtg, VkRenderPass render_pass, uint32_t
 			.subpass = subpass,
 		};
 
-		VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+		VK(vkCreateGraphicsPipelines(rtg.device, rtg.pipeline_cache, 1, &create_info, nullptr, &handle));
 	}
 
 	//modules no longer needed now that pipline ise created:
@@ -23,11 +23,6 @@ void Render::MirrorPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32_t
 				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				.descriptorCount = 1,
 				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
-			VkDescriptorSetLayoutBinding{
-				.binding = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
 			VkDescriptorSetLayoutBinding{
 				.binding = 2,
 				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -58,7 +53,11 @@ void Render::MirrorPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32_t
 										 .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 										 .descriptorCount = 1,
 										 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
-
+			VkDescriptorSetLayoutBinding{ // light clusters
+				.binding = 8,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
 		};
 
 		VkDescriptorSetLayoutCreateInfo create_info{
@@ -242,7 +241,7 @@ void Render::MirrorPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32_t
 			.subpass = subpass,
 		};
 
-		VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+		VK(vkCreateGraphicsPipelines(rtg.device, rtg.pipeline_cache, 1, &create_info, nullptr, &handle));
 	}
 
 	// modules no longer needed now that pipline ise created:
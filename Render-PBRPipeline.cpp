@@ -3,6 +3,8 @@
 #include "Helpers.hpp"
 #include "VK.hpp"
 
+#include <cstddef>
+
 static uint32_t vert_code[] =
 #include "spv/pbr.vert.inl"
 ;
@@ -23,12 +25,6 @@ void Render::PBRPipeline::create(RTG& rtg, VkRenderPass render_pass, uint32_t su
 				.descriptorCount = 1,
 				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
 			},
-			VkDescriptorSetLayoutBinding{
-				.binding = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-			},
 			VkDescriptorSetLayoutBinding{
 				.binding = 2,
 				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -65,6 +61,12 @@ void Render::PBRPipeline::create(RTG& rtg, VkRenderPass render_pass, uint32_t su
 				.descriptorCount = 1,
 				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
 			},
+			VkDescriptorSetLayoutBinding{ // light clusters
+				.binding = 8,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+			},
 		};
 
 		VkDescriptorSetLayoutCreateInfo create_info{
@@ -95,8 +97,8 @@ void Render::PBRPipeline::create(RTG& rtg, VkRenderPass render_pass, uint32_t su
 		VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set1_Transforms));
 	}
 
-	{// the set2_TEXTURE layout has a single descriptor for a sampler2d used in the fragment shader:
-		std::array< VkDescriptorSetLayoutBinding, 5> bindings{
+	{// the set2_TEXTURE layout has NORMAL, ORM (packed roughness / metalness) and ALBEDO samplers used in the fragment shader:
+		std::array< VkDescriptorSetLayoutBinding, 3> bindings{
 			VkDescriptorSetLayoutBinding{
 				.binding = 0,
 				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -115,18 +117,6 @@ void Render::PBRPipeline::create(RTG& rtg, VkRenderPass render_pass, uint32_t su
 				.descriptorCount = 1,
 				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
 			},
-			VkDescriptorSetLayoutBinding{
-				.binding = 3,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-			},
-			VkDescriptorSetLayoutBinding{
-				.binding = 4,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-			},
 		};
 
 		VkDescriptorSetLayoutCreateInfo create_info{
@@ -272,7 +262,42 @@ void Render::PBRPipeline::create(RTG& rtg, VkRenderPass render_pass, uint32_t su
 			.subpass = subpass,
 		};
 
-		VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+		// one pipeline per shading feature combination, only the fragment shader specialization differs:
+		std::array<VkSpecializationMapEntry, 2> specialization_entries{
+			VkSpecializationMapEntry{
+				.constantID = 0,
+				.offset = offsetof(ShadingSpecialization, NORMAL_MAP),
+				.size = sizeof(VkBool32),
+			},
+			VkSpecializationMapEntry{
+				.constantID = 1,
+				.offset = offsetof(ShadingSpecialization, SHADOWS),
+				.size = sizeof(VkBool32),
+			},
+		};
+		std::array<ShadingSpecialization, shading_variant_count> specialization_data;
+		std::array<VkSpecializationInfo, shading_variant_count> specialization_infos;
+		std::array<std::array<VkPipelineShaderStageCreateInfo, 2>, shading_variant_count> variant_stages;
+		std::array<VkGraphicsPipelineCreateInfo, shading_variant_count> create_infos;
+		for (uint32_t v = 0; v < shading_variant_count; ++v)
+		{
+			specialization_data[v] = ShadingSpecialization{
+				.NORMAL_MAP = (v & NormalMapFeature) ? VK_TRUE : VK_FALSE,
+				.SHADOWS = (v & ShadowFeature) ? VK_TRUE : VK_FALSE,
+			};
+			specialization_infos[v] = VkSpecializationInfo{
+				.mapEntryCount = uint32_t(specialization_entries.size()),
+				.pMapEntries = specialization_entries.data(),
+				.dataSize = sizeof(ShadingSpecialization),
+				.pData = &specialization_data[v],
+			};
+			variant_stages[v] = stages;
+			variant_stages[v][1].pSpecializationInfo = &specialization_infos[v];
+			create_infos[v] = create_info;
+			create_infos[v].pStages = variant_stages[v].data();
+		}
+
+		VK(vkCreateGraphicsPipelines(rtg.device, rtg.pipeline_cache, uint32_t(create_infos.size()), create_infos.data(), nullptr, handles.data()));
 	}
 
 	//modules no longer needed now that pipline ise created:
@@ -297,11 +322,13 @@ void Render::PBRPipeline::destroy(RTG& rtg) {
 
 	if (layout != VK_NULL_HANDLE) {
 		vkDestroyPipelineLayout(rtg.device, layout, nullptr);
-		handle = VK_NULL_HANDLE;
+		layout = VK_NULL_HANDLE;
 	}
 
-	if (handle != VK_NULL_HANDLE) {
-		vkDestroyPipeline(rtg.device, handle, nullptr);
-		handle = VK_NULL_HANDLE;
+	for (VkPipeline &handle : handles) {
+		if (handle != VK_NULL_HANDLE) {
+			vkDestroyPipeline(rtg.device, handle, nullptr);
+			handle = VK_NULL_HANDLE;
+		}
 	}
 }
\ No newline at end of file
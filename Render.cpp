@@ -2,21 +2,32 @@
 
 #include "VK.hpp"
 #include "rgbe.hpp"
+#include "TextureCompression.hpp"
+#include "PackedCubemap.hpp"
+#include "SphericalHarmonics.hpp"
+#include "Trace.hpp"
+#include "StartupProfile.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../Lib/stb/stb_image.h"
 
 #include <GLFW/glfw3.h>
+#include <vulkan/utility/vk_format_utils.h>
 
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <deque>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <unordered_map>
 #include "data_path.hpp"
 
 static uint32_t comp_brdf[] =
@@ -29,8 +40,20 @@ struct BrdfPush
 	uint32_t numSamples;
 };
 
+// size of a source file for the startup report, 0 when it isn't being collected (or the file can't be read):
+static uint64_t source_bytes(std::string const &path)
+{
+	if (!StartupProfile::enabled())
+		return 0;
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	return error ? 0 : uint64_t(size);
+}
+
 Render::Render(RTG &rtg_, Scene &scene_) : rtg(rtg_), scene(scene_), shadow_atlas(ShadowAtlas(shadow_atlas_length))
 {
+	TRACE_ZONE("Render::Render");
+	StartupProfile::Phase startup_phase("Render::Render");
 	// select a depth format:
 	// at least on of these two must be supported, arrourding to the spec; but neihet are required
 	/*static std::unique_ptr< Timer > timer;
@@ -191,6 +214,7 @@ Render::Render(RTG &rtg_, Scene &scene_) : rtg(rtg_), scene(scene_), shadow_atla
 	{ // shadow atlas depth framebuffer
 
 		// For shadow mapping we only need a depth attachment
+		Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::ShadowAtlas);
 		shadow_atlas_image = rtg.helpers.create_image(
 			VkExtent2D{.width = shadow_atlas.size, .height = shadow_atlas.size}, // size of each face
 			depth_format,
@@ -249,1431 +273,1706 @@ Render::Render(RTG &rtg_, Scene &scene_) : rtg(rtg_), scene(scene_), shadow_atla
 		VK(vkCreateFramebuffer(rtg.device, &framebuffer_create_info, nullptr, &shadow_framebuffer));
 	}
 
-	background_pipeline.create(rtg, render_pass, 0);
-	lines_pipeline.create(rtg, render_pass, 0);
-	objects_pipeline.create(rtg, render_pass, 0);
-	environment_pipeline.create(rtg, render_pass, 0);
-	mirror_pipeline.create(rtg, render_pass, 0);
-	pbr_pipeline.create(rtg, render_pass, 0);
-	shadow_pipeline.create(rtg, shadow_atlas_pass, 0);
-
-	// create environment texture
-
-	{
-		if (scene.environment.source != "")
-		{
-			std::string environment_source = scene.scene_path + "/" + scene.environment.source;
-		}
-		else
-		{
-			std::string environment_source = data_path("../resource/default_env.png");
-		}
-		int width, height, n;
-		std::string environment_source = scene.scene_path + "/" + scene.environment.source;
-		std::vector<unsigned char *> images;
-		images.push_back(stbi_load(environment_source.c_str(), &width, &height, &n, 4));
-		if (images[0] == NULL)
-			throw std::runtime_error("Error loading texture " + environment_source);
-		// cube map must have 6 sides and stacked vertically
-		if (height % 6 != 0 || width != height / 6)
+	{ // only create pipelines and image based lighting for the material and light types the scene contains:
+		TRACE_ZONE("Render::Render pipelines and lighting");
+		StartupProfile::Phase startup_phase("Render::Render pipelines and lighting");
+		Requirements wanted{
+			.environment_map = !scene.meshes.empty(),
+		};
+		for (Scene::Material const &material : scene.materials)
 		{
-			throw std::runtime_error("Invalid image dimensions for a cubemap");
-		}
-
-		uint8_t mip_levels = 1;
-		size_t period_index = environment_source.find_last_of(".");
-		std::string base_source = environment_source.substr(0, period_index);
-		std::string file_type = environment_source.substr(period_index + 1, environment_source.size() - period_index);
-		int last_width = width;
-		int last_height = height;
-		int total_size = width * height;
-		// load all ggx mip levels of the environment map
-		while (true)
-		{
-			// attempt to load the next mip level, if failed, exit
-			int cur_width, cur_height, cur_n;
-			std::string cur_source = base_source + "." + std::to_string(mip_levels) + "." + file_type;
-			images.push_back(stbi_load(cur_source.c_str(), &cur_width, &cur_height, &cur_n, 4));
-			if (images[mip_levels] == NULL)
-			{
-				if (rtg.configuration.debug)
-				{
-					std::cout << "Environment Loading Completed, " << int(mip_levels) << " mip levels\n";
-				}
-				break;
-			}
-			if (cur_width != std::max(1, last_width >> 1) ||
-				cur_height != std::max(1, last_height >> 1))
-			{
-				throw std::runtime_error("Mip not properly resized");
-			}
-			if (cur_height % 6 != 0 || cur_width != cur_height / 6)
-			{
-				throw std::runtime_error("Invalid image dimensions for a cubemap");
-			}
-			total_size += cur_width * cur_height;
-			last_width = cur_width;
-			last_height = cur_height;
-			mip_levels++;
+			if (material.material_type == Scene::Material::Environment)
+				wanted.environment_pipeline = true;
+			else if (material.material_type == Scene::Material::Mirror)
+				wanted.mirror_pipeline = true;
+			else if (material.material_type == Scene::Material::PBR)
+				wanted.pbr = true;
 		}
-
-		int face_length = width;
-
-		// convert rgbe to rgb values
-		std::vector<uint32_t> rgb_image(total_size); // Store the converted RGB data
-		int temp_width = width;
-		int temp_height = height;
-		uint64_t pixel_index = 0;
-		for (uint8_t level = 0; level < mip_levels; ++level)
+		for (Scene::Light const &light : scene.lights)
 		{
-			for (int i = 0; i < temp_width * temp_height; ++i)
+			if (light.light_type == Scene::Light::Spot && light.shadow > 0)
 			{
-				glm::u8vec4 rgbe_pixel = glm::u8vec4(images[level][4 * i], images[level][4 * i + 1], images[level][4 * i + 2], images[level][4 * i + 3]);
-				rgb_image[pixel_index] = rgbe_to_E5B9G9R9(rgbe_pixel);
-				++pixel_index;
+				scene_has_shadows = true;
 			}
-			temp_width = temp_width >> 1;
-			temp_height = temp_height >> 1;
 		}
+		wanted.shadows = scene_has_shadows;
 
-		World_environment = rtg.helpers.create_image(
-			VkExtent2D{.width = uint32_t(face_length), .height = uint32_t(face_length)}, // size of each face
-			VK_FORMAT_E5B9G9R9_UFLOAT_PACK32,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			Helpers::Unmapped, 6, mip_levels);
-
-		rtg.helpers.transfer_to_image_cube(rgb_image.data(), sizeof(rgb_image[0]) * rgb_image.size(), World_environment, mip_levels);
-
-		// free image:about to reset command buffer
-		for (unsigned char *image : images)
+		if (rtg.configuration.debug)
 		{
-			stbi_image_free(image);
+			std::cout << "Creating pipelines for:" << (wanted.environment_pipeline ? " environment" : "")
+					  << (wanted.mirror_pipeline ? " mirror" : "") << (wanted.pbr ? " pbr" : "")
+					  << (wanted.shadows ? " shadows" : "") << " (lambertian is always created)\n";
 		}
+		require(wanted);
+	}
 
-		// set world mip level
-		world.ENVIRONMENT_MIPS = float(mip_levels - 1);
+	{															  // create descriptor pool:
+		uint32_t per_workspace = uint32_t(rtg.workspaces.size()); // for easier to read counting
 
-		uint32_t irradiance_size = 32; // 16 or 32
+		std::array<VkDescriptorPoolSize, 3> pool_sizes{
 
-		World_irradiance = rtg.helpers.create_image(
-			VkExtent2D{.width = irradiance_size, .height = irradiance_size},
-			VK_FORMAT_R16G16B16A16_SFLOAT,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_STORAGE_BIT |
-				VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			Helpers::Unmapped,
-			6, // cube faces
-			1  // one mip only
-		);
+			VkDescriptorPoolSize{
+				// union buffer desciptors
+				.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				.descriptorCount = 2 * per_workspace, // one descriptor per set, one set per workspace
+			},
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = 3 * per_workspace, // one descriptoper set, one set per workspace
+			},
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.descriptorCount = 5 * per_workspace, // one descriptoper set, one set per workspace
+			},
 
-		{ // make image view for environment- prefixerd ggx
+		};
 
-			VkImageViewCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.flags = 0,
-				.image = World_environment.handle,
-				.viewType = VK_IMAGE_VIEW_TYPE_CUBE,
-				.format = World_environment.format,
-				// .components sets swizzling and is fine when zero-initialized
-				.subresourceRange{
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = mip_levels,
-					.baseArrayLayer = 0,
-					.layerCount = 6,
-				},
-			};
+		VkDescriptorPoolCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.flags = 0,					  // because CCREATE_FREE_DESCRIPTOR_SET_BIT isin;t include , we can't free individual descript allocated for this pool
+			.maxSets = 3 * per_workspace, // two set per workspace
+			.poolSizeCount = uint32_t(pool_sizes.size()),
+			.pPoolSizes = pool_sizes.data(),
+		};
 
-			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &World_environment_view));
-		}
+		VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &descriptor_pool));
+	}
 
-		{ // make a sampler for the environment
-			VkSamplerCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-				.flags = 0,
-				.magFilter = VK_FILTER_LINEAR,
-				.minFilter = VK_FILTER_LINEAR,
-				.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-				.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-				.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-				.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-				.mipLodBias = 0.0f,
-				.anisotropyEnable = VK_FALSE,
-				.maxAnisotropy = 0.0f, // doesn't matter if anisotropy isn't enabled
-				.compareEnable = VK_FALSE,
-				.compareOp = VK_COMPARE_OP_ALWAYS, // doesn't matter if compare isn't enabled
-				.minLod = 0.0f,
-				.maxLod = float(mip_levels - 1),
-				.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
-				.unnormalizedCoordinates = VK_FALSE,
+	Trace::Zone workspaces_zone("Render::Render workspaces");
+	StartupProfile::Phase workspaces_phase("Render::Render workspaces");
+	workspaces.resize(rtg.workspaces.size());
+	for (Workspace &workspace : workspaces)
+	{
+		Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Workspaces);
+		{ // allocate command buffer:
+			VkCommandBufferAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = command_pool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1,
 			};
-			VK(vkCreateSampler(rtg.device, &create_info, nullptr, &World_environment_sampler));
+			VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &workspace.command_buffer));
 		}
 
-		{ /// irradience-view
-			VkImageViewCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.image = World_irradiance.handle,
-				.viewType = VK_IMAGE_VIEW_TYPE_CUBE,
-				.format = World_irradiance.format,
-				.subresourceRange{
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = 0,
-					.layerCount = 6,
-				},
-			};
-			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &World_irradiance_view));
-		}
+		workspace.Camera_src = rtg.helpers.create_buffer(
+			sizeof(LinesPipeline::Camera),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// goign to have the gpu copy this from memory - transfer_bit
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherenet (no special sync needed)
+			Helpers::Mapped																// get a pointer to teh memory
 
-		{ // storage view for compute output
-			VkImageViewCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.image = World_irradiance.handle,
-				.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
-				.format = World_irradiance.format,
-				.subresourceRange{
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = 0,
-					.layerCount = 6,
-				},
-			};
-			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &World_irradiance_storage_view));
-		}
+		);
+		workspace.Camera = rtg.helpers.create_buffer(
+			sizeof(LinesPipeline::Camera),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use a uniform buffer, also ging to have GPU copy into this memory
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU local memory
+			Helpers::Unmapped													   // don;t get a pinter to memoery
+		);
 
-		{ // make a sampler for the irradiance cubemap
-			VkSamplerCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-				.flags = 0,
-				.magFilter = VK_FILTER_LINEAR,
-				.minFilter = VK_FILTER_LINEAR,
-				.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-				.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-				.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-				.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-				.mipLodBias = 0.0f,
-				.anisotropyEnable = VK_FALSE,
-				.maxAnisotropy = 1.0f,
-				.compareEnable = VK_FALSE,
-				.compareOp = VK_COMPARE_OP_ALWAYS,
-				.minLod = 0.0f,
-				.maxLod = 0.0f, // irradiance cube usually has just 1 mip
-				.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
-				.unnormalizedCoordinates = VK_FALSE,
+		{ // allocated descriptor set for Camera descriptor
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &lines_pipeline.set0_Camera,
 			};
 
-			VK(vkCreateSampler(rtg.device, &create_info, nullptr, &World_irradiance_sampler));
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Camera_descriptors));
 		}
+		// allocate for world
 
-		{
-			VkDescriptorPool cube_descriptor_pool = VK_NULL_HANDLE;
-			{
-				std::array<VkDescriptorPoolSize, 2> pool_sizes{
-					VkDescriptorPoolSize{
-						.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-						.descriptorCount = 1,
-					},
-					VkDescriptorPoolSize{
-						.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-						.descriptorCount = 1,
-					},
-				};
-
-				VkDescriptorPoolCreateInfo pool_ci{
-					.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-					.maxSets = 1,
-					.poolSizeCount = uint32_t(pool_sizes.size()),
-					.pPoolSizes = pool_sizes.data(),
-				};
-
-				VK(vkCreateDescriptorPool(rtg.device, &pool_ci, nullptr, &cube_descriptor_pool));
-			}
-
-			CubePipeline cube_pipeline;
-			cube_pipeline.create(rtg);
-
-			VkDescriptorSet irradiance_set = VK_NULL_HANDLE;
-			{
-				VkDescriptorSetAllocateInfo alloc_info{
-					.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-					.descriptorPool = cube_descriptor_pool,
-					.descriptorSetCount = 1,
-					.pSetLayouts = &cube_pipeline.set0_env,
-				};
-				VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &irradiance_set));
-			}
+		workspace.World_src = rtg.helpers.create_buffer(
+			sizeof(ObjectsPipeline::World),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// goign to have the gpu copy this from memory - transfer_bit
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherenet (no special sync needed)
+			Helpers::Mapped																// get a pointer to teh memory
 
-			VkDescriptorImageInfo env_info{
-				.sampler = World_environment_sampler,
-				.imageView = World_environment_view,
-				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			};
+		);
+		workspace.World = rtg.helpers.create_buffer(
+			sizeof(ObjectsPipeline::World),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use a uniform buffer, also ging to have GPU copy into this memory
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU local memory
+			Helpers::Unmapped													   // don;t get a pinter to memoery
+		);
 
-			VkDescriptorImageInfo out_info{
-				.sampler = VK_NULL_HANDLE,
-				.imageView = World_irradiance_storage_view,
-				.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+		{ // allocated descriptor set for World descriptor s
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &objects_pipeline.set0_World,
 			};
 
-			{
-				std::array<VkWriteDescriptorSet, 2> writes{
-					VkWriteDescriptorSet{
-						.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-						.dstSet = irradiance_set,
-						.dstBinding = 0,
-						.descriptorCount = 1,
-						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-						.pImageInfo = &env_info,
-					},
-					VkWriteDescriptorSet{
-						.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-						.dstSet = irradiance_set,
-						.dstBinding = 1,
-						.descriptorCount = 1,
-						.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-						.pImageInfo = &out_info,
-					},
-				};
-
-				vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
-			}
-			std::cout << "about to render transfer command buffer for irradiance: "
-					  << (void *)rtg.helpers.transfer_command_buffer << std::endl;
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.World_descriptors));
 
-			VK(vkResetCommandBuffer(rtg.helpers.transfer_command_buffer, 0));
-			VkCommandBufferBeginInfo begin_info{
-				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-			};
-			VK(vkBeginCommandBuffer(rtg.helpers.transfer_command_buffer, &begin_info));
-
-			VkCommandBuffer cmd = rtg.helpers.transfer_command_buffer;
-
-			{ // World_irradiance: UNDEFINED -> GENERAL
-				VkImageMemoryBarrier barrier{
-					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-					.srcAccessMask = 0,
-					.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-					.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-					.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-					.image = World_irradiance.handle,
-					.subresourceRange{
-						.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-						.baseMipLevel = 0,
-						.levelCount = 1,
-						.baseArrayLayer = 0,
-						.layerCount = 6,
-					},
-				};
+			// not weill actula fill in this descirpt set beflow
+		}
 
-				vkCmdPipelineBarrier(
-					cmd,
-					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					0,
-					0, nullptr,
-					0, nullptr,
-					1, &barrier);
-			}
+		// light descripters
+		{ // set light infos
+			light_info.sun_light_size = std::max(scene.light_instance_count.sun_light * sizeof(ObjectsPipeline::SunLight),
+												 sizeof(ObjectsPipeline::SunLight));
+			light_info.sun_light_alignment = rtg.helpers.align_buffer_size(light_info.sun_light_size, rtg.device_properties.limits.minStorageBufferOffsetAlignment);
+			light_info.sphere_light_size = std::max(scene.light_instance_count.sphere_light * sizeof(ObjectsPipeline::SphereLight),
+													sizeof(ObjectsPipeline::SphereLight));
+			light_info.sphere_light_alignment = rtg.helpers.align_buffer_size(light_info.sun_light_alignment + light_info.sphere_light_size, rtg.device_properties.limits.minStorageBufferOffsetAlignment);
+			light_info.spot_light_size = std::max(scene.light_instance_count.spot_light * sizeof(ObjectsPipeline::SpotLight),
+												  sizeof(ObjectsPipeline::SpotLight));
 
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cube_pipeline.irradiance_pipeline);
-			vkCmdBindDescriptorSets(
-				cmd,
-				VK_PIPELINE_BIND_POINT_COMPUTE,
-				cube_pipeline.irradiance_layout,
-				0,
-				1,
-				&irradiance_set,
-				0,
-				nullptr);
+			world.SUN_LIGHT_COUNT = scene.light_instance_count.sun_light;
+			world.SPHERE_LIGHT_COUNT = scene.light_instance_count.sphere_light;
+			world.SPOT_LIGHT_COUNT = scene.light_instance_count.spot_light;
+		}
+		{ // create Light buffers
+			size_t needed_bytes = light_info.sphere_light_alignment + light_info.spot_light_size;
+			workspace.Light_src = rtg.helpers.create_buffer(
+				needed_bytes,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				Helpers::Mapped // get a pointer to the memory
+			);
+			workspace.Light = rtg.helpers.create_buffer(
+				needed_bytes,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // GPU-local memory
+				Helpers::Unmapped					 // don't get a pointer to the memory
+			);
+		}
 
-			CubePipeline::IrradiancePush push{
-				.size = irradiance_size,
-				.numSamples = 2048 * 16,
+		{ // allocate descriptor
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &objects_pipeline.set1_Transforms,
 			};
 
-			vkCmdPushConstants(
-				cmd,
-				cube_pipeline.irradiance_layout,
-				VK_SHADER_STAGE_COMPUTE_BIT,
-				0,
-				sizeof(push),
-				&push);
-
-			vkCmdDispatch(
-				cmd,
-				(irradiance_size + 7) / 8,
-				(irradiance_size + 7) / 8,
-				6);
-
-			{ // World_irradiance: GENERAL -> SHADER_READ_ONLY_OPTIMAL
-				VkImageMemoryBarrier barrier{
-					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-					.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-					.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-					.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-					.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-					.image = World_irradiance.handle,
-					.subresourceRange{
-						.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-						.baseMipLevel = 0,
-						.levelCount = 1,
-						.baseArrayLayer = 0,
-						.layerCount = 6,
-					},
-				};
-
-				vkCmdPipelineBarrier(
-					cmd,
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-					0,
-					0, nullptr,
-					0, nullptr,
-					1, &barrier);
-			}
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Transforms_descriptors));
+		}
 
-			VK(vkEndCommandBuffer(cmd));
+		{ // point descriptors to buffer:
+			VkDescriptorBufferInfo Camera_info{
+				.buffer = workspace.Camera.handle,
+				.offset = 0,
+				.range = workspace.Camera.size,
+			};
 
-			VkSubmitInfo submit_info{
-				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-				.commandBufferCount = 1,
-				.pCommandBuffers = &cmd,
+			VkDescriptorBufferInfo World_info{
+				.buffer = workspace.World.handle,
+				.offset = 0,
+				.range = workspace.World.size,
 			};
 
-			VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
-			VK(vkQueueWaitIdle(rtg.graphics_queue));
-			vkDestroyDescriptorPool(rtg.device, cube_descriptor_pool, nullptr);
-			cube_pipeline.destroy(rtg);
-		}
-	}
+			VkDescriptorBufferInfo SunLight_info{
+				.buffer = workspace.Light.handle,
+				.offset = 0,
+				.range = light_info.sun_light_size,
+			};
+			VkDescriptorBufferInfo SphereLight_info{
+				.buffer = workspace.Light.handle,
+				.offset = light_info.sun_light_size,
+				.range = light_info.sphere_light_size,
+			};
+			VkDescriptorBufferInfo SpotLight_info{
+				.buffer = workspace.Light.handle,
+				.offset = light_info.sphere_light_alignment,
+				.range = light_info.spot_light_size,
+			};
 
-	{ // make a sampler for the normal textures and BRDF LUT
-		VkSamplerCreateInfo create_info{
-			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-			.flags = 0,
-			.magFilter = VK_FILTER_NEAREST,
-			.minFilter = VK_FILTER_NEAREST,
-			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
-			.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-			.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-			.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-			.mipLodBias = 0.0f,
-			.anisotropyEnable = VK_FALSE,
-			.maxAnisotropy = 0.0f, // doesn't matter if anisotropy isn't enabled
-			.compareEnable = VK_FALSE,
-			.compareOp = VK_COMPARE_OP_ALWAYS, // doesn't matter if compare isn't enabled
-			.minLod = 0.0f,
-			.maxLod = 0.0f,
-			.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
-			.unnormalizedCoordinates = VK_FALSE,
-		};
-		VK(vkCreateSampler(rtg.device, &create_info, nullptr, &texture_sampler));
-	}
-
-	{ // environment BRDF LUT
-		uint32_t brdf_size = 256;
+			VkDescriptorImageInfo ShadowAtlas_info{
+				.sampler = shadow_sampler,
+				.imageView = Shadow_atlas_view,
+				.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, // final layout of shadow_atlas_pass,
+			};
+			// image bindings 1-3 are written by write_world_image_descriptors():
+			std::array<VkWriteDescriptorSet, 6> writes{
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.Camera_descriptors,
+					.dstBinding = 0,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+					.pBufferInfo = &Camera_info,
+				},
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.World_descriptors,
+					.dstBinding = 0,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+					.pBufferInfo = &World_info,
+				},
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.World_descriptors,
+					.dstBinding = 4,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &SunLight_info,
+				},
 
-		World_environment_brdf_lut = rtg.helpers.create_image(
-			VkExtent2D{.width = brdf_size, .height = brdf_size},
-			VK_FORMAT_R16G16_SFLOAT,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			Helpers::Unmapped,
-			1,
-			1);
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.World_descriptors,
+					.dstBinding = 5,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &SphereLight_info,
+				},
 
-		{ // image view
-			VkImageViewCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.image = World_environment_brdf_lut.handle,
-				.viewType = VK_IMAGE_VIEW_TYPE_2D,
-				.format = World_environment_brdf_lut.format,
-				.subresourceRange{
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = 0,
-					.layerCount = 1,
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.World_descriptors,
+					.dstBinding = 6,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &SpotLight_info,
+				},
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.World_descriptors,
+					.dstBinding = 7,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.pImageInfo = &ShadowAtlas_info,
 				},
 			};
 
-			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &World_environment_brdf_lut_view));
+			vkUpdateDescriptorSets(
+				rtg.device,				 // device
+				uint32_t(writes.size()), // descriptor write count
+				writes.data(),			 // pDescriptorWrites
+				0,						 // descriptroyCopyCount
+				nullptr					 // pDescriptorCopies
+			);
 		}
+	}
+	gpu_timestamps.create(rtg, workspaces);
+	workspaces_phase.end();
+	workspaces_zone.end();
 
-		VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
-		{
-			VkDescriptorSetLayoutBinding binding{
-				.binding = 0,
-				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
-			};
-
-			VkDescriptorSetLayoutCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-				.bindingCount = 1,
-				.pBindings = &binding,
-			};
+	{ // create object vertices
+		TRACE_ZONE("Render::Render object vertices");
+		StartupProfile::Phase startup_phase("Render::Render object vertices");
+		std::vector<PosNorTanTexVertex> vertices;
 
-			VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set_layout));
-		}
+		// reserve space and assign vao vbo via scene information
+		vertices.resize(scene.vertices_count);
+		uint32_t new_vertices_start = 0;
+		size_t mesh_count = scene.meshes.size();
+		mesh_vertices.assign(mesh_count, ObjectVertices());
+		mesh_AABBs.assign(scene.meshes.size(), AABB());
 
-		VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+		// create meshes
+		for (uint32_t i = 0; i < uint32_t(mesh_count); ++i)
 		{
-			VkPushConstantRange range{
-				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
-				.offset = 0,
-				.size = sizeof(BrdfPush),
-			};
+			Scene::Mesh &cur_mesh = scene.meshes[i];
+			mesh_vertices[i].count = cur_mesh.count;
+			mesh_vertices[i].first = new_vertices_start;
 
-			VkPipelineLayoutCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-				.setLayoutCount = 1,
-				.pSetLayouts = &set_layout,
-				.pushConstantRangeCount = 1,
-				.pPushConstantRanges = &range,
-			};
+			StartupProfile::Asset mesh_asset("mesh", cur_mesh.attributes[0].source);
+			mesh_asset.bytes = cur_mesh.count * sizeof(PosNorTanTexVertex);
 
-			VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &pipeline_layout));
+			// find mesh source via filepath
+			StartupProfile::Work read_work("mesh read");
+			read_work.bytes = mesh_asset.bytes;
+			std::ifstream file(scene.scene_path + "/" + cur_mesh.attributes[0].source, std::ios::binary); // assuming the attribute layout holds
+			if (!file.is_open())
+				throw std::runtime_error("Error opening file for mesh data: " + scene.scene_path + "/" + cur_mesh.attributes[0].source);
+			if (!file.read(reinterpret_cast<char *>(&vertices[new_vertices_start]), cur_mesh.count * sizeof(PosNorTanTexVertex)))
+			{
+				throw std::runtime_error("Failed to read mesh data: " + scene.scene_path + "/" + cur_mesh.attributes[0].source);
+			}
+			read_work.end();
+
+			// find OOB and create mesh ABBS
+			StartupProfile::Work aabb_work("mesh AABB");
+			aabb_work.bytes = mesh_asset.bytes;
+			for (size_t vertex_i = mesh_vertices[i].first; vertex_i < (mesh_vertices[i].first + mesh_vertices[i].count); ++vertex_i)
+			{
+				glm::vec3 cur_vert_pos = {vertices[vertex_i].Position.x, vertices[vertex_i].Position.y, vertices[vertex_i].Position.z};
+				mesh_AABBs[i].min = glm::min(mesh_AABBs[i].min, cur_vert_pos);
+				mesh_AABBs[i].max = glm::max(mesh_AABBs[i].max, cur_vert_pos);
+			}
+			new_vertices_start += cur_mesh.count;
 		}
+		assert(new_vertices_start == scene.vertices_count);
 
-		VkShaderModule comp_module = rtg.helpers.create_shader_module(comp_brdf, sizeof(comp_brdf));
+		size_t bytes = vertices.size() * sizeof(vertices[0]);
+		startup_phase.bytes = bytes;
+		Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Vertices);
+		object_vertices = rtg.helpers.create_buffer(
+			bytes,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped);
 
-		VkPipeline pipeline = VK_NULL_HANDLE;
-		{
-			VkPipelineShaderStageCreateInfo shader_stage{
-				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
-				.module = comp_module,
-				.pName = "main",
-			};
+		// copy data to buffer
+		rtg.helpers.transfer_to_buffer(vertices.data(), bytes, object_vertices);
+	}
 
-			VkComputePipelineCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-				.stage = shader_stage,
-				.layout = pipeline_layout,
-			};
+	{ /// Create texture
+		TRACE_ZONE("Render::Render textures");
+		StartupProfile::Phase startup_phase("Render::Render textures");
+		Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Textures);
+		// all images loaded should be flipped as s72 file format has the image origin at bottom left while stbi load is top left
+		stbi_set_flip_vertically_on_load(true);
 
-			VK(vkCreateComputePipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
-		}
+		// streaming keeps finer levels of cached block compressed textures on disk until something visible needs them:
+		texture_streaming.budget = rtg.configuration.compress_textures ? size_t(rtg.configuration.texture_budget_mb) << 20 : 0;
 
-		VkDescriptorPool brdf_descriptor_pool = VK_NULL_HANDLE;
-		{
-			VkDescriptorPoolSize pool_size{
-				.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-				.descriptorCount = 1,
-			};
+		// create scene textures
+		{											 // make some textures
+			textures.reserve(scene.textures.size()); // upper bound, constants and packed sources share images
+			texture_slots.assign(scene.textures.size(), NoTextureSlot);
+			material_orm_slots.assign(scene.materials.size(), NoTextureSlot);
 
-			VkDescriptorPoolCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-				.maxSets = 1,
-				.poolSizeCount = 1,
-				.pPoolSizes = &pool_size,
+			// sourced textures get a full mip chain (blitted down by transfer_to_image) when their format allows it:
+			auto create_texture = [&](int width, int height, VkFormat format)
+			{
+				VkExtent2D extent{.width = uint32_t(width), .height = uint32_t(height)};
+				uint32_t mip_levels = rtg.helpers.blittable_mip_levels(extent, format);
+				VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT; // will sample and upload
+				if (mip_levels > 1)
+					usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // mip levels are blitted from the level above
+				return rtg.helpers.create_image(
+					extent,
+					format,
+					VK_IMAGE_TILING_OPTIMAL,
+					usage,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // should be device-local
+					Helpers::Unmapped,
+					1,
+					mip_levels);
 			};
 
-			VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &brdf_descriptor_pool));
-		}
+			// normal maps compress to two channels, everything else by channel count:
+			std::vector<CompressedTexture::Role> texture_roles(scene.textures.size(), CompressedTexture::Color);
+			for (uint32_t i = 0; i < scene.textures.size(); ++i)
+			{
+				if (scene.textures[i].single_channel)
+					texture_roles[i] = CompressedTexture::Scalar;
+			}
+			for (Scene::Material const &material : scene.materials)
+			{
+				texture_roles[material.normal_index] = CompressedTexture::Normal;
+			}
 
-		VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
-		{
-			VkDescriptorSetAllocateInfo alloc_info{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-				.descriptorPool = brdf_descriptor_pool,
-				.descriptorSetCount = 1,
-				.pSetLayouts = &set_layout,
-			};
+			// PBR roughness and metalness are sampled through the packed ORM texture made below (and no PBR shader reads
+			// displacement), so those sources only get an image of their own when another binding samples them:
+			std::vector<bool> sampled_unpacked(scene.textures.size(), false);
+			for (Scene::Material const &material : scene.materials)
+			{
+				sampled_unpacked[material.normal_index] = true;
+				if (material.material_type == Scene::Material::PBR)
+				{
+					sampled_unpacked[std::get<Scene::Material::PBRMaterial>(material.material_textures).albedo_index] = true;
+					continue;
+				}
+				sampled_unpacked[material.displacement_index] = true;
+				if (material.material_type == Scene::Material::Lambertian)
+					sampled_unpacked[std::get<Scene::Material::LambertianMaterial>(material.material_textures).albedo_index] = true;
+			}
 
-			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &descriptor_set));
+			auto can_sample = [&](VkFormat format)
+			{
+				VkFormatProperties props;
+				vkGetPhysicalDeviceFormatProperties(rtg.physical_device, format, &props);
+				VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+				return (props.optimalTilingFeatures & needed) == needed;
+			};
 
-			VkDescriptorImageInfo out_info{
-				.sampler = VK_NULL_HANDLE,
-				.imageView = World_environment_brdf_lut_view,
-				.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+			// reads the block compressed texture cached at cache_path, or calls encode() and caches the result when the cache is stale.
+			// when streaming, only the mip tail is read (or kept), finer levels are read from the cache on demand:
+			auto load_compressed = [&](std::string const &cache_path, uint64_t stamp, VkFormat format, auto const &encode)
+			{
+				uint32_t max_extent = texture_streaming.enabled() ? TextureStreaming::tail_extent : ~0u;
+				CompressedTexture compressed;
+				StartupProfile::Work read_work("texture cache read");
+				bool cached = compressed.load(cache_path, stamp, max_extent) && compressed.format == format;
+				read_work.bytes = cached ? compressed.data.size() : 0;
+				read_work.end();
+				if (!cached)
+				{
+					compressed = encode();
+					StartupProfile::Work write_work("texture cache write");
+					write_work.bytes = compressed.data.size();
+					compressed.save(cache_path, stamp);
+					write_work.end();
+					compressed.drop_levels(compressed.level_for_extent(max_extent));
+					if (rtg.configuration.debug)
+					{
+						std::cout << "Compressed to " << CompressedTexture::format_name(format) << ", cached at " << cache_path << "\n";
+					}
+				}
+				return compressed;
 			};
 
-			VkWriteDescriptorSet write{
-				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-				.dstSet = descriptor_set,
-				.dstBinding = 0,
-				.descriptorCount = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-				.pImageInfo = &out_info,
+			// returns the slot of the uploaded image, textures missing their finer levels are handed to texture streaming:
+			auto upload_compressed = [&](CompressedTexture &&compressed, std::string const &cache_path, uint64_t stamp)
+			{
+				textures.emplace_back(rtg.helpers.create_image(
+					compressed.level_extent(compressed.first_level), // size of image
+					compressed.format,
+					VK_IMAGE_TILING_OPTIMAL,
+					VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
+					Helpers::Unmapped,
+					1,
+					compressed.level_count() - compressed.first_level));
+
+				rtg.helpers.transfer_to_image_levels(compressed.data.data(), compressed.data.size(), textures.back(), compressed.loaded_level_offsets());
+				uint32_t slot = uint32_t(textures.size() - 1);
+
+				if (compressed.first_level > 0)
+				{
+					texture_streaming.slots.resize(textures.size());
+					TextureStreaming::Residency &residency = texture_streaming.slots[slot];
+					residency.cache_path = cache_path;
+					residency.stamp = stamp;
+					residency.tail_level = residency.resident_level = residency.wanted_level = residency.target_level = compressed.first_level;
+					compressed.data.clear();
+					residency.header = std::move(compressed);
+				}
+				return slot;
 			};
 
-			vkUpdateDescriptorSets(rtg.device, 1, &write, 0, nullptr);
-		}
-		std::cout << "about to render tranfer ommand buffer: " << (void *)rtg.helpers.transfer_command_buffer << std::endl;
-		VK(vkResetCommandBuffer(rtg.helpers.transfer_command_buffer, 0));
+			// constant valued textures are 1x1 images, one per distinct value (a small shared palette):
+			std::unordered_map<uint64_t, uint32_t> constant_slots; // (single channel << 32 | rgba) -> slot
+			auto constant_slot = [&](glm::u8vec4 value, bool single_channel)
+			{
+				if (single_channel)
+					value = glm::u8vec4(value.r, 0, 0, 0);
+				uint64_t key = (uint64_t(single_channel) << 32) | uint64_t(value.r) | (uint64_t(value.g) << 8) | (uint64_t(value.b) << 16) | (uint64_t(value.a) << 24);
+				if (auto found = constant_slots.find(key); found != constant_slots.end())
+					return found->second;
+
+				textures.emplace_back(rtg.helpers.create_image(
+					VkExtent2D{.width = 1, .height = 1}, // size of image
+					single_channel ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8G8B8A8_UNORM,
+					VK_IMAGE_TILING_OPTIMAL,
+					VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
+					Helpers::Unmapped));
+
+				// transfer data:
+				rtg.helpers.transfer_to_image(&value, single_channel ? sizeof(uint8_t) : sizeof(uint8_t) * 4, textures.back());
+
+				uint32_t slot = uint32_t(textures.size() - 1);
+				constant_slots.emplace(key, slot);
+				return slot;
+			};
 
-		VkCommandBufferBeginInfo begin_info{
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-		};
-		VK(vkBeginCommandBuffer(rtg.helpers.transfer_command_buffer, &begin_info));
+			for (uint32_t i = 0; i < scene.textures.size(); ++i)
+			{
+				if (!sampled_unpacked[i])
+					continue;
 
-		VkCommandBuffer cmd = rtg.helpers.transfer_command_buffer;
+				Scene::Texture &cur_texture = scene.textures[i];
+				if (cur_texture.has_src)
+				{
+					int width, height, n;
+					unsigned char *image;
+					std::string source = std::get<std::string>(cur_texture.value);
+					StartupProfile::Asset texture_asset("texture", source);
+					texture_asset.bytes = source_bytes(scene.scene_path + "/" + source);
+
+					// block compressed path, RGBE and single channel sRGB sources stay uncompressed (no matching BC format):
+					CompressedTexture::Role role = texture_roles[i];
+					bool srgb = cur_texture.format == Scene::Texture::sRGB;
+					VkFormat compressed_format = CompressedTexture::format_for(role, srgb);
+					if (rtg.configuration.compress_textures && cur_texture.format != Scene::Texture::RGBE && !(role == CompressedTexture::Scalar && srgb) && can_sample(compressed_format))
+					{
+						std::string source_path = scene.scene_path + "/" + source;
+						std::string cache_path = scene.scene_path + "/texture-cache/" + source + "." + CompressedTexture::format_name(compressed_format) + ".nktx";
 
-		{ // UNDEFINED -> GENERAL
-			VkImageMemoryBarrier barrier{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-				.srcAccessMask = 0,
-				.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.image = World_environment_brdf_lut.handle,
-				.subresourceRange{
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = 0,
-					.layerCount = 1,
-				},
-			};
+						auto encode = [&]()
+						{
+							StartupProfile::Work decode_work("texture decode");
+							decode_work.bytes = texture_asset.bytes;
+							image = stbi_load(source_path.c_str(), &width, &height, &n, role == CompressedTexture::Scalar ? 1 : 4);
+							if (image == NULL)
+								throw std::runtime_error("Error loading texture " + source_path);
+							decode_work.end();
+							StartupProfile::Work compress_work("texture compress");
+							compress_work.bytes = size_t(width) * height * (role == CompressedTexture::Scalar ? 1 : 4);
+							CompressedTexture encoded = CompressedTexture::encode(image, uint32_t(width), uint32_t(height), role, srgb);
+							stbi_image_free(image);
+							return encoded;
+						};
 
-			vkCmdPipelineBarrier(
-				cmd,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &barrier);
-		}
+						uint64_t stamp = CompressedTexture::source_stamp(source_path);
+						texture_slots[i] = upload_compressed(load_compressed(cache_path, stamp, compressed_format, encode), cache_path, stamp);
+						continue;
+					}
 
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-		vkCmdBindDescriptorSets(
-			cmd,
-			VK_PIPELINE_BIND_POINT_COMPUTE,
-			pipeline_layout,
-			0,
-			1,
-			&descriptor_set,
-			0,
-			nullptr);
+					if (cur_texture.single_channel)
+					{ // just read the r value
+						assert(cur_texture.format != Scene::Texture::RGBE);
+						VkFormat format = cur_texture.format == Scene::Texture::Linear ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8_SRGB;
+						StartupProfile::Work decode_work("texture decode");
+						decode_work.bytes = texture_asset.bytes;
+						image = stbi_load((scene.scene_path + "/" + source).c_str(), &width, &height, &n, 1);
+						if (image == NULL)
+							throw std::runtime_error("Error loading texture " + scene.scene_path + "/" + source);
+						decode_work.end();
+						textures.emplace_back(create_texture(width, height, format));
 
-		BrdfPush push{
-			.size = brdf_size,
-			.numSamples = 4096 * 16,
-		};
+						rtg.helpers.transfer_to_image(image, sizeof(image[0]) * width * height, textures.back());
+					}
+					else
+					{
+						StartupProfile::Work decode_work("texture decode");
+						decode_work.bytes = texture_asset.bytes;
+						image = stbi_load((scene.scene_path + "/" + source).c_str(), &width, &height, &n, 4);
+						if (image == NULL)
+							throw std::runtime_error("Error loading texture " + scene.scene_path + "/" + source);
+						decode_work.end();
+						if (cur_texture.format == Scene::Texture::RGBE)
+						{
+							std::vector<uint32_t> converted_image(width * height);
+							StartupProfile::Work convert_work("rgbe conversion");
+							convert_work.bytes = converted_image.size() * 4;
+							rgbe_to_E5B9G9R9(image, converted_image.data(), converted_image.size());
+							convert_work.end();
+							textures.emplace_back(create_texture(width, height, VK_FORMAT_E5B9G9R9_UFLOAT_PACK32));
 
-		vkCmdPushConstants(
-			cmd,
-			pipeline_layout,
-			VK_SHADER_STAGE_COMPUTE_BIT,
-			0,
-			sizeof(push),
-			&push);
+							rtg.helpers.transfer_to_image(converted_image.data(), sizeof(converted_image[0]) * width * height, textures.back());
+						}
+						else
+						{
+							VkFormat format = cur_texture.format == Scene::Texture::sRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+							textures.emplace_back(create_texture(width, height, format));
 
-		vkCmdDispatch(
-			cmd,
-			(brdf_size + 7) / 8,
-			(brdf_size + 7) / 8,
-			1);
+							rtg.helpers.transfer_to_image(image, sizeof(image[0]) * width * height * 4, textures.back());
+						}
+					}
+					// free image:
+					stbi_image_free(image);
+					texture_slots[i] = uint32_t(textures.size() - 1);
+				}
+				else if (cur_texture.single_channel)
+				{
+					texture_slots[i] = constant_slot(glm::u8vec4(uint8_t(std::get<float>(cur_texture.value) * 255.0f), 0, 0, 0), true);
+				}
+				else
+				{
+					glm::vec3 value = std::get<glm::vec3>(cur_texture.value);
+					texture_slots[i] = constant_slot(glm::u8vec4(uint8_t(value.x * 255.0f), uint8_t(value.y * 255.0f), uint8_t(value.z * 255.0f), 255), false);
+				}
+			}
 
-		{ // GENERAL -> SHADER_READ_ONLY_OPTIMAL
-			VkImageMemoryBarrier barrier{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-				.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.image = World_environment_brdf_lut.handle,
+			// pack every PBR material's roughness (r) and metalness (g) into one linear two channel texture, one sampler in
+			// pbr.frag instead of two; BC5 (two independent BC4 channels, 1 B/px) with --compress-textures, else R8G8:
+			std::map<std::array<uint32_t, 2>, uint32_t> orm_slots; // (roughness, metalness) texture indices -> slot
+			for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+			{
+				Scene::Material const &material = scene.materials[material_index];
+				if (material.material_type != Scene::Material::PBR)
+					continue;
+
+				Scene::Material::PBRMaterial const &pbr_textures = std::get<Scene::Material::PBRMaterial>(material.material_textures);
+				std::array<uint32_t, 2> channels{pbr_textures.roughness_index, pbr_textures.metalness_index};
+				if (auto found = orm_slots.find(channels); found != orm_slots.end())
+				{
+					material_orm_slots[material_index] = found->second;
+					continue;
+				}
+
+				// channels without a source contribute a constant, named by value in the cache key:
+				glm::u8vec4 constant(0, 0, 0, 255);
+				std::string orm_name;
+				uint64_t stamp = 0;
+				bool has_src = false;
+				for (uint32_t c = 0; c < 2; ++c)
+				{
+					Scene::Texture const &texture = scene.textures[channels[c]];
+					if (texture.has_src)
+					{
+						std::string source_path = scene.scene_path + "/" + std::get<std::string>(texture.value);
+						orm_name += std::get<std::string>(texture.value) + (texture.format == Scene::Texture::sRGB ? ":srgb;" : ";");
+						stamp = (stamp ^ CompressedTexture::source_stamp(source_path)) * 1099511628211ull;
+						has_src = true;
+						continue;
+					}
+					float value = texture.single_channel ? std::get<float>(texture.value) : std::get<glm::vec3>(texture.value).x;
+					constant[c] = uint8_t(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+					orm_name += std::to_string(constant[c]) + ";";
+				}
+
+				uint32_t slot;
+				if (!has_src)
+				{
+					slot = constant_slot(constant, false);
+				}
+				else
+				{
+					StartupProfile::Asset texture_asset("texture", "orm:" + orm_name);
+					for (uint32_t c = 0; c < 2; ++c)
+					{
+						if (scene.textures[channels[c]].has_src)
+							texture_asset.bytes += source_bytes(scene.scene_path + "/" + std::get<std::string>(scene.textures[channels[c]].value));
+					}
+					// reads the sources (nearest-resampled to the largest one) into two channels, sRGB encoded sources are linearized:
+					uint32_t width = 0, height = 0;
+					auto pack = [&]()
+					{
+						StartupProfile::Work pack_work("texture ORM pack");
+						pack_work.bytes = texture_asset.bytes;
+						std::array<unsigned char *, 2> images{};
+						std::array<int, 2> widths{}, heights{};
+						for (uint32_t c = 0; c < 2; ++c)
+						{
+							Scene::Texture const &texture = scene.textures[channels[c]];
+							if (!texture.has_src)
+								continue;
+							std::string source_path = scene.scene_path + "/" + std::get<std::string>(texture.value);
+							int n;
+							images[c] = stbi_load(source_path.c_str(), &widths[c], &heights[c], &n, 1);
+							if (images[c] == NULL)
+								throw std::runtime_error("Error loading texture " + source_path);
+							width = std::max(width, uint32_t(widths[c]));
+							height = std::max(height, uint32_t(heights[c]));
+						}
+
+						std::array<uint8_t, 256> srgb_to_linear;
+						for (uint32_t v = 0; v < 256; ++v)
+						{
+							float s = v / 255.0f;
+							float l = (s <= 0.04045f ? s / 12.92f : std::pow((s + 0.055f) / 1.055f, 2.4f));
+							srgb_to_linear[v] = uint8_t(std::lround(l * 255.0f));
+						}
+
+						std::vector<uint8_t> pixels(size_t(width) * height * 2);
+						for (uint32_t y = 0; y < height; ++y)
+						{
+							for (uint32_t x = 0; x < width; ++x)
+							{
+								uint8_t *px = &pixels[(size_t(y) * width + x) * 2];
+								for (uint32_t c = 0; c < 2; ++c)
+								{
+									if (images[c] == nullptr)
+									{
+										px[c] = constant[c];
+										continue;
+									}
+									uint32_t sx = x * uint32_t(widths[c]) / width;
+									uint32_t sy = y * uint32_t(heights[c]) / height;
+									uint8_t v = images[c][size_t(sy) * widths[c] + sx];
+									px[c] = scene.textures[channels[c]].format == Scene::Texture::sRGB ? srgb_to_linear[v] : v;
+								}
+							}
+						}
+
+						for (unsigned char *image : images)
+						{
+							if (image != nullptr)
+								stbi_image_free(image);
+						}
+						return pixels;
+					};
+
+					// BC5 encodes each channel on its own, so roughness and metalness don't bleed into each other (as with BC1):
+					VkFormat compressed_format = CompressedTexture::format_for(CompressedTexture::Pair, false);
+					if (rtg.configuration.compress_textures && can_sample(compressed_format))
+					{
+						char name[17];
+						std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)std::hash<std::string>{}(orm_name));
+						std::string cache_path = scene.scene_path + "/texture-cache/orm-" + name + "." + CompressedTexture::format_name(compressed_format) + ".nktx";
+
+						auto encode = [&]()
+						{
+							std::vector<uint8_t> pixels = pack();
+							StartupProfile::Work compress_work("texture compress");
+							compress_work.bytes = pixels.size();
+							return CompressedTexture::encode(pixels.data(), width, height, CompressedTexture::Pair, false);
+						};
+
+						slot = upload_compressed(load_compressed(cache_path, stamp, compressed_format, encode), cache_path, stamp);
+					}
+					else
+					{
+						std::vector<uint8_t> pixels = pack();
+						textures.emplace_back(create_texture(int(width), int(height), VK_FORMAT_R8G8_UNORM));
+						rtg.helpers.transfer_to_image(pixels.data(), pixels.size(), textures.back());
+						slot = uint32_t(textures.size() - 1);
+					}
+				}
+
+				orm_slots.emplace(channels, slot);
+				material_orm_slots[material_index] = slot;
+			}
+
+			texture_streaming.slots.resize(textures.size());
+
+			if (rtg.configuration.debug)
+			{
+				std::cout << "Uploaded " << textures.size() << " texture images for " << scene.textures.size() << " scene textures (" << constant_slots.size() << " constants, " << orm_slots.size() << " packed ORM)\n";
+			}
+		}
+	}
+
+	{ // make image views for the texture
+		texture_views.reserve(textures.size());
+		for (Helpers::AllocatedImage const &image : textures)
+		{
+			VkImageViewCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				.flags = 0,
+				.image = image.handle,
+				.viewType = VK_IMAGE_VIEW_TYPE_2D,
+				.format = image.format,
+				// .componet set swizling and is fine when zero-initialied
 				.subresourceRange{
 					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 					.baseMipLevel = 0,
-					.levelCount = 1,
+					.levelCount = image.mip_levels,
 					.baseArrayLayer = 0,
 					.layerCount = 1,
-				},
-			};
+				}};
 
-			vkCmdPipelineBarrier(
-				cmd,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &barrier);
-		}
+			VkImageView image_view = VK_NULL_HANDLE;
+			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &image_view));
 
-		VK(vkEndCommandBuffer(cmd));
+			texture_views.emplace_back(image_view);
+		}
+		assert(texture_views.size() == textures.size());
+	}
 
-		VkSubmitInfo submit_info{
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &cmd,
+	{
+		VkSamplerCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.flags = 0,
+			.magFilter = VK_FILTER_NEAREST,
+			.minFilter = VK_FILTER_LINEAR,				 // minified lookups blend between texels
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR, // and between mip levels
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.mipLodBias = 0.0f,
+			.anisotropyEnable = VK_FALSE,
+			.maxAnisotropy = 0.0f, // doesn't matter if anisotropy ins't enabled
+			.compareEnable = VK_FALSE,
+			.compareOp = VK_COMPARE_OP_ALWAYS, // doesn't matter if compre isnt' enabled
+			.minLod = 0.0f,
+			.maxLod = VK_LOD_CLAMP_NONE, // every texture's full mip chain
+			.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+			.unnormalizedCoordinates = VK_FALSE,
 		};
 
-		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
-		VK(vkQueueWaitIdle(rtg.graphics_queue));
+		VK(vkCreateSampler(rtg.device, &create_info, nullptr, &texture_sampler));
+	}
 
-		vkDestroyDescriptorPool(rtg.device, brdf_descriptor_pool, nullptr);
-		vkDestroyPipeline(rtg.device, pipeline, nullptr);
-		vkDestroyPipelineLayout(rtg.device, pipeline_layout, nullptr);
-		vkDestroyDescriptorSetLayout(rtg.device, set_layout, nullptr);
-		vkDestroyShaderModule(rtg.device, comp_module, nullptr);
+	// point World descriptors at the image based lighting created by require() above (BRDF_LUT uses texture_sampler):
+	write_world_image_descriptors();
+
+	// materials with the same type and the same images share one descriptor set:
+	std::vector<uint32_t> material_sets(scene.materials.size()); // material index -> first material with an identical set
+	std::vector<uint32_t> unique_materials;
+	{
+		std::map<std::pair<uint8_t, std::vector<uint32_t>>, uint32_t> first_material;
+		for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+		{
+			auto key = std::make_pair(uint8_t(scene.materials[material_index].material_type), material_texture_slots(material_index));
+			auto [found, inserted] = first_material.emplace(std::move(key), material_index);
+			material_sets[material_index] = found->second;
+			if (inserted)
+				unique_materials.emplace_back(material_index);
+		}
+		if (rtg.configuration.debug)
+		{
+			std::cout << "Materials use " << unique_materials.size() << " distinct texture descriptor sets for " << scene.materials.size() << " materials.\n";
+		}
 	}
 
-	{															  // create descriptor pool:
-		uint32_t per_workspace = uint32_t(rtg.workspaces.size()); // for easier to read counting
+	Trace::Zone descriptors_zone("Render::Render material descriptors");
+	StartupProfile::Phase descriptors_phase("Render::Render material descriptors");
+	{ // create the texture descirptor pool
 
-		std::array<VkDescriptorPoolSize, 3> pool_sizes{
+		// streamed textures move their materials to new sets while the old ones wait out the frames in flight:
+		uint32_t generations = texture_streaming.enabled() ? uint32_t(rtg.workspaces.size()) + 2 : 1;
+		uint32_t per_material = uint32_t(unique_materials.size());
+		uint32_t per_pbr_material = 0;
+		uint32_t per_lambertian_material = 0;
+		uint32_t per_envmirror_material = 0;
+		for (uint32_t material_index : unique_materials)
+		{
+			Scene::Material::MaterialType type = scene.materials[material_index].material_type;
+			if (type == Scene::Material::PBR)
+				++per_pbr_material;
+			else if (type == Scene::Material::Lambertian)
+				++per_lambertian_material;
+			else
+				++per_envmirror_material;
+		}
+
+		std::array<VkDescriptorPoolSize, 1> pool_sizes{
 
 			VkDescriptorPoolSize{
-				// union buffer desciptors
-				.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				.descriptorCount = 2 * per_workspace, // one descriptor per set, one set per workspace
-			},
-			VkDescriptorPoolSize{
+				// union buffer descirpts
 				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 3 * per_workspace, // one descriptoper set, one set per workspace
-			},
-			VkDescriptorPoolSize{
-				.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				.descriptorCount = 4 * per_workspace, // one descriptoper set, one set per workspace
+				.descriptorCount = generations * (3 * per_pbr_material + 3 * per_lambertian_material + 2 * per_envmirror_material),
 			},
-
 		};
 
 		VkDescriptorPoolCreateInfo create_info{
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-			.flags = 0,					  // because CCREATE_FREE_DESCRIPTOR_SET_BIT isin;t include , we can't free individual descript allocated for this pool
-			.maxSets = 3 * per_workspace, // two set per workspace
+			.flags = texture_streaming.enabled() ? VkDescriptorPoolCreateFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) : 0, // retired sets are freed one by one
+			.maxSets = generations * per_material,
 			.poolSizeCount = uint32_t(pool_sizes.size()),
 			.pPoolSizes = pool_sizes.data(),
 		};
 
-		VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &descriptor_pool));
+		VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &texture_descriptor_pool));
 	}
 
-	workspaces.resize(rtg.workspaces.size());
-	for (Workspace &workspace : workspaces)
-	{
-		{ // allocate command buffer:
-			VkCommandBufferAllocateInfo alloc_info{
-				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-				.commandPool = command_pool,
-				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				.commandBufferCount = 1,
-			};
-			VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &workspace.command_buffer));
-		}
-
-		workspace.Camera_src = rtg.helpers.create_buffer(
-			sizeof(LinesPipeline::Camera),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// goign to have the gpu copy this from memory - transfer_bit
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherenet (no special sync needed)
-			Helpers::Mapped																// get a pointer to teh memory
-
-		);
-		workspace.Camera = rtg.helpers.create_buffer(
-			sizeof(LinesPipeline::Camera),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use a uniform buffer, also ging to have GPU copy into this memory
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU local memory
-			Helpers::Unmapped													   // don;t get a pinter to memoery
-		);
+	{ // allocate and write the texture descriptor sets
+		texture_descriptors.assign(scene.materials.size(), VK_NULL_HANDLE);
 
-		{ // allocated descriptor set for Camera descriptor
+		for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+		{
+			VkDescriptorSet &descriptor_set = texture_descriptors[material_index];
+			if (material_sets[material_index] != material_index)
+			{ // identical to an earlier material, which already has its set
+				descriptor_set = texture_descriptors[material_sets[material_index]];
+				continue;
+			}
+			VkDescriptorSetLayout layout = material_set_layout(material_index);
 			VkDescriptorSetAllocateInfo alloc_info{
 				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-				.descriptorPool = descriptor_pool,
+				.descriptorPool = texture_descriptor_pool,
 				.descriptorSetCount = 1,
-				.pSetLayouts = &lines_pipeline.set0_Camera,
+				.pSetLayouts = &layout,
 			};
-
-			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Camera_descriptors));
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &descriptor_set));
+		}
+		{ // pick the cheapest shading variant each material can use:
+			material_features.assign(scene.materials.size(), 0);
+			for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+			{
+				if (scene.materials[material_index].normal_index != static_cast<uint32_t>(Scene::Texture::DefaultTexture::DefaultNormal))
+				{
+					material_features[material_index] |= NormalMapFeature;
+				}
+			}
 		}
-		// allocate for world
 
-		workspace.World_src = rtg.helpers.create_buffer(
-			sizeof(ObjectsPipeline::World),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// goign to have the gpu copy this from memory - transfer_bit
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherenet (no special sync needed)
-			Helpers::Mapped																// get a pointer to teh memory
+		// write descriptors for materials (shared sets once):
+		write_material_descriptors(unique_materials);
 
-		);
-		workspace.World = rtg.helpers.create_buffer(
-			sizeof(ObjectsPipeline::World),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use a uniform buffer, also ging to have GPU copy into this memory
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU local memory
-			Helpers::Unmapped													   // don;t get a pinter to memoery
-		);
+		if (texture_streaming.enabled())
+		{ // which descriptors to rewrite when a streamed texture changes, and which textures a visible material asks for:
+			texture_streaming.material_slots.resize(scene.materials.size());
+			texture_streaming.slot_materials.assign(textures.size(), {});
+			for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+			{
+				texture_streaming.material_slots[material_index] = material_texture_slots(material_index);
+			}
+			for (uint32_t material_index : unique_materials)
+			{
+				for (uint32_t slot : texture_streaming.material_slots[material_index])
+					texture_streaming.slot_materials[slot].emplace_back(material_index);
+			}
+			texture_streaming.material_screen_size.assign(scene.materials.size(), 0.0f);
+			texture_streaming.set_materials.assign(scene.materials.size(), {});
+			for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+			{
+				texture_streaming.set_materials[material_sets[material_index]].emplace_back(material_index);
+			}
 
-		{ // allocated descriptor set for World descriptor s
-			VkDescriptorSetAllocateInfo alloc_info{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-				.descriptorPool = descriptor_pool,
-				.descriptorSetCount = 1,
-				.pSetLayouts = &objects_pipeline.set0_World,
-			};
+			size_t tail_bytes = 0;
+			for (TextureStreaming::Residency const &residency : texture_streaming.slots)
+			{
+				if (!residency.cache_path.empty())
+					tail_bytes += TextureStreaming::bytes(residency, residency.tail_level);
+			}
+			if (tail_bytes > texture_streaming.budget)
+			{
+				std::cerr << "WARNING: texture mip tails alone take " << (tail_bytes >> 20) << " MiB, more than the --texture-budget of " << rtg.configuration.texture_budget_mb << " MiB." << std::endl;
+			}
+		}
+	}
+	descriptors_phase.end();
+	descriptors_zone.end();
 
-			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.World_descriptors));
+	{ // setup camera if no --camera in the command line, scene camera is set in update
+		if (!rtg_.configuration.scene_camera.has_value())
+		{
+			float x = user_camera.radius * std::sin(user_camera.elevation) * std::cos(user_camera.azimuth);
+			float y = user_camera.radius * std::sin(user_camera.elevation) * std::sin(user_camera.azimuth);
+			float z = user_camera.radius * std::cos(user_camera.elevation);
+			// cache culling view
+			// cache view and clip matrices
+			view_from_world[1] = glm::make_mat4(look_at(
+													x, y, z,		  // eye
+													0.0f, 0.0f, 0.0f, // target
+													0.0f, 0.0f, 1.0f  // up
+													)
+													.data());
 
-			// not weill actula fill in this descirpt set beflow
-		}
+			clip_from_view[1] = glm::make_mat4(perspective(
+												   60.0f * float(M_PI) / 180.0f,									// vfov
+												   rtg.swapchain_extent.width / float(rtg.swapchain_extent.height), // aspect
+												   0.1f,															// near
+												   1000.0f															// far
+												   )
+												   .data());
 
-		// light descripters
-		{ // set light infos
-			light_info.sun_light_size = std::max(scene.light_instance_count.sun_light * sizeof(ObjectsPipeline::SunLight),
-												 sizeof(ObjectsPipeline::SunLight));
-			light_info.sun_light_alignment = rtg.helpers.align_buffer_size(light_info.sun_light_size, rtg.device_properties.limits.minStorageBufferOffsetAlignment);
-			light_info.sphere_light_size = std::max(scene.light_instance_count.sphere_light * sizeof(ObjectsPipeline::SphereLight),
-													sizeof(ObjectsPipeline::SphereLight));
-			light_info.sphere_light_alignment = rtg.helpers.align_buffer_size(light_info.sun_light_alignment + light_info.sphere_light_size, rtg.device_properties.limits.minStorageBufferOffsetAlignment);
-			light_info.spot_light_size = std::max(scene.light_instance_count.spot_light * sizeof(ObjectsPipeline::SpotLight),
-												  sizeof(ObjectsPipeline::SpotLight));
+			view_from_world[2] = view_from_world[1];
+			clip_from_view[2] = clip_from_view[1];
+			glm::mat4x4 clip = clip_from_view[1] * view_from_world[1];
+			CLIP_FROM_WORLD = to_mat4(clip);
 
-			world.SUN_LIGHT_COUNT = scene.light_instance_count.sun_light;
-			world.SPHERE_LIGHT_COUNT = scene.light_instance_count.sphere_light;
-			world.SPOT_LIGHT_COUNT = scene.light_instance_count.spot_light;
+			camera_mode = CameraMode::Free;
+			culling_camera = CameraMode::Free;
 		}
-		{ // create Light buffers
-			size_t needed_bytes = light_info.sphere_light_alignment + light_info.spot_light_size;
-			workspace.Light_src = rtg.helpers.create_buffer(
-				needed_bytes,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				Helpers::Mapped // get a pointer to the memory
-			);
-			workspace.Light = rtg.helpers.create_buffer(
-				needed_bytes,
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // GPU-local memory
-				Helpers::Unmapped					 // don't get a pointer to the memory
+		else
+		{
+			Scene::Camera &cur_camera = scene.cameras[scene.requested_camera_index];
+			glm::mat4x4 cur_camera_transform = scene.nodes[cur_camera.local_to_world[0]].transform.local_to_parent();
+			for (int i = 1; i < cur_camera.local_to_world.size(); ++i)
+			{
+				cur_camera_transform *= scene.nodes[cur_camera.local_to_world[i]].transform.local_to_parent();
+			}
+			glm::vec3 eye = glm::vec3(cur_camera_transform[3]);
+			glm::vec3 forward = -glm::vec3(cur_camera_transform[2]);
+			glm::vec3 target = eye + forward;
+
+			view_from_world[0] = glm::make_mat4(look_at(
+													eye.x, eye.y, eye.z,		  // eye
+													target.x, target.y, target.z, // target
+													0.0f, 0.0f, 1.0f			  // up
+													)
+													.data());
+
+			clip_from_view[0] = glm::make_mat4((perspective(
+													cur_camera.vfov,   // vfov
+													cur_camera.aspect, // aspect
+													cur_camera.near,   // near
+													cur_camera.far	   // far
+													) *
+												look_at(
+													eye.x, eye.y, eye.z,		  // eye
+													target.x, target.y, target.z, // target
+													0.0f, 0.0f, 1.0f			  // up
+													))
+												   .data());
+
+			clip_from_view[1] = glm::make_mat4(perspective(
+												   60.0f * float(M_PI) / 180.0f,									// vfov
+												   rtg.swapchain_extent.width / float(rtg.swapchain_extent.height), // aspect
+												   0.1f,															// near
+												   1000.0f															// far
+												   )
+												   .data());
+
+			scene_cam_frustum = make_frustum(
+				cur_camera.vfov,   // vfov
+				cur_camera.aspect, // aspect
+				cur_camera.near,   // near
+				cur_camera.far	   // far
 			);
-		}
 
-		{ // allocate descriptor
-			VkDescriptorSetAllocateInfo alloc_info{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-				.descriptorPool = descriptor_pool,
-				.descriptorSetCount = 1,
-				.pSetLayouts = &objects_pipeline.set1_Transforms,
-			};
+			clip_from_view[2] = clip_from_view[1];
 
-			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Transforms_descriptors));
+			glm::mat4x4 clip = clip_from_view[0] * view_from_world[0];
+			CLIP_FROM_WORLD = to_mat4(clip);
+
+			camera_mode = CameraMode::Scene;
+			culling_camera = CameraMode::Scene;
 		}
 
-		{ // point descriptors to buffer:
-			VkDescriptorBufferInfo Camera_info{
-				.buffer = workspace.Camera.handle,
-				.offset = 0,
-				.range = workspace.Camera.size,
-			};
+		user_cam_frustum = make_frustum(
+			60.0f * float(M_PI) / 180.0f,									 // vfov
+			rtg.swapchain_extent.width / float(rtg.swapchain_extent.height), // aspect
+			0.1f,															 // near
+			1000.0f															 // far
+		);
+	}
 
-			VkDescriptorBufferInfo World_info{
-				.buffer = workspace.World.handle,
-				.offset = 0,
-				.range = workspace.World.size,
-			};
+	if (rtg.configuration.replay_in != "")
+	{ // from here on the captured frame stands in for everything update() would compute:
+		read_frame_capture(rtg.configuration.replay_in);
+		std::cout << "Replaying frame capture " << rtg.configuration.replay_in << " (" << frame_stats.instances_visited << " instances)." << std::endl;
+	}
+	// headless runs have no keyboard, so capture the first frame:
+	capture_pending = rtg.configuration.capture_out != "" && rtg.configuration.headless;
+}
 
-			VkDescriptorBufferInfo SunLight_info{
-				.buffer = workspace.Light.handle,
-				.offset = 0,
-				.range = light_info.sun_light_size,
-			};
-			VkDescriptorBufferInfo SphereLight_info{
-				.buffer = workspace.Light.handle,
-				.offset = light_info.sun_light_size,
-				.range = light_info.sphere_light_size,
-			};
-			VkDescriptorBufferInfo SpotLight_info{
-				.buffer = workspace.Light.handle,
-				.offset = light_info.sphere_light_alignment,
-				.range = light_info.spot_light_size,
-			};
+void Render::require(Requirements const &wanted)
+{
+	{ // create missing pipelines in parallel, they only share the (internally synchronized) pipeline cache:
+		StartupProfile::Phase startup_phase("Render::require pipelines");
+		std::vector<std::future<void>> creating;
+		auto create_if_missing = [&](char const *name, bool needed, VkPipelineLayout existing, std::function<void()> create)
+		{
+			if (needed && existing == VK_NULL_HANDLE)
+			{
+				auto create_and_time = [name, create]()
+				{
+					StartupProfile::Asset pipeline_asset("pipeline", name);
+					create();
+				};
+				creating.emplace_back(std::async(std::launch::async, create_and_time));
+			}
+		};
+		// objects pipeline owns the World and Transforms layouts every other pipeline is bound through:
+		create_if_missing("background", true, background_pipeline.layout, [&]()
+						  { background_pipeline.create(rtg, render_pass, 0); });
+		create_if_missing("lines", true, lines_pipeline.layout, [&]()
+						  { lines_pipeline.create(rtg, render_pass, 0); });
+		create_if_missing("objects", true, objects_pipeline.layout, [&]()
+						  { objects_pipeline.create(rtg, render_pass, 0); });
+		create_if_missing("environment", wanted.environment_pipeline, environment_pipeline.layout, [&]()
+						  { environment_pipeline.create(rtg, render_pass, 0); });
+		create_if_missing("mirror", wanted.mirror_pipeline, mirror_pipeline.layout, [&]()
+						  { mirror_pipeline.create(rtg, render_pass, 0); });
+		create_if_missing("pbr", wanted.pbr, pbr_pipeline.layout, [&]()
+						  { pbr_pipeline.create(rtg, render_pass, 0); });
+		create_if_missing("shadow", wanted.shadows, shadow_pipeline.layout, [&]()
+						  { shadow_pipeline.create(rtg, shadow_atlas_pass, 0); });
+		for (std::future<void> &pipeline : creating)
+		{
+			pipeline.get(); // rethrows any creation failure
+		}
+	}
 
-			VkDescriptorImageInfo ShadowAtlas_info{
-				.sampler = shadow_sampler,
-				.imageView = Shadow_atlas_view,
-				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			};
-			VkDescriptorImageInfo World_environment_info{
-				.sampler = World_environment_sampler,
-				.imageView = World_environment_view,
-				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			};
+	{ // image based lighting, every lit material samples ENVIRONMENT but only pbr.frag reads BRDF_LUT:
+		bool need_environment = wanted.environment_map || wanted.environment_pipeline || wanted.mirror_pipeline || wanted.pbr;
+		bool create_environment = need_environment && World_environment.handle == VK_NULL_HANDLE;
+		bool create_pbr = wanted.pbr && World_environment_brdf_lut.handle == VK_NULL_HANDLE;
+		if (!create_environment && !create_pbr)
+			return;
 
-			VkDescriptorImageInfo World_irradiance_info{
-				.sampler = World_irradiance_sampler,
-				.imageView = World_irradiance_view,
-				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			};
-			VkDescriptorImageInfo World_environment_brdf_lut_info{
-				.sampler = texture_sampler,
-				.imageView = World_environment_brdf_lut_view,
-				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			};
+		// after construction the World descriptors exist and may be in use by frames in flight:
+		bool rewrite_descriptors = !workspaces.empty();
+		if (rewrite_descriptors)
+		{
+			VK(vkDeviceWaitIdle(rtg.device));
+		}
+		if (create_environment)
+			create_environment_map();
+		if (create_pbr)
+			create_pbr_lighting();
+		if (rewrite_descriptors)
+			write_world_image_descriptors();
+	}
+}
 
-			std::array<VkWriteDescriptorSet, 9> writes{
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.Camera_descriptors,
-					.dstBinding = 0,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-					.pBufferInfo = &Camera_info,
-				},
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 0,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-					.pBufferInfo = &World_info,
-				},
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.pNext = nullptr, // 1. Positioned correctly
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 1, // 2. Positioned correctly
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = &World_irradiance_info,
-					.pBufferInfo = nullptr,
-					.pTexelBufferView = nullptr},
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.pNext = nullptr,
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 2,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = &World_environment_info,
-					.pBufferInfo = nullptr,
-					.pTexelBufferView = nullptr},
+void Render::write_world_image_descriptors()
+{
+	VkDescriptorImageInfo World_environment_info{
+		.sampler = World_environment_sampler,
+		.imageView = World_environment_view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+	VkDescriptorImageInfo World_environment_brdf_lut_info{
+		.sampler = texture_sampler,
+		.imageView = World_environment_brdf_lut_view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
 
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.pNext = nullptr, // 1. Positioned correctly
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 3,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = &World_environment_brdf_lut_info,
-					.pBufferInfo = nullptr,		// 4. Explicitly tell it the buffer slot is empty
-					.pTexelBufferView = nullptr // 5. Explicitly tell it the texel slot is empty
-				},
+	// bindings of resources that were never created stay unwritten, no pipeline that statically uses them exists:
+	std::vector<VkWriteDescriptorSet> writes;
+	for (Workspace &workspace : workspaces)
+	{
+		if (World_environment_view != VK_NULL_HANDLE)
+		{
+			writes.emplace_back(VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = workspace.World_descriptors,
+				.dstBinding = 2,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &World_environment_info,
+			});
+		}
+		if (World_environment_brdf_lut_view != VK_NULL_HANDLE)
+		{
+			writes.emplace_back(VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = workspace.World_descriptors,
+				.dstBinding = 3,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &World_environment_brdf_lut_info,
+			});
+		}
+	}
+	if (!writes.empty())
+	{
+		vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+	}
+}
 
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 4,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-					.pBufferInfo = &SunLight_info,
-				},
+std::vector<uint32_t> Render::material_texture_slots(uint32_t material_index) const
+{
+	// in set2 binding order:
+	Scene::Material const &material = scene.materials[material_index];
+	if (material.material_type == Scene::Material::Lambertian)
+	{
+		return {texture_slots[material.normal_index], texture_slots[material.displacement_index], texture_slots[std::get<Scene::Material::LambertianMaterial>(material.material_textures).albedo_index]};
+	}
+	else if (material.material_type == Scene::Material::PBR)
+	{
+		return {texture_slots[material.normal_index], material_orm_slots[material_index], texture_slots[std::get<Scene::Material::PBRMaterial>(material.material_textures).albedo_index]};
+	}
+	else
+	{
+		return {texture_slots[material.normal_index], texture_slots[material.displacement_index]};
+	}
+}
 
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 5,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-					.pBufferInfo = &SphereLight_info,
-				},
+VkDescriptorSetLayout Render::material_set_layout(uint32_t material_index) const
+{
+	switch (scene.materials[material_index].material_type)
+	{
+	case Scene::Material::Lambertian:
+		return objects_pipeline.set2_TEXTURE;
+	case Scene::Material::PBR:
+		return pbr_pipeline.set2_TEXTURE;
+	case Scene::Material::Mirror:
+		// mirror and environment set2 layouts match, but only the pipelines the scene uses exist:
+		return mirror_pipeline.set2_TEXTURE;
+	default:
+		return environment_pipeline.set2_TEXTURE;
+	}
+}
 
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 6,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-					.pBufferInfo = &SpotLight_info,
-				},
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.World_descriptors,
-					.dstBinding = 6,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = &ShadowAtlas_info,
-				},
-			};
+void Render::write_material_descriptors(std::vector<uint32_t> const &material_indices)
+{
+	std::vector<VkWriteDescriptorSet> writes(material_indices.size());
+	std::vector<std::array<VkDescriptorImageInfo, 3>> infos(material_indices.size());
 
-			vkUpdateDescriptorSets(
-				rtg.device,				 // device
-				uint32_t(writes.size()), // descriptor write count
-				writes.data(),			 // pDescriptorWrites
-				0,						 // descriptroyCopyCount
-				nullptr					 // pDescriptorCopies
-			);
+	for (uint32_t i = 0; i < material_indices.size(); ++i)
+	{
+		std::vector<uint32_t> slots = material_texture_slots(material_indices[i]);
+		assert(slots.size() <= infos[i].size());
+		for (uint32_t binding = 0; binding < slots.size(); ++binding)
+		{
+			assert(slots[binding] != NoTextureSlot);
+			infos[i][binding] = VkDescriptorImageInfo{
+				.sampler = texture_sampler,
+				.imageView = texture_views[slots[binding]],
+				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			};
 		}
+
+		writes[i] = VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = texture_descriptors[material_indices[i]],
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = uint32_t(slots.size()),
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = infos[i].data(),
+		};
 	}
 
-	{ // create object vertices
-		std::vector<PosNorTanTexVertex> vertices;
+	if (!writes.empty())
+	{
+		vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+	}
+}
 
-		// reserve space and assign vao vbo via scene information
-		vertices.resize(scene.vertices_count);
-		uint32_t new_vertices_start = 0;
-		size_t mesh_count = scene.meshes.size();
-		mesh_vertices.assign(mesh_count, ObjectVertices());
-		mesh_AABBs.assign(scene.meshes.size(), AABB());
+// loads source.png and the prefiltered levels next to it (source.1.png, source.2.png, ...) as E5B9G9R9 cubemap data:
+// newest modification time of the pngs load_environment_pngs would read (source and its source.N.png mip levels),
+// nullopt when source doesn't exist:
+static std::optional<std::filesystem::file_time_type> environment_pngs_time(std::string const &environment_source)
+{
+	std::error_code ec;
+	std::filesystem::file_time_type newest = std::filesystem::last_write_time(environment_source, ec);
+	if (ec)
+		return std::nullopt;
+	size_t period_index = environment_source.find_last_of(".");
+	std::string base_source = environment_source.substr(0, period_index);
+	std::string file_type = environment_source.substr(period_index + 1);
+	for (uint32_t level = 1;; ++level)
+	{
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(base_source + "." + std::to_string(level) + "." + file_type, ec);
+		if (ec)
+			break;
+		newest = std::max(newest, time);
+	}
+	return newest;
+}
 
-		// create meshes
-		for (uint32_t i = 0; i < uint32_t(mesh_count); ++i)
+static std::vector<uint32_t> load_environment_pngs(std::string const &environment_source, uint32_t &face_length, uint8_t &mip_levels, bool debug)
+{
+	int width, height, n;
+	std::vector<unsigned char *> images;
+	images.push_back(stbi_load(environment_source.c_str(), &width, &height, &n, 4));
+	if (images[0] == NULL)
+		throw std::runtime_error("Error loading texture " + environment_source);
+	// cube map must have 6 sides and stacked vertically
+	if (height % 6 != 0 || width != height / 6)
+	{
+		throw std::runtime_error("Invalid image dimensions for a cubemap");
+	}
+
+	mip_levels = 1;
+	size_t period_index = environment_source.find_last_of(".");
+	std::string base_source = environment_source.substr(0, period_index);
+	std::string file_type = environment_source.substr(period_index + 1, environment_source.size() - period_index);
+	int last_width = width;
+	int last_height = height;
+	int total_size = width * height;
+	// load all ggx mip levels of the environment map
+	while (true)
+	{
+		// attempt to load the next mip level, if failed, exit
+		int cur_width, cur_height, cur_n;
+		std::string cur_source = base_source + "." + std::to_string(mip_levels) + "." + file_type;
+		images.push_back(stbi_load(cur_source.c_str(), &cur_width, &cur_height, &cur_n, 4));
+		if (images[mip_levels] == NULL)
 		{
-			Scene::Mesh &cur_mesh = scene.meshes[i];
-			mesh_vertices[i].count = cur_mesh.count;
-			mesh_vertices[i].first = new_vertices_start;
-
-			// find mesh source via filepath
-			std::ifstream file(scene.scene_path + "/" + cur_mesh.attributes[0].source, std::ios::binary); // assuming the attribute layout holds
-			if (!file.is_open())
-				throw std::runtime_error("Error opening file for mesh data: " + scene.scene_path + "/" + cur_mesh.attributes[0].source);
-			if (!file.read(reinterpret_cast<char *>(&vertices[new_vertices_start]), cur_mesh.count * sizeof(PosNorTanTexVertex)))
-			{
-				throw std::runtime_error("Failed to read mesh data: " + scene.scene_path + "/" + cur_mesh.attributes[0].source);
-			}
-
-			// find OOB and create mesh ABBS
-			for (size_t vertex_i = mesh_vertices[i].first; vertex_i < (mesh_vertices[i].first + mesh_vertices[i].count); ++vertex_i)
+			if (debug)
 			{
-				glm::vec3 cur_vert_pos = {vertices[vertex_i].Position.x, vertices[vertex_i].Position.y, vertices[vertex_i].Position.z};
-				mesh_AABBs[i].min = glm::min(mesh_AABBs[i].min, cur_vert_pos);
-				mesh_AABBs[i].max = glm::max(mesh_AABBs[i].max, cur_vert_pos);
+				std::cout << "Environment Loading Completed, " << int(mip_levels) << " mip levels\n";
 			}
-			new_vertices_start += cur_mesh.count;
+			break;
 		}
-		assert(new_vertices_start == scene.vertices_count);
+		if (cur_width != std::max(1, last_width >> 1) ||
+			cur_height != std::max(1, last_height >> 1))
+		{
+			throw std::runtime_error("Mip not properly resized");
+		}
+		if (cur_height % 6 != 0 || cur_width != cur_height / 6)
+		{
+			throw std::runtime_error("Invalid image dimensions for a cubemap");
+		}
+		total_size += cur_width * cur_height;
+		last_width = cur_width;
+		last_height = cur_height;
+		mip_levels++;
+	}
 
-		size_t bytes = vertices.size() * sizeof(vertices[0]);
-		object_vertices = rtg.helpers.create_buffer(
-			bytes,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			Helpers::Unmapped);
+	face_length = uint32_t(width);
 
-		// copy data to buffer
-		rtg.helpers.transfer_to_buffer(vertices.data(), bytes, object_vertices);
+	// convert rgbe to rgb values
+	std::vector<uint32_t> rgb_image(total_size); // Store the converted RGB data
+	int temp_width = width;
+	int temp_height = height;
+	uint64_t pixel_index = 0;
+	for (uint8_t level = 0; level < mip_levels; ++level)
+	{
+		rgbe_to_E5B9G9R9(images[level], rgb_image.data() + pixel_index, size_t(temp_width) * temp_height);
+		pixel_index += uint64_t(temp_width) * temp_height;
+		temp_width = temp_width >> 1;
+		temp_height = temp_height >> 1;
 	}
 
-	{ /// Create texture
-		// all images loaded should be flipped as s72 file format has the image origin at bottom left while stbi load is top left
-		stbi_set_flip_vertically_on_load(true);
+	for (unsigned char *image : images)
+	{
+		stbi_image_free(image);
+	}
+	return rgb_image;
+}
 
-		// correct texture loading
-		textures.reserve(scene.textures.size());
+void Render::create_environment_map()
+{
+	StartupProfile::Phase startup_phase("Render::create_environment_map");
+	std::string environment_source = scene.scene_path + "/" + scene.environment.source;
+	StartupProfile::Asset environment_asset("environment", scene.environment.source);
+
+	std::string::size_type period_index = environment_source.find_last_of(".");
+	std::string base_source = environment_source.substr(0, period_index);
+
+	// a packed cubemap (from the cube tool's --packed) is used directly, or in place of source.png when one sits next to it:
+	std::string packed_source;
+	if (period_index != std::string::npos && environment_source.substr(period_index) == PackedCubemap::extension)
+		packed_source = environment_source;
+	else if (std::filesystem::exists(base_source + PackedCubemap::extension))
+	{
+		// ...as long as it isn't older than the pngs, an edited png is loaded instead of the stale cubemap:
+		std::error_code ec;
+		std::filesystem::file_time_type packed_time = std::filesystem::last_write_time(base_source + PackedCubemap::extension, ec);
+		std::optional<std::filesystem::file_time_type> pngs_time = environment_pngs_time(environment_source);
+		if (!ec && (!pngs_time || packed_time >= *pngs_time))
+			packed_source = base_source + PackedCubemap::extension;
+		else
+			std::cerr << "WARNING: '" << base_source << PackedCubemap::extension << "' is older than '" << environment_source << "' (or its mip levels); loading the pngs instead. Re-run the cube tool with --packed to update it." << std::endl;
+	}
 
-		// create scene textures
-		{											 // make some textures
-			textures.reserve(scene.textures.size()); // index 0-4 is the default textures
+	uint32_t face_length = 0;
+	uint8_t mip_levels = 1;
+	VkFormat format = VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+	PackedCubemap packed;			 // mapped file, when there is one
+	std::vector<uint32_t> rgb_image; // otherwise converted from the pngs
+	void const *texels = nullptr;
+	size_t texels_size = 0;
+	if (!packed_source.empty())
+	{
+		packed.map(packed_source);
+		if (packed.header.texel_size != vkuFormatTexelBlockSize(packed.format()))
+			throw std::runtime_error("Packed cubemap '" + packed_source + "' texel size doesn't match its format.");
+		face_length = packed.header.face_size;
+		mip_levels = uint8_t(packed.header.mip_levels);
+		format = packed.format();
+		texels = packed.data;
+		texels_size = size_t(packed.header.data_size);
+		if (rtg.configuration.debug)
+		{
+			std::cout << "Environment mapped from " << packed_source << ", " << int(mip_levels) << " mip levels\n";
+		}
+	}
+	else
+	{
+		StartupProfile::Work decode_work("environment decode and conversion");
+		rgb_image = load_environment_pngs(environment_source, face_length, mip_levels, rtg.configuration.debug);
+		texels = rgb_image.data();
+		texels_size = sizeof(rgb_image[0]) * rgb_image.size();
+		decode_work.bytes = texels_size;
+	}
+	environment_asset.bytes = startup_phase.bytes = texels_size;
+
+	Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Environment);
+	World_environment = rtg.helpers.create_image(
+		VkExtent2D{.width = face_length, .height = face_length}, // size of each face
+		format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		Helpers::Unmapped, 6, mip_levels);
 
-			// all images loaded should be flipped as s72 file format has the image origin at bottom left while stbi load is top left
-			stbi_set_flip_vertically_on_load(true);
+	// the mapped pages are read straight into the staging buffer:
+	rtg.helpers.transfer_to_image_cube(texels, texels_size, World_environment, mip_levels);
 
-			for (uint32_t i = 0; i < scene.textures.size(); ++i)
+	// diffuse lighting: spherical harmonics from the cube tool (--sh) next to the source, otherwise projected from level 0 here:
+	{
+		SH9 sh;
+		std::string sh_source = base_source + ".sh9";
+		if (sh.load(sh_source))
+		{
+			if (rtg.configuration.debug)
 			{
-				Scene::Texture &cur_texture = scene.textures[i];
-				if (cur_texture.has_src)
-				{
-					int width, height, n;
-					unsigned char *image;
-					std::string source = std::get<std::string>(cur_texture.value);
-
-					if (cur_texture.single_channel)
-					{ // just read the r value
-						assert(cur_texture.format != Scene::Texture::RGBE);
-						VkFormat format = cur_texture.format == Scene::Texture::Linear ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8_SRGB;
-						image = stbi_load((scene.scene_path + "/" + source).c_str(), &width, &height, &n, 1);
-						if (image == NULL)
-							throw std::runtime_error("Error loading texture " + scene.scene_path + "/" + source);
-						textures.emplace_back(rtg.helpers.create_image(
-							VkExtent2D{.width = uint32_t(width), .height = uint32_t(height)}, // size of image
-							format,
-							VK_IMAGE_TILING_OPTIMAL,
-							VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-							VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-							Helpers::Unmapped));
-
-						rtg.helpers.transfer_to_image(image, sizeof(image[0]) * width * height, textures.back());
-					}
-					else
-					{
-						image = stbi_load((scene.scene_path + "/" + source).c_str(), &width, &height, &n, 4);
-						if (image == NULL)
-							throw std::runtime_error("Error loading texture " + scene.scene_path + "/" + source);
-						if (cur_texture.format == Scene::Texture::RGBE)
-						{
-							std::vector<uint32_t> converted_image(width * height);
-							for (uint32_t pixel_i = 0; pixel_i < uint32_t(width * height); ++pixel_i)
-							{
-								glm::u8vec4 rgbe_pixel = glm::u8vec4(image[4 * pixel_i], image[4 * pixel_i + 1], image[4 * pixel_i + 2], image[4 * pixel_i + 3]);
-								converted_image[pixel_i] = rgbe_to_E5B9G9R9(rgbe_pixel);
-							}
-							textures.emplace_back(rtg.helpers.create_image(
-								VkExtent2D{.width = uint32_t(width), .height = uint32_t(height)}, // size of image
-								VK_FORMAT_E5B9G9R9_UFLOAT_PACK32,
-								VK_IMAGE_TILING_OPTIMAL,
-								VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-								VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-								Helpers::Unmapped));
-
-							rtg.helpers.transfer_to_image(converted_image.data(), sizeof(converted_image[0]) * width * height, textures.back());
-						}
-						else
-						{
-							VkFormat format = cur_texture.format == Scene::Texture::sRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
-							textures.emplace_back(rtg.helpers.create_image(
-								VkExtent2D{.width = uint32_t(width), .height = uint32_t(height)}, // size of image
-								format,
-								VK_IMAGE_TILING_OPTIMAL,
-								VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-								VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-								Helpers::Unmapped));
-
-							rtg.helpers.transfer_to_image(image, sizeof(image[0]) * width * height * 4, textures.back());
-						}
-					}
-					// free image:
-					stbi_image_free(image);
-				}
-				else
-				{
-					if (cur_texture.single_channel)
-					{
-						uint8_t value = uint8_t(std::get<float>(cur_texture.value) * 255.0f);
-						textures.emplace_back(rtg.helpers.create_image(
-							VkExtent2D{.width = 1, .height = 1}, // size of image
-							VK_FORMAT_R8_UNORM,					 // how to interpret image data (in this case, SRGB-encoded 8-bit RGBA)
-							VK_IMAGE_TILING_OPTIMAL,
-							VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-							VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-							Helpers::Unmapped));
-
-						// transfer data:
-						rtg.helpers.transfer_to_image(&value, sizeof(uint8_t), textures.back());
-					}
-					else
-					{
-						glm::vec3 value = std::get<glm::vec3>(cur_texture.value);
-						uint8_t data[4] = {uint8_t(value.x * 255.0f), uint8_t(value.y * 255.0f), uint8_t(value.z * 255.0f), 255};
-						// make a place for the texture to live on the GPU:
-						textures.emplace_back(rtg.helpers.create_image(
-							VkExtent2D{.width = 1, .height = 1}, // size of image
-							VK_FORMAT_R8G8B8A8_UNORM,			 // how to interpret image data (in this case, SRGB-encoded 8-bit RGBA)
-							VK_IMAGE_TILING_OPTIMAL,
-							VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-							VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-							Helpers::Unmapped));
-
-						// transfer data:
-						rtg.helpers.transfer_to_image(&data, sizeof(uint8_t) * 4, textures.back());
-					}
-				}
+				std::cout << "Environment SH9 loaded from " << sh_source << "\n";
 			}
 		}
+		else if (format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+		{
+			StartupProfile::Work project_work("environment SH9 projection");
+			project_work.bytes = size_t(6) * face_length * face_length * sizeof(uint32_t);
+			sh = SH9::project_E5B9G9R9(static_cast<uint32_t const *>(texels), face_length);
+		}
+		else
+		{
+			std::cerr << "WARNING: no '" << sh_source << "' and the environment isn't E5B9G9R9, diffuse environment lighting is off." << std::endl;
+		}
+		for (uint32_t i = 0; i < 9; ++i)
+		{
+			world.IRRADIANCE_SH[i] = glm::vec4(sh.coefficients[i], 0.0f);
+		}
 	}
+	packed.unmap();
 
-	{ // make image views for the texture
-		texture_views.reserve(textures.size());
-		for (Helpers::AllocatedImage const &image : textures)
-		{
-			VkImageViewCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				.flags = 0,
-				.image = image.handle,
-				.viewType = VK_IMAGE_VIEW_TYPE_2D,
-				.format = image.format,
-				// .componet set swizling and is fine when zero-initialied
-				.subresourceRange{
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = 0,
-					.layerCount = 1,
-				}};
+	// set world mip level
+	world.ENVIRONMENT_MIPS = float(mip_levels - 1);
 
-			VkImageView image_view = VK_NULL_HANDLE;
-			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &image_view));
+	{ // make image view for environment- prefixerd ggx
 
-			texture_views.emplace_back(image_view);
-		}
-		assert(texture_views.size() == textures.size());
+		VkImageViewCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.flags = 0,
+			.image = World_environment.handle,
+			.viewType = VK_IMAGE_VIEW_TYPE_CUBE,
+			.format = World_environment.format,
+			// .components sets swizzling and is fine when zero-initialized
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = mip_levels,
+				.baseArrayLayer = 0,
+				.layerCount = 6,
+			},
+		};
+
+		VK(vkCreateImageView(rtg.device, &create_info, nullptr, &World_environment_view));
 	}
 
-	{
+	{ // make a sampler for the environment
 		VkSamplerCreateInfo create_info{
 			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
 			.flags = 0,
-			.magFilter = VK_FILTER_NEAREST,
-			.minFilter = VK_FILTER_NEAREST,
-			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
-			.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-			.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-			.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.magFilter = VK_FILTER_LINEAR,
+			.minFilter = VK_FILTER_LINEAR,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
 			.mipLodBias = 0.0f,
 			.anisotropyEnable = VK_FALSE,
-			.maxAnisotropy = 0.0f, // doesn't matter if anisotropy ins't enabled
+			.maxAnisotropy = 0.0f, // doesn't matter if anisotropy isn't enabled
 			.compareEnable = VK_FALSE,
-			.compareOp = VK_COMPARE_OP_ALWAYS, // doesn't matter if compre isnt' enabled
+			.compareOp = VK_COMPARE_OP_ALWAYS, // doesn't matter if compare isn't enabled
 			.minLod = 0.0f,
-			.maxLod = 0.0f,
+			.maxLod = float(mip_levels - 1),
 			.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
 			.unnormalizedCoordinates = VK_FALSE,
 		};
-
-		VK(vkCreateSampler(rtg.device, &create_info, nullptr, &texture_sampler));
+		VK(vkCreateSampler(rtg.device, &create_info, nullptr, &World_environment_sampler));
 	}
+}
 
-	{ // create the texture descirptor pool
+void Render::create_pbr_lighting()
+{
+	StartupProfile::Phase startup_phase("Render::create_pbr_lighting");
+	{ // environment BRDF LUT
+		uint32_t brdf_size = 256;
+
+		Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::BRDFLUT);
+		World_environment_brdf_lut = rtg.helpers.create_image(
+			VkExtent2D{.width = brdf_size, .height = brdf_size},
+			VK_FORMAT_R16G16_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped,
+			1,
+			1);
 
-		uint32_t per_material = uint32_t(scene.materials.size());
-		uint32_t per_pbr_material = uint32_t(scene.MatPBR_count);
-		uint32_t per_lambertian_material = uint32_t(scene.MatLambertian_count);
-		uint32_t per_envmirror_material = uint32_t(scene.MatEnvMirror_count);
+		{ // image view
+			VkImageViewCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				.image = World_environment_brdf_lut.handle,
+				.viewType = VK_IMAGE_VIEW_TYPE_2D,
+				.format = World_environment_brdf_lut.format,
+				.subresourceRange{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+			};
 
-		std::array<VkDescriptorPoolSize, 1> pool_sizes{
+			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &World_environment_brdf_lut_view));
+		}
 
-			VkDescriptorPoolSize{
-				// union buffer descirpts
-				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1 * 5 * per_pbr_material + 1 * 3 * per_lambertian_material + 1 * 2 * per_envmirror_material,
-			},
-		};
+		VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+		{
+			VkDescriptorSetLayoutBinding binding{
+				.binding = 0,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			};
 
-		VkDescriptorPoolCreateInfo create_info{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-			.flags = 0,					 // because CCREATE_FREE_DESCRIPTOR_SET_BIT isin;t include , we can't free individual descript allocated for this pool
-			.maxSets = 1 * per_material, // two set per texsture
-			.poolSizeCount = uint32_t(pool_sizes.size()),
-			.pPoolSizes = pool_sizes.data(),
-		};
+			VkDescriptorSetLayoutCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+				.bindingCount = 1,
+				.pBindings = &binding,
+			};
 
-		VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &texture_descriptor_pool));
-	}
+			VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set_layout));
+		}
+
+		VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+		{
+			VkPushConstantRange range{
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+				.offset = 0,
+				.size = sizeof(BrdfPush),
+			};
+
+			VkPipelineLayoutCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+				.setLayoutCount = 1,
+				.pSetLayouts = &set_layout,
+				.pushConstantRangeCount = 1,
+				.pPushConstantRanges = &range,
+			};
 
-	{ // allocate and write the texture descriptor sets
-		// Allocate and write the texture descriptor sets
-		VkDescriptorSetAllocateInfo mat_lambertian_alloc_info{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			.descriptorPool = texture_descriptor_pool,
-			.descriptorSetCount = 1,
-			.pSetLayouts = &objects_pipeline.set2_TEXTURE,
-		};
-		VkDescriptorSetAllocateInfo mat_pbr_alloc_info{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			.descriptorPool = texture_descriptor_pool,
-			.descriptorSetCount = 1,
-			.pSetLayouts = &pbr_pipeline.set2_TEXTURE,
-		};
-		VkDescriptorSetAllocateInfo mat_envmirror_alloc_info{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			.descriptorPool = texture_descriptor_pool,
-			.descriptorSetCount = 1,
-			.pSetLayouts = &environment_pipeline.set2_TEXTURE,
-		};
+			VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &pipeline_layout));
+		}
 
-		texture_descriptors.assign(scene.materials.size(), VK_NULL_HANDLE);
+		VkShaderModule comp_module = rtg.helpers.create_shader_module(comp_brdf, sizeof(comp_brdf));
 
-		for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+		VkPipeline pipeline = VK_NULL_HANDLE;
 		{
-			VkDescriptorSet &descriptor_set = texture_descriptors[material_index];
-			if (scene.materials[material_index].material_type == Scene::Material::Lambertian)
-			{
-				VK(vkAllocateDescriptorSets(rtg.device, &mat_lambertian_alloc_info, &descriptor_set));
-			}
-			else if (scene.materials[material_index].material_type == Scene::Material::PBR)
-			{
-				VK(vkAllocateDescriptorSets(rtg.device, &mat_pbr_alloc_info, &descriptor_set));
-			}
-			else
-			{
-				VK(vkAllocateDescriptorSets(rtg.device, &mat_envmirror_alloc_info, &descriptor_set));
-			}
+			VkPipelineShaderStageCreateInfo shader_stage{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = comp_module,
+				.pName = "main",
+			};
+
+			VkComputePipelineCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+				.stage = shader_stage,
+				.layout = pipeline_layout,
+			};
+
+			VK(vkCreateComputePipelines(rtg.device, rtg.pipeline_cache, 1, &create_info, nullptr, &pipeline));
 		}
-		// write descriptors for materials:
-		std::vector<VkWriteDescriptorSet> writes(scene.materials.size());
-		std::vector<std::array<VkDescriptorImageInfo, 5>> infos(scene.materials.size());
-		constexpr uint8_t pbr_tex_count = 5;
-		constexpr uint8_t lambertian_tex_count = 3;
-		constexpr uint8_t envmirror_tex_count = 2;
 
-		for (uint32_t material_index = 0; material_index < scene.materials.size(); ++material_index)
+		VkDescriptorPool brdf_descriptor_pool = VK_NULL_HANDLE;
 		{
-			const Scene::Material &material = scene.materials[material_index];
-			uint8_t cur_material_tex_count = 0;
+			VkDescriptorPoolSize pool_size{
+				.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.descriptorCount = 1,
+			};
 
-			std::array<VkDescriptorImageInfo, 5> &cur_infos = infos[material_index];
-			cur_infos[0] = VkDescriptorImageInfo{
-				.sampler = texture_sampler,
-				.imageView = texture_views[material.normal_index],
-				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VkDescriptorPoolCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+				.maxSets = 1,
+				.poolSizeCount = 1,
+				.pPoolSizes = &pool_size,
 			};
 
-			cur_infos[1] = VkDescriptorImageInfo{
-				.sampler = texture_sampler,
-				.imageView = texture_views[material.displacement_index],
-				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &brdf_descriptor_pool));
+		}
+
+		VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+		{
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = brdf_descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &set_layout,
 			};
 
-			if (material.material_type == Scene::Material::Lambertian)
-			{
-				cur_material_tex_count = lambertian_tex_count;
-				cur_infos[2] = VkDescriptorImageInfo{
-					.sampler = texture_sampler,
-					.imageView = texture_views[std::get<Scene::Material::LambertianMaterial>(material.material_textures).albedo_index],
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				};
-			}
-			else if (material.material_type == Scene::Material::PBR)
-			{
-				cur_material_tex_count = pbr_tex_count;
-				const Scene::Material::PBRMaterial &pbr_textures = std::get<Scene::Material::PBRMaterial>(material.material_textures);
-				cur_infos[2] = VkDescriptorImageInfo{
-					.sampler = texture_sampler,
-					.imageView = texture_views[pbr_textures.albedo_index],
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				};
-				cur_infos[3] = VkDescriptorImageInfo{
-					.sampler = texture_sampler,
-					.imageView = texture_views[pbr_textures.roughness_index],
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				};
-				cur_infos[4] = VkDescriptorImageInfo{
-					.sampler = texture_sampler,
-					.imageView = texture_views[pbr_textures.metalness_index],
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				};
-			}
-			else
-			{
-				cur_material_tex_count = envmirror_tex_count;
-			}
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &descriptor_set));
+
+			VkDescriptorImageInfo out_info{
+				.sampler = VK_NULL_HANDLE,
+				.imageView = World_environment_brdf_lut_view,
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+			};
 
-			writes[material_index] = VkWriteDescriptorSet{
+			VkWriteDescriptorSet write{
 				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-				.dstSet = texture_descriptors[material_index],
+				.dstSet = descriptor_set,
 				.dstBinding = 0,
-				.dstArrayElement = 0,
-				.descriptorCount = cur_material_tex_count,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.pImageInfo = &cur_infos[0],
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.pImageInfo = &out_info,
 			};
+
+			vkUpdateDescriptorSets(rtg.device, 1, &write, 0, nullptr);
 		}
+		std::cout << "about to render tranfer ommand buffer: " << (void *)rtg.helpers.transfer_command_buffer << std::endl;
+		VK(vkResetCommandBuffer(rtg.helpers.transfer_command_buffer, 0));
 
-		vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
-	}
-	{ // setup camera if no --camera in the command line, scene camera is set in update
-		if (!rtg_.configuration.scene_camera.has_value())
-		{
-			float x = user_camera.radius * std::sin(user_camera.elevation) * std::cos(user_camera.azimuth);
-			float y = user_camera.radius * std::sin(user_camera.elevation) * std::sin(user_camera.azimuth);
-			float z = user_camera.radius * std::cos(user_camera.elevation);
-			// cache culling view
-			// cache view and clip matrices
-			view_from_world[1] = glm::make_mat4(look_at(
-													x, y, z,		  // eye
-													0.0f, 0.0f, 0.0f, // target
-													0.0f, 0.0f, 1.0f  // up
-													)
-													.data());
+		VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		};
+		VK(vkBeginCommandBuffer(rtg.helpers.transfer_command_buffer, &begin_info));
 
-			clip_from_view[1] = glm::make_mat4(perspective(
-												   60.0f * float(M_PI) / 180.0f,									// vfov
-												   rtg.swapchain_extent.width / float(rtg.swapchain_extent.height), // aspect
-												   0.1f,															// near
-												   1000.0f															// far
-												   )
-												   .data());
+		VkCommandBuffer cmd = rtg.helpers.transfer_command_buffer;
 
-			view_from_world[2] = view_from_world[1];
-			clip_from_view[2] = clip_from_view[1];
-			glm::mat4x4 clip = clip_from_view[1] * view_from_world[1];
-			CLIP_FROM_WORLD = to_mat4(clip);
+		{ // UNDEFINED -> GENERAL
+			VkImageMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = World_environment_brdf_lut.handle,
+				.subresourceRange{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+			};
 
-			camera_mode = CameraMode::Free;
-			culling_camera = CameraMode::Free;
+			vkCmdPipelineBarrier(
+				cmd,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
 		}
-		else
-		{
-			Scene::Camera &cur_camera = scene.cameras[scene.requested_camera_index];
-			glm::mat4x4 cur_camera_transform = scene.nodes[cur_camera.local_to_world[0]].transform.local_to_parent();
-			for (int i = 1; i < cur_camera.local_to_world.size(); ++i)
-			{
-				cur_camera_transform *= scene.nodes[cur_camera.local_to_world[i]].transform.local_to_parent();
-			}
-			glm::vec3 eye = glm::vec3(cur_camera_transform[3]);
-			glm::vec3 forward = -glm::vec3(cur_camera_transform[2]);
-			glm::vec3 target = eye + forward;
 
-			view_from_world[0] = glm::make_mat4(look_at(
-													eye.x, eye.y, eye.z,		  // eye
-													target.x, target.y, target.z, // target
-													0.0f, 0.0f, 1.0f			  // up
-													)
-													.data());
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(
+			cmd,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipeline_layout,
+			0,
+			1,
+			&descriptor_set,
+			0,
+			nullptr);
 
-			clip_from_view[0] = glm::make_mat4((perspective(
-													cur_camera.vfov,   // vfov
-													cur_camera.aspect, // aspect
-													cur_camera.near,   // near
-													cur_camera.far	   // far
-													) *
-												look_at(
-													eye.x, eye.y, eye.z,		  // eye
-													target.x, target.y, target.z, // target
-													0.0f, 0.0f, 1.0f			  // up
-													))
-												   .data());
+		BrdfPush push{
+			.size = brdf_size,
+			.numSamples = 4096 * 16,
+		};
 
-			clip_from_view[1] = glm::make_mat4(perspective(
-												   60.0f * float(M_PI) / 180.0f,									// vfov
-												   rtg.swapchain_extent.width / float(rtg.swapchain_extent.height), // aspect
-												   0.1f,															// near
-												   1000.0f															// far
-												   )
-												   .data());
+		vkCmdPushConstants(
+			cmd,
+			pipeline_layout,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(push),
+			&push);
 
-			scene_cam_frustum = make_frustum(
-				cur_camera.vfov,   // vfov
-				cur_camera.aspect, // aspect
-				cur_camera.near,   // near
-				cur_camera.far	   // far
-			);
+		vkCmdDispatch(
+			cmd,
+			(brdf_size + 7) / 8,
+			(brdf_size + 7) / 8,
+			1);
 
-			clip_from_view[2] = clip_from_view[1];
+		{ // GENERAL -> SHADER_READ_ONLY_OPTIMAL
+			VkImageMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = World_environment_brdf_lut.handle,
+				.subresourceRange{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+			};
 
-			glm::mat4x4 clip = clip_from_view[0] * view_from_world[0];
-			CLIP_FROM_WORLD = to_mat4(clip);
+			vkCmdPipelineBarrier(
+				cmd,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
+		}
+
+		VK(vkEndCommandBuffer(cmd));
+
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &cmd,
+		};
 
-			camera_mode = CameraMode::Scene;
-			culling_camera = CameraMode::Scene;
-		}
+		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+		VK(vkQueueWaitIdle(rtg.graphics_queue));
 
-		user_cam_frustum = make_frustum(
-			60.0f * float(M_PI) / 180.0f,									 // vfov
-			rtg.swapchain_extent.width / float(rtg.swapchain_extent.height), // aspect
-			0.1f,															 // near
-			1000.0f															 // far
-		);
+		vkDestroyDescriptorPool(rtg.device, brdf_descriptor_pool, nullptr);
+		vkDestroyPipeline(rtg.device, pipeline, nullptr);
+		vkDestroyPipelineLayout(rtg.device, pipeline_layout, nullptr);
+		vkDestroyDescriptorSetLayout(rtg.device, set_layout, nullptr);
+		vkDestroyShaderModule(rtg.device, comp_module, nullptr);
 	}
 }
 
@@ -1686,6 +1985,13 @@ Render::~Render()
 		std::cerr << "Failed to vkDeviceWaitIdle in Tutorial::~Tutorial [" << string_VkResult(result) << "]; continuing anyway." << std::endl;
 	}
 
+	free_retired_textures(true);
+	for (TextureStreaming::Upload &upload : texture_streaming.uploads)
+	{
+		rtg.helpers.destroy_buffer(std::move(upload.staging));
+	}
+	texture_streaming.uploads.clear();
+
 	if (texture_descriptor_pool)
 	{
 		vkDestroyDescriptorPool(rtg.device, texture_descriptor_pool, nullptr);
@@ -1710,28 +2016,6 @@ Render::~Render()
 	{
 		rtg.helpers.destroy_image(std::move(World_environment));
 	}
-	if (World_irradiance_sampler)
-	{
-		vkDestroySampler(rtg.device, World_irradiance_sampler, nullptr);
-		World_irradiance_sampler = VK_NULL_HANDLE;
-	}
-
-	if (World_irradiance_view)
-	{
-		vkDestroyImageView(rtg.device, World_irradiance_view, nullptr);
-		World_irradiance_view = VK_NULL_HANDLE;
-	}
-
-	if (World_irradiance.handle)
-	{
-		rtg.helpers.destroy_image(std::move(World_irradiance));
-	}
-	if (World_irradiance_storage_view)
-	{
-		vkDestroyImageView(rtg.device, World_irradiance_storage_view, nullptr);
-		World_irradiance_storage_view = VK_NULL_HANDLE;
-	}
-
 	if (World_environment_brdf_lut_view)
 	{
 		vkDestroyImageView(rtg.device, World_environment_brdf_lut_view, nullptr);
@@ -1785,6 +2069,9 @@ Render::~Render()
 	}
 
 	textures.clear();
+	texture_slots.clear();
+	material_orm_slots.clear();
+	texture_streaming.slots.clear();
 
 	rtg.helpers.destroy_buffer(std::move(object_vertices));
 
@@ -1793,6 +2080,7 @@ Render::~Render()
 		destroy_framebuffers();
 	}
 
+	gpu_timestamps.destroy(rtg, workspaces);
 	for (Workspace &workspace : workspaces)
 	{
 		if (workspace.command_buffer != VK_NULL_HANDLE)
@@ -1835,6 +2123,15 @@ Render::~Render()
 			rtg.helpers.destroy_buffer(std::move(workspace.Light));
 		}
 
+		if (workspace.Clusters_src.handle != VK_NULL_HANDLE)
+		{
+			rtg.helpers.destroy_buffer(std::move(workspace.Clusters_src));
+		}
+		if (workspace.Clusters.handle != VK_NULL_HANDLE)
+		{
+			rtg.helpers.destroy_buffer(std::move(workspace.Clusters));
+		}
+
 		if (workspace.Transforms_src.handle != VK_NULL_HANDLE)
 		{
 			rtg.helpers.destroy_buffer(std::move(workspace.Transforms_src));
@@ -1885,6 +2182,7 @@ void Render::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain)
 		destroy_framebuffers();
 	}
 	// allocate depth images for framge buffer to share
+	Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Attachments);
 	swapchain_depth_image = rtg.helpers.create_image(
 		swapchain.extent,
 		depth_format,
@@ -1950,6 +2248,14 @@ void Render::destroy_framebuffers()
 
 void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 {
+	TRACE_ZONE("Render::render");
+	frame_stats.reset_render();
+	if (capture_pending)
+	{ // update() has just filled in everything the frame will draw:
+		capture_pending = false;
+		write_frame_capture(rtg.configuration.capture_out);
+		std::cout << "Wrote frame capture to " << rtg.configuration.capture_out << std::endl;
+	}
 	// assert that parameters are valid:
 	assert(&rtg == &rtg_);
 	assert(render_params.workspace_index < workspaces.size());
@@ -1973,6 +2279,11 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		VK(vkBeginCommandBuffer(workspace.command_buffer, &begin_info));
 	}
 
+	// copy in texture levels streamed since the last frame, ahead of everything that samples them:
+	record_texture_uploads(workspace.command_buffer);
+	gpu_timestamps.begin_frame(rtg, workspace);
+	gpu_timestamps.begin(workspace, GPUTimestamps::Frame);
+
 	// copy transforms, needed for both shadow atlas pass and render pass
 	if (!lambertian_instances.empty() || !environment_instances.empty() || !mirror_instances.empty() || !pbr_instances.empty())
 	{ // upload object transforms:
@@ -1989,6 +2300,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 			{
 				rtg.helpers.destroy_buffer(std::move(workspace.Transforms));
 			}
+			Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Workspaces);
 			workspace.Transforms_src = rtg.helpers.create_buffer(
 				new_bytes,
 				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// going to have GPU copy from this memory
@@ -2065,6 +2377,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 			.size = needed_bytes,
 		};
 		vkCmdCopyBuffer(workspace.command_buffer, workspace.Transforms_src.handle, workspace.Transforms.handle, 1, &copy_region);
+		frame_stats.upload_bytes += copy_region.size;
 	}
 
 	{ // upload camera info
@@ -2084,6 +2397,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		};
 
 		vkCmdCopyBuffer(workspace.command_buffer, workspace.Camera_src.handle, workspace.Camera.handle, 1, &copy_region);
+		frame_stats.upload_bytes += copy_region.size;
 	}
 
 	VkBufferMemoryBarrier buffer_memory_barrier{
@@ -2103,6 +2417,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 	);
 
 	{ // shadow atlas pass:
+		gpu_timestamps.begin(workspace, GPUTimestamps::ShadowAtlas);
 		std::array<VkClearValue, 1> clear_values{
 			VkClearValue{.depthStencil{.depth = 1.0f, .stencil = 0}},
 		};
@@ -2120,7 +2435,8 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 
 		vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
-		if (!lambertian_instances.empty() || !environment_instances.empty() || !mirror_instances.empty() || !pbr_instances.empty())
+		// shadow_pipeline only exists when some spot light casts shadows:
+		if (scene_has_shadows && (!lambertian_instances.empty() || !environment_instances.empty() || !mirror_instances.empty() || !pbr_instances.empty()))
 		{
 			// bind Transforms descriptor set:
 			std::array<VkDescriptorSet, 1> descriptor_sets{
@@ -2134,10 +2450,12 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 				uint32_t(descriptor_sets.size()), descriptor_sets.data(), // descriptor sets count, ptr
 				0, nullptr												  // dynamic offsets count, ptr
 			);
+			++frame_stats.descriptor_set_binds;
 		}
-		if (!spot_lights.empty())
+		if (scene_has_shadows && !spot_lights.empty())
 		{
 			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadow_pipeline.handle);
+			++frame_stats.pipeline_binds;
 
 			{ // use object_vertices (offset 0) as vertex buffer binding 0:
 				std::array<VkBuffer, 1> vertex_buffers{object_vertices.handle};
@@ -2150,6 +2468,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 				ShadowAtlas::Region &region = shadow_atlas.regions[light_index];
 				if (region.size == 0)
 					continue; // skip shadow of size 0
+				++frame_stats.shadow_regions;
 				spot_lights[light_index].LIGHT_FROM_WORLD = spot_light_from_world[i];
 				spot_lights[light_index].ATLAS_COORD_FROM_WORLD = ShadowAtlas::calculate_shadow_atlas_matrix(spot_light_from_world[i], region, shadow_atlas_length);
 				{ // push light:
@@ -2188,6 +2507,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					ObjectInstance const &inst = lambertian_instances[index];
 
 					vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+					frame_stats.draw(FrameStats::Shadow, inst.vertices.count);
 				}
 
 				uint32_t index_offset = uint32_t(lambertian_instances.size()); // account for lambertian size
@@ -2196,6 +2516,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					ObjectInstance const &inst = environment_instances[index];
 					index += index_offset;
 					vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+					frame_stats.draw(FrameStats::Shadow, inst.vertices.count);
 				}
 				index_offset = uint32_t(lambertian_instances.size() + environment_instances.size()); // account for lambertian and environment size
 				for (uint32_t index : in_spot_light_instances[i][static_cast<uint32_t>(Scene::Material::Mirror)])
@@ -2203,6 +2524,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					ObjectInstance const &inst = mirror_instances[index];
 					index += index_offset;
 					vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+					frame_stats.draw(FrameStats::Shadow, inst.vertices.count);
 				}
 				index_offset = uint32_t(lambertian_instances.size() + environment_instances.size() + mirror_instances.size()); // account for lambertian, environment, and mirror size
 				for (uint32_t index : in_spot_light_instances[i][static_cast<uint32_t>(Scene::Material::PBR)])
@@ -2210,10 +2532,12 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					ObjectInstance const &inst = pbr_instances[index];
 					index += index_offset;
 					vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+					frame_stats.draw(FrameStats::Shadow, inst.vertices.count);
 				}
 			}
 		}
 		vkCmdEndRenderPass(workspace.command_buffer);
+		gpu_timestamps.end(workspace, GPUTimestamps::ShadowAtlas);
 	}
 
 	VkImageMemoryBarrier image_memory_barrier{
@@ -2260,6 +2584,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 				rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices));
 			}
 
+			Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Workspaces);
 			workspace.lines_vertices_src = rtg.helpers.create_buffer(
 				new_bytes,
 				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// GOING TO HAVE gpu COPY FROM THIS MEMORY
@@ -2291,6 +2616,7 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 			.size = needed_bytes,
 		};
 		vkCmdCopyBuffer(workspace.command_buffer, workspace.lines_vertices_src.handle, workspace.lines_vertices.handle, 1, &copy_region);
+		frame_stats.upload_bytes += copy_region.size;
 	}
 
 	{ // upload world info
@@ -2308,9 +2634,10 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		};
 
 		vkCmdCopyBuffer(workspace.command_buffer, workspace.World_src.handle, workspace.World.handle, 1, &copy_region);
+		frame_stats.upload_bytes += copy_region.size;
 	}
 
-	if (!spot_lights.empty() && !sun_lights.empty() && !sphere_lights.empty())
+	if (!spot_lights.empty() || !sun_lights.empty() || !sphere_lights.empty())
 	{
 		{ // copy lights into Light_src:
 			assert(workspace.Light_src.allocation.mapped);
@@ -2344,6 +2671,81 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		};
 
 		vkCmdCopyBuffer(workspace.command_buffer, workspace.Light_src.handle, workspace.Light.handle, 1, &copy_region);
+		frame_stats.upload_bytes += copy_region.size;
+	}
+
+	{ // upload light clusters:
+		size_t ranges_bytes = light_clusters.ranges.size() * sizeof(LightClusters::Range);
+		size_t needed_bytes = ranges_bytes + light_clusters.indices.size() * sizeof(uint32_t);
+		if (workspace.Clusters_src.handle == VK_NULL_HANDLE || workspace.Clusters_src.size < needed_bytes)
+		{
+			// round to next multiple of 4k to avoid re-allocating continuously if the index count grows slowly:
+			size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096;
+			if (workspace.Clusters_src.handle)
+			{
+				rtg.helpers.destroy_buffer(std::move(workspace.Clusters_src));
+			}
+			if (workspace.Clusters.handle)
+			{
+				rtg.helpers.destroy_buffer(std::move(workspace.Clusters));
+			}
+			Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Workspaces);
+			workspace.Clusters_src = rtg.helpers.create_buffer(
+				new_bytes,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				Helpers::Mapped);
+			workspace.Clusters = rtg.helpers.create_buffer(
+				new_bytes,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				Helpers::Unmapped);
+
+			// update the descriptor set:
+			VkDescriptorBufferInfo Clusters_info{
+				.buffer = workspace.Clusters.handle,
+				.offset = 0,
+				.range = workspace.Clusters.size,
+			};
+
+			std::array<VkWriteDescriptorSet, 1> writes{
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.World_descriptors,
+					.dstBinding = 8,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &Clusters_info,
+				},
+			};
+
+			vkUpdateDescriptorSets(
+				rtg.device,
+				uint32_t(writes.size()), writes.data(), // descriptorWrites count, data
+				0, nullptr								// descriptorCopies count, data
+			);
+
+			std::cout << "Re-allocated light cluster buffers to " << new_bytes << " bytes." << std::endl;
+		}
+
+		assert(workspace.Clusters_src.size == workspace.Clusters.size);
+		assert(workspace.Clusters_src.size >= needed_bytes);
+
+		{ // copy ranges followed by light indices into Clusters_src:
+			assert(workspace.Clusters_src.allocation.mapped);
+			char *clusters_ptr = reinterpret_cast<char *>(workspace.Clusters_src.allocation.data());
+			std::memcpy(clusters_ptr, light_clusters.ranges.data(), ranges_bytes);
+			std::memcpy(clusters_ptr + ranges_bytes, light_clusters.indices.data(), needed_bytes - ranges_bytes);
+		}
+
+		VkBufferCopy copy_region{
+			.srcOffset = 0,
+			.dstOffset = 0,
+			.size = needed_bytes,
+		};
+		vkCmdCopyBuffer(workspace.command_buffer, workspace.Clusters_src.handle, workspace.Clusters.handle, 1, &copy_region);
+		frame_stats.upload_bytes += copy_region.size;
 	}
 
 	{ // memory barrier to make sure copies complete before rendign happens:
@@ -2429,7 +2831,9 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		}
 
 		{ // draw with the backgorun pipeline
+			gpu_timestamps.begin(workspace, GPUTimestamps::Background);
 			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, background_pipeline.handle);
+			++frame_stats.pipeline_binds;
 
 			{ // push time:
 				BackgroundPipeline::Push push{
@@ -2439,6 +2843,8 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 			}
 
 			vkCmdDraw(workspace.command_buffer, 3, 1, 0, 0);
+			frame_stats.draw(FrameStats::Background, 3);
+			gpu_timestamps.end(workspace, GPUTimestamps::Background);
 		}
 
 		if (!lambertian_instances.empty() || !environment_instances.empty() || !mirror_instances.empty() || !pbr_instances.empty())
@@ -2456,11 +2862,13 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 				uint32_t(descriptor_sets.size()), descriptor_sets.data(), // descriptor sets count, ptr
 				0, nullptr												  // dynamic offsets count, ptr
 			);
+			++frame_stats.descriptor_set_binds;
 		}
 
 		if (!lambertian_instances.empty())
 		{ // draw with the object pipeline:
-			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, objects_pipeline.handle);
+			gpu_timestamps.begin(workspace, GPUTimestamps::Lambertian);
+			VkPipeline bound_pipeline = VK_NULL_HANDLE; // shading variant is bound per material below
 
 			{ // push time:
 				ObjectsPipeline::Push push{
@@ -2485,6 +2893,15 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 			{
 				uint32_t index = uint32_t(&inst - &lambertian_instances[0]);
 
+				// switch shading variant if this material needs a different one:
+				VkPipeline variant = objects_pipeline.handles[material_features[inst.material_index] | (scene_has_shadows ? ShadowFeature : 0)];
+				if (variant != bound_pipeline)
+				{
+					vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, variant);
+					++frame_stats.pipeline_binds;
+					bound_pipeline = variant;
+				}
+
 				// bind texture descriptor set:
 
 				vkCmdBindDescriptorSets(
@@ -2495,13 +2912,18 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					1, &texture_descriptors[inst.material_index], // descriptor sets count, ptr
 					0, nullptr									  // dynamic offsets count, ptr
 				);
+				++frame_stats.descriptor_set_binds;
 
 				vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+				frame_stats.draw(FrameStats::Lambertian, inst.vertices.count);
 			}
+			gpu_timestamps.end(workspace, GPUTimestamps::Lambertian);
 		}
 		if (!environment_instances.empty())
 		{ // draw with the objects pipeline:
+			gpu_timestamps.begin(workspace, GPUTimestamps::Environment);
 			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, environment_pipeline.handle);
+			++frame_stats.pipeline_binds;
 
 			{ // push exposure
 				EnvironmentPipeline::tone_map tone{
@@ -2534,13 +2956,18 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					1, &texture_descriptors[inst.material_index], // descriptor sets count, ptr
 					0, nullptr									  // dynamic offsets count, ptr
 				);
+				++frame_stats.descriptor_set_binds;
 				vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+				frame_stats.draw(FrameStats::Environment, inst.vertices.count);
 			}
+			gpu_timestamps.end(workspace, GPUTimestamps::Environment);
 		}
 		if (!mirror_instances.empty())
 		{ // draw with the objects pipeline:
+			gpu_timestamps.begin(workspace, GPUTimestamps::Mirror);
 
 			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mirror_pipeline.handle);
+			++frame_stats.pipeline_binds;
 
 			{ // push exposure
 				MirrorPipeline::tone_map tone{
@@ -2574,12 +3001,16 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					1, &texture_descriptors[inst.material_index], // descriptor sets count, ptr
 					0, nullptr									  // dynamic offsets count, ptr
 				);
+				++frame_stats.descriptor_set_binds;
 				vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+				frame_stats.draw(FrameStats::Mirror, inst.vertices.count);
 			}
+			gpu_timestamps.end(workspace, GPUTimestamps::Mirror);
 		}
 		if (!pbr_instances.empty())
 		{ // draw with the objects pipeline:
-			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pbr_pipeline.handle);
+			gpu_timestamps.begin(workspace, GPUTimestamps::PBR);
+			VkPipeline bound_pipeline = VK_NULL_HANDLE; // shading variant is bound per material below
 
 			{ // push exposure
 				PBRPipeline::tone_map tone{
@@ -2602,6 +3033,16 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 			for (ObjectInstance const &inst : pbr_instances)
 			{
 				uint32_t index = uint32_t(&inst - &pbr_instances[0]) + index_offset;
+
+				// switch shading variant if this material needs a different one:
+				VkPipeline variant = pbr_pipeline.handles[material_features[inst.material_index] | (scene_has_shadows ? ShadowFeature : 0)];
+				if (variant != bound_pipeline)
+				{
+					vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, variant);
+					++frame_stats.pipeline_binds;
+					bound_pipeline = variant;
+				}
+
 				// bind texture descriptor set:
 
 				vkCmdBindDescriptorSets(
@@ -2612,13 +3053,18 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					1, &texture_descriptors[inst.material_index], // descriptor sets count, ptr
 					0, nullptr									  // dynamic offsets count, ptr
 				);
+				++frame_stats.descriptor_set_binds;
 				vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+				frame_stats.draw(FrameStats::PBR, inst.vertices.count);
 			}
+			gpu_timestamps.end(workspace, GPUTimestamps::PBR);
 		}
 
 		if (!lines_vertices.empty())
 		{ // draw with the lines pipeline;
+			gpu_timestamps.begin(workspace, GPUTimestamps::Lines);
 			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lines_pipeline.handle);
+			++frame_stats.pipeline_binds;
 
 			{ // use lines_vertice (offset 0) as vertex buffer bindign 0:
 				std::array<VkBuffer, 1> vertex_buffers{workspace.lines_vertices.handle};
@@ -2638,14 +3084,24 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					uint32_t(descriptor_sets.size()), descriptor_sets.data(), // descriptor set count, ptr
 					0, nullptr												  // dynamics offsets count, ptr
 				);
+				++frame_stats.descriptor_set_binds;
 			}
 
 			// draw line vertice
 			vkCmdDraw(workspace.command_buffer, uint32_t(lines_vertices.size()), 1, 0, 0);
+			frame_stats.draw(FrameStats::Lines, uint32_t(lines_vertices.size()));
+			gpu_timestamps.end(workspace, GPUTimestamps::Lines);
 		}
 
 		vkCmdEndRenderPass(workspace.command_buffer);
 	}
+	gpu_timestamps.end(workspace, GPUTimestamps::Frame);
+
+	if (show_frame_stats && std::chrono::steady_clock::now() - frame_stats_printed >= std::chrono::seconds(1))
+	{
+		frame_stats.print(std::cout);
+		frame_stats_printed = std::chrono::steady_clock::now();
+	}
 
 	// end recoding
 	VK(vkEndCommandBuffer(workspace.command_buffer));
@@ -2678,7 +3134,11 @@ void Render::render(RTG &rtg_, RTG::RenderParams const &render_params)
 
 void Render::update(float dt)
 {
+	TRACE_ZONE("Render::update");
+	if (replaying)
+		return; // the captured frame is re-submitted as read_frame_capture() left it
 	{ // update the animations according to the drivers
+		TRACE_ZONE("Render::update drivers");
 		scene.animation_setting = rtg.configuration.animation_settings;
 		float new_t = dt + scene.return_time;
 		scene.update_drivers(new_t);
@@ -2725,6 +3185,7 @@ void Render::update(float dt)
 			glm::mat4x4 clip = clip_from_view[0] * view_from_world[0];
 			CLIP_FROM_WORLD = to_mat4(clip);
 			world.CAMERA_POSITION = eye;
+			camera_near = cur_camera.near;
 		}
 	}
 	if (camera_mode != CameraMode::Scene)
@@ -2767,6 +3228,7 @@ void Render::update(float dt)
 							 user_camera.radius * std::cos(user_camera.elevation) * std::sin(user_camera.azimuth),
 							 user_camera.radius * std::sin(user_camera.elevation)};
 			world.CAMERA_POSITION = eye;
+			camera_near = user_camera.near;
 		}
 		else if (camera_mode == CameraMode::Debug)
 		{
@@ -2802,6 +3264,7 @@ void Render::update(float dt)
 							 debug_camera.radius * std::cos(debug_camera.elevation) * std::sin(debug_camera.azimuth),
 							 debug_camera.radius * std::sin(debug_camera.elevation)};
 			world.CAMERA_POSITION = eye;
+			camera_near = debug_camera.near;
 		}
 
 		/*	last_aspect = float(rtg.swapchain_extent.width) / float(rtg.swapchain_extent.height);
@@ -2811,19 +3274,10 @@ void Render::update(float dt)
 	// updating frustrum
 	lines_vertices.clear();
 	std::array<glm::vec3, 8> frustum_vertices;
-	std::array<glm::vec4, 8> clip_space_coordinates = {
-		glm::vec4(1.0f, 1.0f, 0.0f, 1.0f),	 // Near top right
-		glm::vec4(-1.0f, 1.0f, 0.0f, 1.0f),	 // Near top left
-		glm::vec4(1.0f, -1.0f, 0.0f, 1.0f),	 // Near bottom right
-		glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f), // Near bottom left
-		glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),	 // Far top right
-		glm::vec4(-1.0f, 1.0f, 1.0f, 1.0f),	 // Far top left
-		glm::vec4(1.0f, -1.0f, 1.0f, 1.0f),	 // Far bottom right
-		glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f)	 // Far bottom left
-	};
 	std::vector<std::array<glm::vec3, 8>> light_frustums;
 
 	{ // get light frustums for shadow atlas
+		TRACE_ZONE("Render::update light frustums");
 		spot_light_from_world.clear();
 		light_frustums.resize(scene.spot_lights_sorted_indices.size());
 		for (uint32_t i = 0; i < scene.spot_lights_sorted_indices.size(); ++i)
@@ -2831,66 +3285,13 @@ void Render::update(float dt)
 			Scene::Light &cur_light = scene.lights[scene.spot_lights_sorted_indices[i].lights_index];
 			assert(cur_light.light_type == Scene::Light::LightType::Spot); // only support spot for now
 			total_shadow_size += cur_light.shadow * cur_light.shadow;
-			glm::mat4x4 cur_light_transform = scene.nodes[scene.spot_lights_sorted_indices[i].local_to_world[0]].transform.local_to_parent();
-			for (int j = 1; j < scene.spot_lights_sorted_indices[i].local_to_world.size(); ++j)
-			{
-				cur_light_transform *= scene.nodes[scene.spot_lights_sorted_indices[i].local_to_world[j]].transform.local_to_parent();
-			}
-
-			{ // create light frustum and light from world matrices
-				glm::vec3 eye = glm::vec3(cur_light_transform[3]);
-				glm::vec3 forward = -glm::vec3(cur_light_transform[2]);
-				glm::vec3 target = eye + forward;
-
-				glm::vec3 world_up = glm::vec3(0.0f, 0.0f, 1.0f);
-				if (glm::abs(glm::dot(forward, world_up)) > 0.999f)
-				{
-					world_up = glm::vec3(0.0f, 1.0f, 0.0f);
-				}
-				glm::vec3 right = glm::normalize(glm::cross(forward, world_up));
-				glm::vec3 up = glm::normalize(glm::cross(right, forward));
-
-				Scene::Light::Spotlight spot_param = std::get<Scene::Light::Spotlight>(cur_light.additional_params);
-				float aspect = 1.0f;
-				float near = 0.02f;
-				float far;
-				if (spot_param.limit == 0.0f)
-				{
-					far = std::sqrt(glm::length(spot_param.power * cur_light.tint) / (float(M_PI) * 4.0f * 0.001f));
-				}
-				else
-				{
-					far = spot_param.limit;
-				}
-
-				glm::mat4 projection = glm::make_mat4(perspective(spot_param.fov, aspect, near, far).data());
-				glm::mat4 view = glm::make_mat4(look_at(
-													eye.x, eye.y, eye.z,		  // eye
-													target.x, target.y, target.z, // target
-													up.x, up.y, up.z			  // up
-													)
-													.data());
-				spot_light_from_world.emplace_back(projection * view);
-
-				glm::mat4x4 world_from_clip = glm::inverse(spot_light_from_world.back());
-				// Transform clip space to world space and apply perspective divide
-				for (int j = 0; j < 8; ++j)
-				{
-					glm::vec4 world_space_vertex = world_from_clip * clip_space_coordinates[j];
-					light_frustums[i][j] = glm::vec3(world_space_vertex) / world_space_vertex.w;
-				}
-			}
+			spot_light_from_world.emplace_back(spot_light_clip_from_world(scene, scene.spot_lights_sorted_indices[i]));
+			light_frustums[i] = frustum_corners(spot_light_from_world.back());
 		}
 	}
 	if (rtg.configuration.culling_settings == 1)
 	{ // frustum culling is on
-		glm::mat4x4 world_from_clip = glm::inverse(culling_camera == CameraMode::Scene ? clip_from_view[0] * view_from_world[0] : clip_from_view[1] * view_from_world[1]);
-		// Transform clip space to world space and apply perspective divide
-		for (int j = 0; j < 8; ++j)
-		{
-			glm::vec4 world_space_vertex = world_from_clip * clip_space_coordinates[j];
-			frustum_vertices[j] = glm::vec3(world_space_vertex) / world_space_vertex.w;
-		}
+		frustum_vertices = frustum_corners(culling_camera == CameraMode::Scene ? clip_from_view[0] * view_from_world[0] : clip_from_view[1] * view_from_world[1]);
 	}
 	// render last active frustum if in debug mode
 	{
@@ -2898,13 +3299,7 @@ void Render::update(float dt)
 		{
 			if (rtg.configuration.culling_settings != 1)
 			{
-				glm::mat4x4 world_from_clip = glm::inverse(culling_camera == CameraMode::Scene ? clip_from_view[0] * view_from_world[0] : clip_from_view[1] * view_from_world[1]);
-				// Transform clip space to world space and apply perspective divide
-				for (int j = 0; j < 8; ++j)
-				{
-					glm::vec4 world_space_vertex = world_from_clip * clip_space_coordinates[j];
-					frustum_vertices[j] = glm::vec3(world_space_vertex) / world_space_vertex.w;
-				}
+				frustum_vertices = frustum_corners(culling_camera == CameraMode::Scene ? clip_from_view[0] * view_from_world[0] : clip_from_view[1] * view_from_world[1]);
 			}
 
 			lines_vertices.emplace_back(PosColVertex{
@@ -3007,6 +3402,8 @@ void Render::update(float dt)
 	}
 
 	{ // fill object instances with scene hiearchy
+		TRACE_ZONE("Render::update traversal, culling and lights");
+		frame_stats.instances_visited = 0;
 
 		for (uint32_t i = 0; i < in_view_instances.size(); ++i)
 		{
@@ -3029,312 +3426,330 @@ void Render::update(float dt)
 		sun_lights.clear();
 		sphere_lights.clear();
 		spot_lights.clear();
-		spot_light_from_world.clear();
 
 		glm::mat4x4 frustum_view_from_world = culling_camera == CameraMode::Scene ? view_from_world[0] : view_from_world[1];
 
-		std::deque<glm::mat4x4> transform_stack;
+		// texture streaming requests: the largest projected size (in pixels) of each material's visible instances
+		glm::mat4x4 streaming_clip_from_view = culling_camera == CameraMode::Scene ? clip_from_view[0] : clip_from_view[1];
+		glm::mat4x4 streaming_clip_from_world = streaming_clip_from_view * frustum_view_from_world;
+		float streaming_scale = streaming_clip_from_view[1][1] * float(rtg.swapchain_extent.height);
+		std::fill(texture_streaming.material_screen_size.begin(), texture_streaming.material_screen_size.end(), 0.0f);
+		auto request_textures = [&](uint32_t material_index, OBB const &obb)
+		{
+			if (!texture_streaming.enabled())
+				return;
+			if (rtg.configuration.culling_settings == 1 && !check_frustum_obb_intersection(frustum_vertices, obb))
+				return;
+			glm::vec4 clip = streaming_clip_from_world * glm::vec4(obb.center, 1.0f);
+			float size = glm::length(obb.extents) * streaming_scale / std::max(clip.w, camera_near);
+			float &material_size = texture_streaming.material_screen_size[material_index];
+			material_size = std::max(material_size, size);
+		};
+
+		scene_traversal.update(scene, mesh_AABBs);
 
-		std::function<void(uint32_t)> draw_node = [&](uint32_t i)
+		// gather light information
+		for (SceneTraversal::Light const &instance : scene_traversal.lights)
 		{
-			Scene::Node &cur_node = scene.nodes[i];
-			// iterating through the tree to determine position
-			glm::mat4x4 cur_node_transform_in_parent = (cur_node.transform.local_to_parent());
-			if (transform_stack.empty())
+			glm::mat4x4 const &WORLD_FROM_LOCAL = instance.world_from_local;
+			Scene::Light &cur_light = scene.lights[instance.light_index];
+
+			glm::vec3 tint = cur_light.tint;
+			if (cur_light.light_type == Scene::Light::Sun)
 			{
-				transform_stack.push_back(cur_node_transform_in_parent);
+
+				glm::vec3 light_direction = glm::mat3x3(WORLD_FROM_LOCAL) * glm::vec3(0.0f, 0.0f, 1.0f);
+				Scene::Light::Sunlight sun_param = std::get<Scene::Light::Sunlight>(cur_light.additional_params);
+				sun_lights.emplace_back(ObjectsPipeline::SunLight{
+					.DIRECTION = glm::vec4(light_direction, 0.0f),
+					.ENERGY = sun_param.strength * tint,
+					.SIN_ANGLE = sin(sun_param.angle)});
 			}
-			else
+			else if (cur_light.light_type == Scene::Light::Sphere)
 			{
-				glm::mat4x4 parent_node_transform_in_world = transform_stack.back();
-				transform_stack.push_back(parent_node_transform_in_world * cur_node_transform_in_parent);
-			}
 
-			// gather light information
-			if (uint32_t cur_light_index = cur_node.light_index; cur_light_index != -1)
+				glm::vec3 light_position = WORLD_FROM_LOCAL * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+				Scene::Light::Spherelight sphere_param = std::get<Scene::Light::Spherelight>(cur_light.additional_params);
+				sphere_lights.emplace_back(ObjectsPipeline::SphereLight{
+					.POSITION = glm::vec4(light_position, 0.0f),
+					.RADIUS = sphere_param.radius,
+					.ENERGY = sphere_param.power * tint,
+					.LIMIT = sphere_param.limit,
+				});
+			}
+			else if (cur_light.light_type == Scene::Light::Spot)
 			{
-				glm::mat4x4 WORLD_FROM_LOCAL = transform_stack.back();
-				Scene::Light &cur_light = scene.lights[cur_light_index];
 
-				glm::vec3 tint = cur_light.tint;
-				if (cur_light.light_type == Scene::Light::Sun)
+				glm::vec3 light_position = WORLD_FROM_LOCAL * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+				glm::vec3 light_direction = glm::mat3x3(WORLD_FROM_LOCAL) * glm::vec3(0.0f, 0.0f, 1.0f);
+				Scene::Light::Spotlight spot_param = std::get<Scene::Light::Spotlight>(cur_light.additional_params);
+				float outer_angle = spot_param.fov / 2.0f;
+				float inner_angle = (1.0f - spot_param.blend) * outer_angle;
+				spot_lights.emplace_back(ObjectsPipeline::SpotLight{
+					.POSITION = glm::vec4(light_position, 0.0f),
+					.shadow_size = cur_light.shadow,
+					.DIRECTION = light_direction,
+					.RADIUS = spot_param.radius,
+					.ENERGY = spot_param.power * tint,
+					.LIMIT = spot_param.limit,
+					.CONE_ANGLES = glm::vec2(inner_angle, outer_angle),
+				});
+			}
+		}
+
+		// mesh instances, each node's after its children's
+		for (SceneTraversal::Mesh const &instance : scene_traversal.meshes)
+		{
+			uint32_t cur_mesh_index = instance.mesh_index;
+			++frame_stats.instances_visited;
+			mat4 WORLD_FROM_LOCAL = to_mat4(instance.world_from_local);
+			mat4 WORLD_FROM_LOCAL_NORMAL = to_mat4(instance.world_from_local_normal);
+			OBB const &obb = instance.obb;
+			if (camera_mode == CameraMode::Debug)
+			{
+				// debug draw the OBBs
+
+				std::array<glm::vec3, 8> vertices = {
+					obb.center + obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
+					obb.center + obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2],
+					obb.center + obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
+					obb.center + obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2],
+					obb.center - obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
+					obb.center - obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2],
+					obb.center - obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
+					obb.center - obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2]};
+
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[0].x, .y = vertices[0].y, .z = vertices[0].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[1].x, .y = vertices[1].y, .z = vertices[1].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[0].x, .y = vertices[0].y, .z = vertices[0].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[2].x, .y = vertices[2].y, .z = vertices[2].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[2].x, .y = vertices[2].y, .z = vertices[2].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[3].x, .y = vertices[3].y, .z = vertices[3].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[3].x, .y = vertices[3].y, .z = vertices[3].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[1].x, .y = vertices[1].y, .z = vertices[1].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[0].x, .y = vertices[0].y, .z = vertices[0].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[4].x, .y = vertices[4].y, .z = vertices[4].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[4].x, .y = vertices[4].y, .z = vertices[4].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[6].x, .y = vertices[6].y, .z = vertices[6].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[2].x, .y = vertices[2].y, .z = vertices[2].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[6].x, .y = vertices[6].y, .z = vertices[6].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[4].x, .y = vertices[4].y, .z = vertices[4].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[5].x, .y = vertices[5].y, .z = vertices[5].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[6].x, .y = vertices[6].y, .z = vertices[6].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[7].x, .y = vertices[7].y, .z = vertices[7].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[1].x, .y = vertices[1].y, .z = vertices[1].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[5].x, .y = vertices[5].y, .z = vertices[5].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[3].x, .y = vertices[3].y, .z = vertices[3].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[7].x, .y = vertices[7].y, .z = vertices[7].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[5].x, .y = vertices[5].y, .z = vertices[5].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+				lines_vertices.emplace_back(PosColVertex{
+					.Position{.x = vertices[7].x, .y = vertices[7].y, .z = vertices[7].z},
+					.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				});
+
+				if (rtg.configuration.culling_settings == 1 && !check_frustum_obb_intersection(frustum_vertices, obb))
 				{
-
-					glm::vec3 light_direction = glm::mat3x3(WORLD_FROM_LOCAL) * glm::vec3(0.0f, 0.0f, 1.0f);
-					Scene::Light::Sunlight sun_param = std::get<Scene::Light::Sunlight>(cur_light.additional_params);
-					sun_lights.emplace_back(ObjectsPipeline::SunLight{
-						.DIRECTION = glm::vec4(light_direction, 0.0f),
-						.ENERGY = sun_param.strength * tint,
-						.SIN_ANGLE = sin(sun_param.angle)});
+					continue;
 				}
-				else if (cur_light.light_type == Scene::Light::Sphere)
-				{
+			}
 
-					glm::vec3 light_position = WORLD_FROM_LOCAL * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-					Scene::Light::Spherelight sphere_param = std::get<Scene::Light::Spherelight>(cur_light.additional_params);
-					sphere_lights.emplace_back(ObjectsPipeline::SphereLight{
-						.POSITION = glm::vec4(light_position, 0.0f),
-						.RADIUS = sphere_param.radius,
-						.ENERGY = sphere_param.power * tint,
-						.LIMIT = sphere_param.limit,
+			if (uint32_t cur_material_index = scene.meshes[cur_mesh_index].material_index; cur_material_index != -1)
+			{ /// has some material
+				const Scene::Material &cur_material = scene.materials[scene.meshes[cur_mesh_index].material_index];
+				uint32_t instance_index = 0;
+				if (cur_material.material_type == Scene::Material::MaterialType::Environment)
+				{
+					environment_instances.emplace_back(ObjectInstance{
+						.vertices = mesh_vertices[cur_mesh_index],
+						.transform{
+							.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
+						},
+						.material_index = cur_material_index,
 					});
 				}
-				else if (cur_light.light_type == Scene::Light::Spot)
+				else if (cur_material.material_type == Scene::Material::MaterialType::Mirror)
 				{
-
-					glm::vec3 light_position = WORLD_FROM_LOCAL * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-					glm::vec3 light_direction = glm::mat3x3(WORLD_FROM_LOCAL) * glm::vec3(0.0f, 0.0f, 1.0f);
-					Scene::Light::Spotlight spot_param = std::get<Scene::Light::Spotlight>(cur_light.additional_params);
-					float outer_angle = spot_param.fov / 2.0f;
-					float inner_angle = (1.0f - spot_param.blend) * outer_angle;
-					spot_lights.emplace_back(ObjectsPipeline::SpotLight{
-						.POSITION = glm::vec4(light_position, 0.0f),
-						.shadow_size = cur_light.shadow,
-						.DIRECTION = light_direction,
-						.RADIUS = spot_param.radius,
-						.ENERGY = spot_param.power * tint,
-						.LIMIT = spot_param.limit,
-						.CONE_ANGLES = glm::vec2(inner_angle, outer_angle),
+					mirror_instances.emplace_back(ObjectInstance{
+						.vertices = mesh_vertices[cur_mesh_index],
+						.transform{
+							.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
+						},
+						.material_index = cur_material_index,
 					});
 				}
-			}
-
-			// draw children mesh
-			for (uint32_t child_index : cur_node.children)
-			{
-				draw_node(child_index);
-			}
-
-			// draw own mesh
-			if (int32_t cur_mesh_index = cur_node.mesh_index; cur_mesh_index != -1)
-			{
-				mat4 WORLD_FROM_LOCAL = to_mat4(transform_stack.back());
-				glm::mat4x4 glm_world = transform_stack.back();
-				glm::mat4x4 glm_world_normal = glm::mat4x4(glm::inverse(glm::transpose(glm::mat3(glm_world))));
-				mat4 WORLD_FROM_LOCAL_NORMAL = to_mat4(glm_world_normal);
-				OBB obb = AABB_transform_to_OBB(glm_world, mesh_AABBs[cur_mesh_index]);
-				if (camera_mode == CameraMode::Debug)
+				else if (cur_material.material_type == Scene::Material::MaterialType::Lambertian)
 				{
-					// debug draw the OBBs
-
-					std::array<glm::vec3, 8> vertices = {
-						obb.center + obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
-						obb.center + obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2],
-						obb.center + obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
-						obb.center + obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2],
-						obb.center - obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
-						obb.center - obb.extents[0] * obb.axes[0] + obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2],
-						obb.center - obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] + obb.extents[2] * obb.axes[2],
-						obb.center - obb.extents[0] * obb.axes[0] - obb.extents[1] * obb.axes[1] - obb.extents[2] * obb.axes[2]};
-
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[0].x, .y = vertices[0].y, .z = vertices[0].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[1].x, .y = vertices[1].y, .z = vertices[1].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[0].x, .y = vertices[0].y, .z = vertices[0].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[2].x, .y = vertices[2].y, .z = vertices[2].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[2].x, .y = vertices[2].y, .z = vertices[2].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[3].x, .y = vertices[3].y, .z = vertices[3].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[3].x, .y = vertices[3].y, .z = vertices[3].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[1].x, .y = vertices[1].y, .z = vertices[1].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[0].x, .y = vertices[0].y, .z = vertices[0].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[4].x, .y = vertices[4].y, .z = vertices[4].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[4].x, .y = vertices[4].y, .z = vertices[4].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[6].x, .y = vertices[6].y, .z = vertices[6].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[2].x, .y = vertices[2].y, .z = vertices[2].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[6].x, .y = vertices[6].y, .z = vertices[6].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[4].x, .y = vertices[4].y, .z = vertices[4].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[5].x, .y = vertices[5].y, .z = vertices[5].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[6].x, .y = vertices[6].y, .z = vertices[6].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[7].x, .y = vertices[7].y, .z = vertices[7].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[1].x, .y = vertices[1].y, .z = vertices[1].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[5].x, .y = vertices[5].y, .z = vertices[5].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[3].x, .y = vertices[3].y, .z = vertices[3].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[7].x, .y = vertices[7].y, .z = vertices[7].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
-					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[5].x, .y = vertices[5].y, .z = vertices[5].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+					instance_index = uint32_t(lambertian_instances.size());
+					lambertian_instances.emplace_back(ObjectInstance{
+						.vertices = mesh_vertices[cur_mesh_index],
+						.transform{
+							.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
+						},
+						.material_index = cur_material_index,
 					});
-					lines_vertices.emplace_back(PosColVertex{
-						.Position{.x = vertices[7].x, .y = vertices[7].y, .z = vertices[7].z},
-						.Color{.r = 0xff, .g = 0x00, .b = 0x00, .a = 0xff},
+				}
+				else if (cur_material.material_type == Scene::Material::MaterialType::PBR)
+				{
+					pbr_instances.emplace_back(ObjectInstance{
+						.vertices = mesh_vertices[cur_mesh_index],
+						.transform{
+							.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
+							.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
+						},
+						.material_index = cur_material_index,
 					});
-
-					if (rtg.configuration.culling_settings == 1 && !check_frustum_obb_intersection(frustum_vertices, obb))
-					{
-						transform_stack.pop_back();
-						return;
-					}
 				}
 
-				if (uint32_t cur_material_index = scene.meshes[cur_mesh_index].material_index; cur_material_index != -1)
-				{ /// has some material
-					const Scene::Material &cur_material = scene.materials[scene.meshes[cur_mesh_index].material_index];
-					uint32_t instance_index = 0;
-					if (cur_material.material_type == Scene::Material::MaterialType::Environment)
-					{
-						environment_instances.emplace_back(ObjectInstance{
-							.vertices = mesh_vertices[cur_mesh_index],
-							.transform{
-								.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
-							},
-							.material_index = cur_material_index,
-						});
-					}
-					else if (cur_material.material_type == Scene::Material::MaterialType::Mirror)
-					{
-						mirror_instances.emplace_back(ObjectInstance{
-							.vertices = mesh_vertices[cur_mesh_index],
-							.transform{
-								.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
-							},
-							.material_index = cur_material_index,
-						});
-					}
-					else if (cur_material.material_type == Scene::Material::MaterialType::Lambertian)
-					{
-						instance_index = uint32_t(lambertian_instances.size());
-						lambertian_instances.emplace_back(ObjectInstance{
-							.vertices = mesh_vertices[cur_mesh_index],
-							.transform{
-								.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
-							},
-							.material_index = cur_material_index,
-						});
-					}
-					else if (cur_material.material_type == Scene::Material::MaterialType::PBR)
-					{
-						pbr_instances.emplace_back(ObjectInstance{
-							.vertices = mesh_vertices[cur_mesh_index],
-							.transform{
-								.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
-								.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
-							},
-							.material_index = cur_material_index,
-						});
-					}
+				request_textures(cur_material_index, obb);
 
-					if (rtg.configuration.culling_settings == 1 && check_frustum_obb_intersection(frustum_vertices, obb))
-					{
-						in_view_instances[static_cast<uint32_t>(cur_material.material_type)].push_back(instance_index);
-					}
-					for (uint32_t frustum_i = 0; frustum_i < in_spot_light_instances.size(); ++frustum_i)
-					{
-						if (check_frustum_obb_intersection(light_frustums[frustum_i], obb))
-						{
-							in_spot_light_instances[frustum_i][static_cast<uint32_t>(cur_material.material_type)].push_back(instance_index);
-						}
-					}
+				if (rtg.configuration.culling_settings == 1 && check_frustum_obb_intersection(frustum_vertices, obb))
+				{
+					in_view_instances[static_cast<uint32_t>(cur_material.material_type)].push_back(instance_index);
 				}
-				else
+				for (uint32_t frustum_i = 0; frustum_i < in_spot_light_instances.size(); ++frustum_i)
 				{
-
-					if (rtg.configuration.culling_settings == 1 && check_frustum_obb_intersection(frustum_vertices, obb))
+					if (check_frustum_obb_intersection(light_frustums[frustum_i], obb))
 					{
-						in_view_instances[0].push_back(uint32_t(lambertian_instances.size()));
+						in_spot_light_instances[frustum_i][static_cast<uint32_t>(cur_material.material_type)].push_back(instance_index);
 					}
-					for (uint32_t frustum_i = 0; frustum_i < in_spot_light_instances.size(); ++frustum_i)
+				}
+			}
+			else
+			{
+
+				if (rtg.configuration.culling_settings == 1 && check_frustum_obb_intersection(frustum_vertices, obb))
+				{
+					in_view_instances[0].push_back(uint32_t(lambertian_instances.size()));
+				}
+				for (uint32_t frustum_i = 0; frustum_i < in_spot_light_instances.size(); ++frustum_i)
+				{
+					if (check_frustum_obb_intersection(light_frustums[frustum_i], obb))
 					{
-						if (check_frustum_obb_intersection(light_frustums[i], obb))
-						{
-							in_spot_light_instances[frustum_i][0].push_back(uint32_t(lambertian_instances.size()));
-						}
+						in_spot_light_instances[frustum_i][0].push_back(uint32_t(lambertian_instances.size()));
 					}
-					// use lambertian pipeline to render the default albedo, displacement and normal maps
-					lambertian_instances.emplace_back(ObjectInstance{
-						.vertices = mesh_vertices[cur_mesh_index],
-						.transform{
-							.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
-							.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
-							.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
-						},
-						.material_index = 0,
-					});
 				}
+				request_textures(0, obb);
+
+				// use lambertian pipeline to render the default albedo, displacement and normal maps
+				lambertian_instances.emplace_back(ObjectInstance{
+					.vertices = mesh_vertices[cur_mesh_index],
+					.transform{
+						.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
+						.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
+						.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL,
+					},
+					.material_index = 0,
+				});
 			}
+		}
 
-			transform_stack.pop_back();
-		};
-		// traverse the scene hiearchy:
-		for (uint32_t j = 0; j < scene.root_nodes.size(); ++j)
+		// whatever the traversal didn't put in a frustum's list was culled by it:
+		uint32_t in_view = 0;
+		for (std::vector<uint32_t> const &instances : in_view_instances)
+			in_view += uint32_t(instances.size());
+		frame_stats.instances_culled_camera = rtg.configuration.culling_settings == 1 ? frame_stats.instances_visited - in_view : 0;
+		frame_stats.instances_culled_light.assign(in_spot_light_instances.size(), 0);
+		for (uint32_t i = 0; i < in_spot_light_instances.size(); ++i)
 		{
-			transform_stack.clear();
-			draw_node(scene.root_nodes[j]);
+			uint32_t in_light = 0;
+			for (std::vector<uint32_t> const &instances : in_spot_light_instances[i])
+				in_light += uint32_t(instances.size());
+			frame_stats.instances_culled_light[i] = frame_stats.instances_visited - in_light;
 		}
 	}
 
+	{ // stream in the texture levels visible instances need, drop what is over budget or unused:
+		TRACE_ZONE("Render::update texture streaming");
+		stream_textures();
+	}
+
+	{ // bin sphere and spot lights into the light clusters of the current camera
+		TRACE_ZONE("Render::update light clusters");
+		glm::mat4x4 clip_from_world = glm::make_mat4(CLIP_FROM_WORLD.data());
+		light_clusters.update(clip_from_world, camera_near, sphere_lights, spot_lights);
+		world.CLUSTER_FROM_WORLD = clip_from_world;
+		world.CLUSTER_NEAR = light_clusters.z_near;
+		world.CLUSTER_LOG_SCALE = light_clusters.log_scale;
+	}
+
 	{ // shadow map atlas organization
+		TRACE_ZONE("Render::update shadow atlas packing");
 
 		// reduce shadow map size if requesting too many
 		uint8_t reduction = 0;
@@ -3358,6 +3773,36 @@ void Render::on_input(InputEvent const &evt)
 		return;
 	}
 
+	// print GPU memory use:
+	if (evt.type == InputEvent::KeyDown && evt.key.key == GLFW_KEY_M)
+	{
+		rtg.helpers.report_memory(std::cout);
+		return;
+	}
+
+	// toggle the per-frame statistics readout:
+	if (evt.type == InputEvent::KeyDown && evt.key.key == GLFW_KEY_I)
+	{
+		show_frame_stats = !show_frame_stats;
+		frame_stats_printed = std::chrono::steady_clock::time_point();
+		return;
+	}
+
+	// capture the draw state of the next frame (--capture):
+	if (evt.type == InputEvent::KeyDown && evt.key.key == GLFW_KEY_K && rtg.configuration.capture_out != "")
+	{
+		capture_pending = true;
+		return;
+	}
+
+	// write the CPU trace recorded so far (--trace):
+	if (evt.type == InputEvent::KeyDown && evt.key.key == GLFW_KEY_T && Trace::enabled())
+	{
+		Trace::write();
+		std::cout << "Wrote trace to " << Trace::path() << std::endl;
+		return;
+	}
+
 	// animation controls
 	// pausing
 	if (evt.type == InputEvent::KeyDown && (evt.key.key == GLFW_KEY_P))
@@ -7,9 +7,17 @@
 #include "RTG.hpp"
 #include "scene.hpp"
 #include "frustum_culling.hpp"
+#include "Lights.hpp"
+#include "ShadowAtlas.hpp"
+#include "scene_traversal.hpp"
 #include "glm.hpp"
 #include "timer.hpp"
-#include "CubePipeline.hpp"
+#include "TextureCompression.hpp"
+
+#include <deque>
+#include <future>
+#include <iosfwd>
+#include <optional>
 
 struct Render : RTG::Application
 {
@@ -101,6 +109,22 @@ struct Render : RTG::Application
 
 	static constexpr uint32_t shadow_atlas_length = 4096;
 
+	// fragment shader features toggled by specialization constants in objects.frag and pbr.frag,
+	// every combination gets its own pipeline so plain materials skip the work they don't need:
+	enum ShadingFeature : uint32_t
+	{
+		NormalMapFeature = 1 << 0, // material has a non-default normal map
+		ShadowFeature = 1 << 1,	   // scene has at least one shadow casting spot light
+	};
+	static constexpr uint32_t shading_variant_count = 4;
+
+	// specialization constant data shared by the objects and pbr fragment shaders:
+	struct ShadingSpecialization
+	{
+		VkBool32 NORMAL_MAP;
+		VkBool32 SHADOWS;
+	};
+
 	struct ObjectsPipeline
 	{
 
@@ -118,41 +142,20 @@ struct Render : RTG::Application
 			uint32_t SPHERE_LIGHT_COUNT;
 			uint32_t SPOT_LIGHT_COUNT;
 			uint32_t SHADOW_ATLAS_SIZE = shadow_atlas_length;
+			glm::mat4 CLUSTER_FROM_WORLD; // clip-from-world of the camera the light clusters were built for
+			float CLUSTER_NEAR;
+			float CLUSTER_LOG_SCALE; // depth slices per log-unit of view depth
+			float pad0 = 0.0f;
+			float pad1 = 0.0f;
+			glm::vec4 IRRADIANCE_SH[9]{}; // rgb, diffuse lighting of the environment (see SphericalHarmonics.hpp)
 		};
 
-		static_assert(sizeof(World) == 32, "World is the expected size.");
+		static_assert(sizeof(World) == 32 + 16 * 4 + 16 + 16 * 9, "World is the expected size.");
 
-		struct SunLight
-		{
-			glm::vec4 DIRECTION; // w padding
-			glm::vec3 ENERGY;
-			float SIN_ANGLE;
-		};
-		static_assert(sizeof(SunLight) == 4 * 4 + 4 * 3 + 4, "SunLight is the expected size.");
-
-		struct SphereLight
-		{
-			glm::vec3 POSITION;
-			float RADIUS;
-			glm::vec3 ENERGY;
-			float LIMIT;
-		};
-		static_assert(sizeof(SphereLight) == 4 * 3 + 4 + 4 * 3 + 4, "SphereLight is the expected size.");
-
-		struct SpotLight
-		{
-			glm::vec3 POSITION;
-			uint32_t shadow_size = 0;
-			glm::vec3 DIRECTION;
-			float RADIUS;
-			glm::vec3 ENERGY;
-			float LIMIT;
-			glm::vec2 CONE_ANGLES;
-			glm::vec2 pad0 = glm::vec2(0.0f);
-			glm::mat4x4 LIGHT_FROM_WORLD;
-			glm::mat4x4 ATLAS_COORD_FROM_WORLD;
-		};
-		static_assert(sizeof(SpotLight) == 192, "SpotLight is the expected size.");
+		// light arrays (Lights.hpp):
+		using SunLight = ::SunLight;
+		using SphereLight = ::SphereLight;
+		using SpotLight = ::SpotLight;
 
 		struct Transform
 		{
@@ -174,7 +177,8 @@ struct Render : RTG::Application
 
 		using Vertex = PosNorTanTexVertex;
 
-		VkPipeline handle = VK_NULL_HANDLE;
+		// indexed by ShadingFeature bits:
+		std::array<VkPipeline, shading_variant_count> handles{};
 
 		void create(RTG &, VkRenderPass render_pass, uint32_t subpass);
 		void destroy(RTG &);
@@ -252,7 +256,8 @@ struct Render : RTG::Application
 
 		using Vertex = PosNorTanTexVertex;
 
-		VkPipeline handle = VK_NULL_HANDLE;
+		// indexed by ShadingFeature bits:
+		std::array<VkPipeline, shading_variant_count> handles{};
 
 		void create(RTG &, VkRenderPass render_pass, uint32_t subpass);
 		void destroy(RTG &);
@@ -282,15 +287,62 @@ struct Render : RTG::Application
 		Helpers::AllocatedBuffer World;		// device set locat
 		Helpers::AllocatedBuffer Light_src; // host coherent; mapped
 		Helpers::AllocatedBuffer Light;		// device-local
+		Helpers::AllocatedBuffer Clusters_src; // host coherent; mapped
+		Helpers::AllocatedBuffer Clusters;	   // device-local
 		VkDescriptorSet World_descriptors;	// reference ot the world
 
 		// locat for ObjectsPipeline::Transforma data: (stream to GPU per frame).
 		Helpers::AllocatedBuffer Transforms_src; // host coherent ; mapped
 		Helpers::AllocatedBuffer Transforms;	 // decice local
 		VkDescriptorSet Transforms_descriptors;	 // references Transforms
+
+		// per-pass GPU timestamps (see GPUTimestamps below), VK_NULL_HANDLE when the queue can't write timestamps:
+		VkQueryPool timestamps = VK_NULL_HANDLE;
+		bool timestamps_pending = false; // the last submission wrote queries that haven't been read yet
 	};
 	std::vector<Workspace> workspaces;
 
+	// per-pass GPU times (GPUTimestamps.cpp): render() brackets each pass and pipeline batch with a pair of timestamps in the
+	// workspace's query pool; a workspace's queries are read back when render() reuses it, after its fence has signalled,
+	// so reading never waits and the times are workspaces.size() frames old. Timestamps inside the main render pass
+	// aren't separated by barriers, so neighbouring batches can overlap a little on the GPU.
+	struct GPUTimestamps
+	{
+		enum Pass : uint32_t
+		{
+			Frame,
+			ShadowAtlas,
+			Background,
+			Lambertian,
+			Environment,
+			Mirror,
+			PBR,
+			Lines,
+			PassCount
+		};
+		static constexpr std::array<char const *, PassCount> names{"frame", "shadow_atlas", "background", "lambertian", "environment", "mirror", "pbr", "lines"};
+
+		double ms_per_tick = 0.0;
+		uint64_t valid_mask = 0; // timestampValidBits of the graphics queue family, 0 when timestamps are unsupported
+		bool report = false;	 // print per-pass averages about once a second (--gpu-timings)
+
+		std::array<double, PassCount> last_ms{}; // most recently read frame, negative for passes it didn't record
+		bool has_last = false;
+
+		std::array<double, PassCount> report_ms{}; // sums since the last printed readout
+		std::array<uint32_t, PassCount> report_count{};
+		std::chrono::steady_clock::time_point report_start;
+
+		void create(RTG &, std::vector<Workspace> &);
+		void destroy(RTG &, std::vector<Workspace> &);
+		// reads the workspace's pending queries into last_ms (never waits), returns false if nothing was pending:
+		bool read(RTG &, Workspace &);
+		// at the start of recording: reads the previous frame's queries and resets the pool:
+		void begin_frame(RTG &, Workspace &);
+		void begin(Workspace &, Pass);
+		void end(Workspace &, Pass);
+	} gpu_timestamps;
+
 	//-------------------------------------------------------------------
 	// static scene resources:
 	Helpers::AllocatedBuffer object_vertices;
@@ -310,11 +362,6 @@ struct Render : RTG::Application
 	Helpers::AllocatedImage World_environment_brdf_lut;
 	VkImageView World_environment_brdf_lut_view = VK_NULL_HANDLE;
 
-	Helpers::AllocatedImage World_irradiance;
-	VkImageView World_irradiance_view = VK_NULL_HANDLE;
-	VkImageView World_irradiance_storage_view = VK_NULL_HANDLE;
-	VkSampler World_irradiance_sampler = VK_NULL_HANDLE;
-
 	Helpers::AllocatedImage World_prefilter;
 	VkImageView World_prefilter_view = VK_NULL_HANDLE;
 	VkSampler World_prefilter_sampler = VK_NULL_HANDLE;
@@ -322,9 +369,100 @@ struct Render : RTG::Application
 
 	std::vector<Helpers::AllocatedImage> textures;
 	std::vector<VkImageView> texture_views;
+	// scene texture index -> index into textures / texture_views; constant values share one 1x1 image, and
+	// sources only sampled through a packed ORM texture get no image of their own (NoTextureSlot):
+	static constexpr uint32_t NoTextureSlot = ~uint32_t(0);
+	std::vector<uint32_t> texture_slots;
+	std::vector<uint32_t> material_orm_slots; // PBR material index -> packed roughness (r) / metalness (g) slot
 	VkSampler texture_sampler = VK_NULL_HANDLE;
 	VkDescriptorPool texture_descriptor_pool = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> texture_descriptors;
+	std::vector<uint32_t> material_features; // ShadingFeature bits of each material, shadows excluded
+	std::vector<uint32_t> material_texture_slots(uint32_t material_index) const; // in set2 binding order
+	VkDescriptorSetLayout material_set_layout(uint32_t material_index) const; // set2 layout of the material's pipeline
+	void write_material_descriptors(std::vector<uint32_t> const &material_indices);
+
+	// texture streaming (TextureStreaming.cpp): cached block compressed textures load only their mip tail,
+	// visible instances request finer levels by projected size, and residency is trimmed to --texture-budget.
+	// Nothing waits on the GPU: cache reads run on worker threads, uploads are recorded into the next frame's command
+	// buffer, and replaced images and descriptor sets are freed once the frames that may use them have finished:
+	struct TextureStreaming
+	{
+		static constexpr uint32_t tail_extent = 64;					  // levels this size and smaller are always resident
+		static constexpr uint64_t evict_frames = 120;				  // levels nothing wanted for this many frames are dropped
+		static constexpr size_t upload_bytes_per_frame = size_t(16) << 20; // finer levels stream in over several frames
+		static constexpr uint32_t loads_in_flight = 4;				  // cache reads running on worker threads at once
+
+		struct Residency
+		{
+			std::string cache_path;		 // empty for textures that are always fully resident
+			uint64_t stamp = 0;
+			CompressedTexture header;	 // format, size and level offsets (no data), levels are read from the cache on demand
+			uint32_t tail_level = 0;
+			uint32_t resident_level = 0; // finest level on the GPU
+			uint32_t wanted_level = 0;	 // finest level visible instances asked for this frame
+			uint32_t target_level = 0;	 // finest level plan() wants resident
+			float screen_size = 0.0f;	 // largest projected size (pixels) of a visible instance sampling it this frame
+			uint64_t wanted_frame = 0;	 // last frame every resident level was still wanted
+			// cache read of levels loading_level.. on a worker thread, empty result if the cache was unreadable:
+			std::future<std::optional<CompressedTexture>> loading;
+			uint32_t loading_level = 0;
+		};
+		std::vector<Residency> slots;						 // parallel to Render::textures
+		std::vector<std::vector<uint32_t>> material_slots;	 // material index -> texture slots its descriptors use
+		std::vector<std::vector<uint32_t>> slot_materials;	 // texture slot -> materials whose descriptors use it
+		std::vector<float> material_screen_size;			 // filled from the visible instances by update()
+		std::vector<std::vector<uint32_t>> set_materials;	 // material owning a descriptor set -> every material bound with it
+		size_t budget = 0;									 // bytes, 0 when streaming is off
+		uint64_t frame = 0;
+
+		// new images whose levels the next recorded frame copies in from a staging buffer:
+		struct Upload
+		{
+			uint32_t slot;
+			Helpers::AllocatedBuffer staging;
+			std::vector<size_t> level_offsets;
+		};
+		std::vector<Upload> uploads;
+
+		// resources frames in flight may still use, freed when render() has waited on every workspace since:
+		struct Retired
+		{
+			uint64_t frame; // frames_recorded when retired
+			std::vector<Helpers::AllocatedImage> images;
+			std::vector<VkImageView> views;
+			std::vector<VkDescriptorSet> sets;
+			std::vector<Helpers::AllocatedBuffer> staging;
+		};
+		std::deque<Retired> retired;
+		uint64_t frames_recorded = 0;
+
+		bool enabled() const { return budget != 0; }
+		static size_t bytes(Residency const &residency, uint32_t level); // GPU size of levels level.. of the texture
+		// picks target_level for every streamed slot from this frame's requests, returns the slots that have to change:
+		std::vector<uint32_t> plan();
+	} texture_streaming;
+	void stream_textures(); // applies finished cache reads, then starts the reads texture_streaming.plan() asks for
+	// records pending texture uploads into command_buffer and frees retired resources no frame can use anymore:
+	void record_texture_uploads(VkCommandBuffer command_buffer);
+	void free_retired_textures(bool all); // all: only once the device is idle
+	bool scene_has_shadows = false;
+
+	// pipelines and image based lighting are only created for the material and light types in use:
+	struct Requirements
+	{
+		bool environment_map = false; // ENVIRONMENT cubemap, sampled by every material
+		bool environment_pipeline = false;
+		bool mirror_pipeline = false;
+		bool pbr = false;	  // PBR pipeline plus BRDF_LUT (diffuse lighting is World::IRRADIANCE_SH)
+		bool shadows = false; // shadow atlas pipeline
+	};
+	// creates anything wanted that doesn't exist yet, cheap when nothing is missing; called by the constructor with the
+	// scene's material and light types, and by read_frame_capture() for the instance lists it reads from the capture file:
+	void require(Requirements const &wanted);
+	void create_environment_map();
+	void create_pbr_lighting();
+	void write_world_image_descriptors();
 
 	VkImageView Shadow_atlas_view = VK_NULL_HANDLE;
 	VkSampler shadow_sampler = VK_NULL_HANDLE;
@@ -415,6 +553,52 @@ struct Render : RTG::Application
 
 	std::vector<std::array<std::vector<uint32_t>, 4>> in_spot_light_instances;
 
+	SceneTraversal scene_traversal; // update()'s walk of the scene hierarchy, kept so its arrays are reused
+
+	// per-frame counters (FrameStats.cpp): update() fills in traversal and culling, render() the commands it records and
+	// the bytes it copies out of the workspace's *_src buffers. Benchmark mode adds them to its statistics (stats_* series),
+	// the I key toggles a console readout of the latest frame about once a second.
+	struct FrameStats
+	{
+		enum Pipeline : uint32_t
+		{
+			Shadow,
+			Background,
+			Lambertian,
+			Environment,
+			Mirror,
+			PBR,
+			Lines,
+			PipelineCount
+		};
+		static constexpr std::array<char const *, PipelineCount> pipeline_names{"shadow", "background", "lambertian", "environment", "mirror", "pbr", "lines"};
+
+		// from update():
+		uint32_t instances_visited = 0;				  // mesh instances the traversal reached
+		uint32_t instances_culled_camera = 0;		  // outside the culling camera's frustum (0 with culling off)
+		std::vector<uint32_t> instances_culled_light; // per shadow-casting spot light, outside its frustum
+
+		// from render():
+		std::array<uint32_t, PipelineCount> draws{};
+		uint32_t pipeline_binds = 0;
+		uint32_t descriptor_set_binds = 0; // vkCmdBindDescriptorSets calls
+		uint64_t triangles = 0;
+		uint32_t shadow_regions = 0;
+		uint64_t upload_bytes = 0;
+
+		void draw(Pipeline pipeline, uint32_t vertices)
+		{
+			draws[pipeline] += 1;
+			if (pipeline != Lines)
+				triangles += vertices / 3;
+		}
+		void reset_render();
+		void add_to(Benchmark &) const;
+		void print(std::ostream &) const;
+	} frame_stats;
+	bool show_frame_stats = false;
+	std::chrono::steady_clock::time_point frame_stats_printed;
+
 	std::vector<ObjectsPipeline::SunLight> sun_lights;
 	std::vector<ObjectsPipeline::SphereLight> sphere_lights;
 	std::vector<ObjectsPipeline::SpotLight> spot_lights;
@@ -423,24 +607,63 @@ struct Render : RTG::Application
 	uint64_t total_shadow_size = 0;
 	Helpers::AllocatedImage shadow_atlas_image;
 
-	struct ShadowAtlas
+	using ShadowAtlas = ::ShadowAtlas; // ShadowAtlas.hpp
+	ShadowAtlas shadow_atlas;
+
+	// froxel grid of sphere and spot lights, rebuilt every update so fragments only shade lights that can reach them
+	struct LightClusters
 	{
-		uint32_t size;
-		struct Region
+		// must match cluster.glsl:
+		static constexpr uint32_t x_count = 16;
+		static constexpr uint32_t y_count = 9;
+		static constexpr uint32_t z_count = 24;
+		static constexpr uint32_t cluster_count = x_count * y_count * z_count;
+
+		struct Range
 		{
-			uint32_t x;
-			uint32_t y;
-			uint32_t size;
+			uint32_t sphere_first = 0;
+			uint32_t sphere_count = 0;
+			uint32_t spot_first = 0;
+			uint32_t spot_count = 0;
 		};
-		std::vector<Region> regions;
+		static_assert(sizeof(Range) == 16, "Range matches uvec4.");
+
+		std::vector<Range> ranges;	   // one per cluster, x fastest then y then depth slice
+		std::vector<uint32_t> indices; // light indices referenced by ranges
+
+		float z_near = 0.1f;
+		float log_scale = 1.0f;
 
-		// spot lights must be sorted
-		void update_regions(std::vector<Render::ObjectsPipeline::SpotLight> &spot_lights, std::vector<Scene::LightInstance> &sorted_indices, uint8_t reduction);
-		void debug();
-		static glm::mat4 calculate_shadow_atlas_matrix(const glm::mat4 &light_from_world, const Region &region, const int atlas_size);
+		void update(glm::mat4 const &clip_from_world, float near, std::vector<ObjectsPipeline::SphereLight> const &sphere_lights, std::vector<ObjectsPipeline::SpotLight> const &spot_lights);
+	} light_clusters;
+	float camera_near = 0.1f; // near plane of the camera used for CLIP_FROM_WORLD
 
-		ShadowAtlas(uint32_t size_) : size(size_) {};
-	} shadow_atlas;
+	// everything update() leaves for render() -- camera, World, lights, atlas regions, light clusters and the culled
+	// instance lists -- written to / read from a binary file (FrameCapture.cpp), so a replay records exactly the same
+	// GPU work every frame without animating, traversing or culling the scene:
+	struct FrameCapture
+	{
+		static constexpr char const *extension = ".nkframe";
+
+		struct Header
+		{
+			char magic[4] = {'n', 'k', 'f', 'r'};
+			uint32_t version = 1;
+			// the scene the capture was made with, replays against any other scene would index garbage:
+			uint32_t meshes = 0;
+			uint32_t materials = 0;
+			uint32_t vertices_count = 0;
+			uint32_t lights = 0;
+			uint32_t shadowed_spot_lights = 0;
+			uint32_t camera_mode = 0;
+		};
+		static_assert(sizeof(Header) == 4 + 4 * 7, "Header is packed.");
+	};
+	// throw on failure:
+	void write_frame_capture(std::string const &path) const;
+	void read_frame_capture(std::string const &path);
+	bool capture_pending = false; // the next render() writes rtg.configuration.capture_out
+	bool replaying = false;		  // update() leaves the captured frame alone
 	//-------------------------------------
 	void set_animation_time(float t);
 
@@ -448,4 +671,7 @@ struct Render : RTG::Application
 	// Rendering function, uses all the resources above to queue work to draw a frame:
 
 	virtual void render(RTG &, RTG::RenderParams const &) override;
+
+	// per-pass GPU times and frame_stats of the benchmark frame that just finished:
+	virtual void add_benchmark_stats(uint32_t workspace_index, Benchmark &) override;
 };
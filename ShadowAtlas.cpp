@@ -1,8 +1,8 @@
-#include "Render.hpp"
+#include "ShadowAtlas.hpp"
 #include <iostream>
 
 // referenced https://lisyarus.github.io/blog/posts/texture-packing.html
-void Render::ShadowAtlas::update_regions(std::vector<Render::ObjectsPipeline::SpotLight> &spot_lights, std::vector<Scene::LightInstance> &sorted_indices, uint8_t reduction)
+void ShadowAtlas::update_regions(std::vector<SpotLight> &spot_lights, std::vector<Scene::LightInstance> &sorted_indices, uint8_t reduction)
 {
     regions.clear();
     regions.resize(spot_lights.size());
@@ -40,7 +40,7 @@ void Render::ShadowAtlas::update_regions(std::vector<Render::ObjectsPipeline::Sp
     }
 }
 
-void Render::ShadowAtlas::debug()
+void ShadowAtlas::debug()
 {
     std::cout << "\nShadow Atlas, Size: " << size << std::endl;
     for (const auto &region : regions)
@@ -51,7 +51,7 @@ void Render::ShadowAtlas::debug()
     }
 }
 
-glm::mat4 Render::ShadowAtlas::calculate_shadow_atlas_matrix(const glm::mat4 &light_from_world, const Region &region, const int atlas_size)
+glm::mat4 ShadowAtlas::calculate_shadow_atlas_matrix(const glm::mat4 &light_from_world, const Region &region, const int atlas_size)
 {
     int shadow_size = region.size;
     int shadow_x = region.x;
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Lights.hpp"
+#include "scene.hpp"
+#include "glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// packs every shadowed spot light's shadow map into one square atlas texture (Render::shadow_atlas):
+struct ShadowAtlas
+{
+	uint32_t size;
+	struct Region
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t size;
+	};
+	std::vector<Region> regions;
+
+	// spot lights must be sorted
+	void update_regions(std::vector<SpotLight> &spot_lights, std::vector<Scene::LightInstance> &sorted_indices, uint8_t reduction);
+	void debug();
+	static glm::mat4 calculate_shadow_atlas_matrix(const glm::mat4 &light_from_world, const Region &region, const int atlas_size);
+
+	ShadowAtlas(uint32_t size_) : size(size_) {};
+};
@@ -148,7 +148,7 @@ void Render::ShadowAtlasPipeline::create(RTG &rtg, VkRenderPass render_pass, uin
 			.subpass = subpass,
         };
 
-        VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+        VK(vkCreateGraphicsPipelines(rtg.device, rtg.pipeline_cache, 1, &create_info, nullptr, &handle));
 
         //modules no longer needed now that the pipeline is created
         vkDestroyShaderModule(rtg.device, frag_module, nullptr);
@@ -0,0 +1,184 @@
+#include "SphericalHarmonics.hpp"
+
+#include "rgbe.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+std::array<float, 9> SH9::basis(glm::vec3 d)
+{
+	return {
+		0.282095f,
+		0.488603f * d.y,
+		0.488603f * d.z,
+		0.488603f * d.x,
+		1.092548f * d.x * d.y,
+		1.092548f * d.y * d.z,
+		0.315392f * (3.0f * d.z * d.z - 1.0f),
+		1.092548f * d.x * d.z,
+		0.546274f * (d.x * d.x - d.y * d.y),
+	};
+}
+
+glm::vec3 SH9::texel_direction(uint32_t face, uint32_t x, uint32_t y, uint32_t size)
+{
+	// same mapping as the cube tool's compute shaders:
+	float u = (float(x) + 0.5f) / float(size) * 2.0f - 1.0f;
+	float v = (float(y) + 0.5f) / float(size) * 2.0f - 1.0f;
+	glm::vec3 dir;
+	switch (face)
+	{
+	case 0: dir = glm::vec3(1.0f, -v, -u); break;
+	case 1: dir = glm::vec3(-1.0f, -v, u); break;
+	case 2: dir = glm::vec3(u, 1.0f, v); break;
+	case 3: dir = glm::vec3(u, -1.0f, -v); break;
+	case 4: dir = glm::vec3(u, -v, 1.0f); break;
+	default: dir = glm::vec3(-u, -v, -1.0f); break;
+	}
+	return glm::normalize(dir);
+}
+
+float SH9::texel_solid_angle(uint32_t x, uint32_t y, uint32_t size)
+{
+	// solid angle subtended by the face rectangle from (0,0) to (s,t), differenced over the texel's corners:
+	auto area = [](float s, float t)
+	{ return std::atan2(s * t, std::sqrt(s * s + t * t + 1.0f)); };
+	float u0 = 2.0f * float(x) / float(size) - 1.0f;
+	float v0 = 2.0f * float(y) / float(size) - 1.0f;
+	float u1 = 2.0f * float(x + 1) / float(size) - 1.0f;
+	float v1 = 2.0f * float(y + 1) / float(size) - 1.0f;
+	return area(u0, v0) - area(u0, v1) - area(u1, v0) + area(u1, v1);
+}
+
+SH9 SH9::from_radiance_projection(std::array<double, 27> const &projection)
+{
+	// clamped cosine convolution (Ramamoorthi and Hanrahan 2001) is pi, 2pi/3, pi/4 per band, the / pi is folded in:
+	constexpr float band_scale[3] = {1.0f, 2.0f / 3.0f, 1.0f / 4.0f};
+	SH9 sh;
+	for (uint32_t i = 0; i < 9; ++i)
+	{
+		float scale = band_scale[i == 0 ? 0 : (i < 4 ? 1 : 2)];
+		sh.coefficients[i] = scale * glm::vec3(float(projection[3 * i + 0]), float(projection[3 * i + 1]), float(projection[3 * i + 2]));
+	}
+	return sh;
+}
+
+// sums radiance(face, index) * basis * solid angle over every texel, rows split across hardware threads:
+template <typename Radiance>
+static SH9 project_rows(uint32_t size, Radiance const &radiance)
+{
+	uint32_t rows = 6 * size;
+	uint32_t threads = std::max(1u, std::min(std::thread::hardware_concurrency(), rows));
+	uint32_t per_thread = (rows + threads - 1) / threads;
+
+	// solid angles repeat on every face, compute them once:
+	std::vector<float> solid_angles(size_t(size) * size);
+	for (uint32_t y = 0; y < size; ++y)
+		for (uint32_t x = 0; x < size; ++x)
+			solid_angles[size_t(y) * size + x] = SH9::texel_solid_angle(x, y, size);
+
+	std::vector<std::future<std::array<double, 27>>> jobs;
+	for (uint32_t begin = 0; begin < rows; begin += per_thread)
+	{
+		uint32_t end = std::min(rows, begin + per_thread);
+		jobs.emplace_back(std::async(std::launch::async, [&, begin, end]()
+									 {
+			std::array<double, 27> sum{};
+			for (uint32_t row = begin; row < end; ++row) {
+				uint32_t face = row / size;
+				uint32_t y = row % size;
+				std::array<float, 27> row_sum{}; // float within a row, double across rows
+				for (uint32_t x = 0; x < size; ++x) {
+					size_t index = size_t(y) * size + x;
+					glm::vec3 c = radiance(face, index) * solid_angles[index];
+					std::array<float, 9> b = SH9::basis(SH9::texel_direction(face, x, y, size));
+					for (uint32_t i = 0; i < 9; ++i) {
+						row_sum[3 * i + 0] += c.r * b[i];
+						row_sum[3 * i + 1] += c.g * b[i];
+						row_sum[3 * i + 2] += c.b * b[i];
+					}
+				}
+				for (uint32_t i = 0; i < 27; ++i) sum[i] += row_sum[i];
+			}
+			return sum; }));
+	}
+
+	std::array<double, 27> total{};
+	for (auto &job : jobs)
+	{
+		std::array<double, 27> sum = job.get();
+		for (uint32_t i = 0; i < 27; ++i)
+			total[i] += sum[i];
+	}
+	return SH9::from_radiance_projection(total);
+}
+
+SH9 SH9::project(std::array<glm::vec4 const *, 6> const &faces, uint32_t size)
+{
+	return project_rows(size, [&](uint32_t face, size_t index)
+						{ return glm::vec3(faces[face][index]); });
+}
+
+SH9 SH9::project_E5B9G9R9(uint32_t const *faces, uint32_t size)
+{
+	size_t face_texels = size_t(size) * size;
+	return project_rows(size, [&](uint32_t face, size_t index)
+						{ return E5B9G9R9_to_linear(faces[face * face_texels + index]); });
+}
+
+glm::vec3 SH9::evaluate(glm::vec3 normal) const
+{
+	std::array<float, 9> b = basis(normal);
+	glm::vec3 result(0.0f);
+	for (uint32_t i = 0; i < 9; ++i)
+		result += coefficients[i] * b[i];
+	return result;
+}
+
+struct SHFileHeader
+{
+	char magic[4] = {'n', 'k', 's', 'h'};
+	uint32_t version = 1;
+	// followed by 9 rgb float triples
+};
+
+bool SH9::load(std::string const &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	SHFileHeader header;
+	if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+		return false;
+	if (std::memcmp(header.magic, SHFileHeader().magic, 4) != 0 || header.version != SHFileHeader().version)
+		return false;
+	std::array<float, 27> values;
+	if (!file.read(reinterpret_cast<char *>(values.data()), sizeof(values)))
+		return false;
+	for (uint32_t i = 0; i < 9; ++i)
+		coefficients[i] = glm::vec3(values[3 * i + 0], values[3 * i + 1], values[3 * i + 2]);
+	return true;
+}
+
+void SH9::save(std::string const &path) const
+{
+	std::array<float, 27> values;
+	for (uint32_t i = 0; i < 9; ++i)
+	{
+		values[3 * i + 0] = coefficients[i].r;
+		values[3 * i + 1] = coefficients[i].g;
+		values[3 * i + 2] = coefficients[i].b;
+	}
+	SHFileHeader header;
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+	file.write(reinterpret_cast<char const *>(values.data()), sizeof(values));
+	if (!file)
+		throw std::runtime_error("Failed to write spherical harmonics '" + path + "'.");
+}
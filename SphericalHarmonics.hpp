@@ -0,0 +1,34 @@
+#pragma once
+
+#include "glm.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// diffuse image based lighting as 9 spherical harmonics coefficients (bands 0..2) per color channel
+// coefficients are already convolved with the clamped cosine and divided by pi, so evaluating them at a normal gives the
+// cosine-weighted mean radiance an irradiance cubemap used to store (lambert_irradiance.comp); pbr.frag's sh_irradiance() evaluates them
+struct SH9
+{
+	std::array<glm::vec3, 9> coefficients{};
+
+	// real SH basis in the order y00, y1-1, y10, y11, y2-2, y2-1, y20, y21, y22 (direction must be normalized):
+	static std::array<float, 9> basis(glm::vec3 direction);
+	// direction through the center of texel (x, y) of a cube face, Vulkan face order and orientation (+X, -X, +Y, -Y, +Z, -Z):
+	static glm::vec3 texel_direction(uint32_t face, uint32_t x, uint32_t y, uint32_t size);
+	static float texel_solid_angle(uint32_t x, uint32_t y, uint32_t size);
+
+	// radiance projected onto the basis (sum of radiance * basis * solid angle), 3 channels per coefficient -> convolved coefficients:
+	static SH9 from_radiance_projection(std::array<double, 27> const &projection);
+
+	// multi-threaded projection of cubemap level 0, faces in order, each size * size texels, row-major:
+	static SH9 project(std::array<glm::vec4 const *, 6> const &faces, uint32_t size);
+	static SH9 project_E5B9G9R9(uint32_t const *faces, uint32_t size); // faces back to back, as in a PackedCubemap's level 0
+
+	glm::vec3 evaluate(glm::vec3 normal) const;
+
+	// small binary file written by the cube tool (--sh), load returns false if missing or malformed:
+	bool load(std::string const &path);
+	void save(std::string const &path) const; // throws on failure
+};
@@ -0,0 +1,252 @@
+#include "StartupProfile.hpp"
+
+#include "json_string.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> StartupProfile::collecting{false};
+
+namespace
+{
+	struct PhaseRecord
+	{
+		char const *name;
+		uint32_t depth;
+		StartupProfile::Clock::time_point begin;
+		double ms = -1.0; // still open
+		uint64_t bytes = 0;
+	};
+
+	struct WorkTotal
+	{
+		double ms = 0.0;
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+	};
+
+	struct AssetRecord
+	{
+		char const *kind;
+		std::string name;
+		double ms;
+		uint64_t bytes;
+	};
+
+	struct Profile
+	{
+		std::mutex mutex;
+		StartupProfile::Clock::time_point begin, end;
+		std::vector<PhaseRecord> phases; // in the order they started
+		uint32_t open_phases = 0;
+		std::vector<std::pair<char const *, WorkTotal>> work; // in the order first seen
+		std::vector<AssetRecord> assets;
+	};
+
+	Profile &profile()
+	{
+		static Profile profile;
+		return profile;
+	}
+
+	double ms_since(StartupProfile::Clock::time_point begin)
+	{
+		return std::chrono::duration<double, std::milli>(StartupProfile::Clock::now() - begin).count();
+	}
+
+	double total_ms(Profile const &p)
+	{
+		return std::chrono::duration<double, std::milli>(p.end - p.begin).count();
+	}
+
+	// assets by kind (in the order the kinds were first seen), slowest first:
+	std::vector<std::pair<char const *, std::vector<AssetRecord const *>>> assets_by_kind(Profile const &p)
+	{
+		std::vector<std::pair<char const *, std::vector<AssetRecord const *>>> ret;
+		for (AssetRecord const &asset : p.assets)
+		{
+			auto found = std::find_if(ret.begin(), ret.end(), [&](auto const &kind)
+									  { return std::string(kind.first) == asset.kind; });
+			if (found == ret.end())
+				found = ret.emplace(ret.end(), asset.kind, std::vector<AssetRecord const *>());
+			found->second.emplace_back(&asset);
+		}
+		for (auto &kind : ret)
+		{
+			std::stable_sort(kind.second.begin(), kind.second.end(), [](AssetRecord const *a, AssetRecord const *b)
+							 { return a->ms > b->ms; });
+		}
+		return ret;
+	}
+
+	std::string megabytes(uint64_t bytes)
+	{
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(2) << double(bytes) / double(1 << 20) << " MiB";
+		return out.str();
+	}
+}
+
+void StartupProfile::start()
+{
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	p.begin = Clock::now();
+	collecting.store(true, std::memory_order_relaxed);
+}
+
+void StartupProfile::finish()
+{
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	p.end = Clock::now();
+	collecting.store(false, std::memory_order_relaxed);
+}
+
+StartupProfile::Phase::Phase(char const *name) : index(0), active(enabled())
+{
+	if (!active)
+		return;
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	index = p.phases.size();
+	p.phases.emplace_back(PhaseRecord{.name = name, .depth = p.open_phases, .begin = Clock::now()});
+	p.open_phases += 1;
+}
+
+void StartupProfile::Phase::end()
+{
+	if (!active)
+		return;
+	active = false;
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	PhaseRecord &record = p.phases[index];
+	record.ms = ms_since(record.begin);
+	record.bytes = bytes;
+	p.open_phases -= 1;
+}
+
+void StartupProfile::Work::end()
+{
+	if (!active)
+		return;
+	active = false;
+	double ms = ms_since(begin);
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	auto found = std::find_if(p.work.begin(), p.work.end(), [&](auto const &work)
+							  { return std::string(work.first) == name; });
+	if (found == p.work.end())
+		found = p.work.emplace(p.work.end(), name, WorkTotal());
+	found->second.ms += ms;
+	found->second.count += 1;
+	found->second.bytes += bytes;
+}
+
+void StartupProfile::Asset::end()
+{
+	if (!active)
+		return;
+	active = false;
+	double ms = ms_since(begin);
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	p.assets.emplace_back(AssetRecord{.kind = kind, .name = std::move(name), .ms = ms, .bytes = bytes});
+}
+
+void StartupProfile::print(std::ostream &out, size_t slowest)
+{
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+
+	out << "Startup took " << total_ms(p) << " ms:\n";
+	for (PhaseRecord const &phase : p.phases)
+	{
+		std::string name = std::string(2 * phase.depth, ' ') + phase.name;
+		out << "  " << std::left << std::setw(48) << name << std::right << std::setw(10) << phase.ms << " ms";
+		if (phase.bytes != 0)
+			out << "  " << megabytes(phase.bytes);
+		out << "\n";
+	}
+
+	if (!p.work.empty())
+	{
+		out << "Work, summed over phases and threads:\n";
+		for (auto const &[name, work] : p.work)
+		{
+			out << "  " << std::left << std::setw(48) << name << std::right << std::setw(10) << work.ms << " ms  " << work.count << "x";
+			if (work.bytes != 0)
+				out << "  " << megabytes(work.bytes);
+			out << "\n";
+		}
+	}
+
+	for (auto const &[kind, assets] : assets_by_kind(p))
+	{
+		double ms = 0.0;
+		uint64_t bytes = 0;
+		for (AssetRecord const *asset : assets)
+		{
+			ms += asset->ms;
+			bytes += asset->bytes;
+		}
+		out << "Slowest " << std::min(slowest, assets.size()) << " of " << assets.size() << " " << kind << " assets (" << ms << " ms, " << megabytes(bytes) << " in total):\n";
+		for (size_t i = 0; i < assets.size() && i < slowest; ++i)
+		{
+			out << "  " << std::setw(10) << assets[i]->ms << " ms  " << std::setw(12) << megabytes(assets[i]->bytes) << "  " << assets[i]->name << "\n";
+		}
+	}
+	out.flush();
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void StartupProfile::write(std::string const &path)
+{
+	Profile &p = profile();
+	std::lock_guard<std::mutex> lock(p.mutex);
+
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("Failed to open startup report '" + path + "'.");
+	file << std::setprecision(9);
+
+	file << "{\n\t\"total_ms\": " << total_ms(p) << ",\n\t\"phases\": [";
+	for (size_t i = 0; i < p.phases.size(); ++i)
+	{
+		PhaseRecord const &phase = p.phases[i];
+		file << (i ? ",\n" : "\n") << "\t\t{ \"name\": " << json_string(phase.name) << ", \"depth\": " << phase.depth << ", \"ms\": " << phase.ms << ", \"bytes\": " << phase.bytes << " }";
+	}
+	file << "\n\t],\n\t\"work\": [";
+	for (size_t i = 0; i < p.work.size(); ++i)
+	{
+		file << (i ? ",\n" : "\n") << "\t\t{ \"name\": " << json_string(p.work[i].first) << ", \"ms\": " << p.work[i].second.ms << ", \"count\": " << p.work[i].second.count << ", \"bytes\": " << p.work[i].second.bytes << " }";
+	}
+	file << "\n\t],\n\t\"assets\": {";
+	bool first_kind = true;
+	for (auto const &[kind, assets] : assets_by_kind(p))
+	{
+		file << (first_kind ? "\n" : ",\n") << "\t\t" << json_string(kind) << ": [";
+		for (size_t i = 0; i < assets.size(); ++i)
+		{
+			file << (i ? ",\n" : "\n") << "\t\t\t{ \"name\": " << json_string(assets[i]->name) << ", \"ms\": " << assets[i]->ms << ", \"bytes\": " << assets[i]->bytes << " }";
+		}
+		file << "\n\t\t]";
+		first_kind = false;
+	}
+	file << "\n\t}\n}\n";
+
+	if (!file)
+		throw std::runtime_error("Failed to write startup report '" + path + "'.");
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// wall time and bytes of everything between launch and the first frame, as a report (`--startup-report` prints it,
+// `--startup-report-out <file.json>` writes it):
+//   phases: nested steps of the main thread (Scene::load, RTG::RTG, Render::Render textures, ...)
+//   work:   the same kind of work spread over phases, summed (texture decode, upload, ...)
+//   assets: one mesh, texture, environment or pipeline each, listed slowest first
+// while not collecting a scope costs one relaxed atomic load; names and kinds must outlive the report (string literals)
+struct StartupProfile
+{
+	static void start();
+	static bool enabled() { return collecting.load(std::memory_order_relaxed); }
+	// stop collecting, startup is over (RTG::run calls it once the first frame is rendered):
+	static void finish();
+	// phases and work in full, the `slowest` slowest assets of each kind:
+	static void print(std::ostream &, size_t slowest = 10);
+	static void write(std::string const &path); // JSON, every asset; throws on failure
+
+	using Clock = std::chrono::steady_clock;
+
+	// a step of the main thread, phases started while it is open are nested under it:
+	struct Phase
+	{
+		Phase(char const *name);
+		~Phase() { end(); }
+		void end();
+		Phase(Phase const &) = delete;
+		Phase &operator=(Phase const &) = delete;
+
+		uint64_t bytes = 0; // processed by the phase (what that means is up to the phase), 0 if not meaningful
+		size_t index;
+		bool active;
+	};
+
+	// work of one kind that happens in many places (and threads), summed by name:
+	struct Work
+	{
+		Work(char const *name_) : name(name_), active(enabled()), begin(active ? Clock::now() : Clock::time_point()) { }
+		~Work() { end(); }
+		void end();
+		Work(Work const &) = delete;
+		Work &operator=(Work const &) = delete;
+
+		uint64_t bytes = 0;
+		char const *name;
+		bool active;
+		Clock::time_point begin;
+	};
+
+	// loading one asset, from any thread:
+	struct Asset
+	{
+		Asset(char const *kind_, std::string const &name_) : kind(kind_), active(enabled()), begin(active ? Clock::now() : Clock::time_point())
+		{
+			if (active)
+				name = name_;
+		}
+		~Asset() { end(); }
+		void end();
+		Asset(Asset const &) = delete;
+		Asset &operator=(Asset const &) = delete;
+
+		uint64_t bytes = 0; // the asset's source data
+		char const *kind;
+		std::string name;
+		bool active;
+		Clock::time_point begin;
+	};
+
+	static std::atomic<bool> collecting;
+};
@@ -0,0 +1,501 @@
+#include "TextureCompression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+// bump when the encoder changes, so stale cache files get rebuilt:
+static constexpr uint32_t encoder_version = 1;
+
+struct CacheFileHeader
+{
+	char magic[4] = {'n', 'k', 't', 'x'};
+	uint32_t version = encoder_version;
+	uint64_t stamp = 0;
+	uint32_t vk_format = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t level_count = 0;
+	uint64_t data_size = 0;
+	// followed by level_count uint64_t level offsets, then data_size bytes of blocks
+};
+static_assert(sizeof(CacheFileHeader) == 40, "CacheFileHeader is tightly packed.");
+
+// runs fn(begin, end) over [0, count) split across hardware threads:
+template <typename Fn>
+static void parallel_for(uint32_t count, Fn const &fn)
+{
+	uint32_t threads = std::max(1u, std::min(std::thread::hardware_concurrency(), count));
+	uint32_t per_thread = (count + threads - 1) / threads;
+	std::vector<std::future<void>> jobs;
+	for (uint32_t begin = 0; begin < count; begin += per_thread)
+	{
+		jobs.emplace_back(std::async(std::launch::async, [&fn, begin, end = std::min(count, begin + per_thread)]()
+									 { fn(begin, end); }));
+	}
+	for (std::future<void> &job : jobs)
+	{
+		job.get();
+	}
+}
+
+static uint32_t block_bytes(VkFormat format)
+{
+	return format == VK_FORMAT_BC5_UNORM_BLOCK ? 16 : 8;
+}
+
+//--------------------------------------------
+// mip chain:
+
+static float srgb_to_linear(uint8_t value)
+{
+	static std::array<float, 256> const table = []()
+	{
+		std::array<float, 256> ret;
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			float c = i / 255.0f;
+			ret[i] = (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f));
+		}
+		return ret;
+	}();
+	return table[value];
+}
+
+static uint8_t linear_to_srgb(float value)
+{
+	value = std::clamp(value, 0.0f, 1.0f);
+	float c = (value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f);
+	return uint8_t(c * 255.0f + 0.5f);
+}
+
+// 2x2 box filter (edge texels repeat for odd sizes); sRGB colors average in linear light, normals are renormalized:
+static std::vector<uint8_t> downsample(uint8_t const *src, uint32_t width, uint32_t height, uint32_t channels, CompressedTexture::Role role, bool srgb)
+{
+	uint32_t next_width = std::max(1u, width / 2);
+	uint32_t next_height = std::max(1u, height / 2);
+	std::vector<uint8_t> dst(size_t(next_width) * next_height * channels);
+
+	parallel_for(next_height, [&](uint32_t y_begin, uint32_t y_end)
+				 {
+		for (uint32_t y = y_begin; y < y_end; ++y) {
+			uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+			for (uint32_t x = 0; x < next_width; ++x) {
+				uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+				std::array<uint8_t const *, 4> taps{
+					src + (size_t(y0) * width + x0) * channels,
+					src + (size_t(y0) * width + x1) * channels,
+					src + (size_t(y1) * width + x0) * channels,
+					src + (size_t(y1) * width + x1) * channels,
+				};
+				uint8_t *out = dst.data() + (size_t(y) * next_width + x) * channels;
+
+				if (role == CompressedTexture::Normal) {
+					float n[3] = {0.0f, 0.0f, 0.0f};
+					for (uint8_t const *tap : taps) {
+						for (uint32_t c = 0; c < 3; ++c) n[c] += tap[c] / 127.5f - 1.0f;
+					}
+					float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					for (uint32_t c = 0; c < 3; ++c) {
+						float v = (length > 0.0f ? n[c] / length : (c == 2 ? 1.0f : 0.0f));
+						out[c] = uint8_t(std::clamp(v * 127.5f + 127.5f, 0.0f, 255.0f) + 0.5f);
+					}
+					out[3] = 255;
+				} else {
+					for (uint32_t c = 0; c < channels; ++c) {
+						if (srgb && c < 3) {
+							float sum = 0.0f;
+							for (uint8_t const *tap : taps) sum += srgb_to_linear(tap[c]);
+							out[c] = linear_to_srgb(sum * 0.25f);
+						} else {
+							uint32_t sum = 2;
+							for (uint8_t const *tap : taps) sum += tap[c];
+							out[c] = uint8_t(sum / 4);
+						}
+					}
+				}
+			}
+		} });
+
+	return dst;
+}
+
+//--------------------------------------------
+// block encoders:
+
+static uint16_t pack_565(float const rgb[3])
+{
+	uint32_t r = uint32_t(std::clamp(rgb[0], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	uint32_t g = uint32_t(std::clamp(rgb[1], 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+	uint32_t b = uint32_t(std::clamp(rgb[2], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t c, int32_t rgb[3])
+{
+	int32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 (four color mode): endpoints are the extremes of the block's colors along their principal axis
+static void encode_bc1(uint8_t const texels[16][4], uint8_t *out)
+{
+	float mean[3] = {0.0f, 0.0f, 0.0f};
+	for (uint32_t i = 0; i < 16; ++i)
+		for (uint32_t c = 0; c < 3; ++c)
+			mean[c] += texels[i][c] / 16.0f;
+
+	float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f}; // rr rg rb gg gb bb
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+		cov[0] += d[0] * d[0];
+		cov[1] += d[0] * d[1];
+		cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1];
+		cov[4] += d[1] * d[2];
+		cov[5] += d[2] * d[2];
+	}
+
+	float axis[3] = {1.0f, 1.0f, 1.0f};
+	for (uint32_t iter = 0; iter < 8; ++iter)
+	{ // power iteration
+		float next[3] = {
+			cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+			cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+			cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+		};
+		float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1.0e-6f)
+			break; // flat block, any axis works
+		for (uint32_t c = 0; c < 3; ++c)
+			axis[c] = next[c] / length;
+	}
+
+	float t_min = std::numeric_limits<float>::infinity();
+	float t_max = -std::numeric_limits<float>::infinity();
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+		t_min = std::min(t_min, t);
+		t_max = std::max(t_max, t);
+	}
+	float end0[3], end1[3];
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		end0[c] = mean[c] + axis[c] * t_max;
+		end1[c] = mean[c] + axis[c] * t_min;
+	}
+
+	uint16_t c0 = pack_565(end0);
+	uint16_t c1 = pack_565(end1);
+	if (c0 < c1)
+		std::swap(c0, c1); // c0 > c1 selects four color mode
+
+	uint32_t indices = 0;
+	if (c0 != c1)
+	{
+		int32_t palette[4][3];
+		unpack_565(c0, palette[0]);
+		unpack_565(c1, palette[1]);
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint32_t best = 0;
+			int32_t best_distance = std::numeric_limits<int32_t>::max();
+			for (uint32_t p = 0; p < 4; ++p)
+			{
+				int32_t dr = texels[i][0] - palette[p][0], dg = texels[i][1] - palette[p][1], db = texels[i][2] - palette[p][2];
+				int32_t distance = dr * dr + dg * dg + db * db;
+				if (distance < best_distance)
+				{
+					best_distance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+
+	out[0] = uint8_t(c0 & 0xff);
+	out[1] = uint8_t(c0 >> 8);
+	out[2] = uint8_t(c1 & 0xff);
+	out[3] = uint8_t(c1 >> 8);
+	for (uint32_t b = 0; b < 4; ++b)
+		out[4 + b] = uint8_t(indices >> (8 * b));
+}
+
+// BC4 (eight value mode): endpoints are the block's min and max
+static void encode_bc4(uint8_t const values[16], uint8_t *out)
+{
+	uint8_t hi = *std::max_element(values, values + 16);
+	uint8_t lo = *std::min_element(values, values + 16);
+
+	uint64_t indices = 0;
+	if (hi != lo)
+	{
+		int32_t palette[8] = {hi, lo};
+		for (int32_t i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * hi + i * lo + 3) / 7;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint64_t best = 0;
+			int32_t best_distance = 256;
+			for (uint32_t p = 0; p < 8; ++p)
+			{
+				int32_t distance = std::abs(int32_t(values[i]) - palette[p]);
+				if (distance < best_distance)
+				{
+					best_distance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (3 * i);
+		}
+	}
+
+	out[0] = hi;
+	out[1] = lo;
+	for (uint32_t b = 0; b < 6; ++b)
+		out[2 + b] = uint8_t(indices >> (8 * b));
+}
+
+static void encode_level(uint8_t const *pixels, uint32_t width, uint32_t height, uint32_t channels, VkFormat format, uint8_t *out)
+{
+	uint32_t blocks_x = (width + 3) / 4;
+	uint32_t blocks_y = (height + 3) / 4;
+	uint32_t bytes = block_bytes(format);
+
+	parallel_for(blocks_y, [&](uint32_t by_begin, uint32_t by_end)
+				 {
+		uint8_t texels[16][4];
+		for (uint32_t by = by_begin; by < by_end; ++by) {
+			for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+				// gather the block, repeating edge texels past the image border:
+				for (uint32_t i = 0; i < 16; ++i) {
+					uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+					uint32_t y = std::min(by * 4 + i / 4, height - 1);
+					uint8_t const *texel = pixels + (size_t(y) * width + x) * channels;
+					for (uint32_t c = 0; c < 4; ++c) texels[i][c] = (c < channels ? texel[c] : 0);
+				}
+				uint8_t *block = out + (size_t(by) * blocks_x + bx) * bytes;
+				if (format == VK_FORMAT_BC5_UNORM_BLOCK) {
+					uint8_t red[16], green[16];
+					for (uint32_t i = 0; i < 16; ++i) {
+						red[i] = texels[i][0];
+						green[i] = texels[i][1];
+					}
+					encode_bc4(red, block);
+					encode_bc4(green, block + 8);
+				} else if (format == VK_FORMAT_BC4_UNORM_BLOCK) {
+					uint8_t red[16];
+					for (uint32_t i = 0; i < 16; ++i) red[i] = texels[i][0];
+					encode_bc4(red, block);
+				} else {
+					encode_bc1(texels, block);
+				}
+			}
+		} });
+}
+
+//--------------------------------------------
+
+VkFormat CompressedTexture::format_for(Role role, bool srgb)
+{
+	if (role == Normal || role == Pair)
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	if (role == Scalar)
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+}
+
+char const *CompressedTexture::format_name(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		return "bc1-srgb";
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		return "bc1";
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return "bc4";
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		return "bc5";
+	default:
+		return "unknown";
+	}
+}
+
+CompressedTexture CompressedTexture::encode(uint8_t const *pixels, uint32_t width, uint32_t height, Role role, bool srgb)
+{
+	CompressedTexture texture;
+	texture.format = format_for(role, srgb);
+	texture.width = width;
+	texture.height = height;
+
+	uint32_t channels = (role == Scalar ? 1 : role == Pair ? 2 : 4);
+	uint32_t bytes = block_bytes(texture.format);
+
+	{ // lay out every level up front so the data vector is allocated once:
+		size_t offset = 0;
+		for (uint32_t w = width, h = height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+		{
+			texture.level_offsets.emplace_back(offset);
+			offset += size_t((w + 3) / 4) * ((h + 3) / 4) * bytes;
+			if (w == 1 && h == 1)
+				break;
+		}
+		texture.data.resize(offset);
+	}
+
+	std::vector<uint8_t> level; // level 0 is read straight from pixels
+	uint8_t const *level_pixels = pixels;
+	uint32_t w = width, h = height;
+	for (uint32_t l = 0; l < texture.level_offsets.size(); ++l)
+	{
+		if (l > 0)
+		{
+			level = downsample(level_pixels, w, h, channels, role, srgb && role == Color);
+			level_pixels = level.data();
+			w = std::max(1u, w / 2);
+			h = std::max(1u, h / 2);
+		}
+		encode_level(level_pixels, w, h, channels, texture.format, texture.data.data() + texture.level_offsets[l]);
+	}
+
+	return texture;
+}
+
+uint64_t CompressedTexture::source_stamp(std::string const &source_path)
+{
+	std::error_code ec;
+	uint64_t size = std::filesystem::file_size(source_path, ec);
+	if (ec)
+		return 0;
+	auto time = std::filesystem::last_write_time(source_path, ec);
+	if (ec)
+		return 0;
+	return size ^ (uint64_t(time.time_since_epoch().count()) * 0x9E3779B97F4A7C15ull);
+}
+
+bool CompressedTexture::load(std::string const &cache_path, uint64_t stamp, uint32_t max_extent)
+{
+	std::ifstream file(cache_path, std::ios::binary);
+	if (!file)
+		return false;
+
+	CacheFileHeader header;
+	if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+		return false;
+	if (std::memcmp(header.magic, CacheFileHeader().magic, 4) != 0 || header.version != encoder_version || header.stamp != stamp || header.level_count == 0 || header.level_count > 32)
+	{
+		return false;
+	}
+
+	std::vector<uint64_t> offsets(header.level_count);
+	if (!file.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(offsets[0])))
+		return false;
+
+	format = VkFormat(header.vk_format);
+	width = header.width;
+	height = header.height;
+	level_offsets.assign(offsets.begin(), offsets.end());
+	first_level = level_for_extent(max_extent);
+	if (level_offsets[first_level] > header.data_size)
+		return false;
+
+	// only read from the first wanted level to the end of the chain:
+	std::vector<uint8_t> blocks(header.data_size - level_offsets[first_level]);
+	file.seekg(std::streamoff(level_offsets[first_level]), std::ios::cur);
+	if (!file.read(reinterpret_cast<char *>(blocks.data()), blocks.size()))
+		return false;
+
+	data = std::move(blocks);
+	return true;
+}
+
+VkExtent2D CompressedTexture::level_extent(uint32_t level) const
+{
+	return VkExtent2D{.width = std::max(1u, width >> level), .height = std::max(1u, height >> level)};
+}
+
+size_t CompressedTexture::level_size(uint32_t level) const
+{
+	VkExtent2D extent = level_extent(level);
+	return size_t((extent.width + 3) / 4) * ((extent.height + 3) / 4) * block_bytes(format);
+}
+
+uint32_t CompressedTexture::level_for_extent(uint32_t max_extent) const
+{
+	uint32_t level = 0;
+	while (level + 1 < level_count() && std::max(level_extent(level).width, level_extent(level).height) > max_extent)
+		++level;
+	return level;
+}
+
+std::vector<size_t> CompressedTexture::loaded_level_offsets() const
+{
+	std::vector<size_t> offsets;
+	for (uint32_t l = first_level; l < level_count(); ++l)
+		offsets.emplace_back(level_offsets[l] - level_offsets[first_level]);
+	return offsets;
+}
+
+void CompressedTexture::drop_levels(uint32_t level)
+{
+	if (level <= first_level)
+		return;
+	data.erase(data.begin(), data.begin() + std::ptrdiff_t(level_offsets[level] - level_offsets[first_level]));
+	data.shrink_to_fit();
+	first_level = level;
+}
+
+void CompressedTexture::save(std::string const &cache_path, uint64_t stamp) const
+{
+	assert(first_level == 0 && "only complete mip chains are cached");
+
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), ec);
+
+	CacheFileHeader header;
+	header.stamp = stamp;
+	header.vk_format = uint32_t(format);
+	header.width = width;
+	header.height = height;
+	header.level_count = uint32_t(level_offsets.size());
+	header.data_size = data.size();
+	std::vector<uint64_t> offsets(level_offsets.begin(), level_offsets.end());
+
+	// write to a temporary and rename, so a crash never leaves a truncated cache file behind:
+	std::string temp_path = cache_path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary);
+		file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+		file.write(reinterpret_cast<char const *>(offsets.data()), offsets.size() * sizeof(offsets[0]));
+		file.write(reinterpret_cast<char const *>(data.data()), data.size());
+		if (!file)
+		{
+			std::cerr << "WARNING: failed to write texture cache '" << temp_path << "'." << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(temp_path, cache_path, ec);
+	if (ec)
+	{
+		std::cerr << "WARNING: failed to write texture cache '" << cache_path << "': " << ec.message() << std::endl;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// block compressed material textures (BC1 / BC4 / BC5) with a full mip chain built on the CPU
+// encoded once, then cached on disk next to the scene in a small KTX2-like container (header, level index, blocks)
+struct CompressedTexture
+{
+	// what the texels are used for, picks the block format:
+	enum Role : uint8_t
+	{
+		Color,	// BC1, RGB (alpha is dropped)
+		Normal, // BC5, tangent-space xy (shaders rebuild z)
+		Scalar, // BC4, single linear channel (roughness, metalness, displacement)
+		Pair,	// BC5, two unrelated linear channels (packed roughness and metalness)
+	};
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;	 // of level 0
+	uint32_t height = 0; // of level 0
+	std::vector<size_t> level_offsets; // byte offset of each mip level in the full chain, largest level first
+	uint32_t first_level = 0;		   // finest level held in data (texture streaming loads coarse levels only)
+	std::vector<uint8_t> data;		   // tightly packed 4x4 blocks of levels first_level and coarser
+
+	uint32_t level_count() const { return uint32_t(level_offsets.size()); }
+	VkExtent2D level_extent(uint32_t level) const;
+	size_t level_size(uint32_t level) const;				// bytes of one level's blocks
+	uint32_t level_for_extent(uint32_t max_extent) const; // finest level no larger than max_extent on either side
+	std::vector<size_t> loaded_level_offsets() const;		// offsets of levels first_level.. within data
+	void drop_levels(uint32_t level);						// frees the levels finer than level
+
+	static VkFormat format_for(Role role, bool srgb);
+	static char const *format_name(VkFormat format); // used in cache file names
+
+	// pixels: width * height texels of 4 (Color, Normal), 2 (Pair) or 1 (Scalar) uint8_t channels, row-major
+	// blocks are encoded on all hardware threads
+	static CompressedTexture encode(uint8_t const *pixels, uint32_t width, uint32_t height, Role role, bool srgb);
+
+	// cache files record the source file's size and modification time, load fails (returns false) if they don't match:
+	static uint64_t source_stamp(std::string const &source_path);
+	// max_extent skips reading the levels larger than it (see level_for_extent):
+	bool load(std::string const &cache_path, uint64_t stamp, uint32_t max_extent = ~0u);
+	void save(std::string const &cache_path, uint64_t stamp) const; // failures are reported, not thrown; needs every level loaded
+};
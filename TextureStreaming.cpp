@@ -0,0 +1,277 @@
+#include "Render.hpp"
+
+#include "VK.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// texture streaming: every cached block compressed texture starts with just its mip tail (levels up to tail_extent) on the GPU.
+// update() records how large each material's visible instances project, that picks the finest level worth keeping
+// (about one texel per pixel, assuming an object's UVs span its texture once), and plan() fits the result into the budget.
+
+size_t Render::TextureStreaming::bytes(Residency const &residency, uint32_t level)
+{
+	size_t total = 0;
+	for (uint32_t l = level; l < residency.header.level_count(); ++l)
+		total += residency.header.level_size(l);
+	return total;
+}
+
+std::vector<uint32_t> Render::TextureStreaming::plan()
+{
+	++frame;
+
+	std::vector<uint32_t> streamed; // slots that have levels on disk
+	for (uint32_t slot = 0; slot < slots.size(); ++slot)
+	{
+		if (slots[slot].cache_path.empty())
+			continue;
+		slots[slot].wanted_level = slots[slot].tail_level;
+		slots[slot].screen_size = 0.0f;
+		streamed.emplace_back(slot);
+	}
+
+	// requests from this frame's visible instances:
+	for (uint32_t material_index = 0; material_index < material_screen_size.size(); ++material_index)
+	{
+		float size = material_screen_size[material_index];
+		if (size <= 0.0f)
+			continue;
+		for (uint32_t slot : material_slots[material_index])
+		{
+			Residency &residency = slots[slot];
+			if (residency.cache_path.empty())
+				continue;
+			float texels = float(std::max(residency.header.width, residency.header.height));
+			uint32_t level = size >= texels ? 0 : uint32_t(std::floor(std::log2(texels / size)));
+			residency.wanted_level = std::min(residency.wanted_level, level);
+			residency.screen_size = std::max(residency.screen_size, size);
+		}
+	}
+
+	// resident levels stay for evict_frames after they were last wanted, so looking back and forth doesn't thrash:
+	size_t total = 0;
+	for (uint32_t slot : streamed)
+	{
+		Residency &residency = slots[slot];
+		if (residency.wanted_level <= residency.resident_level)
+			residency.wanted_frame = frame;
+		residency.target_level = residency.wanted_level;
+		if (residency.target_level > residency.resident_level && frame - residency.wanted_frame < evict_frames)
+			residency.target_level = residency.resident_level;
+		total += bytes(residency, residency.target_level);
+	}
+
+	// over budget: coarsen whatever is smallest on screen first (textures nothing can see have size 0):
+	if (total > budget)
+	{
+		std::stable_sort(streamed.begin(), streamed.end(), [&](uint32_t a, uint32_t b)
+						 { return slots[a].screen_size < slots[b].screen_size; });
+		for (uint32_t slot : streamed)
+		{
+			Residency &residency = slots[slot];
+			while (total > budget && residency.target_level < residency.tail_level)
+			{
+				total -= residency.header.level_size(residency.target_level);
+				++residency.target_level;
+			}
+		}
+	}
+
+	// every change re-reads its levels from the cache, the largest on screen go first within the per-frame upload limit:
+	std::stable_sort(streamed.begin(), streamed.end(), [&](uint32_t a, uint32_t b)
+					 { return slots[a].screen_size > slots[b].screen_size; });
+	std::vector<uint32_t> changes;
+	size_t upload = 0;
+	for (uint32_t slot : streamed)
+	{
+		Residency &residency = slots[slot];
+		if (residency.target_level == residency.resident_level || residency.loading.valid())
+			continue;
+		size_t size = bytes(residency, residency.target_level);
+		if (residency.target_level < residency.resident_level && upload > 0 && upload + size > upload_bytes_per_frame)
+		{
+			residency.target_level = residency.resident_level; // asked again next frame
+			continue;
+		}
+		upload += size;
+		changes.emplace_back(slot);
+	}
+	return changes;
+}
+
+// runs on a worker thread, empty if the cache can't provide levels level.. any more:
+static std::optional<CompressedTexture> read_levels(std::string cache_path, uint64_t stamp, uint32_t level, uint32_t max_extent)
+{
+	CompressedTexture levels;
+	if (!levels.load(cache_path, stamp, max_extent) || levels.first_level != level)
+		return std::nullopt;
+	return levels;
+}
+
+void Render::stream_textures()
+{
+	if (!texture_streaming.enabled())
+		return;
+
+	TextureStreaming::Retired retiring{.frame = texture_streaming.frames_recorded};
+	std::vector<uint32_t> materials;
+
+	// finished cache reads become new images, the current ones may still be sampled by frames in flight:
+	size_t upload = 0;
+	uint32_t loading = 0;
+	for (uint32_t slot = 0; slot < texture_streaming.slots.size(); ++slot)
+	{
+		TextureStreaming::Residency &residency = texture_streaming.slots[slot];
+		if (!residency.loading.valid())
+			continue;
+		size_t size = TextureStreaming::bytes(residency, residency.loading_level);
+		if (residency.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready || (upload > 0 && upload + size > TextureStreaming::upload_bytes_per_frame))
+		{
+			++loading;
+			continue;
+		}
+
+		std::optional<CompressedTexture> levels = residency.loading.get();
+		if (!levels)
+		{
+			std::cerr << "WARNING: failed to stream levels from '" << residency.cache_path << "', keeping the resident ones." << std::endl;
+			residency.target_level = residency.resident_level;
+			continue;
+		}
+		upload += levels->data.size();
+
+		Helpers::MemoryScope memory_scope(rtg.helpers, Helpers::Textures);
+		Helpers::AllocatedImage image = rtg.helpers.create_image(
+			levels->level_extent(levels->first_level),
+			levels->format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
+			Helpers::Unmapped,
+			1,
+			levels->level_count() - levels->first_level);
+
+		Helpers::AllocatedBuffer staging;
+		{
+			Helpers::MemoryScope staging_scope(rtg.helpers, Helpers::Staging);
+			staging = rtg.helpers.create_buffer(
+				levels->data.size(),
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				Helpers::Mapped);
+			std::memcpy(staging.allocation.data(), levels->data.data(), levels->data.size());
+		}
+
+		VkImageViewCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.flags = 0,
+			.image = image.handle,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = image.format,
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = image.mip_levels,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			}};
+		VkImageView view = VK_NULL_HANDLE;
+		VK(vkCreateImageView(rtg.device, &create_info, nullptr, &view));
+
+		texture_streaming.uploads.emplace_back(TextureStreaming::Upload{.slot = slot, .staging = std::move(staging), .level_offsets = levels->loaded_level_offsets()});
+		retiring.images.emplace_back(std::move(textures[slot]));
+		retiring.views.emplace_back(texture_views[slot]);
+		textures[slot] = std::move(image);
+		texture_views[slot] = view;
+
+		if (rtg.configuration.debug)
+		{
+			std::cout << "Streamed " << residency.cache_path << " from level " << residency.resident_level << " to " << levels->first_level << "\n";
+		}
+		residency.resident_level = levels->first_level;
+
+		std::vector<uint32_t> const &users = texture_streaming.slot_materials[slot];
+		materials.insert(materials.end(), users.begin(), users.end());
+	}
+
+	if (!materials.empty())
+	{ // material descriptors are bound by frames in flight, so the changed ones move to new sets:
+		std::sort(materials.begin(), materials.end());
+		materials.erase(std::unique(materials.begin(), materials.end()), materials.end());
+		for (uint32_t material_index : materials)
+		{
+			VkDescriptorSetLayout layout = material_set_layout(material_index);
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = texture_descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &layout,
+			};
+			VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &descriptor_set));
+			retiring.sets.emplace_back(texture_descriptors[material_index]);
+			for (uint32_t user : texture_streaming.set_materials[material_index])
+				texture_descriptors[user] = descriptor_set;
+		}
+		write_material_descriptors(materials);
+	}
+	if (!retiring.images.empty())
+		texture_streaming.retired.emplace_back(std::move(retiring));
+
+	// start reading the levels plan() asks for, a few at a time:
+	for (uint32_t slot : texture_streaming.plan())
+	{
+		TextureStreaming::Residency &residency = texture_streaming.slots[slot];
+		if (loading >= TextureStreaming::loads_in_flight)
+		{
+			residency.target_level = residency.resident_level; // asked again next frame
+			continue;
+		}
+		++loading;
+		VkExtent2D extent = residency.header.level_extent(residency.target_level);
+		residency.loading_level = residency.target_level;
+		residency.loading = std::async(std::launch::async, read_levels, residency.cache_path, residency.stamp, residency.target_level, std::max(extent.width, extent.height));
+	}
+}
+
+void Render::record_texture_uploads(VkCommandBuffer command_buffer)
+{
+	free_retired_textures(false);
+
+	if (!texture_streaming.uploads.empty())
+	{
+		TextureStreaming::Retired retiring{.frame = texture_streaming.frames_recorded};
+		for (TextureStreaming::Upload &upload : texture_streaming.uploads)
+		{
+			rtg.helpers.record_image_levels_upload(command_buffer, upload.staging, textures[upload.slot], upload.level_offsets);
+			retiring.staging.emplace_back(std::move(upload.staging));
+		}
+		texture_streaming.uploads.clear();
+		texture_streaming.retired.emplace_back(std::move(retiring));
+	}
+
+	++texture_streaming.frames_recorded;
+}
+
+void Render::free_retired_textures(bool all)
+{
+	// render() is called after waiting for its workspace, so once every workspace has been waited for since a
+	// resource was retired, no frame that could have used it is still running:
+	while (!texture_streaming.retired.empty() && (all || texture_streaming.retired.front().frame + rtg.workspaces.size() <= texture_streaming.frames_recorded))
+	{
+		TextureStreaming::Retired &retired = texture_streaming.retired.front();
+		for (VkImageView view : retired.views)
+			vkDestroyImageView(rtg.device, view, nullptr);
+		for (Helpers::AllocatedImage &image : retired.images)
+			rtg.helpers.destroy_image(std::move(image));
+		if (!retired.sets.empty())
+			vkFreeDescriptorSets(rtg.device, texture_descriptor_pool, uint32_t(retired.sets.size()), retired.sets.data()); // always succeeds (and runs in ~Render)
+		for (Helpers::AllocatedBuffer &staging : retired.staging)
+			rtg.helpers.destroy_buffer(std::move(staging));
+		texture_streaming.retired.pop_front();
+	}
+}
@@ -0,0 +1,168 @@
+#include "Trace.hpp"
+
+#include "json_string.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> Trace::recording{false};
+
+namespace
+{
+	struct Event
+	{
+		char const *name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	struct ThreadBuffer
+	{
+		uint32_t tid = 0;
+		std::string name;
+		std::mutex mutex;		   // taken by the owning thread per zone, only contended while write() copies the ring
+		std::vector<Event> events; // ring of Trace::ring_size, allocated by the first zone
+		uint64_t count = 0;		   // zones ever recorded, the next one goes to events[count % ring_size]
+	};
+
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers; // kept after their thread exits, so its zones still get written
+		std::string path;
+	};
+
+	Registry &registry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	std::chrono::steady_clock::time_point const epoch = std::chrono::steady_clock::now();
+
+	ThreadBuffer &thread_buffer()
+	{
+		thread_local std::shared_ptr<ThreadBuffer> buffer = []()
+		{
+			Registry &r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			auto created = std::make_shared<ThreadBuffer>();
+			created->tid = uint32_t(r.buffers.size()) + 1;
+			r.buffers.emplace_back(created);
+			return created;
+		}();
+		return *buffer;
+	}
+}
+
+uint64_t Trace::now()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Trace::start(std::string const &path)
+{
+	{
+		Registry &r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.path = path;
+	}
+	set_thread_name("main");
+	recording.store(true, std::memory_order_relaxed);
+}
+
+std::string const &Trace::path()
+{
+	return registry().path;
+}
+
+void Trace::set_thread_name(std::string const &name)
+{
+	ThreadBuffer &buffer = thread_buffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.name = name;
+}
+
+void Trace::record(char const *name, uint64_t begin, uint64_t end)
+{
+	ThreadBuffer &buffer = thread_buffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	if (buffer.events.empty())
+		buffer.events.resize(ring_size);
+	buffer.events[buffer.count % ring_size] = Event{.name = name, .begin = begin, .end = end};
+	buffer.count += 1;
+}
+
+void Trace::write()
+{
+	// copy every ring out first, so no thread waits on the file:
+	struct Copy
+	{
+		uint32_t tid;
+		std::string name;
+		std::vector<Event> events; // oldest first
+		uint64_t dropped;
+	};
+	std::vector<Copy> copies;
+	std::string path;
+	{
+		Registry &r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		path = r.path;
+		for (auto const &buffer : r.buffers)
+		{
+			std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+			Copy copy{.tid = buffer->tid, .name = buffer->name, .events = {}, .dropped = 0};
+			uint64_t kept = std::min<uint64_t>(buffer->count, ring_size);
+			copy.dropped = buffer->count - kept;
+			copy.events.reserve(size_t(kept));
+			for (uint64_t i = buffer->count - kept; i < buffer->count; ++i)
+				copy.events.emplace_back(buffer->events[i % ring_size]);
+			copies.emplace_back(std::move(copy));
+		}
+	}
+	if (path.empty())
+		throw std::runtime_error("Trace::write() called before Trace::start().");
+
+	std::ofstream out(path, std::ios::binary);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << std::fixed << std::setprecision(3);
+	bool first = true;
+	auto separator = [&]()
+	{
+		if (!first)
+			out << ",\n";
+		first = false;
+	};
+	for (Copy const &copy : copies)
+	{
+		if (!copy.name.empty())
+		{
+			separator();
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << copy.tid << ",\"args\":{\"name\":" << json_string(copy.name) << "}}";
+		}
+		if (copy.dropped != 0)
+		{
+			separator();
+			out << "{\"name\":\"dropped " << copy.dropped << " older zones\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << copy.tid
+				<< ",\"ts\":" << (copy.events.empty() ? 0.0 : double(copy.events.front().begin) * 1e-3) << "}";
+		}
+		// complete ("X") events, times in microseconds:
+		for (Event const &event : copy.events)
+		{
+			separator();
+			out << "{\"name\":" << json_string(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << copy.tid
+				<< ",\"ts\":" << double(event.begin) * 1e-3
+				<< ",\"dur\":" << double(event.end - event.begin) * 1e-3 << "}";
+		}
+	}
+	out << "\n]}\n";
+	if (!out)
+		throw std::runtime_error("Failed to write trace '" + path + "'.");
+}
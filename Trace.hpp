@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// scoped CPU profiling zones, written out as a Chrome trace (open it in ui.perfetto.dev or chrome://tracing):
+//   { TRACE_ZONE("Render::update"); ... }
+// while not recording a zone costs one relaxed atomic load; while recording, each thread keeps its newest ring_size
+// zones in its own ring buffer, so threads never contend with each other (only with write(), briefly)
+// zone names must outlive the trace (string literals)
+struct Trace
+{
+	static constexpr size_t ring_size = size_t(1) << 16; // zones kept per thread
+
+	// start recording, later write() calls go to path (`--trace <file.json>` command-line flag):
+	static void start(std::string const &path);
+	static bool enabled() { return recording.load(std::memory_order_relaxed); }
+	// write every zone recorded so far (recording continues), throws on failure:
+	static void write();
+	static std::string const &path();
+	// name the calling thread's row in the trace:
+	static void set_thread_name(std::string const &name);
+
+	static uint64_t now(); // nanoseconds since the process started
+	static void record(char const *name, uint64_t begin, uint64_t end);
+
+	struct Zone
+	{
+		Zone(char const *name_) : name(name_), active(enabled()), begin(active ? now() : 0) { }
+		~Zone() { end(); }
+		// end the zone before its scope does:
+		void end()
+		{
+			if (active)
+				record(name, begin, now());
+			active = false;
+		}
+		Zone(Zone const &) = delete;
+		Zone &operator=(Zone const &) = delete;
+
+		char const *name;
+		bool active;
+		uint64_t begin;
+	};
+
+	static std::atomic<bool> recording;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
@@ -0,0 +1,21 @@
+#define CLUSTER
+
+// froxel grid of sphere and spot lights, filled by Render::LightClusters (must match its counts)
+// include after the World block, it uses CLUSTER_FROM_WORLD, CLUSTER_NEAR and CLUSTER_LOG_SCALE
+
+#define CLUSTER_X 16u
+#define CLUSTER_Y 9u
+#define CLUSTER_Z 24u
+
+layout(set=0, binding=8, std430) readonly buffer Clusters {
+	uvec4 CLUSTER_RANGES[CLUSTER_X * CLUSTER_Y * CLUSTER_Z]; // sphere first, sphere count, spot first, spot count
+	uint CLUSTER_LIGHTS[];
+};
+
+uvec4 clusterRange(vec3 worldPosition) {
+	vec4 clip = CLUSTER_FROM_WORLD * vec4(worldPosition, 1.0);
+	vec2 tile = clamp(floor((clip.xy / clip.w * 0.5 + 0.5) * vec2(CLUSTER_X, CLUSTER_Y)), vec2(0.0), vec2(CLUSTER_X - 1u, CLUSTER_Y - 1u));
+	float slice = clamp(floor(log(max(clip.w, CLUSTER_NEAR) / CLUSTER_NEAR) * CLUSTER_LOG_SCALE), 0.0, float(CLUSTER_Z - 1u));
+	uint index = (uint(slice) * CLUSTER_Y + uint(tile.y)) * CLUSTER_X + uint(tile.x);
+	return CLUSTER_RANGES[index];
+}
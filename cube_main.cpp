@@ -5,6 +5,9 @@
 
 #include "Scene.hpp"
 #include "glm.hpp"
+#include "rgbe.hpp"
+#include "PackedCubemap.hpp"
+#include "SphericalHarmonics.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../Lib/stb/stb_image.h"
@@ -16,6 +19,19 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 #include "../Lib/glm/glm/gtc/packing.hpp"
 
@@ -156,136 +172,72 @@ static VkSampler make_cube_sampler(RTG &rtg, uint32_t mip_count)
 	VK(vkCreateSampler(rtg.device, &ci, nullptr, &sampler));
 	return sampler;
 }
+// the input strip as decoded: RGBE texels, faces back to back (+X, -X, +Y, -Y, +Z, -Z), 4 bytes per texel; this is the smallest
+// form the environment has, it is converted to half floats a band at a time on upload (upload_rgbe_cubemap_half)
 struct CPUCubeMap
 {
 	uint32_t size = 0;
-	std::array<std::vector<glm::vec3>, 6> faces;
-};
-
-static glm::vec3 rgbe_to_linear(uint8_t r, uint8_t g, uint8_t b, uint8_t e)
-{
-	if (e == 0)
-		return glm::vec3(0.0f);
-	float scale = std::ldexp(1.0f, int(e) - (128 + 8));
-
-	glm::vec3 c(
-		float(r) * scale,
-		float(g) * scale,
-		float(b) * scale);
+	std::unique_ptr<stbi_uc, void (*)(void *)> rgbe{nullptr, stbi_image_free};
 
-	for (int k = 0; k < 3; ++k)
-	{
-		if (!std::isfinite(c[k]))
-			c[k] = 0.0f;
-		c[k] = std::max(c[k], 0.0f);
-	}
-	return glm::vec3(float(r) * scale, float(g) * scale, float(b) * scale);
-}
+	uint8_t const *face(uint32_t face) const { return rgbe.get() + 4 * size_t(face) * size * size; }
+};
 
 static CPUCubeMap load_rgbe_cubemap_vertical(std::string const &filename)
 {
 	int w = 0, h = 0, comp = 0;
-	stbi_uc *pixels = stbi_load(data_path(filename).c_str(), &w, &h, &comp, 4);
-	if (!pixels)
+	CPUCubeMap cube;
+	cube.rgbe.reset(stbi_load(data_path(filename).c_str(), &w, &h, &comp, 4));
+	if (!cube.rgbe)
 	{
 		throw std::runtime_error("Failed to load cubemap PNG: " + filename);
 	}
 
 	if (h % 6 != 0)
 	{
-		stbi_image_free(pixels);
 		throw std::runtime_error("Cubemap PNG height must be 6 * face_size.");
 	}
 	if (w != h / 6)
 	{
-		stbi_image_free(pixels);
 		throw std::runtime_error("Expected vertical strip: height = 6 * width.");
 	}
 
-	uint32_t face_size = uint32_t(w);
-	std::cout << face_size << std::endl;
-	CPUCubeMap cube;
-	cube.size = face_size;
-	for (auto &face : cube.faces)
-	{
-		face.resize(size_t(face_size) * size_t(face_size));
-	}
-
 	// face order in your uploaded image:
 	// 0:+X, 1:-X, 2:+Y, 3:-Y, 4:+Z, 5:-Z
-	for (uint32_t face = 0; face < 6; ++face)
-	{
-		for (uint32_t y = 0; y < face_size; ++y)
-		{
-			for (uint32_t x = 0; x < face_size; ++x)
-			{
-				uint32_t src_x = x;
-				uint32_t src_y = face * face_size + y;
-
-				size_t idx = 4 * (size_t(src_y) * size_t(w) + size_t(src_x));
-				uint8_t r = pixels[idx + 0];
-				uint8_t g = pixels[idx + 1];
-				uint8_t b = pixels[idx + 2];
-				uint8_t e = pixels[idx + 3];
-
-				cube.faces[face][size_t(y) * face_size + x] = rgbe_to_linear(r, g, b, e);
-			}
-		}
-	}
-
-	stbi_image_free(pixels);
+	// the strip is one face_size wide, so each face is already a contiguous run of pixels
+	cube.size = uint32_t(w);
 	return cube;
 }
 
-static glm::u8vec4 linear_to_rgbe(glm::vec3 c)
+// a cubemap level as read back from the GPU, half floats like the images, one vector per face:
+using HalfCubeFaces = std::array<std::vector<Half4>, 6>;
+
+// half floats to RGBE through linear floats a band at a time, so the encode stage never holds a float copy of a face:
+static void half_to_rgbe(Half4 const *half, uint8_t *rgbe, size_t count)
 {
-	float maxc = std::max(c.r, std::max(c.g, c.b));
-	if (maxc < 1e-32f)
-		return glm::u8vec4(0, 0, 0, 0);
-
-	int exp;
-	float mant = std::frexp(maxc, &exp);
-	float scale = mant * 256.0f / maxc;
-
-	return glm::u8vec4(
-		uint8_t(std::clamp(c.r * scale, 0.0f, 255.0f)),
-		uint8_t(std::clamp(c.g * scale, 0.0f, 255.0f)),
-		uint8_t(std::clamp(c.b * scale, 0.0f, 255.0f)),
-		uint8_t(exp + 128));
+	constexpr size_t band = 4096;
+	std::vector<glm::vec4> linear(std::min(band, count));
+	for (size_t begin = 0; begin < count; begin += band)
+	{
+		size_t texels = std::min(band, count - begin);
+		for (size_t i = 0; i < texels; ++i)
+		{
+			linear[i] = unpack_half4(half[begin + i]);
+		}
+		linear_to_rgbe(linear.data(), rgbe + 4 * begin, texels);
+	}
 }
 
+// rgbe: 6 faces of RGBE texels back to back (+X, -X, +Y, -Y, +Z, -Z); stacked vertically and face_size wide, each face is
+// already a contiguous run of the image's pixels:
 static void write_rgbe_cubemap_vertical(
 	std::string const &filename,
-	std::array<std::vector<glm::vec4>, 6> const &faces,
+	uint8_t const *rgbe,
 	uint32_t face_size)
 {
 	int w = int(face_size);
 	int h = int(face_size * 6);
 
-	std::vector<uint8_t> pixels(size_t(w) * size_t(h) * 4, 0);
-
-	for (uint32_t face = 0; face < 6; ++face)
-	{
-		for (uint32_t y = 0; y < face_size; ++y)
-		{
-			for (uint32_t x = 0; x < face_size; ++x)
-			{
-				glm::vec3 c = glm::vec3(faces[face][size_t(y) * face_size + x]);
-				glm::u8vec4 rgbe = linear_to_rgbe(c);
-
-				uint32_t dst_x = x;
-				uint32_t dst_y = face * face_size + y;
-
-				size_t idx = 4 * (size_t(dst_y) * size_t(w) + size_t(dst_x));
-				pixels[idx + 0] = rgbe.r;
-				pixels[idx + 1] = rgbe.g;
-				pixels[idx + 2] = rgbe.b;
-				pixels[idx + 3] = rgbe.a;
-			}
-		}
-	}
-
-	if (!stbi_write_png(filename.c_str(), w, h, 4, pixels.data(), w * 4))
+	if (!stbi_write_png(filename.c_str(), w, h, 4, rgbe, w * 4))
 	{
 		throw std::runtime_error("Failed to write cubemap PNG: " + filename);
 	}
@@ -356,7 +308,6 @@ static void generate_cubemap_mips(
 		throw std::runtime_error("generate_cubemap_mips called with mip_count == 0");
 	}
 
-	std::cout << "about to reset cubemipcommand buffer: " << (void *)rtg.helpers.transfer_command_buffer << std::endl;
 	VK(vkResetCommandBuffer(rtg.helpers.transfer_command_buffer, 0));
 
 	VkCommandBufferBeginInfo begin_info{
@@ -585,571 +536,1286 @@ static void generate_cubemap_mips(
 	VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
 	VK(vkQueueWaitIdle(rtg.graphics_queue));
 }
-static std::vector<glm::vec4> readback_cubemap_face(
+// host memory for staging, uploads and readbacks move at most this much per submit, however big the faces are:
+constexpr size_t StagingBytes = size_t(64) << 20;
+
+// rows of a face_size wide image of texel_size texels that fit in one staging band:
+static uint32_t staging_band_rows(uint32_t face_size, size_t texel_size)
+{
+	return uint32_t(std::clamp<size_t>(StagingBytes / (size_t(face_size) * texel_size), 1, face_size));
+}
+
+// uploads level 0 of a half float cubemap from RGBE texels (CPUCubeMap), converting and copying a band of rows at a time;
+// leaves level 0 in TRANSFER_DST_OPTIMAL for generate_cubemap_mips
+static void upload_rgbe_cubemap_half(
 	RTG &rtg,
 	Helpers::AllocatedImage const &image,
-	uint32_t face,
-	uint32_t mip,
-	uint32_t face_size)
+	CPUCubeMap const &cube)
 {
-	std::vector<Half4> raw(size_t(face_size) * size_t(face_size));
+	uint32_t size = cube.size;
+	uint32_t band_rows = staging_band_rows(size, sizeof(Half4));
 
 	Helpers::AllocatedBuffer staging = rtg.helpers.create_buffer(
-		raw.size() * sizeof(Half4),
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		size_t(band_rows) * size * sizeof(Half4),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		Helpers::Mapped);
 
-	VK(vkResetCommandBuffer(rtg.helpers.transfer_command_buffer, 0));
-
+	VkCommandBuffer cmd = rtg.helpers.transfer_command_buffer;
 	VkCommandBufferBeginInfo begin_info{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
 	};
-	VK(vkBeginCommandBuffer(rtg.helpers.transfer_command_buffer, &begin_info));
 
-	VkImageMemoryBarrier to_transfer{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
-		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.image = image.handle,
-		.subresourceRange{
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.baseMipLevel = mip,
-			.levelCount = 1,
-			.baseArrayLayer = face,
-			.layerCount = 1,
-		},
-	};
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		for (uint32_t row = 0; row < size; row += band_rows)
+		{
+			uint32_t rows = std::min(band_rows, size - row);
+			rgbe_to_half(cube.face(face) + 4 * size_t(row) * size, reinterpret_cast<uint16_t *>(staging.allocation.data()), size_t(rows) * size);
 
-	vkCmdPipelineBarrier(
-		rtg.helpers.transfer_command_buffer,
-		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &to_transfer);
-
-	VkBufferImageCopy region{
-		.bufferOffset = 0,
-		.bufferRowLength = 0,
-		.bufferImageHeight = 0,
-		.imageSubresource{
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.mipLevel = mip,
-			.baseArrayLayer = face,
-			.layerCount = 1,
-		},
-		.imageOffset{0, 0, 0},
-		.imageExtent{face_size, face_size, 1},
-	};
+			VK(vkResetCommandBuffer(cmd, 0));
+			VK(vkBeginCommandBuffer(cmd, &begin_info));
 
-	vkCmdCopyImageToBuffer(
-		rtg.helpers.transfer_command_buffer,
-		image.handle,
-		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		staging.handle,
-		1,
-		&region);
-
-	VkImageMemoryBarrier back_to_general{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.image = image.handle,
-		.subresourceRange{
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.baseMipLevel = mip,
-			.levelCount = 1,
-			.baseArrayLayer = face,
-			.layerCount = 1,
-		},
-	};
+			if (face == 0 && row == 0)
+			{
+				VkImageMemoryBarrier barrier{
+					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+					.srcAccessMask = 0,
+					.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+					.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+					.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.image = image.handle,
+					.subresourceRange{
+						.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+						.baseMipLevel = 0,
+						.levelCount = 1,
+						.baseArrayLayer = 0,
+						.layerCount = 6,
+					},
+				};
 
-	vkCmdPipelineBarrier(
-		rtg.helpers.transfer_command_buffer,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &back_to_general);
+				vkCmdPipelineBarrier(
+					cmd,
+					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					0,
+					0, nullptr,
+					0, nullptr,
+					1, &barrier);
+			}
 
-	VK(vkEndCommandBuffer(rtg.helpers.transfer_command_buffer));
+			VkBufferImageCopy region{
+				.bufferOffset = 0,
+				.bufferRowLength = 0,
+				.bufferImageHeight = 0,
+				.imageSubresource{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = 0,
+					.baseArrayLayer = face,
+					.layerCount = 1,
+				},
+				.imageOffset{0, int32_t(row), 0},
+				.imageExtent{size, rows, 1},
+			};
 
-	VkSubmitInfo submit_info{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &rtg.helpers.transfer_command_buffer,
-	};
+			vkCmdCopyBufferToImage(cmd, staging.handle, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-	VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
-	VK(vkQueueWaitIdle(rtg.graphics_queue));
+			VK(vkEndCommandBuffer(cmd));
 
-	std::memcpy(raw.data(), staging.allocation.data(), raw.size() * sizeof(Half4));
-	rtg.helpers.destroy_buffer(std::move(staging));
+			VkSubmitInfo submit_info{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				.commandBufferCount = 1,
+				.pCommandBuffers = &cmd,
+			};
 
-	std::vector<glm::vec4> out(raw.size());
-	for (size_t i = 0; i < raw.size(); ++i)
-	{
-		out[i] = unpack_half4(raw[i]);
+			// waiting before the next band reuses the staging buffer:
+			VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+			VK(vkQueueWaitIdle(rtg.graphics_queue));
+		}
 	}
 
-	return out;
+	rtg.helpers.destroy_buffer(std::move(staging));
 }
 
-int main(int argc, char **argv)
+// reads one face of a GENERAL layout half float image back a band of rows at a time, leaves it in GENERAL:
+static std::vector<Half4> readback_cubemap_face(
+	RTG &rtg,
+	Helpers::AllocatedImage const &image,
+	uint32_t face,
+	uint32_t mip,
+	uint32_t face_size)
 {
-	// main wrapped in a try-catch so we can print some debug info about uncaught exceptions:
-	try
-	{
-
-		// configure application:
-		RTG::Configuration configuration;
-		configuration.cube = true;
+	std::vector<Half4> out(size_t(face_size) * size_t(face_size));
+	uint32_t band_rows = staging_band_rows(face_size, sizeof(Half4));
 
-		configuration.application_info = VkApplicationInfo{
-			.pApplicationName = "Cube Render",
-			.applicationVersion = VK_MAKE_VERSION(0, 0, 0),
-			.pEngineName = "Unknown",
-			.engineVersion = VK_MAKE_VERSION(0, 0, 0),
-			.apiVersion = VK_API_VERSION_1_3};
+	Helpers::AllocatedBuffer staging = rtg.helpers.create_buffer(
+		size_t(band_rows) * face_size * sizeof(Half4),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		Helpers::Mapped);
 
-		bool print_usage = false;
+	VkCommandBuffer cmd = rtg.helpers.transfer_command_buffer;
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
 
-		try
-		{
-			configuration.parse(argc, argv);
-		}
-		catch (std::runtime_error &e)
-		{
-			std::cerr << "Failed to parse arguments:\n"
-					  << e.what() << std::endl;
-			print_usage = true;
-		}
+	VkImageSubresourceRange range{
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel = mip,
+		.levelCount = 1,
+		.baseArrayLayer = face,
+		.layerCount = 1,
+	};
 
-		if (print_usage)
-		{
-			std::cerr << "Usage:" << std::endl;
-			RTG::Configuration::cube_usage([](const char *arg, const char *desc)
-										   { std::cerr << "    " << arg << "\n        " << desc << std::endl; });
-			return 1;
-		}
+	for (uint32_t row = 0; row < face_size; row += band_rows)
+	{
+		uint32_t rows = std::min(band_rows, face_size - row);
 
-		configuration.headless = true;
+		VK(vkResetCommandBuffer(cmd, 0));
+		VK(vkBeginCommandBuffer(cmd, &begin_info));
 
-		// loads vulkan library, creates surface, initializes helpers:
-		RTG rtg(configuration);
+		// first band moves the face to TRANSFER_SRC, the last one moves it back:
+		if (row == 0)
+		{
+			VkImageMemoryBarrier to_transfer{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image.handle,
+				.subresourceRange = range,
+			};
 
-		// TODO: create computation pipeline
-		CubePipeline pipeline;
-		pipeline.create(rtg);
+			vkCmdPipelineBarrier(
+				cmd,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &to_transfer);
+		}
 
-		// TODO: load images / create descriptors
+		VkBufferImageCopy region{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = mip,
+				.baseArrayLayer = face,
+				.layerCount = 1,
+			},
+			.imageOffset{0, int32_t(row), 0},
+			.imageExtent{face_size, rows, 1},
+		};
 
-		VkCommandPool cube_command_pool = VK_NULL_HANDLE;
-		VkCommandBuffer cube_command_buffer = VK_NULL_HANDLE;
+		vkCmdCopyImageToBuffer(
+			cmd,
+			image.handle,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			staging.handle,
+			1,
+			&region);
 
+		if (row + rows == face_size)
 		{
-			VkCommandPoolCreateInfo pool_info{
-				.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-				.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-				.queueFamilyIndex = rtg.graphics_queue_family.value(),
+			VkImageMemoryBarrier back_to_general{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image.handle,
+				.subresourceRange = range,
 			};
-			VK(vkCreateCommandPool(rtg.device, &pool_info, nullptr, &cube_command_pool));
-		}
 
-		{
-			VkCommandBufferAllocateInfo alloc_info{
-				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-				.commandPool = cube_command_pool,
-				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				.commandBufferCount = 1,
-			};
-			VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &cube_command_buffer));
+			vkCmdPipelineBarrier(
+				cmd,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &back_to_general);
 		}
 
-		CPUCubeMap input_cube = load_rgbe_cubemap_vertical(rtg.configuration.in_image);
+		VK(vkEndCommandBuffer(cmd));
 
-		uint32_t in_size = input_cube.size;
-		uint32_t env_mip_count = 1u + uint32_t(std::floor(std::log2(float(in_size))));
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &cmd,
+		};
 
-		GPUCubeMap env_gpu;
-		env_gpu.image = rtg.helpers.create_cubemap(
-			{in_size, in_size},
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_SAMPLED_BIT |
-				VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-				VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			Helpers::Unmapped,
-			env_mip_count);
+		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+		VK(vkQueueWaitIdle(rtg.graphics_queue));
 
-		for (uint32_t face = 0; face < 6; ++face)
-		{
-			std::vector<glm::vec4> face_rgba32(size_t(in_size) * size_t(in_size));
+		std::memcpy(out.data() + size_t(row) * face_size, staging.allocation.data(), size_t(rows) * face_size * sizeof(Half4));
+	}
 
-			uint32_t bad_count = 0;
+	rtg.helpers.destroy_buffer(std::move(staging));
 
-			for (size_t i = 0; i < face_rgba32.size(); ++i)
-			{
-				glm::vec3 c = input_cube.faces[face][i];
+	return out;
+}
 
-				for (int k = 0; k < 3; ++k)
-				{
-					if (!std::isfinite(c[k]))
-					{
-						c[k] = 0.0f;
-						bad_count++;
-					}
+// in a batch the main thread (prefiltering one environment) and the encode workers (writing earlier ones) print at the
+// same time; every message goes out whole under this lock, and a \r progress line is ended before anything else is printed:
+static std::mutex output_mutex;
+static bool progress_shown = false;
 
-					c[k] = std::max(c[k], 0.0f);
-				}
+static void print_line(std::string const &line, std::ostream &out = std::cout)
+{
+	std::lock_guard<std::mutex> lock(output_mutex);
+	if (progress_shown)
+	{
+		std::cout << std::endl;
+		progress_shown = false;
+	}
+	out << line << std::endl;
+}
 
-				face_rgba32[i] = glm::vec4(c, 1.0f);
-			}
+// shader samples one submit may evaluate: a single dispatch over an 8K+ face (or a few hundred thousand samples per texel)
+// can run past the driver's watchdog and lose the device, so compute passes are split into tiles that stay well under it
+constexpr uint64_t MaxSamplesPerSubmit = uint64_t(1) << 28;
 
-			std::cout << "[env upload R32] face " << face
-					  << " bytes = " << face_rgba32.size() * sizeof(glm::vec4)
-					  << " bad = " << bad_count << std::endl;
+// runs a cube tool compute pass (8x8 workgroups over size x size texels of all 6 faces) as square tiles, one submit each,
+// passing each tile's first texel in push.originX / originY; prints progress (as label) when a pass takes more than a moment
+template <typename Push>
+static void dispatch_tiled(
+	RTG &rtg,
+	VkCommandBuffer cmd,
+	VkPipeline pipeline,
+	VkPipelineLayout layout,
+	VkDescriptorSet set,
+	Push push,
+	uint32_t size,
+	uint32_t samples,
+	std::string const &label)
+{
+	uint64_t samples_per_texel = 6 * uint64_t(std::max(1u, samples));
+	uint32_t tile = uint32_t(std::sqrt(double(MaxSamplesPerSubmit / samples_per_texel))) / 8 * 8; // whole workgroups
+	tile = std::clamp(tile, 8u, std::max(8u, (size + 7) / 8 * 8));
+	uint32_t tiles_per_axis = (size + tile - 1) / tile;
+	uint32_t tile_count = tiles_per_axis * tiles_per_axis;
 
-			rtg.helpers.transfer_to_cubemap_layer(
-				face_rgba32.data(),
-				face_rgba32.size() * sizeof(glm::vec4),
-				env_gpu.image,
-				face,
-				0,
-				VK_IMAGE_LAYOUT_UNDEFINED);
-		}
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
 
-		generate_cubemap_mips(rtg, env_gpu.image, in_size, env_mip_count);
+	auto last_report = std::chrono::high_resolution_clock::now();
+	bool reported = false;
 
-		env_gpu.cube_view = make_cube_view(rtg, env_gpu.image, env_mip_count);
-		// env_gpu.sampled_array_view = make_sampled_array_view(rtg, env_gpu.image, env_mip_count);
-		env_gpu.sampler = make_cube_sampler(rtg, env_mip_count);
-		bool do_lambert = !rtg.configuration.lambert_out_image.empty();
-		bool do_ggx = !rtg.configuration.ggx_out_image.empty();
+	for (uint32_t t = 0; t < tile_count; ++t)
+	{
+		push.originX = (t % tiles_per_axis) * tile;
+		push.originY = (t / tiles_per_axis) * tile;
+		uint32_t width = std::min(tile, size - push.originX);
+		uint32_t height = std::min(tile, size - push.originY);
 
-		std::cout << "this is the size: " << in_size << std::endl;
-		uint32_t lambert_size = 32;
-		uint32_t ggx_levels = 0;
-		uint32_t ggx_base_size = 0;
+		VK(vkResetCommandBuffer(cmd, 0));
+		VK(vkBeginCommandBuffer(cmd, &begin_info));
 
-		if (do_ggx)
-		{
-			ggx_base_size = std::max(1u, in_size);
-			uint32_t max_ggx_levels = 1u + uint32_t(std::floor(std::log2(float(ggx_base_size))));
-			ggx_levels = std::min<uint32_t>(rtg.configuration.ggx_levels, max_ggx_levels);
-		}
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+		vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(cmd, (width + 7) / 8, (height + 7) / 8, 6);
 
-		GPUCubeMap irradiance_gpu{};
-		GPUCubeMap ggx_gpu{};
+		VK(vkEndCommandBuffer(cmd));
 
-		// create output cubemaps first:
-		if (do_lambert)
-		{
-			irradiance_gpu.image = rtg.helpers.create_cubemap(
-				{lambert_size, lambert_size},
-				VK_FORMAT_R16G16B16A16_SFLOAT,
-				VK_IMAGE_TILING_OPTIMAL,
-				VK_IMAGE_USAGE_STORAGE_BIT |
-					VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
-					VK_IMAGE_USAGE_SAMPLED_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				Helpers::Unmapped,
-				1);
-
-			irradiance_gpu.storage_views.push_back(
-				make_storage_view_for_mip(rtg, irradiance_gpu.image, 0));
-			irradiance_gpu.cube_view = make_cube_view(rtg, irradiance_gpu.image, 1);
-			irradiance_gpu.sampler = make_cube_sampler(rtg, 1);
-		}
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &cmd,
+		};
+		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+		VK(vkQueueWaitIdle(rtg.graphics_queue));
 
-		if (do_ggx)
+		auto now = std::chrono::high_resolution_clock::now();
+		if (t + 1 < tile_count && now - last_report > std::chrono::milliseconds(500))
 		{
-			ggx_gpu.image = rtg.helpers.create_cubemap(
-				{ggx_base_size, ggx_base_size},
-				VK_FORMAT_R16G16B16A16_SFLOAT,
-				VK_IMAGE_TILING_OPTIMAL,
-				VK_IMAGE_USAGE_STORAGE_BIT |
-					VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
-					VK_IMAGE_USAGE_SAMPLED_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				Helpers::Unmapped,
-				ggx_levels);
-
-			for (uint32_t mip = 0; mip < ggx_levels; ++mip)
-			{
-				ggx_gpu.storage_views.push_back(
-					make_storage_view_for_mip(rtg, ggx_gpu.image, mip));
-			}
-
-			ggx_gpu.cube_view = make_cube_view(rtg, ggx_gpu.image, ggx_levels);
-			ggx_gpu.sampler = make_cube_sampler(rtg, ggx_levels);
+			std::lock_guard<std::mutex> lock(output_mutex);
+			std::cout << "\r" << label << ": " << (100 * (t + 1) / tile_count) << "% (" << (t + 1) << " of " << tile_count << " tiles)" << std::flush;
+			progress_shown = true;
+			last_report = now;
+			reported = true;
 		}
+	}
 
-		// descriptor pool sized for actual usage:
-		uint32_t descriptor_set_count = 0;
-		if (do_lambert)
-			descriptor_set_count += 1;
-		if (do_ggx)
-			descriptor_set_count += ggx_levels;
+	if (reported)
+	{
+		std::lock_guard<std::mutex> lock(output_mutex);
+		std::cout << "\r" << label << ": done" << std::string(24, ' ') << std::endl;
+		progress_shown = false;
+	}
+}
 
-		VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
-		if (descriptor_set_count > 0)
+// SH9 of env level 0 via sh_project.comp: one partial sum per 16x16 texel workgroup, added up here in double:
+static SH9 project_sh9_gpu(RTG &rtg, CubePipeline const &pipeline, GPUCubeMap const &env, uint32_t size)
+{
+	uint32_t groups_per_axis = (size + CubePipeline::SHTile - 1) / CubePipeline::SHTile;
+	uint32_t group_count = groups_per_axis * groups_per_axis * 6;
+
+	Helpers::AllocatedBuffer partials = rtg.helpers.create_buffer(
+		size_t(group_count) * 9 * sizeof(glm::vec4),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		Helpers::Mapped);
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	{
+		std::array<VkDescriptorPoolSize, 2> pool_sizes{
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = 1,
+			},
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.descriptorCount = 1,
+			},
+		};
+
+		VkDescriptorPoolCreateInfo pool_ci{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = uint32_t(pool_sizes.size()),
+			.pPoolSizes = pool_sizes.data(),
+		};
+
+		VK(vkCreateDescriptorPool(rtg.device, &pool_ci, nullptr, &pool));
+	}
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	{
+		VkDescriptorSetAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &pipeline.set0_sh,
+		};
+		VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &set));
+
+		VkDescriptorImageInfo env_info{
+			.sampler = env.sampler,
+			.imageView = env.cube_view,
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		};
+		VkDescriptorBufferInfo partials_info{
+			.buffer = partials.handle,
+			.offset = 0,
+			.range = partials.size,
+		};
+
+		std::array<VkWriteDescriptorSet, 2> writes{
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = set,
+				.dstBinding = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &env_info,
+			},
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = set,
+				.dstBinding = 1,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &partials_info,
+			},
+		};
+		vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	VkCommandBuffer cmd = rtg.helpers.transfer_command_buffer;
+	VK(vkResetCommandBuffer(cmd, 0));
+
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+	VK(vkBeginCommandBuffer(cmd, &begin_info));
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.sh_pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.sh_layout, 0, 1, &set, 0, nullptr);
+
+	CubePipeline::SHPush push{
+		.size = size,
+	};
+	vkCmdPushConstants(cmd, pipeline.sh_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+
+	vkCmdDispatch(cmd, groups_per_axis, groups_per_axis, 6);
+
+	{ // partial sums -> host reads
+		VkMemoryBarrier barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		};
+		vkCmdPipelineBarrier(
+			cmd,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	VK(vkEndCommandBuffer(cmd));
+
+	VkSubmitInfo submit_info{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &cmd,
+	};
+	VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+	VK(vkQueueWaitIdle(rtg.graphics_queue));
+
+	std::array<double, 27> projection{};
+	glm::vec4 const *sums = reinterpret_cast<glm::vec4 const *>(partials.allocation.data());
+	for (uint32_t group = 0; group < group_count; ++group)
+	{
+		for (uint32_t i = 0; i < 9; ++i)
 		{
-			std::array<VkDescriptorPoolSize, 2> pool_sizes{
-				VkDescriptorPoolSize{
-					.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.descriptorCount = descriptor_set_count,
-				},
-				VkDescriptorPoolSize{
-					.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-					.descriptorCount = descriptor_set_count,
-				},
-			};
+			glm::vec4 const &sum = sums[group * 9 + i];
+			projection[3 * i + 0] += sum.r;
+			projection[3 * i + 1] += sum.g;
+			projection[3 * i + 2] += sum.b;
+		}
+	}
 
-			VkDescriptorPoolCreateInfo pool_ci{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-				.maxSets = descriptor_set_count,
-				.poolSizeCount = uint32_t(pool_sizes.size()),
-				.pPoolSizes = pool_sizes.data(),
-			};
+	vkDestroyDescriptorPool(rtg.device, pool, nullptr);
+	rtg.helpers.destroy_buffer(std::move(partials));
 
-			VK(vkCreateDescriptorPool(rtg.device, &pool_ci, nullptr, &descriptor_pool));
+	return SH9::from_radiance_projection(projection);
+}
+
+// one environment through the tool; a single run's names come straight from the command line, --batch fills them per input:
+struct CubeJob
+{
+	std::string in_image;
+	std::string lambert_out_image;
+	std::string ggx_out_image;
+	std::string packed_out_image;
+	std::string sh_out;
+	std::string tag; // "[3/40] " in a batch, printed before every message about this environment
+};
+
+// encode stage: one worker thread turns read back pieces (a face of a GGX level, the lambertian cube, the SH) into files while
+// the main thread, the only one that touches Vulkan, keeps the GPU busy. The queue is bounded by the bytes its pieces hold,
+// in flight included, so a fast GPU waits for the disk instead of piling up read back levels:
+struct EncodeQueue
+{
+	explicit EncodeQueue(size_t max_bytes_) : max_bytes(max_bytes_)
+	{
+		worker = std::thread([this]()
+							 { run(); });
+	}
+	// runs what is still queued, then joins:
+	~EncodeQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
 		}
+		changed.notify_all();
+		worker.join();
+	}
+	EncodeQueue(EncodeQueue const &) = delete;
+	EncodeQueue &operator=(EncodeQueue const &) = delete;
 
-		// record compute work:
-		std::cout << "about to record comput work  buffer: " << (void *)rtg.helpers.transfer_command_buffer << std::endl;
-		VK(vkResetCommandBuffer(cube_command_buffer, 0));
+	// blocks while the queue is full; an empty queue takes a piece of any size, so a level bigger than max_bytes still goes:
+	void push(size_t bytes, std::function<void()> work)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&]()
+					 { return queued_bytes == 0 || queued_bytes + bytes <= max_bytes; });
+		queued_bytes += bytes;
+		pieces.emplace_back(bytes, std::move(work));
+		changed.notify_all();
+	}
 
-		VkCommandBufferBeginInfo begin_info{
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	// the worker: pieces in the order they were pushed (work must not throw), until stopping with nothing queued:
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			changed.wait(lock, [&]()
+						 { return stopping || !pieces.empty(); });
+			if (pieces.empty())
+				return;
+			std::pair<size_t, std::function<void()>> piece = std::move(pieces.front());
+			pieces.pop_front();
+			lock.unlock();
+			piece.second();
+			piece.second = nullptr; // frees what the piece held before its bytes leave the count
+			lock.lock();
+			queued_bytes -= piece.first;
+			changed.notify_all();
+		}
+	}
+
+	size_t max_bytes;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::pair<size_t, std::function<void()>>> pieces;
+	size_t queued_bytes = 0;
+	bool stopping = false;
+	std::thread worker;
+};
+
+// one environment's outputs while its pieces are encoded; once prefilter_environment starts pushing, only the worker touches it:
+struct EncodeState
+{
+	CubeJob job;
+	std::unique_ptr<PackedCubemap::Writer> packed; // every GGX level in the renderer's E5B9G9R9 format, appended face by face
+	uint32_t ggx_levels = 0;
+	std::vector<uint8_t> ggx_strip;	  // RGBE png of the level being encoded, stb_image_write only takes whole images
+	std::exception_ptr error;		  // first failure, the environment's later pieces are skipped
+	std::promise<void> done;		  // set by the environment's last piece, with the failure if there was one
+};
+
+// queues work(state) for the worker, it is skipped once the environment has failed and its failure is kept in state.error:
+template <typename Work>
+static void push_piece(EncodeQueue &queue, std::shared_ptr<EncodeState> const &state, size_t bytes, Work &&work)
+{
+	queue.push(bytes, [state, work = std::forward<Work>(work)]()
+			   {
+				   if (state->error)
+					   return;
+				   try
+				   {
+					   work(*state);
+				   }
+				   catch (...)
+				   {
+					   state->error = std::current_exception();
+				   } });
+}
+
+// a face of GGX level mip, in level and face order: into the level's png (written with its last face) and the packed cubemap
+static void encode_ggx_face(EncodeState &state, uint32_t mip, uint32_t mip_size, uint32_t face, std::vector<Half4> const &texels)
+{
+	size_t face_pixels = size_t(mip_size) * mip_size;
+
+	uint8_t const *face_rgbe = nullptr;
+	if (!state.job.ggx_out_image.empty())
+	{
+		if (face == 0)
+			state.ggx_strip.resize(6 * 4 * face_pixels);
+		half_to_rgbe(texels.data(), state.ggx_strip.data() + 4 * face * face_pixels, face_pixels);
+		face_rgbe = state.ggx_strip.data() + 4 * face * face_pixels;
+	}
+
+	if (state.packed)
+	{
+		// converted through RGBE like the pngs are, so both outputs agree; a band at a time when there is no png to reuse:
+		constexpr size_t band = 65536;
+		std::vector<uint8_t> rgbe(face_rgbe ? 0 : 4 * std::min(band, face_pixels));
+		std::vector<uint32_t> packed(std::min(band, face_pixels));
+		for (size_t begin = 0; begin < face_pixels; begin += band)
+		{
+			size_t texels_in_band = std::min(band, face_pixels - begin);
+			uint8_t const *band_rgbe = face_rgbe ? face_rgbe + 4 * begin : rgbe.data();
+			if (!face_rgbe)
+				half_to_rgbe(texels.data() + begin, rgbe.data(), texels_in_band);
+			rgbe_to_E5B9G9R9(band_rgbe, packed.data(), texels_in_band);
+			state.packed->append(packed.data(), texels_in_band * sizeof(uint32_t));
+		}
+	}
+
+	if (!state.job.ggx_out_image.empty() && face == 5)
+	{
+		std::string const &path = state.job.ggx_out_image;
+		size_t dot = path.find_last_of('.');
+		std::string base = dot == std::string::npos ? path : path.substr(0, dot);
+		std::string ext = dot == std::string::npos ? std::string() : path.substr(dot);
+		write_rgbe_cubemap_vertical(base + "." + std::to_string(mip + 1) + ext, state.ggx_strip.data(), mip_size);
+	}
+}
+
+// the environment's last piece: closes the packed cubemap and hands the outcome to state.done
+static void finish_encoding(EncodeQueue &queue, std::shared_ptr<EncodeState> const &state)
+{
+	queue.push(0, [state]()
+			   {
+				   if (!state->error && state->packed)
+				   {
+					   try
+					   {
+						   state->packed->finish();
+						   print_line(state->job.tag + "Wrote " + std::to_string(state->ggx_levels) + " levels to " + state->job.packed_out_image);
+					   }
+					   catch (...)
+					   {
+						   state->error = std::current_exception();
+					   }
+				   }
+				   state->packed.reset(); // an unfinished one removes its temporary file
+				   state->ggx_strip = std::vector<uint8_t>();
+				   if (state->error)
+					   state->done.set_exception(state->error);
+				   else
+					   state->done.set_value(); });
+}
+
+// prefilter stage (main thread): runs the GPU passes for one environment and pushes each result to the encoder as soon as
+// it is final, so at most the GGX refinement pair is held here; finish_encoding is up to the caller
+static void prefilter_environment(
+	RTG &rtg,
+	CubePipeline const &pipeline,
+	VkCommandBuffer cube_command_buffer,
+	CPUCubeMap const &input,
+	EncodeQueue &queue,
+	std::shared_ptr<EncodeState> const &state)
+{
+	CubeJob const &job = state->job;
+	uint32_t in_size = input.size;
+	uint32_t env_mip_count = 1u + uint32_t(std::floor(std::log2(float(in_size))));
+
+	// half floats: RGBE inputs carry 8 bits of mantissa, so R32 only doubled the memory (an 8K environment with mips is 3 GiB in R32)
+	GPUCubeMap env_gpu;
+	env_gpu.image = rtg.helpers.create_cubemap(
+		{in_size, in_size},
+		VK_FORMAT_R16G16B16A16_SFLOAT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_SAMPLED_BIT |
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		Helpers::Unmapped,
+		env_mip_count);
+
+	upload_rgbe_cubemap_half(rtg, env_gpu.image, input);
+
+	generate_cubemap_mips(rtg, env_gpu.image, in_size, env_mip_count);
+
+	env_gpu.cube_view = make_cube_view(rtg, env_gpu.image, env_mip_count);
+	// env_gpu.sampled_array_view = make_sampled_array_view(rtg, env_gpu.image, env_mip_count);
+	env_gpu.sampler = make_cube_sampler(rtg, env_mip_count);
+	bool do_lambert = !job.lambert_out_image.empty();
+	bool do_ggx = !job.ggx_out_image.empty() || !job.packed_out_image.empty();
+
+	uint32_t lambert_size = 32;
+	uint32_t ggx_levels = 0;
+	uint32_t ggx_base_size = 0;
+
+	if (do_ggx)
+	{
+		ggx_base_size = std::max(1u, in_size);
+		uint32_t max_ggx_levels = 1u + uint32_t(std::floor(std::log2(float(ggx_base_size))));
+		ggx_levels = std::min<uint32_t>(rtg.configuration.ggx_levels, max_ggx_levels);
+	}
+
+	GPUCubeMap irradiance_gpu{};
+	GPUCubeMap ggx_gpu{};
+
+	// create output cubemaps first:
+	if (do_lambert)
+	{
+		irradiance_gpu.image = rtg.helpers.create_cubemap(
+			{lambert_size, lambert_size},
+			VK_FORMAT_R16G16B16A16_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT |
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+				VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped,
+			1);
+
+		irradiance_gpu.storage_views.push_back(
+			make_storage_view_for_mip(rtg, irradiance_gpu.image, 0));
+		irradiance_gpu.cube_view = make_cube_view(rtg, irradiance_gpu.image, 1);
+		irradiance_gpu.sampler = make_cube_sampler(rtg, 1);
+	}
+
+	if (do_ggx)
+	{
+		ggx_gpu.image = rtg.helpers.create_cubemap(
+			{ggx_base_size, ggx_base_size},
+			VK_FORMAT_R16G16B16A16_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT |
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+				VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped,
+			ggx_levels);
+
+		for (uint32_t mip = 0; mip < ggx_levels; ++mip)
+		{
+			ggx_gpu.storage_views.push_back(
+				make_storage_view_for_mip(rtg, ggx_gpu.image, mip));
+		}
+
+		ggx_gpu.cube_view = make_cube_view(rtg, ggx_gpu.image, ggx_levels);
+		ggx_gpu.sampler = make_cube_sampler(rtg, ggx_levels);
+	}
+
+	// descriptor pool sized for actual usage:
+	uint32_t descriptor_set_count = 0;
+	if (do_lambert)
+		descriptor_set_count += 1;
+	if (do_ggx)
+		descriptor_set_count += ggx_levels;
+
+	VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+	if (descriptor_set_count > 0)
+	{
+		std::array<VkDescriptorPoolSize, 2> pool_sizes{
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = descriptor_set_count,
+			},
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.descriptorCount = descriptor_set_count,
+			},
+		};
+
+		VkDescriptorPoolCreateInfo pool_ci{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = descriptor_set_count,
+			.poolSizeCount = uint32_t(pool_sizes.size()),
+			.pPoolSizes = pool_sizes.data(),
 		};
-		VK(vkBeginCommandBuffer(cube_command_buffer, &begin_info));
 
-		VkCommandBuffer cmd = cube_command_buffer;
+		VK(vkCreateDescriptorPool(rtg.device, &pool_ci, nullptr, &descriptor_pool));
+	}
+
+	// record compute work:
+	VK(vkResetCommandBuffer(cube_command_buffer, 0));
 
-		// transition storage outputs from UNDEFINED -> GENERAL before compute:
-		auto transition_output_to_general = [&](Helpers::AllocatedImage const &image, uint32_t mip_count)
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+	VK(vkBeginCommandBuffer(cube_command_buffer, &begin_info));
+
+	VkCommandBuffer cmd = cube_command_buffer;
+
+	// transition storage outputs from UNDEFINED -> GENERAL before compute:
+	auto transition_output_to_general = [&](Helpers::AllocatedImage const &image, uint32_t mip_count)
+	{
+		VkImageMemoryBarrier barrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = image.handle,
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = mip_count,
+				.baseArrayLayer = 0,
+				.layerCount = 6,
+			},
+		};
+
+		vkCmdPipelineBarrier(
+			cmd,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+	};
+
+	if (do_lambert)
+	{
+		transition_output_to_general(irradiance_gpu.image, 1);
+	}
+	if (do_ggx)
+	{
+		transition_output_to_general(ggx_gpu.image, ggx_levels);
+	}
+
+	VK(vkEndCommandBuffer(cube_command_buffer));
+
+	{
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &cube_command_buffer,
+		};
+
+		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+		VK(vkQueueWaitIdle(rtg.graphics_queue));
+	}
+
+	// Lambertian dispatch:
+	if (do_lambert)
+	{
+		VkDescriptorSet irradiance_set = make_ibl_descriptor(
+			rtg,
+			descriptor_pool,
+			pipeline.set0_env,
+			env_gpu.sampler,
+			env_gpu.cube_view,
+			irradiance_gpu.storage_views[0]);
+
+		CubePipeline::IrradiancePush ipush{
+			.size = lambert_size,
+			.numSamples = 262144,
+		};
+
+		dispatch_tiled(rtg, cmd, pipeline.irradiance_pipeline, pipeline.irradiance_layout, irradiance_set, ipush, lambert_size, ipush.numSamples, job.tag + "  lambertian");
+
+		HalfCubeFaces lambert;
+		for (uint32_t face = 0; face < 6; ++face)
 		{
-			VkImageMemoryBarrier barrier{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-				.srcAccessMask = 0,
-				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.image = image.handle,
-				.subresourceRange{
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = mip_count,
-					.baseArrayLayer = 0,
-					.layerCount = 6,
-				},
+			lambert[face] = readback_cubemap_face(
+				rtg, irradiance_gpu.image, face, 0, lambert_size);
+		}
+		size_t lambert_bytes = 6 * lambert[0].size() * sizeof(Half4);
+		push_piece(queue, state, lambert_bytes, [lambert = std::move(lambert), lambert_size](EncodeState &encode)
+				   {
+					   size_t face_pixels = size_t(lambert_size) * lambert_size;
+					   std::vector<uint8_t> rgbe(6 * 4 * face_pixels);
+					   for (uint32_t face = 0; face < 6; ++face)
+					   {
+						   half_to_rgbe(lambert[face].data(), rgbe.data() + 4 * face * face_pixels, face_pixels);
+					   }
+					   write_rgbe_cubemap_vertical(encode.job.lambert_out_image, rgbe.data(), lambert_size); });
+	}
+
+	// GGX levels: each starts with a few samples and doubles them until two estimates differ by less than ggx_quality
+	// (filtered importance sampling keeps the counts low, rough levels read blurrier source levels instead of more texels)
+	if (do_ggx)
+	{
+		constexpr uint32_t start_samples = 32;
+		constexpr uint32_t max_samples = 262144; // the old fixed count
+		constexpr float mip_bias = 1.0f;		 // GPU Gems 3 ch. 20 recommends biasing one level blurrier
+
+		auto run_level = [&](VkDescriptorSet set, uint32_t mip, uint32_t mip_size, float roughness, uint32_t samples)
+		{
+			auto before = std::chrono::high_resolution_clock::now();
+
+			CubePipeline::SpecularPush spush{
+				.size = mip_size,
+				.numSamples = samples,
+				.roughness = roughness,
+				.mipBias = mip_bias,
 			};
+			dispatch_tiled(rtg, cmd, pipeline.specular_pipeline, pipeline.specular_layout, set, spush, mip_size, samples,
+						   job.tag + "  level " + std::to_string(mip) + ", " + std::to_string(samples) + " samples");
 
-			vkCmdPipelineBarrier(
-				cmd,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &barrier);
+			auto after = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double, std::milli>(after - before).count();
 		};
 
-		if (do_lambert)
+		auto read_level = [&](uint32_t mip, uint32_t mip_size)
 		{
-			transition_output_to_general(irradiance_gpu.image, 1);
-		}
-		if (do_ggx)
+			HalfCubeFaces faces;
+			for (uint32_t face = 0; face < 6; ++face)
+			{
+				faces[face] = readback_cubemap_face(rtg, ggx_gpu.image, face, mip, mip_size);
+			}
+			return faces;
+		};
+
+		// sum of absolute rgb differences over sum of rgb, so dim texels don't dominate:
+		auto relative_difference = [](HalfCubeFaces const &a, HalfCubeFaces const &b)
 		{
-			transition_output_to_general(ggx_gpu.image, ggx_levels);
+			double difference = 0.0, total = 0.0;
+			for (uint32_t face = 0; face < 6; ++face)
+			{
+				for (size_t i = 0; i < a[face].size(); ++i)
+				{
+					glm::vec4 ca = unpack_half4(a[face][i]);
+					glm::vec4 cb = unpack_half4(b[face][i]);
+					for (int c = 0; c < 3; ++c)
+					{
+						difference += std::abs(double(ca[c]) - double(cb[c]));
+						total += std::abs(double(cb[c]));
+					}
+				}
+			}
+			return total > 0.0 ? float(difference / total) : 0.0f;
+		};
+
+		// faces go to the encoder one at a time, in the packed cubemap's order (level by level, +X to -Z):
+		auto push_level = [&](uint32_t mip, uint32_t mip_size, HalfCubeFaces &&faces)
+		{
+			for (uint32_t face = 0; face < 6; ++face)
+			{
+				size_t bytes = faces[face].size() * sizeof(Half4);
+				push_piece(queue, state, bytes, [mip, mip_size, face, texels = std::move(faces[face])](EncodeState &encode)
+						   { encode_ggx_face(encode, mip, mip_size, face, texels); });
+			}
+		};
+
+		if (!job.packed_out_image.empty())
+		{
+			push_piece(queue, state, 0, [ggx_base_size, ggx_levels](EncodeState &encode)
+					   {
+						   encode.ggx_levels = ggx_levels;
+						   encode.packed = std::make_unique<PackedCubemap::Writer>(encode.job.packed_out_image, VK_FORMAT_E5B9G9R9_UFLOAT_PACK32, ggx_base_size, ggx_levels, uint32_t(sizeof(uint32_t))); });
 		}
 
-		// Lambertian dispatch:
-		if (do_lambert)
 		{
-			VkDescriptorSet irradiance_set = make_ibl_descriptor(
+			std::ostringstream line;
+			line << job.tag << "GGX levels (quality target " << rtg.configuration.ggx_quality << "):";
+			print_line(line.str());
+		}
+		double all_ms = 0.0;
+		for (uint32_t mip = 0; mip < ggx_levels; ++mip)
+		{
+			uint32_t mip_size = std::max(1u, ggx_base_size >> mip);
+			float roughness = (ggx_levels <= 1)
+								  ? 0.0f
+								  : float(mip) / float(ggx_levels - 1);
+
+			VkDescriptorSet spec_set = make_ibl_descriptor(
 				rtg,
 				descriptor_pool,
 				pipeline.set0_env,
 				env_gpu.sampler,
 				env_gpu.cube_view,
-				irradiance_gpu.storage_views[0]);
-
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.irradiance_pipeline);
-			vkCmdBindDescriptorSets(
-				cmd,
-				VK_PIPELINE_BIND_POINT_COMPUTE,
-				pipeline.irradiance_layout,
-				0,
-				1,
-				&irradiance_set,
-				0,
-				nullptr);
+				ggx_gpu.storage_views[mip]);
 
-			CubePipeline::IrradiancePush ipush{
-				.size = lambert_size,
-				.numSamples = 262144,
-			};
+			// roughness 0 is a copy of the source (ggx.comp skips sampling), nothing to refine:
+			uint32_t samples = roughness <= 0.0001f ? 1 : start_samples;
+			double level_ms = run_level(spec_set, mip, mip_size, roughness, samples);
+			float error = 0.0f;
+			if (samples > 1)
+			{
+				// the last estimate read back is the result:
+				HalfCubeFaces latest = read_level(mip, mip_size);
+				while (samples < max_samples)
+				{
+					samples *= 2;
+					level_ms += run_level(spec_set, mip, mip_size, roughness, samples);
+					HalfCubeFaces current = read_level(mip, mip_size);
+					error = relative_difference(latest, current);
+					latest = std::move(current);
+					if (error <= rtg.configuration.ggx_quality)
+						break;
+				}
+				push_level(mip, mip_size, std::move(latest));
+			}
+			else
+			{
+				push_level(mip, mip_size, read_level(mip, mip_size));
+			}
+			all_ms += level_ms;
+
+			std::ostringstream line;
+			line << job.tag << "  level " << mip << ": " << mip_size << "x" << mip_size
+				 << " roughness " << roughness
+				 << ", " << samples << " samples"
+				 << ", error " << error << (error > rtg.configuration.ggx_quality ? " (sample limit reached)" : "")
+				 << ", " << level_ms << " ms";
+			print_line(line.str());
+		}
+		std::ostringstream line;
+		line << job.tag << "GGX total: " << all_ms << " ms";
+		print_line(line.str());
+	}
 
-			vkCmdPushConstants(
-				cmd,
-				pipeline.irradiance_layout,
-				VK_SHADER_STAGE_COMPUTE_BIT,
-				0,
-				sizeof(ipush),
-				&ipush);
+	print_line(job.tag + "Computing: done.");
 
-			vkCmdDispatch(
-				cmd,
-				(lambert_size + 7) / 8,
-				(lambert_size + 7) / 8,
-				6);
+	// diffuse lighting as spherical harmonics, projected on the GPU; the CPU projection (what the renderer falls back to) checks it:
+	if (!job.sh_out.empty())
+	{
+		SH9 sh = project_sh9_gpu(rtg, pipeline, env_gpu, in_size);
+		if (rtg.configuration.debug)
+		{
+			size_t face_pixels = size_t(in_size) * in_size;
+			std::array<std::vector<glm::vec4>, 6> linear;
+			std::array<glm::vec4 const *, 6> faces;
+			for (uint32_t face = 0; face < 6; ++face)
+			{
+				std::vector<glm::vec3> rgb(face_pixels);
+				rgbe_to_linear(input.face(face), rgb.data(), face_pixels);
+				linear[face].reserve(face_pixels);
+				for (glm::vec3 const &c : rgb)
+					linear[face].emplace_back(c, 1.0f);
+				faces[face] = linear[face].data();
+			}
+			SH9 cpu = SH9::project(faces, in_size);
+			float difference = 0.0f;
+			for (uint32_t i = 0; i < 9; ++i)
+				difference = std::max(difference, glm::length(sh.coefficients[i] - cpu.coefficients[i]));
+			std::ostringstream line;
+			line << job.tag << "SH9 GPU vs CPU projection: max coefficient difference " << difference;
+			print_line(line.str());
 		}
+		push_piece(queue, state, 0, [sh](EncodeState &encode)
+				   {
+					   sh.save(encode.job.sh_out);
+					   print_line(encode.job.tag + "Wrote SH9 irradiance to " + encode.job.sh_out); });
+	}
 
-		// GGX dispatch:
-		if (do_ggx)
-		{
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.specular_pipeline);
+	irradiance_gpu.destroy(rtg);
+	ggx_gpu.destroy(rtg);
+	env_gpu.destroy(rtg);
+
+	if (descriptor_pool)
+	{
+		vkDestroyDescriptorPool(rtg.device, descriptor_pool, nullptr);
+		descriptor_pool = VK_NULL_HANDLE;
+	}
+}
+
+// --batch: the input is a directory (every .png in it, by name) or a text file listing one input per line (blank lines
+// and lines starting with # are skipped); each output name's % becomes the input's file name without its extension
+static std::vector<CubeJob> batch_jobs(RTG::Configuration const &configuration)
+{
+	std::vector<std::string> inputs;
 
-			for (uint32_t mip = 0; mip < ggx_levels; ++mip)
+	std::filesystem::path batch = data_path(configuration.in_image);
+	if (std::filesystem::is_directory(batch))
+	{
+		for (auto const &entry : std::filesystem::directory_iterator(batch))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".png")
 			{
-				uint32_t mip_size = std::max(1u, ggx_base_size >> mip);
-				float roughness = (ggx_levels <= 1)
-									  ? 0.0f
-									  : float(mip) / float(ggx_levels - 1);
-
-				VkDescriptorSet spec_set = make_ibl_descriptor(
-					rtg,
-					descriptor_pool,
-					pipeline.set0_env,
-					env_gpu.sampler,
-					env_gpu.cube_view,
-					ggx_gpu.storage_views[mip]);
-
-				vkCmdBindDescriptorSets(
-					cmd,
-					VK_PIPELINE_BIND_POINT_COMPUTE,
-					pipeline.specular_layout,
-					0,
-					1,
-					&spec_set,
-					0,
-					nullptr);
+				// relative to the same place as the batch argument, load_rgbe_cubemap_vertical resolves it with data_path:
+				inputs.emplace_back(configuration.in_image + "/" + entry.path().filename().string());
+			}
+		}
+		std::sort(inputs.begin(), inputs.end());
+	}
+	else
+	{
+		std::ifstream list(batch);
+		if (!list)
+			throw std::runtime_error("Failed to open batch list '" + configuration.in_image + "'.");
+		std::string line;
+		while (std::getline(list, line))
+		{
+			while (!line.empty() && std::isspace((unsigned char)line.back()))
+				line.pop_back();
+			size_t first = line.find_first_not_of(" \t");
+			if (first == std::string::npos || line[first] == '#')
+				continue;
+			inputs.emplace_back(line.substr(first));
+		}
+	}
 
-				CubePipeline::SpecularPush spush{
-					.size = mip_size,
-					.numSamples = 262144,
-					.roughness = roughness,
-					.pad = 0.0f,
-				};
+	if (inputs.empty())
+		throw std::runtime_error("Batch '" + configuration.in_image + "' has no inputs.");
 
-				vkCmdPushConstants(
-					cmd,
-					pipeline.specular_layout,
-					VK_SHADER_STAGE_COMPUTE_BIT,
-					0,
-					sizeof(spush),
-					&spush);
+	auto expand = [](std::string pattern, std::string const &name)
+	{
+		for (size_t at = pattern.find('%'); at != std::string::npos; at = pattern.find('%', at + name.size()))
+			pattern.replace(at, 1, name);
+		return pattern;
+	};
 
-				vkCmdDispatch(
-					cmd,
-					(mip_size + 7) / 8,
-					(mip_size + 7) / 8,
-					6);
-			}
+	std::vector<CubeJob> jobs;
+	for (std::string const &input : inputs)
+	{
+		std::string name = std::filesystem::path(input).stem().string();
+		jobs.emplace_back(CubeJob{
+			.in_image = input,
+			.lambert_out_image = expand(configuration.lambert_out_image, name),
+			.ggx_out_image = expand(configuration.ggx_out_image, name),
+			.packed_out_image = expand(configuration.packed_out_image, name),
+			.sh_out = expand(configuration.sh_out, name),
+		});
+	}
+	return jobs;
+}
+
+int main(int argc, char **argv)
+{
+	// main wrapped in a try-catch so we can print some debug info about uncaught exceptions:
+	try
+	{
+
+		// configure application:
+		RTG::Configuration configuration;
+		configuration.cube = true;
+
+		configuration.application_info = VkApplicationInfo{
+			.pApplicationName = "Cube Render",
+			.applicationVersion = VK_MAKE_VERSION(0, 0, 0),
+			.pEngineName = "Unknown",
+			.engineVersion = VK_MAKE_VERSION(0, 0, 0),
+			.apiVersion = VK_API_VERSION_1_3};
+
+		bool print_usage = false;
+
+		try
+		{
+			configuration.parse(argc, argv);
 		}
+		catch (std::runtime_error &e)
+		{
+			std::cerr << "Failed to parse arguments:\n"
+					  << e.what() << std::endl;
+			print_usage = true;
+		}
+
+		if (print_usage)
+		{
+			std::cerr << "Usage:" << std::endl;
+			RTG::Configuration::cube_usage([](const char *arg, const char *desc)
+										   { std::cerr << "    " << arg << "\n        " << desc << std::endl; });
+			return 1;
+		}
+
+		configuration.headless = true;
+
+		// loads vulkan library, creates surface, initializes helpers:
+		RTG rtg(configuration);
+
+		// TODO: create computation pipeline
+		CubePipeline pipeline;
+		pipeline.create(rtg);
+
+		// TODO: load images / create descriptors
 
-		VK(vkEndCommandBuffer(cube_command_buffer));
+		VkCommandPool cube_command_pool = VK_NULL_HANDLE;
+		VkCommandBuffer cube_command_buffer = VK_NULL_HANDLE;
 
 		{
-			VkSubmitInfo submit_info{
-				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			VkCommandPoolCreateInfo pool_info{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+				.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+				.queueFamilyIndex = rtg.graphics_queue_family.value(),
+			};
+			VK(vkCreateCommandPool(rtg.device, &pool_info, nullptr, &cube_command_pool));
+		}
+
+		{
+			VkCommandBufferAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = cube_command_pool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
 				.commandBufferCount = 1,
-				.pCommandBuffers = &cube_command_buffer,
 			};
+			VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &cube_command_buffer));
+		}
 
-			VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
-			VK(vkQueueWaitIdle(rtg.graphics_queue));
+		std::vector<CubeJob> jobs;
+		if (configuration.cube_batch)
+		{
+			jobs = batch_jobs(configuration);
+			for (size_t i = 0; i < jobs.size(); ++i)
+			{
+				jobs[i].tag = "[" + std::to_string(i + 1) + "/" + std::to_string(jobs.size()) + "] ";
+			}
+		}
+		else
+		{
+			jobs.emplace_back(CubeJob{
+				.in_image = configuration.in_image,
+				.lambert_out_image = configuration.lambert_out_image,
+				.ggx_out_image = configuration.ggx_out_image,
+				.packed_out_image = configuration.packed_out_image,
+				.sh_out = configuration.sh_out,
+			});
 		}
 
-		std::cout << "Computing: done." << std::endl;
+		// decoding the next environment and encoding earlier ones run on worker threads while this thread keeps the GPU busy,
+		// so the GPU isn't idle during file I/O; in a batch a bad input is reported and skipped instead of ending the run:
+		constexpr size_t max_queued_bytes = size_t(1) << 30; // read back faces waiting for (or in) the encoder
+		EncodeQueue queue(max_queued_bytes);
+		std::deque<std::pair<size_t, std::future<void>>> encoding; // (job index, done), oldest first
+		uint32_t failures = 0;
 
-		// read back + save Lambertian:
-		if (do_lambert)
+		auto report = [&](CubeJob const &job, std::exception const &e)
 		{
-			std::array<std::vector<glm::vec4>, 6> result_faces;
-			for (uint32_t face = 0; face < 6; ++face)
+			print_line(job.tag + "WARNING: skipping '" + job.in_image + "': " + e.what(), std::cerr);
+			failures += 1;
+		};
+		// the encoder finishes environments in order, so the oldest is always the next one done:
+		auto collect_encoded = [&](bool wait)
+		{
+			while (!encoding.empty() && (wait || encoding.front().second.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
 			{
-				result_faces[face] = readback_cubemap_face(
-					rtg, irradiance_gpu.image, face, 0, lambert_size);
+				try
+				{
+					encoding.front().second.get();
+				}
+				catch (std::exception &e)
+				{
+					if (!configuration.cube_batch)
+						throw;
+					report(jobs[encoding.front().first], e);
+				}
+				encoding.pop_front();
 			}
+		};
 
-			write_rgbe_cubemap_vertical(
-				rtg.configuration.lambert_out_image,
-				result_faces,
-				lambert_size);
-		}
+		auto before = std::chrono::high_resolution_clock::now();
 
-		// read back + save GGX:
-		if (do_ggx)
+		std::future<CPUCubeMap> next = std::async(std::launch::async, load_rgbe_cubemap_vertical, jobs[0].in_image);
+		for (size_t i = 0; i < jobs.size(); ++i)
 		{
-			auto split_ext = [](std::string const &path)
+			std::future<CPUCubeMap> current = std::move(next);
+			if (i + 1 < jobs.size())
 			{
-				size_t dot = path.find_last_of('.');
-				if (dot == std::string::npos)
-					return std::pair(path, std::string{});
-				return std::pair(path.substr(0, dot), path.substr(dot));
-			};
+				next = std::async(std::launch::async, load_rgbe_cubemap_vertical, jobs[i + 1].in_image);
+			}
 
-			auto [ggx_base, ggx_ext] = split_ext(rtg.configuration.ggx_out_image);
+			if (configuration.cube_batch)
+			{
+				print_line(jobs[i].tag + jobs[i].in_image);
+			}
 
-			for (uint32_t mip = 0; mip < ggx_levels; ++mip)
+			CPUCubeMap input;
+			try
+			{
+				input = current.get();
+			}
+			catch (std::exception &e)
 			{
-				uint32_t mip_size = std::max(1u, ggx_base_size >> mip);
+				if (!configuration.cube_batch)
+					throw;
+				report(jobs[i], e);
+				continue;
+			}
 
-				std::array<std::vector<glm::vec4>, 6> faces;
-				for (uint32_t face = 0; face < 6; ++face)
-				{
-					faces[face] = readback_cubemap_face(
-						rtg, ggx_gpu.image, face, mip, mip_size);
-				}
+			// GPU failures aren't per-input problems, they end the run:
+			std::shared_ptr<EncodeState> state = std::make_shared<EncodeState>();
+			state->job = jobs[i];
+			encoding.emplace_back(i, state->done.get_future());
+			prefilter_environment(rtg, pipeline, cube_command_buffer, input, queue, state);
+			finish_encoding(queue, state);
 
-				std::string out_name = ggx_base + "." + std::to_string(mip + 1) + ggx_ext;
-				write_rgbe_cubemap_vertical(out_name, faces, mip_size);
-			}
+			collect_encoded(false);
 		}
+		collect_encoded(true);
 
-		irradiance_gpu.destroy(rtg);
-		ggx_gpu.destroy(rtg);
-		env_gpu.destroy(rtg);
-
-		if (descriptor_pool)
+		auto after = std::chrono::high_resolution_clock::now();
+		if (configuration.cube_batch)
 		{
-			vkDestroyDescriptorPool(rtg.device, descriptor_pool, nullptr);
-			descriptor_pool = VK_NULL_HANDLE;
+			double seconds = std::chrono::duration<double>(after - before).count();
+			std::cout << "Batch: " << (jobs.size() - failures) << " of " << jobs.size() << " environments in " << seconds << " s ("
+					  << (seconds / double(jobs.size())) << " s each)." << std::endl;
 		}
 
 		vkDestroyCommandPool(rtg.device, cube_command_pool, nullptr);
 		cube_command_pool = VK_NULL_HANDLE;
 
 		pipeline.destroy(rtg);
+
+		if (failures)
+		{
+			std::cerr << failures << " environment(s) failed." << std::endl;
+			return 1;
+		}
 	}
 	catch (std::exception &e)
 	{
@@ -13,7 +13,6 @@ layout(push_constant) uniform tone_map{
 	float expose;
 	int toneMapMode;
 };
-layout(set=0, binding=1) uniform samplerCube IRRADIANCE_MAP;
 layout(set=0, binding=2) uniform samplerCube ENVIRONMENT;
 layout(set=0, binding=3) uniform sampler2D BRDF_LUT;
 
@@ -29,8 +28,9 @@ layout(location=0) out vec4 outColor;
 
 void main() {
 	// Sample the normal map and convert from [0,1] to [-1,1]
-    vec3 normal_rgb = texture(NORMAL, texCoord).rgb; 
-    vec3 tangentNormal = normalize(normal_rgb * 2.0 - 1.0); 
+    // z is rebuilt from xy so two channel (BC5) normal maps work too
+    vec2 normal_xy = texture(NORMAL, texCoord).rg * 2.0 - 1.0;
+    vec3 tangentNormal = normalize(vec3(normal_xy, sqrt(max(0.0, 1.0 - dot(normal_xy, normal_xy)))));
 
     // Transform the normal from tangent space to world space
     vec3 worldNormal = normalize(TBN * tangentNormal); 
@@ -152,4 +152,25 @@ bool check_frustum_obb_intersection(const std::array<glm::vec3, 8>& frustum_vert
     }
     // If no separating axis is found, the OBB and frustum intersect
     return true;
-}
\ No newline at end of file
+}
+
+std::array<glm::vec3, 8> frustum_corners(const glm::mat4x4& clip_from_world)
+{
+    static const std::array<glm::vec4, 8> clip_space_coordinates = {
+        glm::vec4(1.0f, 1.0f, 0.0f, 1.0f),   // Near top right
+        glm::vec4(-1.0f, 1.0f, 0.0f, 1.0f),  // Near top left
+        glm::vec4(1.0f, -1.0f, 0.0f, 1.0f),  // Near bottom right
+        glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f), // Near bottom left
+        glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),   // Far top right
+        glm::vec4(-1.0f, 1.0f, 1.0f, 1.0f),  // Far top left
+        glm::vec4(1.0f, -1.0f, 1.0f, 1.0f),  // Far bottom right
+        glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f)  // Far bottom left
+    };
+    glm::mat4x4 world_from_clip = glm::inverse(clip_from_world);
+    std::array<glm::vec3, 8> corners;
+    for (size_t i = 0; i < 8; ++i) {
+        glm::vec4 world_space_vertex = world_from_clip * clip_space_coordinates[i];
+        corners[i] = glm::vec3(world_space_vertex) / world_space_vertex.w;
+    }
+    return corners;
+}
@@ -48,4 +48,7 @@ bool overlap_on_axis(const std::array<glm::vec3, 8>& frustum_vertices, const OBB
 // Far top left,
 // Far bottom right,
 // Far bottom left
-bool check_frustum_obb_intersection(const std::array<glm::vec3, 8>& frustum_vertices, const OBB& obb);
\ No newline at end of file
+bool check_frustum_obb_intersection(const std::array<glm::vec3, 8>& frustum_vertices, const OBB& obb);
+
+// the corners of clip_from_world's view volume (depth 0 to 1) in the order above, perspective divided:
+std::array<glm::vec3, 8> frustum_corners(const glm::mat4x4& clip_from_world);
@@ -0,0 +1,33 @@
+#include "json_string.hpp"
+
+#include <cstdint>
+
+std::string json_string(std::string const &str)
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string ret = "\"";
+	ret.reserve(str.size() + 2);
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			ret += '\\';
+			ret += c;
+		}
+		else if (c == '\n')
+			ret += "\\n";
+		else if (c == '\r')
+			ret += "\\r";
+		else if (c == '\t')
+			ret += "\\t";
+		else if (uint8_t(c) < 0x20)
+		{
+			ret += "\\u00";
+			ret += hex[uint8_t(c) >> 4];
+			ret += hex[uint8_t(c) & 0xf];
+		}
+		else
+			ret += c;
+	}
+	return ret + "\"";
+}
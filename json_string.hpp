@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// str as a JSON string literal, quotes included; '"', '\' and control characters are escaped, other bytes (UTF-8)
+// are copied as-is. Shared by every JSON report the viewer and tools write (trace, benchmark, startup, regress):
+std::string json_string(std::string const &str);
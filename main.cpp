@@ -3,6 +3,8 @@
 
 #include "scene.hpp"
 #include "Render.hpp"
+#include "Trace.hpp"
+#include "StartupProfile.hpp"
 
 #include <iostream>
 
@@ -37,18 +39,30 @@ int main(int argc, char **argv) {
 			});
 			return 1;
 		}
+		if (configuration.trace_out != "") Trace::start(configuration.trace_out);
+		//the startup report is finished (and printed/written) by rtg.run once the first frame is rendered:
+		if (configuration.startup_report || configuration.startup_report_out != "") StartupProfile::start();
+
 		//loads .s72 scene and information
-		Scene scene(configuration.scene_path, configuration.scene_camera, configuration.animation_settings);
+		Scene scene(configuration.scene_path, configuration.scene_camera, configuration.animation_settings, configuration.debug);
 
 		//loads vulkan library, creates surface, initializes helpers:
 		RTG rtg(configuration);
 
 		//initializes global (whole-life-of-application) resources:
 		Render application(rtg, scene);
+		if (configuration.memory_report) rtg.helpers.report_memory(std::cout);
 
 		//main loop -- handles events, renders frames, etc:
 		rtg.run(application);
 
+		if (configuration.memory_report) rtg.helpers.report_memory(std::cout);
+
+		if (Trace::enabled()) {
+			Trace::write();
+			std::cout << "Wrote trace to " << Trace::path() << std::endl;
+		}
+
 	} catch (std::exception &e) {
 		std::cerr << "Exception: " << e.what() << std::endl;
 		return 1;
@@ -0,0 +1,511 @@
+// microbench: times the viewer's CPU-side hot paths in isolation, no GPU (or window) needed
+//   bin/microbench                          run every kernel with the default sizes
+//   bin/microbench --filter rgbe --out rgbe.json
+// each kernel is run in samples of enough iterations to last --sample-ms; the ns/op of every sample goes into a
+// Benchmark series, so --out writes the same JSON/CSV summaries as the viewer's --benchmark-out
+
+#include "scene.hpp"
+#include "scene_gen.hpp"
+#include "scene_traversal.hpp"
+#include "frustum_culling.hpp"
+#include "ShadowAtlas.hpp"
+#include "Lights.hpp"
+#include "rgbe.hpp"
+#include "mat4.hpp"
+#include "Benchmark.hpp"
+#include "data_path.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct Options
+{
+	std::string filter;			  // only kernels whose name contains this
+	std::string out;			  // .json or .csv summary
+	std::string scene;			  // data_path-relative .s72 to load instead of the generated one
+	uint32_t nodes = 10000;		  // instances in the generated scene
+	uint32_t spots = 16;		  // shadowed spot lights in the generated scene (and atlas regions)
+	uint32_t samples = 15;
+	uint32_t sample_ms = 20;
+	uint32_t seed = 1;
+	bool list = false;
+
+	void parse(int argc, char **argv);
+	static void usage(std::function<void(const char *, const char *)> const &callback);
+};
+
+void Options::parse(int argc, char **argv)
+{
+	for (int argi = 1; argi < argc; ++argi)
+	{
+		std::string arg = argv[argi];
+		auto next = [&]() -> std::string
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error(arg + " requires a parameter.");
+			argi += 1;
+			return argv[argi];
+		};
+		auto next_uint = [&]() -> uint32_t
+		{
+			std::string value = next();
+			size_t used = 0;
+			unsigned long parsed = 0;
+			try
+			{
+				parsed = std::stoul(value, &used);
+			}
+			catch (std::exception &)
+			{
+				used = 0;
+			}
+			if (used != value.size() || value.empty() || value[0] == '-')
+				throw std::runtime_error(arg + " expects a non-negative integer, got '" + value + "'.");
+			return uint32_t(parsed);
+		};
+
+		if (arg == "--filter")
+			filter = next();
+		else if (arg == "--out")
+			out = next();
+		else if (arg == "--scene")
+			scene = next();
+		else if (arg == "--nodes")
+			nodes = next_uint();
+		else if (arg == "--spots")
+			spots = next_uint();
+		else if (arg == "--samples")
+			samples = next_uint();
+		else if (arg == "--sample-ms")
+			sample_ms = next_uint();
+		else if (arg == "--seed")
+			seed = next_uint();
+		else if (arg == "--list")
+			list = true;
+		else
+			throw std::runtime_error("Unrecognized argument '" + arg + "'.");
+	}
+	if (nodes == 0)
+		throw std::runtime_error("--nodes must be at least 1.");
+	if (samples == 0 || sample_ms == 0)
+		throw std::runtime_error("--samples and --sample-ms must be at least 1.");
+}
+
+void Options::usage(std::function<void(const char *, const char *)> const &callback)
+{
+	callback("--filter <text>", "Only run kernels whose name contains <text>.");
+	callback("--list", "List the kernels (after --filter) and exit.");
+	callback("--out <file>", "Write the ns/op summaries, .csv for CSV, anything else JSON.");
+	callback("--scene <path>", "Benchmark the scene kernels on this .s72 (relative to the executable, like the viewer's --scene) instead of a generated one.");
+	callback("--nodes <n>", "Mesh instances in the generated scene (default 10000).");
+	callback("--spots <n>", "Shadowed spot lights in the generated scene and shadow atlas kernels (default 16).");
+	callback("--samples <n>", "Timed samples per kernel (default 15).");
+	callback("--sample-ms <ms>", "Minimum length of each sample, the iteration count is calibrated to it (default 20).");
+	callback("--seed <n>", "Seed for the generated inputs (default 1).");
+}
+
+// results are folded in here so the optimizer can't drop the work:
+static volatile uint64_t sink = 0;
+static void consume(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	sink = sink + bits;
+}
+
+struct Kernel
+{
+	std::string name;
+	std::string unit;	 // what one item is, for throughput
+	double items = 1.0; // per op
+	std::function<void()> op;
+};
+
+static glm::mat4 camera_clip_from_world(glm::vec3 eye, glm::vec3 target, float vfov, float near, float far)
+{
+	glm::vec3 up = std::abs(glm::normalize(target - eye).z) > 0.999f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+	return glm::make_mat4(perspective(vfov, 1.0f, near, far).data()) *
+		   glm::make_mat4(look_at(eye.x, eye.y, eye.z, target.x, target.y, target.z, up.x, up.y, up.z).data());
+}
+
+// Scene::load reports everything it read on std::cout, which would drown the results:
+struct QuietCout
+{
+	std::ostringstream discard;
+	std::streambuf *saved;
+	QuietCout() : saved(std::cout.rdbuf(discard.rdbuf())) {}
+	~QuietCout() { std::cout.rdbuf(saved); }
+};
+
+int main(int argc, char **argv)
+{
+	// main wrapped in a try-catch so we can print some debug info about uncaught exceptions:
+	try
+	{
+		Options options;
+		try
+		{
+			options.parse(argc, argv);
+		}
+		catch (std::runtime_error &e)
+		{
+			std::cerr << "Failed to parse arguments:\n"
+					  << e.what() << std::endl;
+			std::cerr << "Usage:" << std::endl;
+			Options::usage([](const char *arg, const char *desc)
+						   { std::cerr << "    " << arg << "\n        " << desc << std::endl; });
+			return 1;
+		}
+
+		std::mt19937 mt(options.seed);
+		auto uniform = [&](float lo, float hi)
+		{
+			return std::uniform_real_distribution<float>(lo, hi)(mt);
+		};
+
+		//------------------------------------------
+		// inputs
+
+		// the scene kernels share one scene, generated by scene-gen's generator (into its own directory next to the
+		// executable, where Scene resolves paths) unless --scene was given:
+		std::string scene_file = options.scene;
+		std::string generated_directory;
+		if (scene_file.empty())
+		{
+			scene_file = "microbench-scene/microbench-scene.s72";
+			generated_directory = data_path("microbench-scene");
+			generate_scene(SceneGenSettings{
+				.out = data_path(scene_file),
+				.seed = options.seed,
+				.nodes = options.nodes,
+				.depth = 4,
+				.spots = options.spots,
+				.drivers = options.nodes / 10,
+				.texture_size = 16,
+				.environment_size = 16,
+			});
+		}
+		std::unique_ptr<Scene> scene;
+		{
+			QuietCout quiet;
+			scene = std::make_unique<Scene>(scene_file, std::nullopt, uint8_t(1));
+		}
+
+		// random OBBs over the scene's extent, and a camera frustum that sees roughly a quarter of them:
+		const uint32_t box_count = 4096;
+		std::vector<glm::mat4> box_transforms(box_count);
+		std::vector<OBB> boxes(box_count);
+		AABB unit_box{.min = glm::vec3(-0.5f), .max = glm::vec3(0.5f)};
+		for (uint32_t i = 0; i < box_count; ++i)
+		{
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(uniform(-40.0f, 40.0f), uniform(-40.0f, 40.0f), uniform(0.0f, 4.0f)));
+			transform = glm::rotate(transform, uniform(0.0f, 6.2831853f), glm::normalize(glm::vec3(uniform(-1.0f, 1.0f), uniform(-1.0f, 1.0f), 1.0f)));
+			transform = glm::scale(transform, glm::vec3(uniform(0.5f, 2.0f)));
+			box_transforms[i] = transform;
+			boxes[i] = AABB_transform_to_OBB(transform, unit_box);
+		}
+		std::array<glm::vec3, 8> camera_frustum = frustum_corners(camera_clip_from_world(glm::vec3(-30.0f, -30.0f, 10.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.8f, 0.1f, 100.0f));
+
+		// one frustum per shadowed spot light in the scene, as Render::update builds its light_frustums:
+		std::vector<std::array<glm::vec3, 8>> light_frustums;
+		for (Scene::LightInstance const &instance : scene->spot_lights_sorted_indices)
+			light_frustums.emplace_back(frustum_corners(spot_light_clip_from_world(*scene, instance)));
+		std::vector<AABB> mesh_AABBs(scene->meshes.size(), unit_box); // Scene doesn't read vertices, so every mesh gets the unit box
+
+		// spot lights to pack, sorted largest shadow first as Scene sorts them:
+		std::vector<SpotLight> spot_lights(std::max(1u, options.spots));
+		std::vector<Scene::LightInstance> sorted_spots(spot_lights.size());
+		for (uint32_t i = 0; i < spot_lights.size(); ++i)
+		{
+			spot_lights[i].shadow_size = 1024u >> (i * 4 / uint32_t(spot_lights.size()));
+			spot_lights[i].LIGHT_FROM_WORLD = camera_clip_from_world(glm::vec3(uniform(-40.0f, 40.0f), uniform(-40.0f, 40.0f), 10.0f), glm::vec3(0.0f), 0.9f, 0.02f, 40.0f);
+			sorted_spots[i] = Scene::LightInstance{.lights_index = i, .spot_lights_index = i, .local_to_world = {}};
+		}
+		ShadowAtlas atlas(4096);
+		uint8_t reduction = 0;
+		{
+			uint64_t total = 0;
+			for (auto const &light : spot_lights)
+				total += uint64_t(light.shadow_size) * light.shadow_size;
+			while (total > uint64_t(atlas.size) * atlas.size)
+			{
+				total /= 4;
+				++reduction;
+			}
+		}
+		atlas.update_regions(spot_lights, sorted_spots, reduction);
+
+		// rgbe images, a 1024x1024 face's worth of pixels:
+		const size_t pixel_count = 1024 * 1024;
+		std::vector<uint8_t> rgbe(pixel_count * 4);
+		std::vector<glm::vec4> linear(pixel_count);
+		for (size_t i = 0; i < pixel_count; ++i)
+		{
+			glm::vec3 color(uniform(0.0f, 4.0f), uniform(0.0f, 4.0f), uniform(0.0f, 4.0f));
+			linear[i] = glm::vec4(color, 1.0f);
+			glm::u8vec4 packed = float_to_rgbe(color);
+			std::memcpy(&rgbe[i * 4], &packed, 4);
+		}
+		std::vector<uint32_t> e5b9g9r9(pixel_count);
+		std::vector<glm::vec3> rgb(pixel_count);
+		std::vector<uint16_t> half(pixel_count * 4);
+		std::vector<uint8_t> rgbe_out(pixel_count * 4);
+
+		// Render::update's "traversal, culling and lights" pass: SceneTraversal walks the hierarchy (transform stack, normal
+		// matrix, OBB), then every mesh instance is tested against the camera and light frustums into per-material lists;
+		// only the Vulkan-side bookkeeping (ObjectInstance, texture streaming requests) is left out:
+		SceneTraversal traversal;
+		std::array<std::vector<uint32_t>, 4> in_view; // by Scene::Material::MaterialType
+		std::vector<std::array<std::vector<uint32_t>, 4>> in_lights(light_frustums.size());
+		// returns the number of instances visited:
+		auto traverse = [&]() -> uint32_t
+		{
+			for (std::vector<uint32_t> &list : in_view)
+				list.clear();
+			for (std::array<std::vector<uint32_t>, 4> &lists : in_lights)
+			{
+				for (std::vector<uint32_t> &list : lists)
+					list.clear();
+			}
+			traversal.update(*scene, mesh_AABBs);
+			for (uint32_t instance_index = 0; instance_index < traversal.meshes.size(); ++instance_index)
+			{
+				SceneTraversal::Mesh const &instance = traversal.meshes[instance_index];
+				uint32_t material_type = uint32_t(scene->materials[scene->meshes[instance.mesh_index].material_index].material_type);
+				if (check_frustum_obb_intersection(camera_frustum, instance.obb))
+					in_view[material_type].emplace_back(instance_index);
+				for (uint32_t f = 0; f < light_frustums.size(); ++f)
+				{
+					if (check_frustum_obb_intersection(light_frustums[f], instance.obb))
+						in_lights[f][material_type].emplace_back(instance_index);
+				}
+			}
+			sink = sink + in_view[0].size() + traversal.lights.size();
+			return uint32_t(traversal.meshes.size());
+		};
+
+		//------------------------------------------
+		// kernels
+
+		std::vector<Kernel> kernels;
+		kernels.emplace_back(Kernel{
+			.name = "frustum_obb_intersection",
+			.unit = "boxes",
+			.items = double(box_count),
+			.op = [&]()
+			{
+				uint32_t inside = 0;
+				for (OBB const &obb : boxes)
+					inside += check_frustum_obb_intersection(camera_frustum, obb) ? 1 : 0;
+				sink = sink + inside;
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "aabb_transform_to_obb",
+			.unit = "boxes",
+			.items = double(box_count),
+			.op = [&]()
+			{
+				for (uint32_t i = 0; i < box_count; ++i)
+					boxes[i] = AABB_transform_to_OBB(box_transforms[i], unit_box);
+				consume(boxes[box_count / 2].center.x);
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "scene_update_drivers",
+			.unit = "drivers",
+			.items = double(std::max<size_t>(1, scene->drivers.size())),
+			.op = [&]()
+			{
+				scene->update_drivers(1.0f / 60.0f);
+				if (!scene->drivers.empty())
+					consume(scene->nodes[scene->drivers[0].node_index].transform.position.z);
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "scene_traversal",
+			.unit = "instances",
+			.items = double(std::max(1u, traverse())),
+			.op = [&]()
+			{
+				traverse();
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "scene_load",
+			.unit = "nodes",
+			.items = double(std::max<size_t>(1, scene->nodes.size())),
+			.op = [&]()
+			{
+				QuietCout quiet;
+				Scene loaded(scene_file, std::nullopt, uint8_t(1));
+				sink = sink + loaded.nodes.size();
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "shadow_atlas_update_regions",
+			.unit = "lights",
+			.items = double(spot_lights.size()),
+			.op = [&]()
+			{
+				atlas.update_regions(spot_lights, sorted_spots, reduction);
+				sink = sink + atlas.regions.back().x;
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "shadow_atlas_matrix",
+			.unit = "lights",
+			.items = double(spot_lights.size()),
+			.op = [&]()
+			{
+				for (uint32_t i = 0; i < spot_lights.size(); ++i)
+					spot_lights[i].ATLAS_COORD_FROM_WORLD = ShadowAtlas::calculate_shadow_atlas_matrix(spot_lights[i].LIGHT_FROM_WORLD, atlas.regions[i], int(atlas.size));
+				consume(spot_lights[0].ATLAS_COORD_FROM_WORLD[3][0]);
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "rgbe_to_E5B9G9R9",
+			.unit = "pixels",
+			.items = double(pixel_count),
+			.op = [&]()
+			{
+				rgbe_to_E5B9G9R9(rgbe.data(), e5b9g9r9.data(), pixel_count);
+				sink = sink + e5b9g9r9[pixel_count / 2];
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "rgbe_to_linear",
+			.unit = "pixels",
+			.items = double(pixel_count),
+			.op = [&]()
+			{
+				rgbe_to_linear(rgbe.data(), rgb.data(), pixel_count);
+				consume(rgb[pixel_count / 2].r);
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "linear_to_rgbe",
+			.unit = "pixels",
+			.items = double(pixel_count),
+			.op = [&]()
+			{
+				linear_to_rgbe(linear.data(), rgbe_out.data(), pixel_count);
+				sink = sink + rgbe_out[pixel_count * 2];
+			},
+		});
+		kernels.emplace_back(Kernel{
+			.name = "rgbe_to_half",
+			.unit = "pixels",
+			.items = double(pixel_count),
+			.op = [&]()
+			{
+				rgbe_to_half(rgbe.data(), half.data(), pixel_count);
+				sink = sink + half[pixel_count * 2];
+			},
+		});
+
+		kernels.erase(std::remove_if(kernels.begin(), kernels.end(), [&](Kernel const &kernel)
+									 { return kernel.name.find(options.filter) == std::string::npos; }),
+					  kernels.end());
+		if (options.list)
+		{
+			for (Kernel const &kernel : kernels)
+				std::cout << kernel.name << "\n";
+			std::cout.flush();
+			if (!generated_directory.empty())
+				std::filesystem::remove_all(generated_directory);
+			return 0;
+		}
+
+		//------------------------------------------
+		// measurement
+
+		std::cout << "Scene: " << scene->nodes.size() << " nodes, " << scene->drivers.size() << " drivers, "
+				  << scene->spot_lights_sorted_indices.size() << " shadowed spots" << (options.scene.empty() ? " (generated)" : "")
+				  << "; rgbe conversions take the " << rgbe_simd_path() << " path." << std::endl;
+
+		using clock = std::chrono::steady_clock;
+		Benchmark benchmark;
+		benchmark.device = "cpu";
+		benchmark.measured_frames = options.samples;
+
+		std::cout << "  " << std::left << std::setw(30) << "kernel" << std::right << std::setw(14) << "ns/op" << std::setw(14) << "min"
+				  << std::setw(14) << "p95" << std::setw(16) << "throughput" << "\n";
+		for (Kernel &kernel : kernels)
+		{
+			// calibrate: double the iterations until one sample lasts sample_ms (this also warms caches up):
+			double sample_ns = double(options.sample_ms) * 1e6;
+			uint64_t iterations = 1;
+			while (true)
+			{
+				clock::time_point before = clock::now();
+				for (uint64_t i = 0; i < iterations; ++i)
+					kernel.op();
+				double elapsed = double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - before).count());
+				if (elapsed >= sample_ns)
+					break;
+				iterations = elapsed <= 0.0 ? iterations * 2 : std::max(iterations + 1, uint64_t(double(iterations) * std::min(2.0, sample_ns / elapsed * 1.1)));
+			}
+
+			std::string series = kernel.name + "_ns";
+			for (uint32_t s = 0; s < options.samples; ++s)
+			{
+				clock::time_point before = clock::now();
+				for (uint64_t i = 0; i < iterations; ++i)
+					kernel.op();
+				double elapsed = double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - before).count());
+				benchmark.add(series, elapsed / double(iterations));
+			}
+
+			Benchmark::Summary summary = Benchmark::summarize(benchmark.series.back().values);
+			double per_second = kernel.items / (summary.median * 1e-9);
+			std::ostringstream throughput;
+			throughput << std::fixed << std::setprecision(1);
+			if (per_second >= 1e9)
+				throughput << per_second * 1e-9 << " G";
+			else if (per_second >= 1e6)
+				throughput << per_second * 1e-6 << " M";
+			else if (per_second >= 1e3)
+				throughput << per_second * 1e-3 << " k";
+			else
+				throughput << per_second << " ";
+			throughput << kernel.unit << "/s";
+
+			std::cout << "  " << std::left << std::setw(30) << kernel.name << std::right << std::fixed << std::setprecision(1)
+					  << std::setw(14) << summary.median << std::setw(14) << summary.min << std::setw(14) << summary.p95
+					  << std::setw(16) << throughput.str() << "\n";
+			std::cout.unsetf(std::ios::floatfield);
+			std::cout.flush();
+
+			// throughput alongside the times, in items per second:
+			benchmark.add(kernel.name + "_per_second", per_second);
+		}
+
+		if (!options.out.empty())
+		{
+			benchmark.write(options.out);
+			std::cout << "Wrote microbenchmark results to " << options.out << std::endl;
+		}
+		if (!generated_directory.empty())
+			std::filesystem::remove_all(generated_directory);
+	}
+	catch (std::exception &e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -15,6 +15,10 @@ layout(set=0,binding=0,std140) uniform World {
 	uint SUN_LIGHT_COUNT;
 	uint SPHERE_LIGHT_COUNT;
 	uint SPOT_LIGHT_COUNT;
+	uint SHADOW_ATLAS_SIZE;
+	mat4 CLUSTER_FROM_WORLD;
+	float CLUSTER_NEAR;
+	float CLUSTER_LOG_SCALE;
 };
 
 layout(push_constant) uniform push{
@@ -39,6 +43,14 @@ layout(set=0, binding=6, std140) readonly buffer SpotLights {
 
 layout(set=0, binding=7) uniform sampler2DShadow SHADOW_ATLAS;
 
+#ifndef CLUSTER
+	#include "cluster.glsl"
+#endif
+
+
+// shading variants, see Render::ShadingFeature:
+layout(constant_id = 0) const bool NORMAL_MAP = true;
+layout(constant_id = 1) const bool SHADOWS = true;
 
 layout(set=2, binding=0) uniform sampler2D NORMAL;
 layout(set=2, binding=1) uniform sampler2D DISPLACEMENT;
@@ -66,9 +78,12 @@ vec3 computeDirectLightDiffuse(vec3 worldNormal, vec3 albedo) {
         light_energy += (float(aboveHorizon) * NdotL + float(!aboveHorizon) * (factor * light.SIN_ANGLE)) * light.ENERGY * (albedo );
     }
 
+    // only the sphere and spot lights binned into this fragment's cluster can reach it
+    uvec4 cluster = clusterRange(position);
+
     // Sphere Lights
-    for (uint i = 0; i < SPHERE_LIGHT_COUNT; ++i) {
-        SphereLight light = SPHERELIGHTS[i];
+    for (uint c = 0; c < cluster.y; ++c) {
+        SphereLight light = SPHERELIGHTS[CLUSTER_LIGHTS[cluster.x + c]];
         vec3 L = normalize(light.POSITION - position);
         float d = length(light.POSITION - position);
 		
@@ -93,12 +108,12 @@ vec3 computeDirectLightDiffuse(vec3 worldNormal, vec3 albedo) {
     }
 	
     // Spot Lights
-    for (uint i = 0; i < SPOT_LIGHT_COUNT; ++i) {
-        SpotLight light = SPOTLIGHTS[i];
+    for (uint c = 0; c < cluster.w; ++c) {
+        SpotLight light = SPOTLIGHTS[CLUSTER_LIGHTS[cluster.z + c]];
 
 		float shadowTerm = 1.0f;
 		//calculate shadow
-		if (light.SHADOW_SIZE > 0) {
+		if (SHADOWS && light.SHADOW_SIZE > 0) {
 			vec4 clipPosition = light.LIGHT_FROM_WORLD * vec4(position, 1.0);
 			if (!(clipPosition.x < - clipPosition.w || clipPosition.x > clipPosition.w || 
 				clipPosition.y < - clipPosition.w || clipPosition.y > clipPosition.w ||
@@ -151,12 +166,17 @@ void main() {
 
 	vec3 albedo = texture(ALBEDO, texCoord).rgb;
 
-	// Sample the normal map and convert from [0,1] to [-1,1]
-    vec3 normal_rgb = texture(NORMAL, texCoord).rgb; 
-    vec3 tangentNormal = normalize(normal_rgb * 2.0 - 1.0); 
+	// the default normal map is flat, so only sample when the material has its own
+	vec3 worldNormal = TBN[2];
+	if (NORMAL_MAP) {
+		// Sample the normal map and convert from [0,1] to [-1,1]
+		// z is rebuilt from xy so two channel (BC5) normal maps work too
+		vec2 normal_xy = texture(NORMAL, texCoord).rg * 2.0 - 1.0;
+		vec3 tangentNormal = normalize(vec3(normal_xy, sqrt(max(0.0, 1.0 - dot(normal_xy, normal_xy)))));
 
-    // Transform the normal from tangent space to world space
-    vec3 worldNormal = TBN * tangentNormal;
+		// Transform the normal from tangent space to world space
+		worldNormal = TBN * tangentNormal;
+	}
 
 	vec3 irradiance = textureLod(ENVIRONMENT, worldNormal, ENVIRONMENT_MIPS).rgb;
 
@@ -16,12 +16,15 @@ layout(set=0,binding=0,std140) uniform World {
 	uint SPHERE_LIGHT_COUNT;
 	uint SPOT_LIGHT_COUNT;
 	uint SHADOW_ATLAS_SIZE;
+	mat4 CLUSTER_FROM_WORLD;
+	float CLUSTER_NEAR;
+	float CLUSTER_LOG_SCALE;
+	vec4 IRRADIANCE_SH[9]; // rgb, convolved spherical harmonics of the environment (SphericalHarmonics.hpp)
 };
 layout(push_constant) uniform tone_map{
 	float expose;
 	int toneMapMode;
 };
-layout(set=0,binding=1) uniform samplerCube IRRADIANCE_MAP;
 layout(set=0, binding=2) uniform samplerCube ENVIRONMENT;
 layout(set=0, binding=3) uniform sampler2D BRDF_LUT;
 
@@ -39,11 +42,17 @@ layout(set=0, binding=6, std140) readonly buffer SpotLights {
 
 layout(set=0, binding=7) uniform sampler2DShadow SHADOW_ATLAS;
 
+#ifndef CLUSTER
+	#include "cluster.glsl"
+#endif
+
+// shading variants, see Render::ShadingFeature:
+layout(constant_id = 0) const bool NORMAL_MAP = true;
+layout(constant_id = 1) const bool SHADOWS = true;
+
 layout(set=2, binding=0) uniform sampler2D NORMAL;
-layout(set=2, binding=1) uniform sampler2D DISPLACEMENT;
+layout(set=2, binding=1) uniform sampler2D ORM; // packed at load: r = roughness, g = metalness
 layout(set=2, binding=2) uniform sampler2D ALBEDO;
-layout(set=2, binding=3) uniform sampler2D ROUGHNESS;
-layout(set=2, binding=4) uniform sampler2D METALNESS;
 
 layout(location=0) in vec3 position;
 layout(location=1) in vec2 texCoord;
@@ -53,6 +62,21 @@ layout(location=0) out vec4 outColor;
 
 //partly from https://learnopengl.com/PBR/IBL/Specular-IBL and https://learnopengl.com/code_viewer_gh.php?code=src/6.pbr/2.2.2.ibl_specular_textured/2.2.2.pbr.fs
 
+// cosine-weighted mean environment radiance around n, what an irradiance cubemap would hold:
+vec3 sh_irradiance(vec3 n)
+{
+	vec3 result = IRRADIANCE_SH[0].rgb * 0.282095;
+	result += IRRADIANCE_SH[1].rgb * (0.488603 * n.y);
+	result += IRRADIANCE_SH[2].rgb * (0.488603 * n.z);
+	result += IRRADIANCE_SH[3].rgb * (0.488603 * n.x);
+	result += IRRADIANCE_SH[4].rgb * (1.092548 * n.x * n.y);
+	result += IRRADIANCE_SH[5].rgb * (1.092548 * n.y * n.z);
+	result += IRRADIANCE_SH[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0));
+	result += IRRADIANCE_SH[7].rgb * (1.092548 * n.x * n.z);
+	result += IRRADIANCE_SH[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+	return max(result, vec3(0.0)); // ringing can dip below zero opposite bright lights
+}
+
 vec3 FresnelSchlickRoughness(float cosTheta, float roughness, vec3 F0)
 {
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
@@ -136,9 +160,12 @@ vec3 computeDirectLight(vec3 worldNormal, vec3 viewDir, vec3 reflectDir, vec3 al
 		light_energy += diffuse + specular ;
     }
 
+    // only the sphere and spot lights binned into this fragment's cluster can reach it
+    uvec4 cluster = clusterRange(position);
+
     // Sphere Lights
-    for (uint i = 0; i < SPHERE_LIGHT_COUNT; ++i) {
-        SphereLight light = SPHERELIGHTS[i];
+    for (uint c = 0; c < cluster.y; ++c) {
+        SphereLight light = SPHERELIGHTS[CLUSTER_LIGHTS[cluster.x + c]];
 		vec3 lightRelativePosition = light.POSITION - position;
         vec3 L = normalize(lightRelativePosition);
         float d = length(light.POSITION - position);
@@ -175,12 +202,12 @@ vec3 computeDirectLight(vec3 worldNormal, vec3 viewDir, vec3 reflectDir, vec3 al
     }
 	
     // Spot Lights
-    for (uint i = 0; i < SPOT_LIGHT_COUNT; ++i) {
-        SpotLight light = SPOTLIGHTS[i];
+    for (uint c = 0; c < cluster.w; ++c) {
+        SpotLight light = SPOTLIGHTS[CLUSTER_LIGHTS[cluster.z + c]];
 
 		float shadowTerm = 1.0f;
 		// calculate shadow
-		if (light.SHADOW_SIZE > 0) {
+		if (SHADOWS && light.SHADOW_SIZE > 0) {
 			vec4 clipPosition = light.LIGHT_FROM_WORLD * vec4(position, 1.0);
 			if (!(clipPosition.x < - clipPosition.w || clipPosition.x > clipPosition.w || 
 				clipPosition.y < - clipPosition.w || clipPosition.y > clipPosition.w ||
@@ -249,23 +276,28 @@ void main() {
 
 	vec3 F0 = vec3(0.04,0.04,0.04);
 	vec3 albedo = texture(ALBEDO, texCoord).rgb;
-	float metalness = texture(METALNESS, texCoord).r;
+	vec2 orm = texture(ORM, texCoord).rg;
+	float metalness = orm.g;
 	//tint for metallic surface
 	F0 = mix(F0, albedo, metalness);
 
-	// Sample the normal map and convert from [0,1] to [-1,1]
+	// the default normal map is flat, so only sample when the material has its own
+	vec3 worldNormal = normalize(TBN[2]);
+	if (NORMAL_MAP) {
+		// Sample the normal map and convert from [0,1] to [-1,1]
+		// z is rebuilt from xy so two channel (BC5) normal maps work too
+		vec2 normal_xy = texture(NORMAL, texCoord).rg * 2.0 - 1.0;
+		vec3 tangentNormal = normalize(vec3(normal_xy, sqrt(max(0.0, 1.0 - dot(normal_xy, normal_xy)))));
 
-    vec3 normal_rgb = texture(NORMAL, texCoord).rgb; 
-    vec3 tangentNormal = normalize(normal_rgb * 2.0 - 1.0); 
-
-    // Transform the normal from tangent space to world space
-    vec3 worldNormal = normalize(TBN * tangentNormal);
+		// Transform the normal from tangent space to world space
+		worldNormal = normalize(TBN * tangentNormal);
+	}
 
 	vec3 viewDir = normalize(CAMERA_POSITION - position);
 	vec3 reflectDir = normalize(reflect(-viewDir,worldNormal));
 	    float NdotV = max(dot(worldNormal, viewDir), 0.0);
 	
-		float roughness = texture(ROUGHNESS, texCoord).r;
+		float roughness = orm.r;
 
 float mip = roughness * float(ENVIRONMENT_MIPS);
 
@@ -274,7 +306,7 @@ vec3 radiance = textureLod(
     normalize(reflect(-viewDir, worldNormal)),
     mip
 ).rgb;
-	vec3 irradiance = textureLod(IRRADIANCE_MAP, worldNormal,0.0).rgb;
+	vec3 irradiance = sh_irradiance(worldNormal);
 
 
 	vec2 brdfCoord = vec2(NdotV ,roughness);
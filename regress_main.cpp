@@ -0,0 +1,804 @@
+// regress: the regression gate -- renders every case of a manifest with the headless viewer, compares the frames it
+// saves against golden images and its benchmark statistics against stored baselines, and reports pass/fail per check
+//   bin/regress --manifest regress/manifest.json            check everything, exit status 1 if anything failed
+//   bin/regress --manifest regress/manifest.json --update   (re)write the goldens and baselines from this build
+//
+// manifest (golden and baseline paths are relative to the manifest; scene is handed to the viewer's --scene as is,
+// so it is relative to the viewer's executable):
+// {
+//   "cases": [
+//     { "name": "sponza-main", "scene": "sponza.s72", "camera": "main", "args": ["--drawing-size", "640", "360"],
+//       "frames": [ { "dt": 0.0, "golden": "golden/sponza-main-0.ppm" }, { "dt": 0.5 }, { "dt": 0.5, "golden": "golden/sponza-main-1.ppm" } ],
+//       "tolerance": 8, "max_differing": 0.001,
+//       "benchmark": { "warmup": 30, "frames": 300, "baseline": "baselines/sponza-main.json", "series": ["frame_ms", "gpu_ms"],
+//                      "slowdown": 1.1, "args": ["--replay", "sponza-main.nkframe"] } }
+//   ]
+// }
+// frames are sent to the viewer as `AVAILABLE dt [save.ppm]` events (a frame without a golden only advances time);
+// tolerance, max_differing and slowdown fall back to the command-line values
+
+#include "data_path.hpp"
+#include "json_string.hpp"
+
+#include "../Lib/sejp.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+struct Options
+{
+	std::string manifest;
+	std::string viewer;		// default: viewer next to this executable
+	std::string work;		// rendered frames, benchmark output, diff images and viewer logs; default: regress-out next to this executable
+	std::string report;		// JSON pass/fail report
+	std::string filter;		// only cases whose name contains this
+	uint32_t tolerance = 8; // per-channel difference (of 255) a pixel may have and still match
+	double max_differing = 0.001; // fraction of pixels allowed past tolerance
+	double slowdown = 1.10;		  // allowed ratio of statistic to the baseline's
+	std::string statistic = "median";
+	bool update = false;
+	bool images = true;
+	bool timings = true;
+
+	void parse(int argc, char **argv);
+	static void usage(std::function<void(const char *, const char *)> const &callback);
+};
+
+void Options::parse(int argc, char **argv)
+{
+	for (int argi = 1; argi < argc; ++argi)
+	{
+		std::string arg = argv[argi];
+		auto next = [&]() -> std::string
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error(arg + " requires a parameter.");
+			argi += 1;
+			return argv[argi];
+		};
+		auto next_number = [&]() -> double
+		{
+			std::string value = next();
+			size_t used = 0;
+			double parsed = 0.0;
+			try
+			{
+				parsed = std::stod(value, &used);
+			}
+			catch (std::exception &)
+			{
+				used = 0;
+			}
+			if (used != value.size() || value.empty() || !(parsed >= 0.0))
+				throw std::runtime_error(arg + " expects a non-negative number, got '" + value + "'.");
+			return parsed;
+		};
+
+		if (arg == "--manifest")
+			manifest = next();
+		else if (arg == "--viewer")
+			viewer = next();
+		else if (arg == "--work")
+			work = next();
+		else if (arg == "--report")
+			report = next();
+		else if (arg == "--filter")
+			filter = next();
+		else if (arg == "--tolerance")
+		{
+			double value = next_number();
+			if (value > 255.0 || value != std::floor(value))
+				throw std::runtime_error("--tolerance expects an integer from 0 to 255.");
+			tolerance = uint32_t(value);
+		}
+		else if (arg == "--max-differing")
+		{
+			max_differing = next_number();
+			if (max_differing > 1.0)
+				throw std::runtime_error("--max-differing is a fraction of the pixels, at most 1.");
+		}
+		else if (arg == "--slowdown")
+		{
+			slowdown = next_number();
+			if (slowdown < 1.0)
+				throw std::runtime_error("--slowdown is a ratio to the baseline, at least 1.");
+		}
+		else if (arg == "--statistic")
+		{
+			statistic = next();
+			if (statistic != "min" && statistic != "median" && statistic != "p95" && statistic != "p99" && statistic != "mean")
+				throw std::runtime_error("--statistic must be one of min, median, p95, p99, mean.");
+		}
+		else if (arg == "--update")
+			update = true;
+		else if (arg == "--images-only")
+			timings = false;
+		else if (arg == "--timings-only")
+			images = false;
+		else
+			throw std::runtime_error("Unrecognized argument '" + arg + "'.");
+	}
+	if (manifest.empty())
+		throw std::runtime_error("--manifest is required.");
+	if (!images && !timings)
+		throw std::runtime_error("--images-only and --timings-only leave nothing to check.");
+	if (viewer.empty())
+	{
+#ifdef _WIN32
+		viewer = data_path("viewer.exe");
+#else
+		viewer = data_path("viewer");
+#endif
+	}
+	if (work.empty())
+		work = data_path("regress-out");
+}
+
+void Options::usage(std::function<void(const char *, const char *)> const &callback)
+{
+	callback("--manifest <file.json>", "The cases to run (required; the format is described at the top of regress_main.cpp).");
+	callback("--viewer <path>", "Viewer executable to run (default: viewer next to this executable).");
+	callback("--work <dir>", "Where rendered frames, benchmark output, diff images and viewer logs go (default: regress-out next to this executable).");
+	callback("--report <file.json>", "Also write the pass/fail report as JSON.");
+	callback("--filter <text>", "Only run cases whose name contains <text>.");
+	callback("--tolerance <0-255>", "Per-channel difference a pixel may have and still match its golden (default 8).");
+	callback("--max-differing <fraction>", "Fraction of pixels allowed past the tolerance (default 0.001).");
+	callback("--slowdown <ratio>", "Fail timings whose statistic exceeds the baseline's by more than <ratio> (default 1.10).");
+	callback("--statistic <min|median|p95|p99|mean>", "Which benchmark statistic to compare (default median).");
+	callback("--update", "Write this build's frames and timings as the new goldens and baselines instead of checking.");
+	callback("--images-only, --timings-only", "Skip the benchmark runs, or the golden image comparisons.");
+}
+
+//------------------------------------------
+// manifest
+
+using Object = std::map<std::string, sejp::value>;
+
+static std::optional<sejp::value> find(Object const &object, std::string const &key)
+{
+	auto found = object.find(key);
+	if (found == object.end())
+		return std::nullopt;
+	return found->second;
+}
+
+static std::string get_string(Object const &object, std::string const &key, std::string const &context, std::optional<std::string> fallback = std::nullopt)
+{
+	std::optional<sejp::value> value = find(object, key);
+	if (!value)
+	{
+		if (fallback)
+			return *fallback;
+		throw std::runtime_error(context + " is missing \"" + key + "\".");
+	}
+	std::optional<std::string> ret = value->as_string();
+	if (!ret)
+		throw std::runtime_error(context + "'s \"" + key + "\" should be a string.");
+	return *ret;
+}
+
+static double get_number(Object const &object, std::string const &key, std::string const &context, double fallback)
+{
+	std::optional<sejp::value> value = find(object, key);
+	if (!value)
+		return fallback;
+	std::optional<double> ret = value->as_number();
+	if (!ret)
+		throw std::runtime_error(context + "'s \"" + key + "\" should be a number.");
+	return *ret;
+}
+
+static std::vector<std::string> get_strings(Object const &object, std::string const &key, std::string const &context, std::vector<std::string> const &fallback)
+{
+	std::optional<sejp::value> value = find(object, key);
+	if (!value)
+		return fallback;
+	std::optional<std::vector<sejp::value>> array = value->as_array();
+	if (!array)
+		throw std::runtime_error(context + "'s \"" + key + "\" should be an array of strings.");
+	std::vector<std::string> ret;
+	for (sejp::value const &element : *array)
+	{
+		std::optional<std::string> str = element.as_string();
+		if (!str)
+			throw std::runtime_error(context + "'s \"" + key + "\" should be an array of strings.");
+		ret.emplace_back(*str);
+	}
+	return ret;
+}
+
+struct Case
+{
+	std::string name;
+	std::string scene;
+	std::string camera;
+	std::vector<std::string> args;
+
+	struct Frame
+	{
+		float dt = 0.0f;
+		std::string golden; // empty: not saved or compared
+	};
+	std::vector<Frame> frames;
+	uint32_t tolerance = 0;
+	double max_differing = 0.0;
+
+	struct Benchmark
+	{
+		uint32_t warmup = 30;
+		uint32_t frames = 300;
+		std::string baseline;
+		std::vector<std::string> series;
+		double slowdown = 0.0;
+		std::vector<std::string> args; // after the case's
+	};
+	std::optional<Benchmark> benchmark;
+};
+
+static std::vector<Case> load_manifest(Options const &options)
+{
+	std::filesystem::path base = std::filesystem::path(options.manifest).parent_path();
+	auto relative = [&](std::string const &path)
+	{
+		return (base / path).string();
+	};
+
+	sejp::value root = sejp::load(options.manifest);
+	std::optional<Object> manifest = root.as_object();
+	if (!manifest)
+		throw std::runtime_error("Manifest '" + options.manifest + "' should be an object.");
+	std::optional<sejp::value> cases_value = find(*manifest, "cases");
+	std::optional<std::vector<sejp::value>> cases_array = cases_value ? cases_value->as_array() : std::nullopt;
+	if (!cases_array)
+		throw std::runtime_error("Manifest '" + options.manifest + "' should have a \"cases\" array.");
+
+	std::vector<Case> cases;
+	for (size_t i = 0; i < cases_array->size(); ++i)
+	{
+		std::optional<Object> object = (*cases_array)[i].as_object();
+		if (!object)
+			throw std::runtime_error("Case " + std::to_string(i) + " should be an object.");
+		std::string context = "Case " + std::to_string(i);
+
+		Case c;
+		c.name = get_string(*object, "name", context);
+		context = "Case '" + c.name + "'";
+		for (Case const &other : cases)
+		{
+			if (other.name == c.name)
+				throw std::runtime_error(context + " appears twice (names pick the work files).");
+		}
+		c.scene = get_string(*object, "scene", context);
+		c.camera = get_string(*object, "camera", context, "");
+		c.args = get_strings(*object, "args", context, {});
+		double tolerance = get_number(*object, "tolerance", context, options.tolerance);
+		if (!(tolerance >= 0.0 && tolerance <= 255.0))
+			throw std::runtime_error(context + " needs a tolerance from 0 to 255.");
+		c.tolerance = uint32_t(tolerance);
+		c.max_differing = get_number(*object, "max_differing", context, options.max_differing);
+		if (!(c.max_differing >= 0.0 && c.max_differing <= 1.0))
+			throw std::runtime_error(context + "'s max_differing is a fraction of the pixels, from 0 to 1.");
+
+		if (std::optional<sejp::value> frames_value = find(*object, "frames"))
+		{
+			std::optional<std::vector<sejp::value>> frames = frames_value->as_array();
+			if (!frames)
+				throw std::runtime_error(context + "'s \"frames\" should be an array.");
+			for (sejp::value const &frame_value : *frames)
+			{
+				std::optional<Object> frame_object = frame_value.as_object();
+				if (!frame_object)
+					throw std::runtime_error(context + "'s frames should be objects.");
+				Case::Frame frame;
+				frame.dt = float(get_number(*frame_object, "dt", context + " frame", 0.0));
+				if (frame.dt < 0.0f)
+					throw std::runtime_error(context + " has a frame with negative dt.");
+				std::string golden = get_string(*frame_object, "golden", context + " frame", "");
+				if (!golden.empty())
+				{
+					if (!golden.ends_with(".ppm"))
+						throw std::runtime_error(context + "'s golden '" + golden + "' must be a .ppm (what the viewer saves).");
+					frame.golden = relative(golden);
+				}
+				c.frames.emplace_back(frame);
+			}
+		}
+
+		if (std::optional<sejp::value> benchmark_value = find(*object, "benchmark"))
+		{
+			std::optional<Object> benchmark_object = benchmark_value->as_object();
+			if (!benchmark_object)
+				throw std::runtime_error(context + "'s \"benchmark\" should be an object.");
+			std::string benchmark_context = context + " benchmark";
+			Case::Benchmark benchmark;
+			benchmark.warmup = uint32_t(get_number(*benchmark_object, "warmup", benchmark_context, benchmark.warmup));
+			benchmark.frames = uint32_t(get_number(*benchmark_object, "frames", benchmark_context, benchmark.frames));
+			if (benchmark.frames == 0)
+				throw std::runtime_error(benchmark_context + " needs at least one frame.");
+			benchmark.baseline = relative(get_string(*benchmark_object, "baseline", benchmark_context));
+			benchmark.series = get_strings(*benchmark_object, "series", benchmark_context, {"frame_ms"});
+			benchmark.slowdown = get_number(*benchmark_object, "slowdown", benchmark_context, options.slowdown);
+			benchmark.args = get_strings(*benchmark_object, "args", benchmark_context, {});
+			c.benchmark = benchmark;
+		}
+
+		if (!options.filter.empty() && c.name.find(options.filter) == std::string::npos)
+			continue;
+		cases.emplace_back(std::move(c));
+	}
+	return cases;
+}
+
+//------------------------------------------
+// running the viewer
+
+static std::string quote(std::string const &arg)
+{
+#ifdef _WIN32
+	return "\"" + arg + "\""; // (cmd.exe has no way to escape '"' in an argument)
+#else
+	std::string ret = "'";
+	for (char c : arg)
+	{
+		if (c == '\'')
+			ret += "'\\''";
+		else
+			ret += c;
+	}
+	return ret + "'";
+#endif
+}
+
+// how the viewer ended, from std::system's return value (on POSIX a wait status, not the exit code); empty if it exited with 0:
+static std::string viewer_failure(int status)
+{
+	if (status == -1)
+		return "could not be started";
+#ifdef _WIN32
+	if (status != 0)
+		return "exited with status " + std::to_string(status);
+#else
+	if (WIFEXITED(status))
+	{
+		if (WEXITSTATUS(status) != 0)
+			return "exited with status " + std::to_string(WEXITSTATUS(status));
+	}
+	else if (WIFSIGNALED(status))
+		return "was killed by signal " + std::to_string(WTERMSIG(status));
+	else
+		return "stopped with wait status " + std::to_string(status);
+#endif
+	return "";
+}
+
+// runs the viewer with stdin from events_path and stdout+stderr to log_path, returns viewer_failure() of how it ended:
+static std::string run_viewer(Options const &options, std::vector<std::string> const &args, std::string const &events_path, std::string const &log_path)
+{
+	std::string command = quote(options.viewer);
+	for (std::string const &arg : args)
+		command += " " + quote(arg);
+	command += " < " + quote(events_path) + " > " + quote(log_path) + " 2>&1";
+#ifdef _WIN32
+	command = "\"" + command + "\""; // cmd /c strips the outer quotes
+#endif
+	std::cout.flush();
+	return viewer_failure(std::system(command.c_str()));
+}
+
+static std::vector<std::string> viewer_args(Case const &c)
+{
+	std::vector<std::string> args{"--headless", "--scene", c.scene};
+	if (!c.camera.empty())
+	{
+		args.emplace_back("--camera");
+		args.emplace_back(c.camera);
+	}
+	args.insert(args.end(), c.args.begin(), c.args.end());
+	return args;
+}
+
+//------------------------------------------
+// images
+
+struct Image
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> rgb;
+};
+
+// binary PPM with maxval 255, as RTG::HeadlessSwapchainImage::save writes them:
+static Image load_ppm(std::string const &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to open '" + path + "'.");
+
+	auto token = [&]() -> std::string
+	{
+		std::string ret;
+		int c = file.get();
+		while (true)
+		{ // skip whitespace and comments:
+			while (c != EOF && std::isspace(c))
+				c = file.get();
+			if (c != '#')
+				break;
+			while (c != EOF && c != '\n')
+				c = file.get();
+		}
+		while (c != EOF && !std::isspace(c))
+		{
+			ret += char(c);
+			c = file.get();
+		}
+		return ret; // the single whitespace after the token has been consumed
+	};
+
+	if (token() != "P6")
+		throw std::runtime_error("'" + path + "' is not a binary PPM.");
+	Image image;
+	std::string width = token(), height = token(), maxval = token();
+	try
+	{
+		image.width = uint32_t(std::stoul(width));
+		image.height = uint32_t(std::stoul(height));
+	}
+	catch (std::exception &)
+	{
+		throw std::runtime_error("'" + path + "' has a malformed size.");
+	}
+	if (maxval != "255")
+		throw std::runtime_error("'" + path + "' has maxval " + maxval + ", only 255 is supported.");
+	if (image.width == 0 || image.height == 0 || uint64_t(image.width) * image.height > (uint64_t(1) << 28))
+		throw std::runtime_error("'" + path + "' has an unreasonable size.");
+	image.rgb.resize(size_t(image.width) * image.height * 3);
+	if (!file.read(reinterpret_cast<char *>(image.rgb.data()), std::streamsize(image.rgb.size())))
+		throw std::runtime_error("'" + path + "' is truncated.");
+	return image;
+}
+
+static void save_ppm(std::string const &path, Image const &image)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << "P6\n" << image.width << " " << image.height << "\n255\n";
+	file.write(reinterpret_cast<char const *>(image.rgb.data()), std::streamsize(image.rgb.size()));
+	if (!file)
+		throw std::runtime_error("Failed to write '" + path + "'.");
+}
+
+struct ImageDifference
+{
+	uint64_t pixels = 0;
+	uint64_t differing = 0; // pixels with some channel past the tolerance
+	uint32_t max = 0;		// largest channel difference
+	double psnr = INFINITY; // over all channels, dB
+	Image diff;				// differing pixels red (brighter is larger), the rest the golden, dimmed
+};
+
+static ImageDifference compare(Image const &image, Image const &golden, uint32_t tolerance)
+{
+	ImageDifference ret;
+	ret.pixels = uint64_t(golden.width) * golden.height;
+	ret.diff.width = golden.width;
+	ret.diff.height = golden.height;
+	ret.diff.rgb.resize(golden.rgb.size());
+
+	double squared_error = 0.0;
+	for (size_t p = 0; p < ret.pixels; ++p)
+	{
+		uint32_t largest = 0;
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			int32_t d = int32_t(image.rgb[3 * p + c]) - int32_t(golden.rgb[3 * p + c]);
+			squared_error += double(d * d);
+			largest = std::max(largest, uint32_t(std::abs(d)));
+		}
+		ret.max = std::max(ret.max, largest);
+		if (largest > tolerance)
+		{
+			ret.differing += 1;
+			ret.diff.rgb[3 * p + 0] = uint8_t(std::min(255u, 128u + largest));
+			ret.diff.rgb[3 * p + 1] = 0;
+			ret.diff.rgb[3 * p + 2] = 0;
+		}
+		else
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				ret.diff.rgb[3 * p + c] = uint8_t(golden.rgb[3 * p + c] / 4);
+		}
+	}
+	double mse = squared_error / double(3 * ret.pixels);
+	if (mse > 0.0)
+		ret.psnr = 10.0 * std::log10(255.0 * 255.0 / mse);
+	return ret;
+}
+
+//------------------------------------------
+// timings
+
+struct Timings
+{
+	std::string device;
+	std::map<std::string, Object> series; // name -> { count, min, median, ... }
+};
+
+// reads what Benchmark::write writes for a .json path:
+static Timings load_timings(std::string const &path)
+{
+	sejp::value root = sejp::load(path);
+	std::optional<Object> object = root.as_object();
+	if (!object)
+		throw std::runtime_error("'" + path + "' is not benchmark output.");
+	Timings ret;
+	ret.device = get_string(*object, "device", "'" + path + "'", "");
+	std::optional<sejp::value> series = find(*object, "series");
+	std::optional<Object> series_object = series ? series->as_object() : std::nullopt;
+	if (!series_object)
+		throw std::runtime_error("'" + path + "' has no \"series\" object.");
+	for (auto const &[name, value] : *series_object)
+	{
+		std::optional<Object> summary = value.as_object();
+		if (summary)
+			ret.series.emplace(name, *summary);
+	}
+	return ret;
+}
+
+//------------------------------------------
+// report
+
+struct Check
+{
+	std::string case_name;
+	std::string what; // "frame 0", "frame_ms", ...
+	bool passed = false;
+	std::string detail;
+};
+
+static void write_report(std::string const &path, std::vector<Check> const &checks, bool passed)
+{
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("Failed to open report '" + path + "'.");
+	file << "{\n\t\"passed\": " << (passed ? "true" : "false") << ",\n\t\"checks\": [";
+	for (size_t i = 0; i < checks.size(); ++i)
+	{
+		file << (i ? ",\n" : "\n") << "\t\t{ \"case\": " << json_string(checks[i].case_name) << ", \"check\": " << json_string(checks[i].what)
+			 << ", \"passed\": " << (checks[i].passed ? "true" : "false") << ", \"detail\": " << json_string(checks[i].detail) << " }";
+	}
+	file << "\n\t]\n}\n";
+	if (!file)
+		throw std::runtime_error("Failed to write report '" + path + "'.");
+}
+
+int main(int argc, char **argv)
+{
+	// main wrapped in a try-catch so we can print some debug info about uncaught exceptions:
+	try
+	{
+		Options options;
+		try
+		{
+			options.parse(argc, argv);
+		}
+		catch (std::runtime_error &e)
+		{
+			std::cerr << "Failed to parse arguments:\n"
+					  << e.what() << std::endl;
+			std::cerr << "Usage:" << std::endl;
+			Options::usage([](const char *arg, const char *desc)
+						   { std::cerr << "    " << arg << "\n        " << desc << std::endl; });
+			return 1;
+		}
+
+		std::vector<Case> cases = load_manifest(options);
+		if (cases.empty())
+			throw std::runtime_error("No cases to run" + (options.filter.empty() ? std::string(".") : " (after --filter '" + options.filter + "')."));
+		std::filesystem::create_directories(options.work);
+		auto work_path = [&](std::string const &name)
+		{
+			return (std::filesystem::path(options.work) / name).string();
+		};
+
+		std::vector<Check> checks;
+		auto report = [&](Case const &c, std::string const &what, bool passed, std::string const &detail)
+		{
+			checks.emplace_back(Check{.case_name = c.name, .what = what, .passed = passed, .detail = detail});
+			std::cout << (passed ? "PASS " : "FAIL ") << c.name << " " << what << ": " << detail << std::endl;
+		};
+		auto install = [&](std::string const &from, std::string const &to)
+		{
+			std::filesystem::path parent = std::filesystem::path(to).parent_path();
+			if (!parent.empty())
+				std::filesystem::create_directories(parent);
+			std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
+		};
+
+		for (Case const &c : cases)
+		{
+			//------------------------------------------
+			// images: one headless run that saves every frame with a golden
+
+			bool has_goldens = false;
+			for (Case::Frame const &frame : c.frames)
+				has_goldens = has_goldens || !frame.golden.empty();
+			if (options.images && has_goldens)
+			{
+				std::string events_path = work_path(c.name + ".events");
+				std::vector<std::string> rendered(c.frames.size());
+				{
+					std::ofstream events(events_path, std::ios::binary);
+					events.imbue(std::locale::classic()); // the viewer parses '.' as the decimal separator
+					for (size_t i = 0; i < c.frames.size(); ++i)
+					{
+						events << "AVAILABLE " << c.frames[i].dt;
+						if (!c.frames[i].golden.empty())
+						{
+							rendered[i] = work_path(c.name + "-" + std::to_string(i) + ".ppm");
+							std::filesystem::remove(rendered[i]); // so a crashed run can't compare a stale frame
+							events << " " << rendered[i];
+						}
+						events << "\n";
+					}
+					if (!events)
+						throw std::runtime_error("Failed to write '" + events_path + "'.");
+				}
+
+				std::string log_path = work_path(c.name + ".log");
+				std::string failure = run_viewer(options, viewer_args(c), events_path, log_path);
+				if (!failure.empty())
+				{
+					report(c, "render", false, "viewer " + failure + ", see " + log_path);
+				}
+				else
+				{
+					for (size_t i = 0; i < c.frames.size(); ++i)
+					{
+						if (c.frames[i].golden.empty())
+							continue;
+						std::string what = "frame " + std::to_string(i);
+						if (!std::filesystem::exists(rendered[i]))
+						{
+							report(c, what, false, "the viewer didn't save it, see " + log_path);
+							continue;
+						}
+						if (options.update)
+						{
+							install(rendered[i], c.frames[i].golden);
+							report(c, what, true, "wrote golden " + c.frames[i].golden);
+							continue;
+						}
+						if (!std::filesystem::exists(c.frames[i].golden))
+						{
+							report(c, what, false, "no golden " + c.frames[i].golden + " (create it with --update)");
+							continue;
+						}
+
+						Image image = load_ppm(rendered[i]);
+						Image golden = load_ppm(c.frames[i].golden);
+						if (image.width != golden.width || image.height != golden.height)
+						{
+							report(c, what, false, "rendered " + std::to_string(image.width) + "x" + std::to_string(image.height) + ", golden is " + std::to_string(golden.width) + "x" + std::to_string(golden.height));
+							continue;
+						}
+						ImageDifference difference = compare(image, golden, c.tolerance);
+						double fraction = double(difference.differing) / double(difference.pixels);
+						bool passed = fraction <= c.max_differing;
+
+						std::ostringstream detail;
+						detail << difference.differing << " of " << difference.pixels << " pixels differ by more than " << c.tolerance
+							   << " (" << std::setprecision(3) << 100.0 * fraction << "%, allowed " << 100.0 * c.max_differing << "%), max " << difference.max
+							   << ", PSNR " << std::fixed << std::setprecision(1) << difference.psnr << " dB";
+						if (!passed)
+						{
+							std::string diff_path = work_path(c.name + "-" + std::to_string(i) + ".diff.ppm");
+							save_ppm(diff_path, difference.diff);
+							detail << ", see " << diff_path;
+						}
+						report(c, what, passed, detail.str());
+					}
+				}
+			}
+
+			//------------------------------------------
+			// timings: one headless benchmark run
+
+			if (options.timings && c.benchmark)
+			{
+				Case::Benchmark const &benchmark = *c.benchmark;
+				std::string out_path = work_path(c.name + ".benchmark.json");
+				std::string events_path = work_path(c.name + ".benchmark.events");
+				std::string log_path = work_path(c.name + ".benchmark.log");
+				std::filesystem::remove(out_path);
+				std::ofstream(events_path, std::ios::binary).close(); // benchmark mode doesn't read events
+
+				std::vector<std::string> args = viewer_args(c);
+				args.insert(args.end(), {"--benchmark", std::to_string(benchmark.warmup), std::to_string(benchmark.frames), "--benchmark-out", out_path});
+				args.insert(args.end(), benchmark.args.begin(), benchmark.args.end());
+				std::string failure = run_viewer(options, args, events_path, log_path);
+				if (failure.empty() && !std::filesystem::exists(out_path))
+					failure = "didn't write " + out_path;
+				if (!failure.empty())
+				{
+					report(c, "benchmark", false, "viewer " + failure + ", see " + log_path);
+					continue;
+				}
+				if (options.update)
+				{
+					install(out_path, benchmark.baseline);
+					report(c, "benchmark", true, "wrote baseline " + benchmark.baseline);
+					continue;
+				}
+				if (!std::filesystem::exists(benchmark.baseline))
+				{
+					report(c, "benchmark", false, "no baseline " + benchmark.baseline + " (create it with --update)");
+					continue;
+				}
+
+				Timings current = load_timings(out_path);
+				Timings baseline = load_timings(benchmark.baseline);
+				if (current.device != baseline.device)
+					std::cerr << "WARNING: " << c.name << "'s baseline was measured on '" << baseline.device << "', not '" << current.device << "'; its timings may not be comparable." << std::endl;
+
+				for (std::string const &series : benchmark.series)
+				{
+					std::string what = series + " " + options.statistic;
+					auto current_series = current.series.find(series);
+					auto baseline_series = baseline.series.find(series);
+					if (current_series == current.series.end() || baseline_series == baseline.series.end())
+					{
+						report(c, what, false, std::string("no such series in the ") + (current_series == current.series.end() ? "benchmark output" : "baseline"));
+						continue;
+					}
+					double now = get_number(current_series->second, options.statistic, what, NAN);
+					double then = get_number(baseline_series->second, options.statistic, what, NAN);
+					if (!(now >= 0.0) || !(then > 0.0))
+					{
+						report(c, what, false, "missing or non-positive statistic");
+						continue;
+					}
+					double ratio = now / then;
+					std::ostringstream detail;
+					detail << std::fixed << std::setprecision(3) << now << " vs baseline " << then << " (x" << std::setprecision(2) << ratio
+						   << ", allowed x" << benchmark.slowdown << ")";
+					report(c, what, ratio <= benchmark.slowdown, detail.str());
+				}
+			}
+		}
+
+		uint32_t failed = 0;
+		for (Check const &check : checks)
+			failed += check.passed ? 0 : 1;
+		bool passed = failed == 0;
+		std::cout << (passed ? "PASSED: " : "FAILED: ") << checks.size() - failed << " of " << checks.size() << " checks passed over " << cases.size() << " cases." << std::endl;
+		if (!options.report.empty())
+		{
+			write_report(options.report, checks, passed);
+			std::cout << "Wrote report to " << options.report << std::endl;
+		}
+		return passed ? 0 : 1;
+	}
+	catch (std::exception &e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,468 @@
+#include "rgbe.hpp"
+
+#include "../Lib/glm/glm/gtc/packing.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RGBE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RGBE_AVX2 // MSVC emits AVX2 intrinsics without a target switch
+#else
+#define RGBE_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// the vector paths build powers of two straight from exponent bits. Scales that would be denormal are built 2^32 larger and
+// multiplied back down: every product involved is exactly representable, so the results match the scalar ldexp bit for bit.
+
+//--------------------------------------------
+// scalar:
+
+static void e5b9g9r9_scalar(uint8_t const *rgbe, uint32_t *out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i] = rgbe_to_E5B9G9R9(glm::u8vec4(rgbe[4 * i + 0], rgbe[4 * i + 1], rgbe[4 * i + 2], rgbe[4 * i + 3]));
+	}
+}
+
+static void rgbe_to_linear_scalar(uint8_t const *rgbe, glm::vec3 *out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i] = rgbe_to_linear(glm::u8vec4(rgbe[4 * i + 0], rgbe[4 * i + 1], rgbe[4 * i + 2], rgbe[4 * i + 3]));
+	}
+}
+
+static void linear_to_rgbe_scalar(glm::vec4 const *linear, uint8_t *rgbe, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::u8vec4 col = linear_to_rgbe(glm::vec3(linear[i]));
+		rgbe[4 * i + 0] = col.r;
+		rgbe[4 * i + 1] = col.g;
+		rgbe[4 * i + 2] = col.b;
+		rgbe[4 * i + 3] = col.a;
+	}
+}
+
+#ifdef RGBE_X86
+//--------------------------------------------
+// SSE2, 4 pixels at a time:
+
+static inline __m128 e5b9g9r9_channel_sse2(__m128i c, __m128 scale, __m128 fixup)
+{
+	// ldexp((c + 0.5) / 256, e - 128), clamped to the largest shared exponent value:
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f / 256.0f));
+	v = _mm_mul_ps(_mm_mul_ps(v, scale), fixup);
+	return _mm_min_ps(v, _mm_set1_ps((float(2 << 9) - 1.0f) / float(2 << 9) * float(2 << (31 - 15))));
+}
+
+static inline __m128i e5b9g9r9_quantize_sse2(__m128 v, __m128 inv_divisor)
+{
+	return _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, inv_divisor), _mm_set1_ps(0.5f))), _mm_set1_epi32(0x1ff));
+}
+
+static void e5b9g9r9_sse2(uint8_t const *rgbe, uint32_t *out, size_t count)
+{
+	__m128i const byte = _mm_set1_epi32(0xff);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const *>(rgbe + 4 * i));
+		__m128i e = _mm_srli_epi32(px, 24);
+
+		// 2^(e - 128):
+		__m128i low = _mm_cmplt_epi32(e, _mm_set1_epi32(2));
+		__m128i e_adj = _mm_add_epi32(e, _mm_and_si128(low, _mm_set1_epi32(32)));
+		__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(e_adj, _mm_set1_epi32(1)), 23));
+		__m128 fixup = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(low), _mm_set1_ps(0x1p-32f)), _mm_andnot_ps(_mm_castsi128_ps(low), _mm_set1_ps(1.0f)));
+
+		__m128 r = e5b9g9r9_channel_sse2(_mm_and_si128(px, byte), scale, fixup);
+		__m128 g = e5b9g9r9_channel_sse2(_mm_and_si128(_mm_srli_epi32(px, 8), byte), scale, fixup);
+		__m128 b = e5b9g9r9_channel_sse2(_mm_and_si128(_mm_srli_epi32(px, 16), byte), scale, fixup);
+		__m128 max = _mm_max_ps(r, _mm_max_ps(g, b));
+
+		// int(log2(max)) truncates toward zero, so below 1 it is one more than the exponent unless max is a power of two:
+		__m128i bits = _mm_castps_si128(max);
+		__m128i floor_log = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+		__m128i has_fraction = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(bits, _mm_set1_epi32(0x7fffff)), _mm_setzero_si128()), _mm_set1_epi32(-1));
+		__m128i round_up = _mm_and_si128(has_fraction, _mm_castps_si128(_mm_cmplt_ps(max, _mm_set1_ps(1.0f))));
+		__m128i above = _mm_castps_si128(_mm_cmpgt_ps(max, _mm_set1_ps(0x1p-16f)));
+		__m128i exp_prime = _mm_and_si128(above, _mm_add_epi32(_mm_sub_epi32(floor_log, round_up), _mm_set1_epi32(16)));
+
+		// 1 / 2^(exp - B - N), exponent bits of 2^(24 - exp):
+		__m128 inv_divisor = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(151), exp_prime), 23));
+		__m128i max_shared = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(max, inv_divisor), _mm_set1_ps(0.5f)));
+		__m128i exp_shared = _mm_sub_epi32(exp_prime, _mm_cmpeq_epi32(max_shared, _mm_set1_epi32(2 << 9)));
+		inv_divisor = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(151), exp_shared), 23));
+
+		__m128i packed = _mm_slli_epi32(_mm_and_si128(exp_shared, _mm_set1_epi32(0x1f)), 27);
+		packed = _mm_or_si128(packed, _mm_slli_epi32(e5b9g9r9_quantize_sse2(b, inv_divisor), 18));
+		packed = _mm_or_si128(packed, _mm_slli_epi32(e5b9g9r9_quantize_sse2(g, inv_divisor), 9));
+		packed = _mm_or_si128(packed, e5b9g9r9_quantize_sse2(r, inv_divisor));
+
+		// pure black stays pure black:
+		packed = _mm_andnot_si128(_mm_cmpeq_epi32(px, _mm_setzero_si128()), packed);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+	}
+	e5b9g9r9_scalar(rgbe + 4 * i, out + i, count - i);
+}
+
+// 2^(e - 136) as (scale, fixup) with e == 0 mapped to zero:
+static inline void rgbe_to_linear_scale_sse2(__m128i e, __m128 &scale, __m128 &fixup)
+{
+	__m128i low = _mm_cmplt_epi32(e, _mm_set1_epi32(10));
+	__m128i e_adj = _mm_add_epi32(e, _mm_and_si128(low, _mm_set1_epi32(32)));
+	scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(e_adj, _mm_set1_epi32(9)), 23));
+	fixup = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(low), _mm_set1_ps(0x1p-32f)), _mm_andnot_ps(_mm_castsi128_ps(low), _mm_set1_ps(1.0f)));
+	fixup = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(e, _mm_setzero_si128())), fixup);
+}
+
+// stores 4 pixels of r, g, b to 12 consecutive floats:
+static inline void store_rgb4_sse2(float *out, __m128 r, __m128 g, __m128 b)
+{
+	__m128 a = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r, g, b, a);
+	_mm_storeu_ps(out + 0, r); // each store's fourth float is overwritten by the next pixel
+	_mm_storeu_ps(out + 3, g);
+	_mm_storeu_ps(out + 6, b);
+	_mm_storel_pi(reinterpret_cast<__m64 *>(out + 9), a);
+	_mm_store_ss(out + 11, _mm_movehl_ps(a, a));
+}
+
+static void rgbe_to_linear_sse2(uint8_t const *rgbe, glm::vec3 *out, size_t count)
+{
+	static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 is tightly packed.");
+	__m128i const byte = _mm_set1_epi32(0xff);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const *>(rgbe + 4 * i));
+		__m128 scale, fixup;
+		rgbe_to_linear_scale_sse2(_mm_srli_epi32(px, 24), scale, fixup);
+		__m128 r = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(px, byte)), scale), fixup);
+		__m128 g = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), byte)), scale), fixup);
+		__m128 b = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), byte)), scale), fixup);
+		store_rgb4_sse2(reinterpret_cast<float *>(out + i), r, g, b);
+	}
+	rgbe_to_linear_scalar(rgbe + 4 * i, out + i, count - i);
+}
+
+// r, g, b of 4 pixels to packed rgbe:
+static inline __m128i linear_to_rgbe4_sse2(__m128 r, __m128 g, __m128 b)
+{
+	__m128 max = _mm_max_ps(r, _mm_max_ps(g, b));
+	__m128i tiny = _mm_castps_si128(_mm_cmplt_ps(max, _mm_set1_ps(1e-32f)));
+
+	// frexp of a normal float: mantissa in [0.5, 1) and the matching exponent
+	__m128i bits = _mm_castps_si128(max);
+	__m128i exp = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(126));
+	__m128 mant = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(int32_t(0x807fffff))), _mm_set1_epi32(126 << 23)));
+	__m128 scale = _mm_div_ps(_mm_mul_ps(mant, _mm_set1_ps(256.0f)), max);
+
+	__m128 const zero = _mm_setzero_ps();
+	__m128 const top = _mm_set1_ps(255.0f);
+	__m128i qr = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(r, scale), zero), top));
+	__m128i qg = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(g, scale), zero), top));
+	__m128i qb = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(b, scale), zero), top));
+	__m128i qe = _mm_and_si128(_mm_add_epi32(exp, _mm_set1_epi32(128)), _mm_set1_epi32(0xff));
+
+	__m128i packed = _mm_or_si128(_mm_or_si128(qr, _mm_slli_epi32(qg, 8)), _mm_or_si128(_mm_slli_epi32(qb, 16), _mm_slli_epi32(qe, 24)));
+	return _mm_andnot_si128(tiny, packed);
+}
+
+static void linear_to_rgbe_sse2(glm::vec4 const *linear, uint8_t *rgbe, size_t count)
+{
+	static_assert(sizeof(glm::vec4) == 4 * sizeof(float), "glm::vec4 is tightly packed.");
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		float const *in = reinterpret_cast<float const *>(linear + i);
+		__m128 r = _mm_loadu_ps(in + 0), g = _mm_loadu_ps(in + 4), b = _mm_loadu_ps(in + 8), a = _mm_loadu_ps(in + 12);
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(rgbe + 4 * i), linear_to_rgbe4_sse2(r, g, b));
+	}
+	linear_to_rgbe_scalar(linear + i, rgbe + 4 * i, count - i);
+}
+
+//--------------------------------------------
+// AVX2, 8 pixels at a time (same steps as SSE2):
+
+RGBE_AVX2 static inline __m256 e5b9g9r9_channel_avx2(__m256i c, __m256 scale, __m256 fixup)
+{
+	__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(c), _mm256_set1_ps(0.5f)), _mm256_set1_ps(1.0f / 256.0f));
+	v = _mm256_mul_ps(_mm256_mul_ps(v, scale), fixup);
+	return _mm256_min_ps(v, _mm256_set1_ps((float(2 << 9) - 1.0f) / float(2 << 9) * float(2 << (31 - 15))));
+}
+
+RGBE_AVX2 static inline __m256i e5b9g9r9_quantize_avx2(__m256 v, __m256 inv_divisor)
+{
+	return _mm256_and_si256(_mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, inv_divisor), _mm256_set1_ps(0.5f))), _mm256_set1_epi32(0x1ff));
+}
+
+RGBE_AVX2 static void e5b9g9r9_avx2(uint8_t const *rgbe, uint32_t *out, size_t count)
+{
+	__m256i const byte = _mm256_set1_epi32(0xff);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i px = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(rgbe + 4 * i));
+		__m256i e = _mm256_srli_epi32(px, 24);
+
+		__m256i low = _mm256_cmpgt_epi32(_mm256_set1_epi32(2), e);
+		__m256i e_adj = _mm256_add_epi32(e, _mm256_and_si256(low, _mm256_set1_epi32(32)));
+		__m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(e_adj, _mm256_set1_epi32(1)), 23));
+		__m256 fixup = _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_set1_ps(0x1p-32f), _mm256_castsi256_ps(low));
+
+		__m256 r = e5b9g9r9_channel_avx2(_mm256_and_si256(px, byte), scale, fixup);
+		__m256 g = e5b9g9r9_channel_avx2(_mm256_and_si256(_mm256_srli_epi32(px, 8), byte), scale, fixup);
+		__m256 b = e5b9g9r9_channel_avx2(_mm256_and_si256(_mm256_srli_epi32(px, 16), byte), scale, fixup);
+		__m256 max = _mm256_max_ps(r, _mm256_max_ps(g, b));
+
+		__m256i bits = _mm256_castps_si256(max);
+		__m256i floor_log = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+		__m256i exact = _mm256_cmpeq_epi32(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)), _mm256_setzero_si256());
+		__m256i round_up = _mm256_andnot_si256(exact, _mm256_castps_si256(_mm256_cmp_ps(max, _mm256_set1_ps(1.0f), _CMP_LT_OQ)));
+		__m256i above = _mm256_castps_si256(_mm256_cmp_ps(max, _mm256_set1_ps(0x1p-16f), _CMP_GT_OQ));
+		__m256i exp_prime = _mm256_and_si256(above, _mm256_add_epi32(_mm256_sub_epi32(floor_log, round_up), _mm256_set1_epi32(16)));
+
+		__m256 inv_divisor = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(151), exp_prime), 23));
+		__m256i max_shared = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(max, inv_divisor), _mm256_set1_ps(0.5f)));
+		__m256i exp_shared = _mm256_sub_epi32(exp_prime, _mm256_cmpeq_epi32(max_shared, _mm256_set1_epi32(2 << 9)));
+		inv_divisor = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(151), exp_shared), 23));
+
+		__m256i packed = _mm256_slli_epi32(_mm256_and_si256(exp_shared, _mm256_set1_epi32(0x1f)), 27);
+		packed = _mm256_or_si256(packed, _mm256_slli_epi32(e5b9g9r9_quantize_avx2(b, inv_divisor), 18));
+		packed = _mm256_or_si256(packed, _mm256_slli_epi32(e5b9g9r9_quantize_avx2(g, inv_divisor), 9));
+		packed = _mm256_or_si256(packed, e5b9g9r9_quantize_avx2(r, inv_divisor));
+
+		packed = _mm256_andnot_si256(_mm256_cmpeq_epi32(px, _mm256_setzero_si256()), packed);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+	}
+	e5b9g9r9_sse2(rgbe + 4 * i, out + i, count - i);
+}
+
+RGBE_AVX2 static void rgbe_to_linear_avx2(uint8_t const *rgbe, glm::vec3 *out, size_t count)
+{
+	__m256i const byte = _mm256_set1_epi32(0xff);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i px = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(rgbe + 4 * i));
+		__m256i e = _mm256_srli_epi32(px, 24);
+		__m256i low = _mm256_cmpgt_epi32(_mm256_set1_epi32(10), e);
+		__m256i e_adj = _mm256_add_epi32(e, _mm256_and_si256(low, _mm256_set1_epi32(32)));
+		__m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(e_adj, _mm256_set1_epi32(9)), 23));
+		__m256 fixup = _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_set1_ps(0x1p-32f), _mm256_castsi256_ps(low));
+		fixup = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(e, _mm256_setzero_si256())), fixup);
+
+		__m256 r = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(px, byte)), scale), fixup);
+		__m256 g = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), byte)), scale), fixup);
+		__m256 b = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), byte)), scale), fixup);
+
+		float *dst = reinterpret_cast<float *>(out + i);
+		store_rgb4_sse2(dst, _mm256_castps256_ps128(r), _mm256_castps256_ps128(g), _mm256_castps256_ps128(b));
+		store_rgb4_sse2(dst + 12, _mm256_extractf128_ps(r, 1), _mm256_extractf128_ps(g, 1), _mm256_extractf128_ps(b, 1));
+	}
+	rgbe_to_linear_sse2(rgbe + 4 * i, out + i, count - i);
+}
+
+RGBE_AVX2 static void linear_to_rgbe_avx2(glm::vec4 const *linear, uint8_t *rgbe, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		// transpose two groups of 4 pixels, then convert all 8 at once:
+		float const *in = reinterpret_cast<float const *>(linear + i);
+		__m128 r0 = _mm_loadu_ps(in + 0), g0 = _mm_loadu_ps(in + 4), b0 = _mm_loadu_ps(in + 8), a0 = _mm_loadu_ps(in + 12);
+		__m128 r1 = _mm_loadu_ps(in + 16), g1 = _mm_loadu_ps(in + 20), b1 = _mm_loadu_ps(in + 24), a1 = _mm_loadu_ps(in + 28);
+		_MM_TRANSPOSE4_PS(r0, g0, b0, a0);
+		_MM_TRANSPOSE4_PS(r1, g1, b1, a1);
+		__m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(r0), r1, 1);
+		__m256 g = _mm256_insertf128_ps(_mm256_castps128_ps256(g0), g1, 1);
+		__m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(b0), b1, 1);
+
+		__m256 max = _mm256_max_ps(r, _mm256_max_ps(g, b));
+		__m256i tiny = _mm256_castps_si256(_mm256_cmp_ps(max, _mm256_set1_ps(1e-32f), _CMP_LT_OQ));
+
+		__m256i bits = _mm256_castps_si256(max);
+		__m256i exp = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(126));
+		__m256 mant = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(int32_t(0x807fffff))), _mm256_set1_epi32(126 << 23)));
+		__m256 scale = _mm256_div_ps(_mm256_mul_ps(mant, _mm256_set1_ps(256.0f)), max);
+
+		__m256 const zero = _mm256_setzero_ps();
+		__m256 const top = _mm256_set1_ps(255.0f);
+		__m256i qr = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(r, scale), zero), top));
+		__m256i qg = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(g, scale), zero), top));
+		__m256i qb = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(b, scale), zero), top));
+		__m256i qe = _mm256_and_si256(_mm256_add_epi32(exp, _mm256_set1_epi32(128)), _mm256_set1_epi32(0xff));
+
+		__m256i packed = _mm256_or_si256(_mm256_or_si256(qr, _mm256_slli_epi32(qg, 8)), _mm256_or_si256(_mm256_slli_epi32(qb, 16), _mm256_slli_epi32(qe, 24)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(rgbe + 4 * i), _mm256_andnot_si256(tiny, packed));
+	}
+	linear_to_rgbe_sse2(linear + i, rgbe + 4 * i, count - i);
+}
+
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	if (!os_saves_ymm)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif // RGBE_X86
+
+//--------------------------------------------
+// dispatch:
+
+namespace
+{
+	enum class Path
+	{
+		Scalar,
+		SSE2,
+		AVX2,
+	};
+
+	Path best_path()
+	{
+#ifdef RGBE_X86
+		static Path const path = cpu_has_avx2() ? Path::AVX2 : Path::SSE2; // SSE2 is part of x86-64
+		return path;
+#else
+		return Path::Scalar;
+#endif
+	}
+
+	std::atomic<int> forced_path{-1}; // rgbe_force_simd_path(), -1 if not forced
+
+	Path simd_path()
+	{
+		int forced = forced_path.load(std::memory_order_relaxed);
+		return forced < 0 ? best_path() : Path(forced);
+	}
+
+	// runs fn(begin, end) over [0, count) pixels split across hardware threads, small images stay on the calling thread:
+	template <typename Fn>
+	void parallel_pixels(size_t count, Fn const &fn)
+	{
+		constexpr size_t min_per_thread = size_t(1) << 16;
+		size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count / min_per_thread));
+		if (threads == 1)
+		{
+			fn(size_t(0), count);
+			return;
+		}
+		size_t per_thread = ((count + threads - 1) / threads + 7) & ~size_t(7); // whole vectors per thread
+		std::vector<std::future<void>> jobs;
+		for (size_t begin = 0; begin < count; begin += per_thread)
+		{
+			jobs.emplace_back(std::async(std::launch::async, [&fn, begin, end = std::min(count, begin + per_thread)]()
+										 { fn(begin, end); }));
+		}
+		for (std::future<void> &job : jobs)
+		{
+			job.get();
+		}
+	}
+}
+
+void rgbe_to_E5B9G9R9(uint8_t const *rgbe, uint32_t *out, size_t count)
+{
+	Path path = simd_path();
+	parallel_pixels(count, [&](size_t begin, size_t end)
+					{
+#ifdef RGBE_X86
+		if (path == Path::AVX2) return e5b9g9r9_avx2(rgbe + 4 * begin, out + begin, end - begin);
+		if (path == Path::SSE2) return e5b9g9r9_sse2(rgbe + 4 * begin, out + begin, end - begin);
+#endif
+		e5b9g9r9_scalar(rgbe + 4 * begin, out + begin, end - begin); });
+}
+
+void rgbe_to_linear(uint8_t const *rgbe, glm::vec3 *out, size_t count)
+{
+	Path path = simd_path();
+	parallel_pixels(count, [&](size_t begin, size_t end)
+					{
+#ifdef RGBE_X86
+		if (path == Path::AVX2) return rgbe_to_linear_avx2(rgbe + 4 * begin, out + begin, end - begin);
+		if (path == Path::SSE2) return rgbe_to_linear_sse2(rgbe + 4 * begin, out + begin, end - begin);
+#endif
+		rgbe_to_linear_scalar(rgbe + 4 * begin, out + begin, end - begin); });
+}
+
+void linear_to_rgbe(glm::vec4 const *linear, uint8_t *rgbe, size_t count)
+{
+	Path path = simd_path();
+	parallel_pixels(count, [&](size_t begin, size_t end)
+					{
+#ifdef RGBE_X86
+		if (path == Path::AVX2) return linear_to_rgbe_avx2(linear + begin, rgbe + 4 * begin, end - begin);
+		if (path == Path::SSE2) return linear_to_rgbe_sse2(linear + begin, rgbe + 4 * begin, end - begin);
+#endif
+		linear_to_rgbe_scalar(linear + begin, rgbe + 4 * begin, end - begin); });
+}
+
+void rgbe_to_half(uint8_t const *rgbe, uint16_t *out, size_t count)
+{
+	uint16_t const one = glm::packHalf1x16(1.0f);
+	parallel_pixels(count, [&](size_t begin, size_t end)
+					{
+		for (size_t i = begin; i < end; ++i) {
+			glm::vec3 c = glm::min(rgbe_to_linear(glm::u8vec4(rgbe[4 * i + 0], rgbe[4 * i + 1], rgbe[4 * i + 2], rgbe[4 * i + 3])), glm::vec3(65504.0f));
+			out[4 * i + 0] = glm::packHalf1x16(c.r);
+			out[4 * i + 1] = glm::packHalf1x16(c.g);
+			out[4 * i + 2] = glm::packHalf1x16(c.b);
+			out[4 * i + 3] = one;
+		} });
+}
+
+char const *rgbe_simd_path()
+{
+	switch (simd_path())
+	{
+	case Path::AVX2:
+		return "avx2";
+	case Path::SSE2:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+bool rgbe_force_simd_path(char const *path)
+{
+	std::string name(path);
+	Path wanted = Path::Scalar;
+	if (name == "scalar")
+		wanted = Path::Scalar;
+	else if (name == "sse2")
+		wanted = Path::SSE2;
+	else if (name == "avx2")
+		wanted = Path::AVX2;
+	else
+		return false;
+	if (wanted > best_path()) // paths are ordered by the instructions they need
+		return false;
+	forced_path.store(int(wanted), std::memory_order_relaxed);
+	return true;
+}
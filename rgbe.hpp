@@ -2,6 +2,9 @@
 
 #include "glm.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 
 //from https://github.com/ixchow/15-466-ibl/blob/master/rgbe.hpp
 
@@ -39,6 +42,12 @@ inline uint32_t rgbe_to_E5B9G9R9(glm::u8vec4 col) {
 	return ((exp_shared & 0b11111) << 27) | ((b & 0b111111111) << 18) | ((g & 0b111111111) << 9) | (r & 0b111111111);
 }
 
+// shared exponent in the top 5 bits (bias 15), 9-bit mantissas without an implied leading one:
+inline glm::vec3 E5B9G9R9_to_linear(uint32_t packed) {
+	float scale = std::ldexp(1.0f, int32_t(packed >> 27) - 15 - 9);
+	return glm::vec3(float(packed & 0x1ff) * scale, float((packed >> 9) & 0x1ff) * scale, float((packed >> 18) & 0x1ff) * scale);
+}
+
 inline glm::u8vec4 float_to_rgbe(glm::vec3 col) {
 
 	float d = std::max(col.r, std::max(col.g, col.b));
@@ -63,4 +72,44 @@ inline glm::u8vec4 float_to_rgbe(glm::vec3 col) {
 		std::max(0, int32_t(col.b * fac)),
 		e + 128
 	);
-}
\ No newline at end of file
+}
+
+// cube tool's conversions (radiance .pic style, no rounding offset):
+inline glm::vec3 rgbe_to_linear(glm::u8vec4 col) {
+	if (col.a == 0) return glm::vec3(0.0f);
+	float scale = std::ldexp(1.0f, int(col.a) - (128 + 8));
+	return glm::vec3(float(col.r) * scale, float(col.g) * scale, float(col.b) * scale);
+}
+
+inline glm::u8vec4 linear_to_rgbe(glm::vec3 c) {
+	float maxc = std::max(c.r, std::max(c.g, c.b));
+	if (maxc < 1e-32f) return glm::u8vec4(0, 0, 0, 0);
+
+	int exp;
+	float mant = std::frexp(maxc, &exp);
+	float scale = mant * 256.0f / maxc;
+
+	return glm::u8vec4(
+		uint8_t(std::clamp(c.r * scale, 0.0f, 255.0f)),
+		uint8_t(std::clamp(c.g * scale, 0.0f, 255.0f)),
+		uint8_t(std::clamp(c.b * scale, 0.0f, 255.0f)),
+		uint8_t(exp + 128)
+	);
+}
+
+//--------------------------------------------
+// bulk conversions (rgbe.cpp) for whole images: split across hardware threads, and vectorized with AVX2 or SSE2
+// (picked at runtime) on x86-64, scalar elsewhere. Every path produces exactly the bits of the per-pixel functions above.
+
+// rgbe: count pixels of 4 bytes (r, g, b, e)
+void rgbe_to_E5B9G9R9(uint8_t const *rgbe, uint32_t *out, size_t count);
+void rgbe_to_linear(uint8_t const *rgbe, glm::vec3 *out, size_t count);
+void linear_to_rgbe(glm::vec4 const *linear, uint8_t *rgbe, size_t count); // alpha is ignored
+// rgbe_to_linear then 4 half floats per pixel (alpha 1), clamped to the largest finite half (threaded, not vectorized):
+void rgbe_to_half(uint8_t const *rgbe, uint16_t *out, size_t count);
+
+// which path the bulk conversions take on this machine ("avx2", "sse2" or "scalar"), for logging:
+char const *rgbe_simd_path();
+// makes the bulk conversions take path ("avx2", "sse2" or "scalar") instead, so bin/rgbe-test can check every path the
+// machine supports; returns false (and changes nothing) if this machine can't run it:
+bool rgbe_force_simd_path(char const *path);
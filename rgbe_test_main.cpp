@@ -0,0 +1,344 @@
+// rgbe-test: checks that the bulk rgbe conversions (rgbe.cpp) produce exactly the bits of the per-pixel reference
+// functions in rgbe.hpp, on every SIMD path this machine supports, with images large enough to be split across threads:
+//   rgbe_to_E5B9G9R9 and rgbe_to_linear over every r,g,b,e byte pattern
+//   linear_to_rgbe over edge-case floats (signed zeros, denormals, the 1e-32 cutoff, powers of two and their neighbors,
+//   the largest floats, negative channels) and seeded random finite floats
+// exits with 1 if any path differs anywhere:
+//   bin/rgbe-test
+//   bin/rgbe-test --exponents 120 136 --path sse2
+
+#include "glm.hpp"
+#include "rgbe.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct Options
+{
+	uint32_t exponent_first = 0;	// e bytes whose every r,g,b is checked
+	uint32_t exponent_last = 255;
+	std::vector<std::string> paths; // empty: every path this machine supports
+	uint32_t random_floats = 1 << 22;
+	uint32_t seed = 1;
+
+	void parse(int argc, char **argv);
+	static void usage(std::function<void(const char *, const char *)> const &callback);
+};
+
+void Options::parse(int argc, char **argv)
+{
+	for (int argi = 1; argi < argc; ++argi)
+	{
+		std::string arg = argv[argi];
+		auto next = [&]() -> std::string
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error(arg + " requires a parameter.");
+			argi += 1;
+			return argv[argi];
+		};
+		auto next_uint = [&]() -> uint32_t
+		{
+			std::string value = next();
+			size_t used = 0;
+			unsigned long parsed = 0;
+			try
+			{
+				parsed = std::stoul(value, &used);
+			}
+			catch (std::exception &)
+			{
+				used = 0;
+			}
+			if (used != value.size() || value.empty() || value[0] == '-')
+				throw std::runtime_error(arg + " expects a non-negative integer, got '" + value + "'.");
+			return uint32_t(parsed);
+		};
+
+		if (arg == "--exponents")
+		{
+			exponent_first = next_uint();
+			exponent_last = next_uint();
+			if (exponent_first > exponent_last || exponent_last > 255)
+				throw std::runtime_error("--exponents expects first <= last <= 255.");
+		}
+		else if (arg == "--path")
+		{
+			std::string path = next();
+			if (path != "avx2" && path != "sse2" && path != "scalar")
+				throw std::runtime_error("--path expects avx2, sse2 or scalar, got '" + path + "'.");
+			paths.emplace_back(path);
+		}
+		else if (arg == "--random")
+			random_floats = next_uint();
+		else if (arg == "--seed")
+			seed = next_uint();
+		else
+			throw std::runtime_error("Unrecognized argument '" + arg + "'.");
+	}
+}
+
+void Options::usage(std::function<void(const char *, const char *)> const &callback)
+{
+	callback("--exponents <first> <last>", "Only check rgbe inputs whose e byte is in [first, last] (default: 0 255, all of them).");
+	callback("--path <avx2|sse2|scalar>", "Check this path (repeat for several). Default: every path this machine supports.");
+	callback("--random <count>", "Random floats checked through linear_to_rgbe (default: 4194304).");
+	callback("--seed <seed>", "Seed for the random floats (default: 1).");
+}
+
+// mismatches of one conversion on one path, the first few are printed:
+struct Mismatches
+{
+	char const *what;
+	char const *path;
+	uint64_t count = 0;
+
+	template <typename Describe>
+	void add(Describe const &describe)
+	{
+		if (count < 8)
+		{
+			std::cerr << "MISMATCH " << what << " (" << path << "): ";
+			describe(std::cerr);
+			std::cerr << "\n";
+		}
+		count += 1;
+	}
+};
+
+static std::string hex(uint32_t value)
+{
+	char buffer[11];
+	std::snprintf(buffer, sizeof(buffer), "0x%08x", value);
+	return buffer;
+}
+
+static uint32_t bits(float value)
+{
+	uint32_t ret;
+	std::memcpy(&ret, &value, sizeof(ret));
+	return ret;
+}
+
+// every value linear_to_rgbe treats specially or rounds near a boundary, from both sides:
+static std::vector<float> edge_floats()
+{
+	std::vector<float> values{
+		0.0f,
+		-0.0f,
+		1e-32f,
+		std::nextafter(1e-32f, 0.0f),
+		std::nextafter(1e-32f, 1.0f),
+		std::numeric_limits<float>::denorm_min(),
+		std::numeric_limits<float>::min(),
+		std::nextafter(std::numeric_limits<float>::min(), 0.0f),
+		std::numeric_limits<float>::max(),
+		std::nextafter(std::numeric_limits<float>::max(), 0.0f),
+		255.0f / 256.0f,
+		255.5f / 256.0f,
+		0.1f,
+		1.0f / 3.0f,
+		3.14159265f,
+	};
+	for (int32_t e = -149; e <= 127; ++e)
+	{
+		float p = std::ldexp(1.0f, e);
+		values.emplace_back(p);
+		values.emplace_back(std::nextafter(p, 0.0f));
+		values.emplace_back(std::nextafter(p, std::numeric_limits<float>::infinity()));
+		values.emplace_back(std::ldexp(1.5f, e));
+	}
+	size_t positive = values.size();
+	for (size_t i = 0; i < positive; i += 3)
+	{
+		values.emplace_back(-values[i]);
+	}
+	values.erase(std::remove_if(values.begin(), values.end(), [](float v)
+								{ return !std::isfinite(v); }),
+				 values.end());
+	return values;
+}
+
+int main(int argc, char **argv)
+{
+	// main wrapped in a try-catch so we can print some debug info about uncaught exceptions:
+	try
+	{
+		Options options;
+		try
+		{
+			options.parse(argc, argv);
+		}
+		catch (std::runtime_error &e)
+		{
+			std::cerr << "Failed to parse arguments:\n"
+					  << e.what() << std::endl;
+			std::cerr << "Usage:" << std::endl;
+			Options::usage([](const char *arg, const char *desc)
+						   { std::cerr << "    " << arg << "\n        " << desc << std::endl; });
+			return 1;
+		}
+
+		std::vector<std::string> paths = options.paths;
+		if (paths.empty())
+		{
+			for (char const *path : {"scalar", "sse2", "avx2"})
+			{
+				if (rgbe_force_simd_path(path))
+					paths.emplace_back(path);
+			}
+		}
+		for (std::string const &path : paths)
+		{
+			if (!rgbe_force_simd_path(path.c_str()))
+				throw std::runtime_error("This machine can't run the " + path + " path.");
+		}
+		std::cout << "Checking paths:";
+		for (std::string const &path : paths)
+			std::cout << " " << path;
+		std::cout << std::endl;
+
+		std::vector<Mismatches> e5b9g9r9_mismatches, linear_mismatches, rgbe_mismatches;
+		for (std::string const &path : paths)
+		{
+			e5b9g9r9_mismatches.emplace_back(Mismatches{.what = "rgbe_to_E5B9G9R9", .path = path.c_str()});
+			linear_mismatches.emplace_back(Mismatches{.what = "rgbe_to_linear", .path = path.c_str()});
+			rgbe_mismatches.emplace_back(Mismatches{.what = "linear_to_rgbe", .path = path.c_str()});
+		}
+
+		{ // every r,g,b for each e byte, one batch of 2^24 pixels at a time:
+			constexpr size_t batch = size_t(1) << 24;
+			std::vector<uint8_t> rgbe(batch * 4);
+			std::vector<uint32_t> e5b9g9r9_expected(batch), e5b9g9r9(batch);
+			std::vector<glm::vec3> linear_expected(batch), linear(batch);
+			for (uint32_t e = options.exponent_first; e <= options.exponent_last; ++e)
+			{
+				for (size_t i = 0; i < batch; ++i)
+				{
+					glm::u8vec4 col(int(i & 0xff), int((i >> 8) & 0xff), int((i >> 16) & 0xff), int(e));
+					std::memcpy(&rgbe[4 * i], &col, 4);
+					e5b9g9r9_expected[i] = rgbe_to_E5B9G9R9(col);
+					linear_expected[i] = rgbe_to_linear(col);
+				}
+
+				for (size_t p = 0; p < paths.size(); ++p)
+				{
+					rgbe_force_simd_path(paths[p].c_str());
+					// the whole batch (split across threads), then an odd offset and length (vector tails on both ends):
+					for (size_t offset : {size_t(0), size_t(3)})
+					{
+						size_t count = batch - 2 * offset;
+						std::fill(e5b9g9r9.begin(), e5b9g9r9.end(), 0xdeadbeef);
+						rgbe_to_E5B9G9R9(rgbe.data() + 4 * offset, e5b9g9r9.data() + offset, count);
+						std::fill(linear.begin(), linear.end(), glm::vec3(-1.0f));
+						rgbe_to_linear(rgbe.data() + 4 * offset, linear.data() + offset, count);
+						for (size_t i = offset; i < offset + count; ++i)
+						{
+							if (e5b9g9r9[i] != e5b9g9r9_expected[i])
+							{
+								e5b9g9r9_mismatches[p].add([&](std::ostream &out)
+														   { out << "rgbe " << hex(uint32_t(i) | (e << 24)) << " (a,b,g,r) gave " << hex(e5b9g9r9[i]) << ", expected " << hex(e5b9g9r9_expected[i]); });
+							}
+							if (std::memcmp(&linear[i], &linear_expected[i], sizeof(glm::vec3)) != 0)
+							{
+								linear_mismatches[p].add([&](std::ostream &out)
+														 { out << "rgbe " << hex(uint32_t(i) | (e << 24)) << " (a,b,g,r) gave (" << linear[i].r << ", " << linear[i].g << ", " << linear[i].b << "), expected (" << linear_expected[i].r << ", " << linear_expected[i].g << ", " << linear_expected[i].b << ")"; });
+							}
+						}
+					}
+				}
+			}
+			std::cout << "Checked " << uint64_t(options.exponent_last - options.exponent_first + 1) * batch << " rgbe inputs." << std::endl;
+		}
+
+		{ // edge-case floats in every channel position, then random finite floats:
+			std::vector<float> edges = edge_floats();
+			std::vector<glm::vec4> linear;
+			linear.reserve(edges.size() * edges.size() + options.random_floats);
+			for (size_t i = 0; i < edges.size(); ++i)
+			{
+				for (size_t j = 0; j < edges.size(); ++j)
+				{
+					linear.emplace_back(edges[i], edges[j], edges[(i + j) % edges.size()], edges[(i * 7 + j) % edges.size()]);
+				}
+			}
+			std::mt19937 mt(options.seed);
+			auto random_float = [&]() -> float
+			{
+				while (true)
+				{
+					float value;
+					if (mt() & 1)
+					{ // any bit pattern:
+						uint32_t pattern = uint32_t(mt());
+						std::memcpy(&value, &pattern, sizeof(value));
+					}
+					else
+					{ // a plausible radiance:
+						value = std::ldexp(std::uniform_real_distribution<float>(0.0f, 1.0f)(mt), int32_t(mt() % 80) - 40);
+					}
+					if (std::isfinite(value))
+						return value;
+				}
+			};
+			for (uint32_t i = 0; i < options.random_floats; ++i)
+			{
+				linear.emplace_back(random_float(), random_float(), random_float(), random_float());
+			}
+
+			std::vector<uint8_t> expected(linear.size() * 4), rgbe(linear.size() * 4);
+			for (size_t i = 0; i < linear.size(); ++i)
+			{
+				glm::u8vec4 col = linear_to_rgbe(glm::vec3(linear[i]));
+				std::memcpy(&expected[4 * i], &col, 4);
+			}
+			for (size_t p = 0; p < paths.size(); ++p)
+			{
+				rgbe_force_simd_path(paths[p].c_str());
+				std::fill(rgbe.begin(), rgbe.end(), uint8_t(0xcd));
+				linear_to_rgbe(linear.data(), rgbe.data(), linear.size());
+				for (size_t i = 0; i < linear.size(); ++i)
+				{
+					if (std::memcmp(&rgbe[4 * i], &expected[4 * i], 4) != 0)
+					{
+						uint32_t got, want;
+						std::memcpy(&got, &rgbe[4 * i], 4);
+						std::memcpy(&want, &expected[4 * i], 4);
+						rgbe_mismatches[p].add([&](std::ostream &out)
+											   { out << "(" << hex(bits(linear[i].r)) << ", " << hex(bits(linear[i].g)) << ", " << hex(bits(linear[i].b)) << ") gave " << hex(got) << " (e,b,g,r), expected " << hex(want); });
+					}
+				}
+			}
+			std::cout << "Checked " << linear.size() << " float inputs (" << edges.size() << " edge values)." << std::endl;
+		}
+
+		uint64_t failed = 0;
+		for (std::vector<Mismatches> const *mismatches : {&e5b9g9r9_mismatches, &linear_mismatches, &rgbe_mismatches})
+		{
+			for (Mismatches const &m : *mismatches)
+			{
+				if (m.count != 0)
+					std::cout << m.what << " (" << m.path << "): " << m.count << " mismatches." << std::endl;
+				failed += m.count;
+			}
+		}
+		if (failed != 0)
+			return 1;
+		std::cout << "All bulk conversions match the reference functions bit for bit." << std::endl;
+	}
+	catch (std::exception &e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
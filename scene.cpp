@@ -1,20 +1,27 @@
 #include "scene.hpp"
 #include "../Lib/sejp.hpp"
 #include "glm.hpp"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include "data_path.hpp"
+#include "Trace.hpp"
+#include "StartupProfile.hpp"
 #include <optional>
 #include <unordered_map>
+#include <filesystem>
+#include <tuple>
 
-Scene::Scene(std::string filename, std::optional<std::string> camera, uint8_t animation_setting_)
-    : animation_setting(animation_setting_)
+Scene::Scene(std::string filename, std::optional<std::string> camera, uint8_t animation_setting_, bool verbose_)
+    : animation_setting(animation_setting_), verbose(verbose_)
 {
     load(data_path(filename), camera);
 }
 
 void Scene::load(std::string filename, std::optional<std::string> requested_camera)
 {
+    TRACE_ZONE("Scene::load");
+    StartupProfile::Phase startup_phase("Scene::load");
     // check file format
     if (filename.substr(filename.size() - 4, 4) != ".s72")
     {
@@ -22,7 +29,17 @@ void Scene::load(std::string filename, std::optional<std::string> requested_came
     }
 
     scene_path = filename.substr(0, filename.rfind('/'));
+    Trace::Zone parse_zone("Scene::load parse");
+    StartupProfile::Phase parse_phase("Scene::load parse");
+    if (StartupProfile::enabled())
+    {
+        std::error_code size_error;
+        uintmax_t size = std::filesystem::file_size(filename, size_error);
+        parse_phase.bytes = startup_phase.bytes = size_error ? 0 : uint64_t(size);
+    }
     sejp::value val = sejp::load(filename);
+    parse_phase.end();
+    parse_zone.end();
 
     try
     {
@@ -778,6 +795,7 @@ void Scene::load(std::string filename, std::optional<std::string> requested_came
                     {
                         shadow = uint32_t(shadow_res->second.as_number().value());
                     }
+                    lights[light_index].shadow = shadow;
                 }
 
                 // For sun
@@ -1014,9 +1032,127 @@ void Scene::load(std::string filename, std::optional<std::string> requested_came
     {
         requested_camera_index = 0;
     }
+    deduplicate_textures();
     debug();
 }
 
+// byte-for-byte comparison of two files, false if either can't be read:
+static bool same_file_contents(std::string const &a_path, std::string const &b_path)
+{
+    std::ifstream a(a_path, std::ios::binary), b(b_path, std::ios::binary);
+    if (!a || !b)
+        return false;
+    std::vector<char> a_chunk(1 << 16), b_chunk(1 << 16);
+    while (true)
+    {
+        a.read(a_chunk.data(), a_chunk.size());
+        b.read(b_chunk.data(), b_chunk.size());
+        if (a.bad() || b.bad() || a.gcount() != b.gcount())
+            return false;
+        if (a.gcount() == 0)
+            return true;
+        if (!std::equal(a_chunk.begin(), a_chunk.begin() + a.gcount(), b_chunk.begin()))
+            return false;
+    }
+}
+
+void Scene::deduplicate_textures()
+{
+    TRACE_ZONE("Scene::deduplicate_textures");
+    StartupProfile::Phase startup_phase("Scene::deduplicate_textures");
+    // exported scenes reach the same image through different paths or copies, and repeat constant values across materials.
+    // material references are pointed at the first texture with the same contents and format (unreferenced ones are never uploaded):
+    std::vector<uint32_t> remap(textures.size());
+    for (uint32_t i = 0; i < textures.size(); ++i)
+    {
+        remap[i] = i;
+    }
+
+    // constants compare by value:
+    std::map<std::tuple<uint32_t, bool, float, float, float>, uint32_t> constants;
+    // sources are grouped by file size first, so only files that could match are read and hashed:
+    std::map<std::tuple<uint32_t, bool, uint64_t>, std::vector<uint32_t>> same_size;
+    for (uint32_t i = 0; i < textures.size(); ++i)
+    {
+        const Texture &texture = textures[i];
+        if (!texture.has_src)
+        {
+            glm::vec3 value = texture.single_channel ? glm::vec3(std::get<float>(texture.value), 0.0f, 0.0f) : std::get<glm::vec3>(texture.value);
+            auto [found, inserted] = constants.emplace(std::make_tuple(uint32_t(texture.format), texture.single_channel, value.x, value.y, value.z), i);
+            remap[i] = found->second;
+            continue;
+        }
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(scene_path + "/" + std::get<std::string>(texture.value), ec);
+        if (ec)
+            continue; // reported when the renderer fails to load it
+        same_size[std::make_tuple(uint32_t(texture.format), texture.single_channel, size)].push_back(i);
+    }
+
+    for (auto const &[key, candidates] : same_size)
+    {
+        if (candidates.size() < 2)
+            continue;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> by_hash; // hash -> first texture of each distinct content
+        for (uint32_t i : candidates)
+        {
+            std::string path = scene_path + "/" + std::get<std::string>(textures[i].value);
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                continue; // reported when the renderer fails to load it
+            // FNV-1a over the file contents:
+            uint64_t hash = 0xcbf29ce484222325ull;
+            std::vector<char> chunk(1 << 16);
+            while (file.read(chunk.data(), chunk.size()) || file.gcount() > 0)
+            {
+                for (std::streamsize b = 0; b < file.gcount(); ++b)
+                {
+                    hash = (hash ^ uint8_t(chunk[b])) * 0x100000001b3ull;
+                }
+            }
+            if (file.bad())
+                continue;
+            // a matching hash is only a candidate, the bytes decide:
+            std::vector<uint32_t> &firsts = by_hash[hash];
+            auto found = std::find_if(firsts.begin(), firsts.end(), [&](uint32_t first)
+                                      { return same_file_contents(scene_path + "/" + std::get<std::string>(textures[first].value), path); });
+            if (found != firsts.end())
+                remap[i] = *found;
+            else
+                firsts.push_back(i);
+        }
+    }
+
+    uint32_t merged = 0;
+    for (uint32_t i = 0; i < textures.size(); ++i)
+    {
+        if (remap[i] != i)
+            ++merged;
+    }
+    if (merged == 0)
+        return;
+
+    for (Material &material : materials)
+    {
+        material.normal_index = remap[material.normal_index];
+        material.displacement_index = remap[material.displacement_index];
+        if (Material::LambertianMaterial *lambertian = std::get_if<Material::LambertianMaterial>(&material.material_textures))
+        {
+            lambertian->albedo_index = remap[lambertian->albedo_index];
+        }
+        else if (Material::PBRMaterial *pbr = std::get_if<Material::PBRMaterial>(&material.material_textures))
+        {
+            pbr->albedo_index = remap[pbr->albedo_index];
+            pbr->roughness_index = remap[pbr->roughness_index];
+            pbr->metalness_index = remap[pbr->metalness_index];
+        }
+    }
+    if (verbose)
+    {
+        std::cout << "Deduplicated " << merged << " of " << textures.size() << " textures." << std::endl;
+    }
+}
+
 void Scene::debug()
 {
     for (const auto &node : nodes)
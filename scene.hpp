@@ -202,9 +202,9 @@ struct Scene
     std::vector<Mesh> meshes;
     uint32_t vertices_count = 0;
     std::vector<Material> materials;
-    uint32_t MatPBR_count;
-    uint32_t MatLambertian_count;
-    uint32_t MatEnvMirror_count; // both environment and mirror just need normal and displacement
+    uint32_t MatPBR_count = 0;
+    uint32_t MatLambertian_count = 0;
+    uint32_t MatEnvMirror_count = 0; // both environment and mirror just need normal and displacement
     std::vector<Texture> textures;
     std::vector<uint32_t> root_nodes;
     std::vector<Light> lights;
@@ -214,10 +214,12 @@ struct Scene
     uint8_t animation_setting;
     float return_time = 0.0f;
     Environment environment = Environment();
+    bool verbose = false; // report load statistics (--debug)
 
     // Functions
-    Scene(std::string filename, std::optional<std::string> camera, uint8_t animation_setting);
+    Scene(std::string filename, std::optional<std::string> camera, uint8_t animation_setting, bool verbose = false);
     void load(std::string filename, std::optional<std::string> camera);
+    void deduplicate_textures(); // points material references at the first texture with the same contents
     void debug();
     void update_drivers(float dt);
     void set_driver_time(float t);
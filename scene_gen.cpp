@@ -0,0 +1,697 @@
+#include "scene_gen.hpp"
+
+#include "glm.hpp"
+#include "rgbe.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../Lib/stb/stb_image_write.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// the generator's pieces stay local to this file, it is linked into tools with their own Mesh and Node types:
+namespace
+{
+
+// matches PosNorTanTexVertex, which the viewer reads .b72 files straight into:
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec4 tangent;
+	glm::vec2 texcoord;
+};
+static_assert(sizeof(Vertex) == 48, "Vertex is packed like PosNorTanTexVertex");
+
+//--------------------------------------------
+// geometry: triangle lists of parametric surfaces, so normals and tangents come out exact
+
+struct Mesh
+{
+	std::string name;
+	std::vector<Vertex> vertices;
+};
+
+// emits a (u, v) grid of surface(u, v) -> vertex, two triangles per cell:
+static void add_grid(std::vector<Vertex> &out, uint32_t cols, uint32_t rows, std::function<Vertex(float, float)> const &surface)
+{
+	std::vector<Vertex> grid;
+	grid.reserve(size_t(cols + 1) * (rows + 1));
+	for (uint32_t y = 0; y <= rows; ++y)
+	{
+		for (uint32_t x = 0; x <= cols; ++x)
+		{
+			grid.emplace_back(surface(float(x) / float(cols), float(y) / float(rows)));
+		}
+	}
+	auto at = [&](uint32_t x, uint32_t y) -> Vertex const &
+	{
+		return grid[size_t(y) * (cols + 1) + x];
+	};
+	for (uint32_t y = 0; y < rows; ++y)
+	{
+		for (uint32_t x = 0; x < cols; ++x)
+		{
+			out.emplace_back(at(x, y));
+			out.emplace_back(at(x + 1, y));
+			out.emplace_back(at(x + 1, y + 1));
+			out.emplace_back(at(x, y));
+			out.emplace_back(at(x + 1, y + 1));
+			out.emplace_back(at(x, y + 1));
+		}
+	}
+}
+
+static Mesh make_box(uint32_t detail)
+{
+	Mesh mesh;
+	// (normal, tangent) of each face, bitangent = cross(normal, tangent):
+	static const std::array<std::pair<glm::vec3, glm::vec3>, 6> faces{{
+		{{1, 0, 0}, {0, 1, 0}},
+		{{-1, 0, 0}, {0, -1, 0}},
+		{{0, 1, 0}, {-1, 0, 0}},
+		{{0, -1, 0}, {1, 0, 0}},
+		{{0, 0, 1}, {1, 0, 0}},
+		{{0, 0, -1}, {-1, 0, 0}},
+	}};
+	for (auto const &[normal, tangent] : faces)
+	{
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		add_grid(mesh.vertices, detail, detail, [&](float u, float v)
+				 { return Vertex{
+					   .position = 0.5f * (normal + (2.0f * u - 1.0f) * tangent + (2.0f * v - 1.0f) * bitangent),
+					   .normal = normal,
+					   .tangent = glm::vec4(tangent, 1.0f),
+					   .texcoord = glm::vec2(u, v),
+				   }; });
+	}
+	return mesh;
+}
+
+static Mesh make_sphere(uint32_t detail)
+{
+	Mesh mesh;
+	add_grid(mesh.vertices, 2 * detail, detail, [](float u, float v)
+			 {
+		float phi = u * 2.0f * float(M_PI);
+		float theta = (v - 0.5f) * float(M_PI);
+		glm::vec3 normal(std::cos(theta) * std::cos(phi), std::cos(theta) * std::sin(phi), std::sin(theta));
+		return Vertex{
+			.position = 0.5f * normal,
+			.normal = normal,
+			.tangent = glm::vec4(-std::sin(phi), std::cos(phi), 0.0f, 1.0f),
+			.texcoord = glm::vec2(u, v),
+		}; });
+	return mesh;
+}
+
+static Mesh make_torus(uint32_t detail)
+{
+	Mesh mesh;
+	const float major = 0.35f, minor = 0.15f;
+	add_grid(mesh.vertices, 2 * detail, detail, [&](float u, float v)
+			 {
+		float phi = u * 2.0f * float(M_PI);
+		float theta = v * 2.0f * float(M_PI);
+		glm::vec3 ring(std::cos(phi), std::sin(phi), 0.0f);
+		glm::vec3 normal = std::cos(theta) * ring + glm::vec3(0.0f, 0.0f, std::sin(theta));
+		return Vertex{
+			.position = major * ring + minor * normal,
+			.normal = normal,
+			.tangent = glm::vec4(-std::sin(phi), std::cos(phi), 0.0f, 1.0f),
+			.texcoord = glm::vec2(u, v),
+		}; });
+	return mesh;
+}
+
+static Mesh make_cylinder(uint32_t detail)
+{
+	Mesh mesh;
+	add_grid(mesh.vertices, 2 * detail, std::max(1u, detail / 4), [](float u, float v)
+			 {
+		float phi = u * 2.0f * float(M_PI);
+		glm::vec3 normal(std::cos(phi), std::sin(phi), 0.0f);
+		return Vertex{
+			.position = 0.4f * normal + glm::vec3(0.0f, 0.0f, v - 0.5f),
+			.normal = normal,
+			.tangent = glm::vec4(-std::sin(phi), std::cos(phi), 0.0f, 1.0f),
+			.texcoord = glm::vec2(u, v),
+		}; });
+	// caps:
+	for (float side : {-1.0f, 1.0f})
+	{
+		add_grid(mesh.vertices, 2 * detail, 1, [&](float u, float v)
+				 {
+			float phi = side * u * 2.0f * float(M_PI);
+			glm::vec2 disk = 0.4f * (1.0f - v) * glm::vec2(std::cos(phi), std::sin(phi));
+			return Vertex{
+				.position = glm::vec3(disk, 0.5f * side),
+				.normal = glm::vec3(0.0f, 0.0f, side),
+				.tangent = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f),
+				.texcoord = glm::vec2(0.5f) + disk,
+			}; });
+	}
+	return mesh;
+}
+
+static Mesh make_ground(float extent)
+{
+	Mesh mesh;
+	mesh.name = "ground";
+	add_grid(mesh.vertices, 1, 1, [&](float u, float v)
+			 { return Vertex{
+				   .position = glm::vec3((2.0f * u - 1.0f) * extent, (2.0f * v - 1.0f) * extent, 0.0f),
+				   .normal = glm::vec3(0.0f, 0.0f, 1.0f),
+				   .tangent = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f),
+				   .texcoord = glm::vec2(u, v) * extent * 0.25f,
+			   }; });
+	return mesh;
+}
+
+//--------------------------------------------
+// textures
+
+static void write_png(std::filesystem::path const &path, uint32_t size, int channels, std::vector<uint8_t> const &pixels)
+{
+	if (!stbi_write_png(path.string().c_str(), int(size), int(size), channels, pixels.data(), int(size) * channels))
+		throw std::runtime_error("Failed to write '" + path.string() + "'.");
+}
+
+// checkerboard of two colors, with a random number of squares:
+static std::vector<uint8_t> checker_rgba(uint32_t size, glm::vec3 a, glm::vec3 b, uint32_t squares)
+{
+	std::vector<uint8_t> pixels(size_t(size) * size * 4);
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			bool odd = (((x * squares) / size) + ((y * squares) / size)) % 2;
+			glm::vec3 c = odd ? a : b;
+			uint8_t *px = &pixels[(size_t(y) * size + x) * 4];
+			px[0] = uint8_t(std::clamp(c.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+			px[1] = uint8_t(std::clamp(c.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+			px[2] = uint8_t(std::clamp(c.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+			px[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+// smooth single channel pattern between lo and hi:
+static std::vector<uint8_t> waves_gray(uint32_t size, float lo, float hi, float frequency, float phase)
+{
+	std::vector<uint8_t> pixels(size_t(size) * size);
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			float u = float(x) / float(size), v = float(y) / float(size);
+			float t = 0.5f + 0.25f * std::sin(2.0f * float(M_PI) * (frequency * u + phase)) + 0.25f * std::sin(2.0f * float(M_PI) * (frequency * v - phase));
+			pixels[size_t(y) * size + x] = uint8_t(std::clamp(lo + (hi - lo) * t, 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+	return pixels;
+}
+
+// tangent space normals of a grid of rounded bumps:
+static std::vector<uint8_t> bumps_normal(uint32_t size, uint32_t bumps)
+{
+	std::vector<uint8_t> pixels(size_t(size) * size * 4);
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			float u = float(x) / float(size) * float(bumps), v = float(y) / float(size) * float(bumps);
+			float k = 2.0f * float(M_PI);
+			glm::vec3 n = glm::normalize(glm::vec3(-0.3f * std::cos(k * u) * std::sin(k * v), -0.3f * std::sin(k * u) * std::cos(k * v), 1.0f));
+			uint8_t *px = &pixels[(size_t(y) * size + x) * 4];
+			px[0] = uint8_t((n.x * 0.5f + 0.5f) * 255.0f + 0.5f);
+			px[1] = uint8_t((n.y * 0.5f + 0.5f) * 255.0f + 0.5f);
+			px[2] = uint8_t((n.z * 0.5f + 0.5f) * 255.0f + 0.5f);
+			px[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+// rgbe cubemap, faces +x -x +y -y +z -z stacked vertically like the cube tool writes them; a z-up sky with a sun:
+static void write_environment(std::filesystem::path const &path, uint32_t size, glm::vec3 sun_direction)
+{
+	std::vector<uint8_t> pixels(size_t(size) * size * 6 * 4);
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				glm::vec2 uv = (glm::vec2(float(x) + 0.5f, float(y) + 0.5f) / float(size)) * 2.0f - 1.0f;
+				glm::vec3 dir;
+				switch (face)
+				{
+				case 0: dir = glm::vec3(1.0f, -uv.y, -uv.x); break;
+				case 1: dir = glm::vec3(-1.0f, -uv.y, uv.x); break;
+				case 2: dir = glm::vec3(uv.x, 1.0f, uv.y); break;
+				case 3: dir = glm::vec3(uv.x, -1.0f, -uv.y); break;
+				case 4: dir = glm::vec3(uv.x, -uv.y, 1.0f); break;
+				default: dir = glm::vec3(-uv.x, -uv.y, -1.0f); break;
+				}
+				dir = glm::normalize(dir);
+
+				glm::vec3 horizon(0.9f, 0.85f, 0.8f), zenith(0.25f, 0.45f, 0.9f), ground(0.2f, 0.18f, 0.15f);
+				glm::vec3 radiance = dir.z >= 0.0f ? glm::mix(horizon, zenith, std::sqrt(dir.z)) : glm::mix(horizon, ground, std::sqrt(-dir.z));
+				radiance += glm::vec3(40.0f, 36.0f, 30.0f) * std::pow(std::max(0.0f, glm::dot(dir, sun_direction)), 512.0f);
+
+				glm::u8vec4 rgbe = linear_to_rgbe(radiance);
+				std::memcpy(&pixels[((size_t(face) * size + y) * size + x) * 4], &rgbe, 4);
+			}
+		}
+	}
+	if (!stbi_write_png(path.string().c_str(), int(size), int(size * 6), 4, pixels.data(), int(size) * 4))
+		throw std::runtime_error("Failed to write '" + path.string() + "'.");
+}
+
+//--------------------------------------------
+// s72 writing
+
+static std::string quote(std::string const &str)
+{
+	return "\"" + str + "\""; // generated names never need escapes
+}
+
+struct Writer
+{
+	std::ostringstream out;
+
+	Writer()
+	{
+		out << std::setprecision(6);
+		out << "[\"s72-v2\"";
+	}
+	// start the next object in the top-level array:
+	std::ostream &object()
+	{
+		out << ",\n";
+		return out;
+	}
+	template <typename T>
+	std::string list(T const &values)
+	{
+		std::ostringstream list;
+		list << std::setprecision(6) << "[";
+		for (size_t i = 0; i < values.size(); ++i)
+			list << (i ? "," : "") << values[i];
+		list << "]";
+		return list.str();
+	}
+	std::string vec(glm::vec3 v) { return list(std::array<float, 3>{v.x, v.y, v.z}); }
+	std::string quat(glm::quat q) { return list(std::array<float, 4>{q.x, q.y, q.z, q.w}); }
+};
+
+struct Node
+{
+	std::string name;
+	glm::vec3 translation = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+	std::vector<uint32_t> children;
+	std::string mesh, camera, light;
+	uint32_t level = 0;
+};
+
+} // namespace
+
+//--------------------------------------------
+// the scene
+
+SceneGenStats generate_scene(SceneGenSettings const &settings)
+{
+	std::mt19937 mt(settings.seed);
+	auto uniform = [&](float lo, float hi)
+	{
+		return std::uniform_real_distribution<float>(lo, hi)(mt);
+	};
+	auto pick = [&](uint32_t count)
+	{
+		return std::uniform_int_distribution<uint32_t>(0, count - 1)(mt);
+	};
+	auto random_color = [&]()
+	{
+		return glm::vec3(uniform(0.1f, 0.9f), uniform(0.1f, 0.9f), uniform(0.1f, 0.9f));
+	};
+
+	std::filesystem::path out_path(settings.out);
+	std::filesystem::path directory = out_path.parent_path();
+	std::string stem = out_path.stem().string();
+	if (!directory.empty())
+		std::filesystem::create_directories(directory);
+	auto asset = [&](std::string const &suffix)
+	{
+		return stem + "." + suffix; // relative to the scene, which is how s72 sources are resolved
+	};
+
+	Writer writer;
+	uint64_t vertices_written = 0;
+	uint32_t textures_written = 0;
+
+	// geometry, the shape cycles and the tessellation grows from coarse to settings.detail:
+	auto write_mesh_data = [&](Mesh const &mesh)
+	{
+		std::filesystem::path path = directory / asset(mesh.name + ".b72");
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<char const *>(mesh.vertices.data()), std::streamsize(mesh.vertices.size() * sizeof(Vertex)));
+		if (!file)
+			throw std::runtime_error("Failed to write '" + path.string() + "'.");
+		vertices_written += mesh.vertices.size();
+	};
+	std::vector<Mesh> geometries;
+	for (uint32_t i = 0; i < settings.geometries; ++i)
+	{
+		uint32_t detail = std::max(3u, settings.detail * (i / 4 + 1) / ((settings.geometries + 3) / 4));
+		Mesh mesh;
+		switch (i % 4)
+		{
+		case 0: mesh = make_box(std::max(1u, detail / 4)); break;
+		case 1: mesh = make_sphere(detail); break;
+		case 2: mesh = make_torus(detail); break;
+		default: mesh = make_cylinder(detail); break;
+		}
+		mesh.name = "geometry" + std::to_string(i);
+		write_mesh_data(mesh);
+		geometries.emplace_back(std::move(mesh));
+	}
+	Mesh ground = make_ground(settings.extent * 1.25f);
+	write_mesh_data(ground);
+
+	auto write_mesh = [&](std::string const &name, Mesh const &mesh, std::string const &material)
+	{
+		std::string src = quote(asset(mesh.name + ".b72"));
+		writer.object() << "{\"type\":\"MESH\",\"name\":" << quote(name) << ",\"topology\":\"TRIANGLE_LIST\",\"count\":" << mesh.vertices.size()
+						<< ",\"attributes\":{"
+						<< "\"POSITION\":{\"src\":" << src << ",\"offset\":0,\"stride\":48,\"format\":\"R32G32B32_SFLOAT\"},"
+						<< "\"NORMAL\":{\"src\":" << src << ",\"offset\":12,\"stride\":48,\"format\":\"R32G32B32_SFLOAT\"},"
+						<< "\"TANGENT\":{\"src\":" << src << ",\"offset\":24,\"stride\":48,\"format\":\"R32G32B32A32_SFLOAT\"},"
+						<< "\"TEXCOORD\":{\"src\":" << src << ",\"offset\":40,\"stride\":48,\"format\":\"R32G32_SFLOAT\"}"
+						<< "},\"material\":" << quote(material) << "}";
+	};
+
+	// materials, types drawn by --mix weights, about half of them textured:
+	uint32_t size = settings.texture_size;
+	std::string normal_map = asset("bumps.png");
+	bool normal_map_written = false;
+	bool needs_environment = false;
+	std::array<uint32_t, 4> material_counts{};
+	std::discrete_distribution<uint32_t> material_type(settings.mix.begin(), settings.mix.end());
+	std::vector<std::string> material_names;
+	for (uint32_t i = 0; i < settings.materials; ++i)
+	{
+		std::string name = "material" + std::to_string(i);
+		material_names.emplace_back(name);
+		uint32_t type = material_type(mt);
+		material_counts[type] += 1;
+		bool textured = uniform(0.0f, 1.0f) < 0.5f;
+		auto albedo = [&]() -> std::string
+		{
+			if (!textured)
+				return writer.vec(random_color());
+			std::string src = asset(name + ".albedo.png");
+			write_png(directory / src, size, 4, checker_rgba(size, random_color(), random_color(), 2 + 2 * pick(8)));
+			textures_written += 1;
+			return "{\"src\":" + quote(src) + ",\"format\":\"srgb\"}";
+		};
+		auto scalar = [&](char const *what, float lo, float hi) -> std::string
+		{
+			if (!textured)
+			{
+				std::ostringstream value;
+				value << std::setprecision(3) << uniform(lo, hi);
+				return value.str();
+			}
+			std::string src = asset(name + "." + what + ".png");
+			write_png(directory / src, size, 1, waves_gray(size, lo, hi, float(1 + pick(6)), uniform(0.0f, 1.0f)));
+			textures_written += 1;
+			return "{\"src\":" + quote(src) + "}";
+		};
+
+		std::ostream &out = writer.object();
+		out << "{\"type\":\"MATERIAL\",\"name\":" << quote(name);
+		if (textured && type < 2)
+		{
+			if (!normal_map_written)
+			{
+				write_png(directory / normal_map, size, 4, bumps_normal(size, 8));
+				textures_written += 1;
+				normal_map_written = true;
+			}
+			out << ",\"normalMap\":{\"src\":" << quote(normal_map) << "}";
+		}
+		if (type == 0)
+			out << ",\"lambertian\":{\"albedo\":" << albedo() << "}";
+		else if (type == 1)
+		{
+			std::string albedo_value = albedo();
+			std::string roughness = scalar("roughness", 0.05f, 0.95f);
+			std::string metalness = scalar("metalness", 0.0f, 1.0f);
+			out << ",\"pbr\":{\"albedo\":" << albedo_value << ",\"roughness\":" << roughness << ",\"metalness\":" << metalness << "}";
+			needs_environment = true;
+		}
+		else if (type == 2)
+		{
+			out << ",\"mirror\":{}";
+			needs_environment = true;
+		}
+		else
+		{
+			out << ",\"environment\":{}";
+			needs_environment = true;
+		}
+		out << "}";
+	}
+	{ // the ground is always a textured lambertian:
+		std::string src = asset("ground.albedo.png");
+		write_png(directory / src, size, 4, checker_rgba(size, glm::vec3(0.6f), glm::vec3(0.35f), 8));
+		textures_written += 1;
+		writer.object() << "{\"type\":\"MATERIAL\",\"name\":\"ground\",\"lambertian\":{\"albedo\":{\"src\":" << quote(src) << ",\"format\":\"srgb\"}}}";
+	}
+
+	// meshes pair geometry i % geometries with a material (every material once, then random), so instances reuse both:
+	std::vector<std::string> mesh_names;
+	for (uint32_t i = 0; i < settings.meshes; ++i)
+	{
+		std::string name = "mesh" + std::to_string(i);
+		mesh_names.emplace_back(name);
+		write_mesh(name, geometries[i % geometries.size()], material_names[i < settings.materials ? i : pick(settings.materials)]);
+	}
+	write_mesh("ground", ground, "ground");
+
+	// nodes, each instance hangs off a random earlier node a level above the bottom (or is a root):
+	std::vector<Node> nodes;
+	std::vector<uint32_t> roots;
+	std::vector<uint32_t> parents; // nodes that can still take children
+	nodes.reserve(size_t(settings.nodes) + settings.suns + settings.spheres + settings.spots + 2);
+	for (uint32_t i = 0; i < settings.nodes; ++i)
+	{
+		Node node;
+		node.name = "node" + std::to_string(i);
+		node.mesh = mesh_names[pick(uint32_t(mesh_names.size()))];
+		node.rotation = glm::angleAxis(uniform(0.0f, 2.0f * float(M_PI)), glm::vec3(0.0f, 0.0f, 1.0f));
+		bool root = parents.empty() || uniform(0.0f, 1.0f) < 1.0f / float(settings.depth);
+		if (root)
+		{
+			node.translation = glm::vec3(uniform(-settings.extent, settings.extent), uniform(-settings.extent, settings.extent), uniform(0.5f, 3.0f));
+			node.scale = glm::vec3(uniform(0.5f, 2.0f));
+			roots.emplace_back(uint32_t(nodes.size()));
+		}
+		else
+		{
+			uint32_t parent = parents[pick(uint32_t(parents.size()))];
+			node.level = nodes[parent].level + 1;
+			node.translation = glm::vec3(uniform(-1.5f, 1.5f), uniform(-1.5f, 1.5f), uniform(0.5f, 1.5f));
+			node.scale = glm::vec3(uniform(0.4f, 0.8f));
+			nodes[parent].children.emplace_back(uint32_t(nodes.size()));
+		}
+		if (node.level + 1 < settings.depth)
+			parents.emplace_back(uint32_t(nodes.size()));
+		nodes.emplace_back(std::move(node));
+	}
+	uint32_t instance_count = uint32_t(nodes.size());
+	{
+		Node node;
+		node.name = "ground";
+		node.mesh = "ground";
+		roots.emplace_back(uint32_t(nodes.size()));
+		nodes.emplace_back(std::move(node));
+	}
+
+	// lights, all roots; only spot lights cast shadows in the viewer:
+	glm::vec3 sun_direction = glm::normalize(glm::vec3(0.4f, 0.3f, 1.0f));
+	auto light_node = [&](std::string const &name, glm::vec3 translation, glm::vec3 forward)
+	{
+		Node node;
+		node.name = name;
+		node.light = name;
+		node.translation = translation;
+		// lights shine down their local -z:
+		glm::vec3 up = std::abs(forward.z) > 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+		node.rotation = glm::quatLookAt(glm::normalize(forward), up);
+		roots.emplace_back(uint32_t(nodes.size()));
+		nodes.emplace_back(std::move(node));
+	};
+	for (uint32_t i = 0; i < settings.suns; ++i)
+	{
+		std::string name = "sun" + std::to_string(i);
+		glm::vec3 toward = i == 0 ? sun_direction : glm::normalize(glm::vec3(uniform(-1.0f, 1.0f), uniform(-1.0f, 1.0f), uniform(0.2f, 1.0f)));
+		light_node(name, glm::vec3(0.0f, 0.0f, 20.0f), -toward);
+		writer.object() << "{\"type\":\"LIGHT\",\"name\":" << quote(name) << ",\"tint\":" << writer.vec(glm::vec3(1.0f, 0.95f, 0.9f))
+						<< ",\"sun\":{\"angle\":0.02,\"strength\":" << (i == 0 ? 3.0f : 0.5f) << "}}";
+	}
+	for (uint32_t i = 0; i < settings.spheres; ++i)
+	{
+		std::string name = "sphere" + std::to_string(i);
+		light_node(name, glm::vec3(uniform(-settings.extent, settings.extent), uniform(-settings.extent, settings.extent), uniform(2.0f, 6.0f)), glm::vec3(0.0f, 0.0f, -1.0f));
+		writer.object() << "{\"type\":\"LIGHT\",\"name\":" << quote(name) << ",\"tint\":" << writer.vec(glm::mix(glm::vec3(1.0f), random_color(), 0.5f))
+						<< ",\"sphere\":{\"radius\":0.1,\"power\":" << uniform(50.0f, 200.0f) << ",\"limit\":" << settings.extent * 0.5f << "}}";
+	}
+	for (uint32_t i = 0; i < settings.spots; ++i)
+	{
+		std::string name = "spot" + std::to_string(i);
+		glm::vec3 position(uniform(-settings.extent, settings.extent), uniform(-settings.extent, settings.extent), uniform(6.0f, 12.0f));
+		glm::vec3 target(position.x + uniform(-4.0f, 4.0f), position.y + uniform(-4.0f, 4.0f), 0.0f);
+		light_node(name, position, target - position);
+		std::ostream &out = writer.object();
+		out << "{\"type\":\"LIGHT\",\"name\":" << quote(name) << ",\"tint\":" << writer.vec(glm::mix(glm::vec3(1.0f), random_color(), 0.5f));
+		if (settings.shadow != 0)
+			out << ",\"shadow\":" << settings.shadow;
+		out << ",\"spot\":{\"radius\":0.1,\"power\":" << uniform(200.0f, 800.0f) << ",\"limit\":" << settings.extent
+			<< ",\"fov\":" << uniform(0.5f, 1.2f) << ",\"blend\":" << uniform(0.05f, 0.3f) << "}}";
+	}
+
+	{ // a camera looking over the whole scene:
+		Node node;
+		node.name = "main";
+		node.camera = "main";
+		node.translation = glm::vec3(-1.1f * settings.extent, -1.1f * settings.extent, 0.6f * settings.extent);
+		node.rotation = glm::quatLookAt(glm::normalize(glm::vec3(0.0f, 0.0f, 1.0f) - node.translation), glm::vec3(0.0f, 0.0f, 1.0f));
+		roots.emplace_back(uint32_t(nodes.size()));
+		nodes.emplace_back(std::move(node));
+		writer.object() << "{\"type\":\"CAMERA\",\"name\":\"main\",\"perspective\":{\"aspect\":1.77778,\"vfov\":0.8,\"near\":0.1,\"far\":"
+						<< 5.0f * settings.extent << "}}";
+	}
+
+	if (needs_environment)
+	{
+		std::string src = asset("environment.png");
+		write_environment(directory / src, settings.environment_size, sun_direction);
+		textures_written += 1;
+		writer.object() << "{\"type\":\"ENVIRONMENT\",\"name\":\"sky\",\"radiance\":{\"src\":" << quote(src) << ",\"type\":\"cube\",\"format\":\"rgbe\"}}";
+	}
+
+	// drivers animate distinct instances, their first key is the node's own transform:
+	uint32_t driver_count = std::min(settings.drivers, instance_count);
+	std::vector<uint32_t> animated(instance_count);
+	for (uint32_t i = 0; i < instance_count; ++i)
+		animated[i] = i;
+	for (uint32_t i = 0; i < driver_count; ++i)
+		std::swap(animated[i], animated[i + pick(instance_count - i)]);
+	for (uint32_t i = 0; i < driver_count; ++i)
+	{
+		Node const &node = nodes[animated[i]];
+		std::vector<float> times, values;
+		for (uint32_t k = 0; k < settings.keys; ++k)
+			times.emplace_back(settings.duration * float(k) / float(settings.keys - 1));
+
+		char const *channel = nullptr;
+		char const *interpolation = nullptr;
+		if (i % 3 == 0)
+		{
+			channel = "translation";
+			interpolation = (i % 2) ? "STEP" : "LINEAR";
+			for (uint32_t k = 0; k < settings.keys; ++k)
+			{
+				glm::vec3 offset = (k == 0 || k + 1 == settings.keys) ? glm::vec3(0.0f) : glm::vec3(uniform(-2.0f, 2.0f), uniform(-2.0f, 2.0f), uniform(0.0f, 2.0f));
+				glm::vec3 t = node.translation + offset;
+				values.insert(values.end(), {t.x, t.y, t.z});
+			}
+		}
+		else if (i % 3 == 1)
+		{
+			channel = "rotation";
+			interpolation = "SLERP";
+			for (uint32_t k = 0; k < settings.keys; ++k)
+			{
+				float angle = 2.0f * float(M_PI) * float(k) / float(settings.keys - 1);
+				glm::quat r = node.rotation * glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+				values.insert(values.end(), {r.x, r.y, r.z, r.w});
+			}
+		}
+		else
+		{
+			channel = "scale";
+			interpolation = "LINEAR";
+			for (uint32_t k = 0; k < settings.keys; ++k)
+			{
+				glm::vec3 s = node.scale * (k % 2 ? uniform(0.6f, 1.4f) : 1.0f);
+				values.insert(values.end(), {s.x, s.y, s.z});
+			}
+		}
+		writer.object() << "{\"type\":\"DRIVER\",\"name\":" << quote("driver" + std::to_string(i)) << ",\"node\":" << quote(node.name)
+						<< ",\"channel\":\"" << channel << "\",\"times\":" << writer.list(times) << ",\"values\":" << writer.list(values)
+						<< ",\"interpolation\":\"" << interpolation << "\"}";
+	}
+
+	for (Node const &node : nodes)
+	{
+		std::ostream &out = writer.object();
+		out << "{\"type\":\"NODE\",\"name\":" << quote(node.name)
+			<< ",\"translation\":" << writer.vec(node.translation)
+			<< ",\"rotation\":" << writer.quat(node.rotation)
+			<< ",\"scale\":" << writer.vec(node.scale);
+		if (!node.children.empty())
+		{
+			out << ",\"children\":[";
+			for (size_t c = 0; c < node.children.size(); ++c)
+				out << (c ? "," : "") << quote(nodes[node.children[c]].name);
+			out << "]";
+		}
+		if (!node.mesh.empty())
+			out << ",\"mesh\":" << quote(node.mesh);
+		if (!node.camera.empty())
+			out << ",\"camera\":" << quote(node.camera);
+		if (!node.light.empty())
+			out << ",\"light\":" << quote(node.light);
+		out << "}";
+	}
+
+	{
+		std::ostream &out = writer.object();
+		out << "{\"type\":\"SCENE\",\"name\":" << quote(stem) << ",\"roots\":[";
+		for (size_t r = 0; r < roots.size(); ++r)
+			out << (r ? "," : "") << quote(nodes[roots[r]].name);
+		out << "]}";
+	}
+	writer.out << "\n]\n";
+
+	std::ofstream file(out_path, std::ios::binary);
+	file << writer.out.str();
+	if (!file)
+		throw std::runtime_error("Failed to write '" + out_path.string() + "'.");
+
+	return SceneGenStats{
+		.instances = instance_count,
+		.roots = uint32_t(roots.size()),
+		.vertices = vertices_written,
+		.material_counts = material_counts,
+		.drivers = driver_count,
+		.textures = textures_written,
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// the scene-gen generator: a synthetic s72-v2 scene plus its .b72 meshes and .png textures; the output only depends on
+// the settings (including seed), so bin/scene-gen runs are reproducible and bin/microbench times the same scenes:
+struct SceneGenSettings
+{
+	std::string out = "scenes/generated/generated.s72";
+	uint32_t seed = 1;
+	uint32_t nodes = 1000;		// mesh instances
+	uint32_t depth = 3;			// levels in the node hierarchy (1 = every instance is a root)
+	uint32_t geometries = 8;	// distinct .b72 files
+	uint32_t meshes = 32;		// MESH objects (geometry + material pairs) the instances are spread over
+	uint32_t materials = 16;	// distinct materials
+	std::array<float, 4> mix{4.0f, 3.0f, 1.0f, 1.0f}; // relative weights of lambertian, pbr, mirror, environment materials
+	uint32_t suns = 1;
+	uint32_t spheres = 4;
+	uint32_t spots = 4;
+	uint32_t shadow = 512;		// shadow map size of each spot light (0 = no shadows)
+	uint32_t drivers = 16;		// animated nodes
+	uint32_t keys = 5;			// keyframes per driver
+	float duration = 4.0f;		// seconds of animation
+	uint32_t texture_size = 256;
+	uint32_t environment_size = 64; // cube face size
+	uint32_t detail = 24;		// tessellation of the finest geometry
+	float extent = 40.0f;		// instances are scattered over [-extent, extent]^2
+};
+
+struct SceneGenStats
+{
+	uint32_t instances = 0;
+	uint32_t roots = 0;
+	uint64_t vertices = 0;
+	std::array<uint32_t, 4> material_counts{}; // lambertian, pbr, mirror, environment
+	uint32_t drivers = 0;
+	uint32_t textures = 0;
+};
+
+// writes settings.out and its .b72 and .png files next to it (creating the directory); throws on failure:
+SceneGenStats generate_scene(SceneGenSettings const &settings);
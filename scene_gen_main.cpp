@@ -0,0 +1,191 @@
+// scene-gen: writes a synthetic s72-v2 scene (plus its .b72 meshes and .png textures) for stress testing the viewer
+// every size is a flag and the output only depends on the flags (including --seed), so runs are reproducible:
+//   bin/scene-gen --out scenes/stress/stress.s72 --nodes 20000 --depth 4 --spots 16 --shadow 1024
+//   bin/viewer --scene scenes/stress/stress.s72 --camera main --benchmark 60 600
+
+#include "scene_gen.hpp"
+
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+struct Options : SceneGenSettings
+{
+	void parse(int argc, char **argv);
+	static void usage(std::function<void(const char *, const char *)> const &callback);
+};
+
+void Options::parse(int argc, char **argv)
+{
+	for (int argi = 1; argi < argc; ++argi)
+	{
+		std::string arg = argv[argi];
+		auto next = [&]() -> std::string
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error(arg + " requires a parameter.");
+			argi += 1;
+			return argv[argi];
+		};
+		auto next_uint = [&]() -> uint32_t
+		{
+			std::string value = next();
+			size_t used = 0;
+			unsigned long parsed = 0;
+			try
+			{
+				parsed = std::stoul(value, &used);
+			}
+			catch (std::exception &)
+			{
+				used = 0;
+			}
+			if (used != value.size() || value.empty() || value[0] == '-')
+				throw std::runtime_error(arg + " expects a non-negative integer, got '" + value + "'.");
+			return uint32_t(parsed);
+		};
+		auto next_float = [&]() -> float
+		{
+			std::string value = next();
+			size_t used = 0;
+			float parsed = 0.0f;
+			try
+			{
+				parsed = std::stof(value, &used);
+			}
+			catch (std::exception &)
+			{
+				used = 0;
+			}
+			if (used != value.size() || value.empty())
+				throw std::runtime_error(arg + " expects a number, got '" + value + "'.");
+			return parsed;
+		};
+
+		if (arg == "--out")
+			out = next();
+		else if (arg == "--seed")
+			seed = next_uint();
+		else if (arg == "--nodes")
+			nodes = next_uint();
+		else if (arg == "--depth")
+			depth = next_uint();
+		else if (arg == "--geometries")
+			geometries = next_uint();
+		else if (arg == "--meshes")
+			meshes = next_uint();
+		else if (arg == "--materials")
+			materials = next_uint();
+		else if (arg == "--mix")
+		{
+			for (float &weight : mix)
+			{
+				weight = next_float();
+				if (weight < 0.0f)
+					throw std::runtime_error("--mix weights can't be negative.");
+			}
+		}
+		else if (arg == "--suns")
+			suns = next_uint();
+		else if (arg == "--spheres")
+			spheres = next_uint();
+		else if (arg == "--spots")
+			spots = next_uint();
+		else if (arg == "--shadow")
+			shadow = next_uint();
+		else if (arg == "--drivers")
+			drivers = next_uint();
+		else if (arg == "--keys")
+			keys = next_uint();
+		else if (arg == "--duration")
+			duration = next_float();
+		else if (arg == "--texture-size")
+			texture_size = next_uint();
+		else if (arg == "--environment-size")
+			environment_size = next_uint();
+		else if (arg == "--detail")
+			detail = next_uint();
+		else if (arg == "--extent")
+			extent = next_float();
+		else
+			throw std::runtime_error("Unrecognized argument '" + arg + "'.");
+	}
+
+	if (depth == 0)
+		throw std::runtime_error("--depth must be at least 1.");
+	if (geometries == 0 || meshes == 0 || materials == 0)
+		throw std::runtime_error("--geometries, --meshes and --materials must be at least 1.");
+	if (mix[0] + mix[1] + mix[2] + mix[3] <= 0.0f)
+		throw std::runtime_error("--mix needs at least one non-zero weight.");
+	if (keys < 2)
+		throw std::runtime_error("--keys must be at least 2.");
+	if (duration <= 0.0f || extent <= 0.0f)
+		throw std::runtime_error("--duration and --extent must be positive.");
+	if (texture_size == 0 || environment_size == 0)
+		throw std::runtime_error("--texture-size and --environment-size must be at least 1.");
+	if (detail < 3)
+		throw std::runtime_error("--detail must be at least 3.");
+	if (shadow != 0 && (shadow & (shadow - 1)) != 0)
+		throw std::runtime_error("--shadow must be a power of two (or 0).");
+}
+
+void Options::usage(std::function<void(const char *, const char *)> const &callback)
+{
+	callback("--out <file.s72>", "Write the scene here, its .b72 and .png files go next to it (default scenes/generated/generated.s72).");
+	callback("--seed <n>", "Seed for every random choice; the same flags and seed write the same scene (default 1).");
+	callback("--nodes <n>", "Number of mesh instances (default 1000).");
+	callback("--depth <n>", "Levels of the node hierarchy, 1 makes every instance a root (default 3).");
+	callback("--geometries <n>", "Distinct .b72 meshes, of increasing tessellation (default 8).");
+	callback("--meshes <n>", "MESH objects (geometry + material pairs) the instances reuse (default 32).");
+	callback("--materials <n>", "Distinct materials (default 16).");
+	callback("--mix <l> <p> <m> <e>", "Relative weights of lambertian, pbr, mirror and environment materials (default 4 3 1 1).");
+	callback("--suns <n>", "Sun lights (default 1).");
+	callback("--spheres <n>", "Sphere lights (default 4).");
+	callback("--spots <n>", "Spot lights (default 4).");
+	callback("--shadow <size>", "Shadow map size of each spot light, a power of two, 0 for none (default 512).");
+	callback("--drivers <n>", "Animated nodes, cycling translation, rotation and scale drivers (default 16).");
+	callback("--keys <n>", "Keyframes per driver (default 5).");
+	callback("--duration <s>", "Length of the animation in seconds (default 4).");
+	callback("--texture-size <n>", "Size of the generated albedo, roughness, metalness and normal textures (default 256).");
+	callback("--environment-size <n>", "Face size of the generated environment cubemap (default 64).");
+	callback("--detail <n>", "Tessellation of the finest geometry (default 24).");
+	callback("--extent <f>", "Instances are scattered over [-f, f] in x and y (default 40).");
+}
+
+int main(int argc, char **argv)
+{
+	// main wrapped in a try-catch so we can print some debug info about uncaught exceptions:
+	try
+	{
+		Options options;
+		try
+		{
+			options.parse(argc, argv);
+		}
+		catch (std::runtime_error &e)
+		{
+			std::cerr << "Failed to parse arguments:\n"
+					  << e.what() << std::endl;
+			std::cerr << "Usage:" << std::endl;
+			Options::usage([](const char *arg, const char *desc)
+						   { std::cerr << "    " << arg << "\n        " << desc << std::endl; });
+			return 1;
+		}
+
+		SceneGenStats stats = generate_scene(options);
+
+		std::cout << "Wrote " << options.out << ": " << stats.instances << " instances (" << stats.roots << " roots, depth " << options.depth << "), "
+				  << options.meshes << " meshes over " << options.geometries << " geometries (" << stats.vertices << " vertices), "
+				  << options.materials << " materials (" << stats.material_counts[0] << " lambertian, " << stats.material_counts[1] << " pbr, "
+				  << stats.material_counts[2] << " mirror, " << stats.material_counts[3] << " environment), "
+				  << options.suns << " suns, " << options.spheres << " spheres, " << options.spots << " spots, "
+				  << stats.drivers << " drivers, " << stats.textures << " textures." << std::endl;
+	}
+	catch (std::exception &e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,102 @@
+#include "scene_traversal.hpp"
+
+#include "mat4.hpp"
+
+#include <cmath>
+#include <variant>
+
+glm::mat4 spot_light_clip_from_world(Scene const &scene, Scene::LightInstance const &instance)
+{
+	Scene::Light const &light = scene.lights[instance.lights_index];
+	glm::mat4x4 world_from_light = scene.nodes[instance.local_to_world[0]].transform.local_to_parent();
+	for (size_t j = 1; j < instance.local_to_world.size(); ++j)
+	{
+		world_from_light *= scene.nodes[instance.local_to_world[j]].transform.local_to_parent();
+	}
+
+	glm::vec3 eye = glm::vec3(world_from_light[3]);
+	glm::vec3 forward = -glm::vec3(world_from_light[2]);
+	glm::vec3 target = eye + forward;
+
+	glm::vec3 world_up = glm::vec3(0.0f, 0.0f, 1.0f);
+	if (glm::abs(glm::dot(forward, world_up)) > 0.999f)
+	{
+		world_up = glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+	glm::vec3 right = glm::normalize(glm::cross(forward, world_up));
+	glm::vec3 up = glm::normalize(glm::cross(right, forward));
+
+	Scene::Light::Spotlight spot_param = std::get<Scene::Light::Spotlight>(light.additional_params);
+	float aspect = 1.0f;
+	float near = 0.02f;
+	float far;
+	if (spot_param.limit == 0.0f)
+	{
+		far = std::sqrt(glm::length(spot_param.power * light.tint) / (float(M_PI) * 4.0f * 0.001f));
+	}
+	else
+	{
+		far = spot_param.limit;
+	}
+
+	glm::mat4 projection = glm::make_mat4(perspective(spot_param.fov, aspect, near, far).data());
+	glm::mat4 view = glm::make_mat4(look_at(
+										eye.x, eye.y, eye.z,		  // eye
+										target.x, target.y, target.z, // target
+										up.x, up.y, up.z			  // up
+										)
+										.data());
+	return projection * view;
+}
+
+// depth first, transform_stack.back() is the world transform of the node being visited:
+static void traverse_node(SceneTraversal &traversal, Scene const &scene, std::vector<AABB> const &mesh_AABBs, uint32_t i)
+{
+	Scene::Node const &node = scene.nodes[i];
+	glm::mat4x4 local_to_parent = node.transform.local_to_parent();
+	if (traversal.transform_stack.empty())
+	{
+		traversal.transform_stack.push_back(local_to_parent);
+	}
+	else
+	{
+		traversal.transform_stack.push_back(traversal.transform_stack.back() * local_to_parent);
+	}
+
+	if (node.light_index != -1)
+	{
+		traversal.lights.emplace_back(SceneTraversal::Light{
+			.light_index = uint32_t(node.light_index),
+			.world_from_local = traversal.transform_stack.back(),
+		});
+	}
+
+	for (uint32_t child_index : node.children)
+	{
+		traverse_node(traversal, scene, mesh_AABBs, child_index);
+	}
+
+	if (node.mesh_index != -1)
+	{
+		glm::mat4x4 const &world_from_local = traversal.transform_stack.back();
+		traversal.meshes.emplace_back(SceneTraversal::Mesh{
+			.mesh_index = uint32_t(node.mesh_index),
+			.world_from_local = world_from_local,
+			.world_from_local_normal = glm::mat4x4(glm::inverse(glm::transpose(glm::mat3(world_from_local)))),
+			.obb = AABB_transform_to_OBB(world_from_local, mesh_AABBs[node.mesh_index]),
+		});
+	}
+
+	traversal.transform_stack.pop_back();
+}
+
+void SceneTraversal::update(Scene const &scene, std::vector<AABB> const &mesh_AABBs)
+{
+	meshes.clear();
+	lights.clear();
+	for (uint32_t root : scene.root_nodes)
+	{
+		transform_stack.clear();
+		traverse_node(*this, scene, mesh_AABBs, root);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "scene.hpp"
+#include "frustum_culling.hpp"
+#include "glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// the scene-side half of Render::update, kept free of Vulkan so bin/microbench times the code the viewer runs:
+
+// clip-from-world of a shadowed spot light: its cone as a square perspective looking down the light's -z, out to its
+// limit (or, with no limit, to where its power falls off):
+glm::mat4 spot_light_clip_from_world(Scene const &scene, Scene::LightInstance const &instance);
+
+// every mesh and light instance of the scene's hierarchy with its world transform; meshes come after their node's
+// children and lights before them, the order Render::update fills its instance and light arrays in:
+struct SceneTraversal
+{
+	struct Mesh
+	{
+		uint32_t mesh_index;
+		glm::mat4 world_from_local;
+		glm::mat4 world_from_local_normal;
+		OBB obb; // mesh_AABBs[mesh_index] in world space
+	};
+	std::vector<Mesh> meshes;
+
+	struct Light
+	{
+		uint32_t light_index;
+		glm::mat4 world_from_local;
+	};
+	std::vector<Light> lights;
+
+	// refills meshes and lights (keeping their storage from the last update):
+	void update(Scene const &scene, std::vector<AABB> const &mesh_AABBs);
+
+	std::vector<glm::mat4> transform_stack; // reused between updates
+};